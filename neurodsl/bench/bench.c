@@ -0,0 +1,187 @@
+// bench: compiler throughput on DSL inputs, compared against a stored baseline.
+//
+//   bench [--repeat N] [--baseline FILE] [--save] [--tolerance PCT] [--out FILE] file.nn
+//
+// Measures, best of N runs each:
+//   lex      MB/s and tokens/s for a standalone pass over the token stream
+//   parse    layers/s for parse_program (which lexes as it goes)
+//   codegen  bytes/s for generate_python
+// and the process's peak RSS. Run one input per process so the RSS figure
+// belongs to that input.
+//
+// With --baseline, results are compared against the lines for the same
+// input name in FILE; any metric more than PCT (default 10) worse fails the
+// run with exit status 1. --save replaces those lines with this run instead.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include "../include/compile.h"
+#include "../include/parser.h"
+#include "../include/codegen.h"
+
+typedef struct {
+    const char *name;
+    double value;
+    int higher_is_better;
+} Metric;
+
+enum { M_LEX_MB, M_LEX_TOK, M_PARSE, M_CODEGEN, M_RSS, M_COUNT };
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// generate_python reports on stdout; keep that out of the results
+static int quiet_fd = -1;
+static void quiet(int on) {
+    fflush(stdout);
+    if (on) {
+        quiet_fd = dup(1);
+        int null = open("/dev/null", O_WRONLY);
+        if (null >= 0) { dup2(null, 1); close(null); }
+    } else if (quiet_fd >= 0) {
+        dup2(quiet_fd, 1);
+        close(quiet_fd);
+        quiet_fd = -1;
+    }
+}
+
+static const char *base_name(const char *p) {
+    const char *s = strrchr(p, '/');
+    return s ? s + 1 : p;
+}
+
+// compare against (or with save, rewrite) the baseline lines "<input> <metric> <value>"
+static int baseline(const char *path, const char *input, Metric *m, int save, double tol) {
+    FILE *f = fopen(path, "r");
+    char line[512], **keep = NULL;
+    size_t n_keep = 0;
+    int regressions = 0, compared = 0;
+    while (f && fgets(line, sizeof(line), f)) {
+        char in[256], metric[64];
+        double v;
+        if (sscanf(line, "%255s %63s %lf", in, metric, &v) != 3) continue;
+        if (strcmp(in, input) != 0) {
+            if (save) { keep = (char**)realloc(keep, (n_keep + 1) * sizeof(char*)); keep[n_keep++] = strdup(line); }
+            continue;
+        }
+        if (save) continue;
+        for (int i = 0; i < M_COUNT; i++) {
+            if (strcmp(metric, m[i].name) != 0 || v <= 0) continue;
+            double change = (m[i].value - v) / v * 100.0;
+            int worse = m[i].higher_is_better ? change < -tol : change > tol;
+            printf("  %-15s %14.1f  baseline %14.1f  %+6.1f%%%s\n", m[i].name, m[i].value, v, change, worse ? "  REGRESSION" : "");
+            regressions += worse;
+            compared++;
+        }
+    }
+    if (f) fclose(f);
+    if (save) {
+        FILE *w = fopen(path, "w");
+        if (!w) { perror(path); return 1; }
+        for (size_t i = 0; i < n_keep; i++) { fputs(keep[i], w); free(keep[i]); }
+        for (int i = 0; i < M_COUNT; i++) fprintf(w, "%s %s %.1f\n", input, m[i].name, m[i].value);
+        fclose(w);
+        free(keep);
+        printf("  saved baseline for %s to %s\n", input, path);
+        return 0;
+    }
+    if (!compared) printf("  no baseline for %s in %s\n", input, path);
+    return regressions ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+    int repeat = 3, save = 0;
+    double tol = 10.0;
+    const char *base = NULL, *in = NULL, *out = "bench.out.py";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) repeat = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) base = argv[++i];
+        else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) tol = atof(argv[++i]);
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) out = argv[++i];
+        else if (strcmp(argv[i], "--save") == 0) save = 1;
+        else in = argv[i];
+    }
+    if (!in || (save && !base)) {
+        fprintf(stderr, "usage: %s [--repeat N] [--baseline FILE [--save]] [--tolerance PCT] [--out FILE] file.nn\n", argv[0]);
+        return 2;
+    }
+    if (repeat < 1) repeat = 1;
+
+    CompileContext ctx;
+    compile_ctx_init(&ctx, in, out);
+    double t_lex = 1e30, t_parse = 1e30, t_gen = 1e30;
+    size_t bytes = 0;
+    long long tokens = 0;
+    int layers = 0;
+
+    for (int r = 0; r < repeat; r++) {
+        if (lexer_init_file(&ctx.lex, in) != 0) return 1;
+        bytes = ctx.lex.len;
+        tokens = 0;
+        double t0 = now();
+        while (lexer_next(&ctx.lex).type != TOK_EOF) tokens++;
+        double t = now() - t0;
+        if (t < t_lex) t_lex = t;
+        lexer_free(&ctx.lex);
+    }
+
+    ProgramAST prog;
+    for (int r = 0; r < repeat; r++) {
+        arena_reset(&ctx.arena);
+        interner_reset(&ctx.strings);
+        if (lexer_init_file(&ctx.lex, in) != 0) return 1;
+        double t0 = now();
+        int rc = parse_program(&ctx, &prog);
+        double t = now() - t0;
+        if (rc != 0) { fprintf(stderr, "%s: Parsing failed.\n", in); return 1; }
+        if (t < t_parse) t_parse = t;
+        layers = 0;
+        for (int i = 0; i < prog.n_nets; i++) layers += prog.nets[i].model->n_layers;
+        if (r + 1 < repeat) lexer_free(&ctx.lex);
+    }
+    // codegen is timed on the first network
+    ModelAST *model = prog.nets[0].model;
+    if (analyze_model(&ctx.arena, ctx.diag, model, &ctx.cost) != 0) return 1;
+
+    struct stat st;
+    for (int r = 0; r < repeat; r++) {
+        quiet(1);
+        double t0 = now();
+        int rc = generate_python(&ctx, model, &prog.nets[0].train);
+        double t = now() - t0;
+        quiet(0);
+        if (rc != 0) return 1;
+        if (t < t_gen) t_gen = t;
+    }
+    if (stat(out, &st) != 0) { perror(out); return 1; }
+    remove(out);
+    compile_ctx_free(&ctx);
+
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    Metric m[M_COUNT] = {
+        [M_LEX_MB] = { "lex_mb_s", bytes / 1048576.0 / t_lex, 1 },
+        [M_LEX_TOK] = { "lex_tok_s", tokens / t_lex, 1 },
+        [M_PARSE] = { "parse_layers_s", layers / t_parse, 1 },
+        [M_CODEGEN] = { "codegen_mb_s", (double)st.st_size / 1048576.0 / t_gen, 1 },
+        [M_RSS] = { "peak_rss_kb", (double)ru.ru_maxrss, 0 },
+    };
+
+    const char *name = base_name(in);
+    printf("%s: %.2f MB, %lld tokens, %d layers, %.2f MB generated (best of %d)\n",
+           name, bytes / 1048576.0, tokens, layers, (double)st.st_size / 1048576.0, repeat);
+    printf("  lex      %10.1f MB/s  %10.2f Mtokens/s\n", m[M_LEX_MB].value, m[M_LEX_TOK].value / 1e6);
+    printf("  parse    %10.3f Mlayers/s\n", m[M_PARSE].value / 1e6);
+    printf("  codegen  %10.1f MB/s\n", m[M_CODEGEN].value);
+    printf("  peak RSS %10.0f KB\n", m[M_RSS].value);
+    return base ? baseline(base, name, m, save, tol) : 0;
+}
@@ -0,0 +1,227 @@
+// edit: edit-to-result latency of incremental re-parsing (src/reparse.c)
+// against parsing the whole edited text again.
+//
+//   edit [--edits N] [--seed S] [--verify] file.nn
+//
+// Applies N (default 50) random edits of each kind near the start, the
+// middle and the end of the file:
+//   units    change one dense layer's units=... value
+//   insert   a new dense layer on its own line
+//   delete   a dense layer's line (alternating with insert, so the size holds)
+//   comment  a comment line, which leaves the tokens as they were
+// and prints the median and p99 of reparse_edit next to the median of a
+// full parse of the same text (lex, parse_program, analyze_model per
+// network). --verify checks the document after every edit against a
+// fresh reparse_open of its text: tokens, layers and costs must match.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../include/compile.h"
+#include "../include/parser.h"
+#include "../include/reparse.h"
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned long long rng = 1;
+
+// xorshift64*, as in gen.c
+static unsigned rnd(unsigned n) {
+    rng ^= rng >> 12; rng ^= rng << 25; rng ^= rng >> 27;
+    return (unsigned)((rng * 2685821657736338717ULL) >> 33) % n;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+static FILE *null_diag;
+
+// what the editor would wait for without reparse.c
+static double full_parse(const char *src, size_t len) {
+    double t0 = now();
+    CompileContext ctx;
+    compile_ctx_init(&ctx, NULL, NULL);
+    ctx.diag = null_diag;
+    ProgramAST prog;
+    if (lexer_init_buffer(&ctx.lex, src, len) == 0 && parse_program(&ctx, &prog) == 0) {
+        for (int k = 0; k < prog.n_nets; k++) {
+            ModelCost c;
+            analyze_model(&ctx.arena, null_diag, prog.nets[k].model, &c);
+        }
+    }
+    compile_ctx_free(&ctx);
+    return now() - t0;
+}
+
+// start of the line of the first "    dense" line at or after offset at
+static size_t dense_line(const ReparseDoc *d, size_t at) {
+    const char *s = d->src, *end = s + d->len;
+    for (const char *p = s + at; p < end; p++) {
+        p = (const char*)memchr(p, '\n', (size_t)(end - p));
+        if (!p) break;
+        const char *q = p + 1;
+        while (q < end && (*q == ' ' || *q == '\t')) q++;
+        if (end - q > 6 && memcmp(q, "dense ", 6) == 0) return (size_t)(p + 1 - s);
+    }
+    return (size_t)-1;
+}
+
+static size_t line_end(const ReparseDoc *d, size_t at) {
+    const char *nl = (const char*)memchr(d->src + at, '\n', d->len - at);
+    return nl ? (size_t)(nl - d->src) + 1 : d->len;
+}
+
+enum { EDIT_UNITS, EDIT_INSERT, EDIT_DELETE, EDIT_COMMENT, EDIT_KINDS };
+static const char *const kind_names[EDIT_KINDS] = { "units", "insert", "delete", "comment" };
+
+// one edit of kind near at into e (text in buf); 1 when there is no dense layer there
+static int make_edit(const ReparseDoc *d, int kind, size_t at, TextEdit *e, char *buf, size_t n) {
+    size_t line = dense_line(d, at);
+    if (line == (size_t)-1) return 1;
+    size_t eol = line_end(d, line);
+    memset(e, 0, sizeof(*e));
+    e->text = buf;
+    switch (kind) {
+        case EDIT_UNITS: {
+            const char *u = NULL;
+            for (const char *p = d->src + line; p + 6 < d->src + eol && !u; p++)
+                if (memcmp(p, "units=", 6) == 0) u = p + 6;
+            if (!u) {
+                // dense without units: give it some
+                e->offset = eol - 1;
+                e->inserted = (size_t)snprintf(buf, n, " units=%u", 16 + rnd(240));
+                return 0;
+            }
+            e->offset = (size_t)(u - d->src);
+            while (e->offset + e->removed < eol && u[e->removed] >= '0' && u[e->removed] <= '9') e->removed++;
+            e->inserted = (size_t)snprintf(buf, n, "%u", 16 + rnd(240));
+            return 0;
+        }
+        case EDIT_INSERT:
+            e->offset = line;
+            e->inserted = (size_t)snprintf(buf, n, "    dense units=%u, activation=relu\n", 16 + rnd(240));
+            return 0;
+        case EDIT_DELETE:
+            e->offset = line;
+            e->removed = eol - line;
+            return 0;
+        default:
+            e->offset = line;
+            e->inserted = (size_t)snprintf(buf, n, "    # edited %u\n", rnd(1000));
+            return 0;
+    }
+}
+
+static int str_eq(const char *a, const char *b) {
+    return a == b || (a && b && strcmp(a, b) == 0);
+}
+
+// d against a document parsed from scratch; prints the first difference
+static int verify(const ReparseDoc *d) {
+    ReparseDoc f;
+    reparse_open(&f, d->src, d->len, null_diag);
+    const char *diff = NULL;
+    char where[96] = "";
+    if (f.ok != d->ok) diff = "parse status";
+    else if (f.n_toks != d->n_toks || memcmp(f.toks, d->toks, (size_t)f.n_toks * sizeof(Token)) != 0) diff = "tokens";
+    else if (f.prog.n_nets != d->prog.n_nets) diff = "network count";
+    for (int k = 0; !diff && k < f.prog.n_nets; k++) {
+        const ModelAST *a = d->prog.nets[k].model, *b = f.prog.nets[k].model;
+        const ReparseNet *ra = &d->nets[k], *rb = &f.nets[k];
+        snprintf(where, sizeof(where), " in network %s", b->name);
+        if (a->n_layers != b->n_layers) { diff = "layer count"; break; }
+        if (ra->open != rb->open || ra->close != rb->close || ra->open_line != rb->open_line) { diff = "body position"; break; }
+        if (ra->n_errors != rb->n_errors) { diff = "shape error count"; break; }
+        const ModelCost *ca = &ra->cost, *cb = &rb->cost;
+        if (ca->n != cb->n || memcmp(&ca->input, &cb->input, sizeof(TensorShape)) != 0 || ca->params != cb->params ||
+            ca->macs != cb->macs || ca->flops != cb->flops || ca->act_bytes != cb->act_bytes ||
+            ca->peak_act_bytes != cb->peak_act_bytes) { diff = "totals"; break; }
+        for (int i = 0; i < a->n_layers && !diff; i++) {
+            const Layer *x = &a->layers[i], *y = &b->layers[i];
+            snprintf(where, sizeof(where), " at layer %d (line %d) of network %s", i, y->line, b->name);
+            if (x->type != y->type || x->line != y->line || !str_eq(x->activation, y->activation) ||
+                memcmp(&x->p, &y->p, sizeof(x->p)) != 0) diff = "layer";
+            else if (ra->kw[i] != rb->kw[i]) diff = "layer token";
+            else if (memcmp(&ra->cost.layers[i], &rb->cost.layers[i], sizeof(LayerCost)) != 0 || ra->errors[i] != rb->errors[i]) diff = "layer cost";
+        }
+    }
+    if (diff) fprintf(stderr, "verify: %s differs%s\n", diff, where);
+    reparse_free(&f);
+    return diff != NULL;
+}
+
+int main(int argc, char **argv) {
+    int edits = 50, verifying = 0;
+    const char *in = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--edits") == 0 && i + 1 < argc) edits = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) rng = strtoull(argv[++i], NULL, 10) | 1;
+        else if (strcmp(argv[i], "--verify") == 0) verifying = 1;
+        else in = argv[i];
+    }
+    if (!in || edits < 1) {
+        fprintf(stderr, "usage: %s [--edits N] [--seed S] [--verify] file.nn\n", argv[0]);
+        return 2;
+    }
+    LexerState lx;
+    if (lexer_init_file(&lx, in) != 0) return 1;
+    null_diag = fopen("/dev/null", "w");
+    if (!null_diag) null_diag = stderr;
+
+    ReparseDoc d;
+    double t0 = now();
+    int rc = reparse_open(&d, lx.src, lx.len, null_diag);
+    double t_open = now() - t0;
+    lexer_free(&lx);
+    if (rc != 0) { fprintf(stderr, "%s does not compile cleanly\n", in); return 1; }
+    int layers = 0;
+    for (int k = 0; k < d.prog.n_nets; k++) layers += d.prog.nets[k].model->n_layers;
+    printf("%s: %zu bytes, %d tokens, %d layers, reparse_open %.2f ms\n", in, d.len, d.n_toks, layers, t_open * 1e3);
+    printf("%-8s %-6s %10s %10s %10s %8s %7s %8s %5s\n", "edit", "where", "median ms", "p99 ms", "full ms", "speedup", "parsed", "analysed", "full");
+
+    static const char *const where_names[] = { "start", "middle", "end" };
+    static const double where_at[] = { 0.0, 0.5, 0.98 };
+    double *lat = (double*)malloc((size_t)edits * sizeof(double)), *full = (double*)malloc((size_t)edits * sizeof(double));
+    char buf[128];
+    int failures = 0;
+    for (int kind = 0; kind < EDIT_KINDS; kind++) {
+        for (int w = 0; w < 3; w++) {
+            long long parsed = 0, analysed = 0;
+            int fulls = 0, n = 0;
+            for (int r = 0; r < edits; r++) {
+                // deletes alternate with inserts so the layer count holds
+                int k = kind == EDIT_DELETE && r % 2 ? EDIT_INSERT : kind;
+                TextEdit e;
+                if (make_edit(&d, k, (size_t)(d.len * where_at[w]), &e, buf, sizeof(buf)) != 0) break;
+                ReparseStats st;
+                reparse_edit(&d, &e, &st);
+                lat[n] = st.seconds;
+                full[n] = full_parse(d.src, d.len);
+                n++;
+                parsed += st.layers_parsed;
+                analysed += st.layers_analyzed;
+                fulls += st.full;
+                if (verifying && verify(&d)) failures++;
+            }
+            if (!n) continue;
+            qsort(lat, (size_t)n, sizeof(double), cmp_double);
+            qsort(full, (size_t)n, sizeof(double), cmp_double);
+            double med = lat[n / 2], p99 = lat[(n * 99) / 100], fm = full[n / 2];
+            printf("%-8s %-6s %10.3f %10.3f %10.2f %7.0fx %7.1f %8.1f %5d\n", kind_names[kind], where_names[w],
+                   med * 1e3, p99 * 1e3, fm * 1e3, med > 0 ? fm / med : 0.0, (double)parsed / n, (double)analysed / n, fulls);
+        }
+    }
+    if (verifying) printf("verify: %s\n", failures ? "FAILED" : "every edit matches a full parse");
+    free(lat);
+    free(full);
+    reparse_free(&d);
+    if (null_diag != stderr) fclose(null_diag);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,21 @@
+#!/bin/sh
+# Edit-to-result latency of incremental re-parsing (src/reparse.c) against a
+# full parse, on the synthetic inputs of bench/run.sh.
+#
+#   bench/edit.sh [LAYERS...] [-- bench/edit options]
+#
+# Default sizes are 1k, 100k and 1M layers. Pass -- --verify to check every
+# edit against a fresh parse of the edited text.
+set -e
+cd "$(dirname "$0")/.."
+mkdir -p bench/data
+gcc -O2 -o bench/data/gen bench/gen.c
+gcc -O2 -Iinclude -o bench/data/edit bench/edit.c $(ls src/*.c | grep -v 'src/main.c') -lpthread
+sizes=
+while [ $# -gt 0 ] && [ "$1" != "--" ]; do sizes="$sizes $1"; shift; done
+[ "$1" = "--" ] && shift
+for n in ${sizes:-1000 100000 1000000}; do
+    f=bench/data/model_$n.nn
+    [ -f "$f" ] || bench/data/gen "$n" --seed 1 --comments 10 --ws 2 > "$f"
+    bench/data/edit "$@" "$f"
+done
@@ -0,0 +1,20 @@
+#!/bin/sh
+# Compare the native backend with and without layer fusion on one model:
+# scratch memory, activation bytes kept out of memory and nn_forward latency.
+#
+#   bench/fusion.sh [MODEL.nn] [ITERATIONS]
+set -e
+cd "$(dirname "$0")/.."
+model=${1:-examples/example.nn}
+iters=${2:-2000}
+mkdir -p bench/data
+gcc -O2 -Iinclude -o bench/data/neurodsl src/*.c -lpthread
+for mode in fused unfused; do
+    flag=; [ $mode = unfused ] && flag=--no-fuse
+    echo "== $mode"
+    mkdir -p bench/data/$mode
+    bench/data/neurodsl $flag --report=memory --out-dir bench/data/$mode --target=c "$model" | grep -E '^(planned peak|fusion):'
+    stem=$(basename "$model" | sed 's/\.[^.]*$//')
+    cc -O3 -march=native -DNN_BENCH -o bench/data/$mode/forward bench/data/$mode/$stem.c -lm
+    bench/data/$mode/forward "$iters"
+done
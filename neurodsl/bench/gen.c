@@ -0,0 +1,87 @@
+// gen: deterministic synthetic NeuroDSL programs for benchmarking.
+//
+//   gen LAYERS [--seed N] [--comments PCT] [--ws N] [--params min|mixed|full]
+//
+// Writes a valid program with LAYERS layers to stdout: input, a conv2d /
+// maxpool2d front end, flatten, then dense layers and an output layer.
+// The same arguments always produce the same bytes.
+//
+//   --comments PCT   percentage of layers preceded by a comment line (default 10)
+//   --ws N           up to N extra blanks between tokens (default 0)
+//   --params         parameters per layer: none given, random subset, all (default mixed)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned long long rng;
+
+// xorshift64*
+static unsigned rnd(unsigned n) {
+    rng ^= rng >> 12; rng ^= rng << 25; rng ^= rng >> 27;
+    return (unsigned)((rng * 2685821657736338717ULL) >> 33) % n;
+}
+
+static int ws_max;
+static void gap(void) {
+    putchar(' ');
+    for (int k = ws_max ? (int)rnd((unsigned)ws_max + 1) : 0; k > 0; k--) putchar(rnd(4) ? ' ' : '\t');
+}
+
+enum { PARAMS_MIN, PARAMS_MIXED, PARAMS_FULL };
+static int params_mode = PARAMS_MIXED;
+
+static int want(void) {
+    return params_mode == PARAMS_FULL || (params_mode == PARAMS_MIXED && rnd(3) != 0);
+}
+
+static const char *const acts[] = { "relu", "relu", "tanh", "sigmoid", "linear" };
+
+static void dense(const char *kw, unsigned units, int is_out) {
+    int first = 1;
+    printf("    %s", kw);
+    if (want()) { gap(); printf("units=%u", units); first = 0; }
+    if (want()) {
+        if (!first) putchar(',');
+        gap();
+        printf("activation=%s", is_out ? "softmax" : acts[rnd(5)]);
+    }
+    putchar('\n');
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s LAYERS [--seed N] [--comments PCT] [--ws N] [--params min|mixed|full]\n", argv[0]);
+        return 2;
+    }
+    long long layers = atoll(argv[1]);
+    unsigned long long seed = 1;
+    unsigned comments = 10;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--seed") == 0) seed = strtoull(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "--comments") == 0) comments = (unsigned)atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--ws") == 0) ws_max = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--params") == 0) {
+            const char *p = argv[i + 1];
+            params_mode = strcmp(p, "min") == 0 ? PARAMS_MIN : strcmp(p, "full") == 0 ? PARAMS_FULL : PARAMS_MIXED;
+        } else { fprintf(stderr, "unknown option %s\n", argv[i]); return 2; }
+    }
+    if (layers < 6) layers = 6;
+    rng = seed * 0x9E3779B97F4A7C15ULL + 1;
+
+    static char buf[1 << 20];
+    setvbuf(stdout, buf, _IOFBF, sizeof(buf));
+    printf("# synthetic benchmark model: %lld layers, seed %llu\n", layers, seed);
+    printf("network Bench%lld {\n", layers);
+    printf("    input (1, 28, 28)\n");
+    printf("    conv2d filters=%u, kernel=3, activation=relu\n", 8 + rnd(25));
+    printf("    maxpool2d size=2\n");
+    printf("    flatten\n");
+    for (long long i = 4; i < layers - 1; i++) {
+        if (comments && rnd(100) < comments) printf("    # block %lld\n", i);
+        dense("dense", 16 + rnd(241), 0);
+    }
+    dense("output", 10, 1);
+    printf("}\n\ntrain {\n    optimizer: adam\n    loss: categorical_crossentropy\n    epochs: 1\n}\n");
+    return fflush(stdout) != 0;
+}
@@ -0,0 +1,207 @@
+// idx: images/s of runtime/nnidx.c reading IDX files, decoding alone and
+// feeding one generated model.
+//
+//   gcc -O3 -march=native -Iinclude [-DNN_MODEL='"model.c"'] bench/idx.c runtime/nnidx.c -lpthread -lm
+//   idx IMAGES [LABELS] [--batch N] [--passes P] [--slots S] [--weights model.nnw]
+//   idx --synth N IMAGES LABELS [HxWxC]     write N random images (default 28x28x1) and labels
+//
+// Rows decode inline (slots 0, nnidx_next decodes on the caller's thread)
+// and ahead on the loader's thread. Built with NN_MODEL, each batch also
+// runs through nn_forward_batch, with random weights unless --weights maps
+// trained ones (then the accuracy is printed as well). "wait" is the share
+// of the run the caller spent in nnidx_next. bench/idx.sh builds and runs it.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../runtime/nnidx.h"
+
+#ifdef NN_MODEL
+#include NN_MODEL
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+#endif
+
+static void put_be32(FILE *f, unsigned v) {
+    unsigned char b[4] = { (unsigned char)(v >> 24), (unsigned char)(v >> 16), (unsigned char)(v >> 8), (unsigned char)v };
+    fwrite(b, 1, 4, f);
+}
+
+static int synth(long n, const char *images, const char *labels, const char *shape) {
+    int h = 28, w = 28, c = 1;
+    if (shape && sscanf(shape, "%dx%dx%d", &h, &w, &c) != 3) { fprintf(stderr, "bad shape %s, expected HxWxC\n", shape); return 1; }
+    FILE *fi = fopen(images, "wb"), *fl = fopen(labels, "wb");
+    if (!fi || !fl) { perror(!fi ? images : labels); return 1; }
+    unsigned char head[4] = { 0, 0, NNIDX_UBYTE, (unsigned char)(c > 1 ? 4 : 3) };
+    fwrite(head, 1, 4, fi);
+    put_be32(fi, (unsigned)n); put_be32(fi, (unsigned)h); put_be32(fi, (unsigned)w);
+    if (c > 1) put_be32(fi, (unsigned)c);
+    head[3] = 1;
+    fwrite(head, 1, 4, fl);
+    put_be32(fl, (unsigned)n);
+    size_t size = (size_t)h * w * c;
+    unsigned char *px = (unsigned char*)malloc(size);
+    srand(1);
+    for (long i = 0; i < n; i++) {
+        for (size_t j = 0; j < size; j++) px[j] = (unsigned char)(rand() & 255);
+        fwrite(px, 1, size, fi);
+        fputc(rand() % 10, fl);
+    }
+    free(px);
+    if (fclose(fi) != 0 || fclose(fl) != 0) { perror("write"); return 1; }
+    printf("Wrote %ld %dx%dx%d images to %s and labels to %s\n", n, h, w, c, images, labels);
+    return 0;
+}
+
+typedef struct {
+    double images_per_s, wait;
+    long long correct, labelled;
+} Run;
+
+#ifdef NN_MODEL
+typedef struct {
+    nn_weights *w;
+    void *scratch;
+    float *y;
+} Model;
+#else
+typedef void Model;
+#endif
+
+// one pass of cfg, every batch through m when there is one
+static int run(const NnidxConfig *cfg, Model *m, Run *r) {
+    const char *err = NULL;
+    NnidxLoader *l = nnidx_create(cfg, &err);
+    if (!l) { fprintf(stderr, "nnidx_create: %s\n", err); return 1; }
+    memset(r, 0, sizeof(*r));
+    NnidxBatch b;
+    while (nnidx_next(l, &b) == 0) {
+#ifdef NN_MODEL
+        if (!m) continue;
+        nn_forward_batch(m->w, b.x, m->y, b.n, m->scratch);
+        for (int i = 0; b.y && i < b.n; i++) {
+            const float *y = m->y + (size_t)i * NN_OUT_SIZE;
+            int k = 0;
+            for (int j = 1; j < NN_OUT_SIZE; j++) k = y[j] > y[k] ? j : k;
+            r->correct += k == b.y[i];
+            r->labelled++;
+        }
+#else
+        (void)m;
+#endif
+    }
+    NnidxStats s;
+    nnidx_stats(l, &s);
+    nnidx_destroy(l);
+    r->images_per_s = s.images_per_s;
+    r->wait = s.seconds > 0.0 ? s.wait_s / s.seconds : 0.0;
+    return 0;
+}
+
+static void print_row(const char *mode, const Run *r, int accuracy) {
+    printf("%-22s %12.0f %6.0f%%", mode, r->images_per_s, 100.0 * r->wait);
+    if (accuracy && r->labelled) printf(" %9.4f", (double)r->correct / r->labelled);
+    printf("\n");
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 5 && strcmp(argv[1], "--synth") == 0) return synth(atol(argv[2]), argv[3], argv[4], argc > 5 ? argv[5] : NULL);
+    const char *paths[2] = { NULL, NULL }, *weights = NULL;
+    int n_paths = 0;
+    NnidxConfig cfg;
+    nnidx_config_default(&cfg);
+    int slots = cfg.slots;
+    cfg.passes = 3;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) cfg.batch = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--passes") == 0 && i + 1 < argc) cfg.passes = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--slots") == 0 && i + 1 < argc) slots = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--weights") == 0 && i + 1 < argc) weights = argv[++i];
+        else if (argv[i][0] == '-') { fprintf(stderr, "unknown option %s\n", argv[i]); return 1; }
+        else if (n_paths < 2) paths[n_paths++] = argv[i];
+    }
+    if (n_paths == 0 || cfg.passes <= 0 || slots <= 0) {
+        fprintf(stderr, "usage: %s IMAGES [LABELS] [--batch N] [--passes P] [--slots S] [--weights model.nnw]\n", argv[0]);
+        return 1;
+    }
+    NnidxFile images, labels;
+    const char *err = nnidx_open(&images, paths[0]);
+    if (err) { fprintf(stderr, "%s: %s\n", paths[0], err); return 1; }
+    if (paths[1]) {
+        if ((err = nnidx_open(&labels, paths[1])) != NULL) { fprintf(stderr, "%s: %s\n", paths[1], err); return 1; }
+        cfg.labels = &labels;
+    }
+    cfg.images = &images;
+#ifdef NN_MODEL
+    cfg.h = NN_IN_H; cfg.w = NN_IN_W; cfg.c = NN_IN_C;
+#else
+    cfg.h = images.rank >= 3 ? images.dims[1] : 1;
+    cfg.w = images.rank >= 3 ? images.dims[2] : (int)images.item_size;
+    cfg.c = images.rank >= 4 ? images.dims[3] : 1;
+#endif
+    printf("%s: %zu images of %dx%dx%d, batch %d, %d passes per row\n", paths[0], images.count, cfg.h, cfg.w, cfg.c, cfg.batch, cfg.passes);
+    printf("%-22s %12s %7s%s\n", "mode", "images/s", "wait", weights ? "  accuracy" : "");
+
+    char mode[64];
+    Run r;
+    cfg.slots = 0;
+    if (run(&cfg, NULL, &r)) return 1;
+    print_row("decode, inline", &r, 0);
+    cfg.slots = slots;
+    if (run(&cfg, NULL, &r)) return 1;
+    snprintf(mode, sizeof(mode), "decode, %d slots", slots);
+    print_row(mode, &r, 0);
+
+#ifdef NN_MODEL
+    nn_weights w;
+    nn_weight_file wf;
+    float *blob = NULL;
+    if (weights) {
+        if ((err = nn_map_weights(&wf, &w, weights)) != NULL) { fprintf(stderr, "%s: %s\n", weights, err); return 1; }
+    } else {
+        blob = (float*)malloc(sizeof(float) * (NN_PARAM_COUNT > 0 ? NN_PARAM_COUNT : 1));
+        srand(1);
+        for (long i = 0; i < NN_PARAM_COUNT; i++) blob[i] = ((float)rand() / RAND_MAX - 0.5f) * 0.1f;
+        nn_bind_weights(&w, blob);
+    }
+    Model m;
+    m.w = &w;
+    m.scratch = malloc(NN_SCRATCH_BYTES > 0 ? NN_SCRATCH_BYTES : 1);
+    m.y = (float*)malloc(sizeof(float) * NN_OUT_SIZE * (size_t)cfg.batch);
+
+    // the model alone on one decoded batch: the most the loader has to keep up with
+    float *x = (float*)calloc((size_t)NN_IN_SIZE * cfg.batch, sizeof(float));
+    long iters = 0;
+    double t0 = now_s(), t1 = t0;
+    while (t1 - t0 < 0.5 || iters < 3) {
+        nn_forward_batch(&w, x, m.y, cfg.batch, m.scratch);
+        iters++;
+        t1 = now_s();
+    }
+    printf("%-22s %12.0f %7s\n", "forward only", iters * cfg.batch / (t1 - t0), "-");
+    free(x);
+
+    cfg.slots = 0;
+    if (run(&cfg, &m, &r)) return 1;
+    print_row("forward, inline", &r, weights != NULL);
+    cfg.slots = slots;
+    if (run(&cfg, &m, &r)) return 1;
+    snprintf(mode, sizeof(mode), "forward, %d slots", slots);
+    print_row(mode, &r, weights != NULL);
+
+    free(m.scratch);
+    free(m.y);
+    if (weights) nn_unmap_weights(&wf);
+    free(blob);
+#else
+    (void)weights;
+#endif
+    if (cfg.labels) nnidx_close(&labels);
+    nnidx_close(&images);
+    return 0;
+}
@@ -0,0 +1,26 @@
+#!/bin/sh
+# Images/s of the IDX loader (runtime/nnidx.c) decoding on its own and
+# feeding one generated model. Uses the MNIST test set from bench/data/mnist
+# when it is there (t10k-images-idx3-ubyte, t10k-labels-idx1-ubyte, already
+# gunzipped), otherwise 10000 synthetic images in the model's input shape.
+#
+#   bench/idx.sh [MODEL.nn] [bench/idx options]
+set -e
+cd "$(dirname "$0")/.."
+model=${1:-examples/example.nn}
+[ $# -gt 0 ] && shift
+mkdir -p bench/data/idx
+gcc -O2 -Iinclude -o bench/data/neurodsl src/*.c -lpthread
+bench/data/neurodsl --out-dir bench/data/idx --target=c "$model" > /dev/null
+stem=$(basename "$model" | sed 's/\.[^.]*$//')
+cc -O3 -march=native -Iinclude -DNN_MODEL="\"data/idx/$stem.c\"" -o bench/data/idx/idx \
+    bench/idx.c runtime/nnidx.c -lpthread -lm
+images=bench/data/mnist/t10k-images-idx3-ubyte
+labels=bench/data/mnist/t10k-labels-idx1-ubyte
+if [ ! -f "$images" ]; then
+    shape=$(sed -n 's/^#define NN_IN_\([HWC]\) \([0-9]*\)$/\2/p' "bench/data/idx/$stem.c" | paste -sd x)
+    images=bench/data/idx/images-$shape-idx
+    labels=bench/data/idx/labels-idx
+    [ -f "$images" ] || bench/data/idx/idx --synth 10000 "$images" "$labels" "$shape"
+fi
+bench/data/idx/idx "$images" "$labels" "$@"
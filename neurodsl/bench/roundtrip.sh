@@ -0,0 +1,39 @@
+#!/bin/sh
+# Round trip of the binary AST (--emit=ast-bin, src/astbin.c) against the
+# text parser: each input is compiled from its source and from the .nab
+# files emitted for it, to Python and to C, and the outputs must be
+# byte-identical. Covers examples/ and the 1k and 100k-layer inputs of
+# bench/run.sh; pass layer counts or .nn files to change that. Exits 1 on
+# any mismatch.
+#
+#   bench/roundtrip.sh [LAYERS | FILE.nn ...]
+set -e
+cd "$(dirname "$0")/.."
+mkdir -p bench/data
+gcc -O2 -o bench/data/gen bench/gen.c
+gcc -O2 -Iinclude -o bench/data/neurodsl src/*.c -lpthread
+nd=bench/data/neurodsl
+work=bench/data/roundtrip
+status=0
+for a in ${*:-examples/*.nn 1000 100000}; do
+    case $a in
+        *.nn) f=$a ;;
+        *) f=bench/data/model_$a.nn
+           [ -f "$f" ] || bench/data/gen "$a" --seed 1 --comments 10 --ws 2 > "$f" ;;
+    esac
+    stem=$(basename "$f" .nn)
+    rm -rf "$work/$stem"
+    mkdir -p "$work/$stem/nab" "$work/$stem/text" "$work/$stem/bin"
+    $nd --out-dir "$work/$stem/nab" --emit=ast-bin "$f" > /dev/null
+    for target in python c; do
+        $nd --out-dir "$work/$stem/text" --target=$target "$f" > /dev/null
+        $nd --out-dir "$work/$stem/bin" --target=$target "$work/$stem/nab"/*.nab > /dev/null
+    done
+    if diff -r "$work/$stem/text" "$work/$stem/bin" > "$work/$stem.diff"; then
+        echo "ok        $f ($(ls "$work/$stem/nab" | wc -l | tr -d ' ') .nab, $(ls "$work/$stem/text" | wc -l | tr -d ' ') outputs)"
+    else
+        echo "MISMATCH  $f: see $work/$stem.diff"
+        status=1
+    fi
+done
+exit $status
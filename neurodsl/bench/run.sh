@@ -0,0 +1,20 @@
+#!/bin/sh
+# Build the benchmark tools, generate the synthetic inputs and run them.
+#
+#   bench/run.sh [LAYERS...]          compare against bench/baseline.txt
+#   SAVE=1 bench/run.sh [LAYERS...]   record this machine's baseline instead
+#
+# Default sizes are 1k, 100k and 1M layers; pass e.g. 10000000 for the
+# 10M-layer input (about 300 MB of source). Exits 1 on any regression.
+set -e
+cd "$(dirname "$0")/.."
+mkdir -p bench/data
+gcc -O2 -o bench/data/gen bench/gen.c
+gcc -O2 -Iinclude -o bench/data/bench bench/bench.c $(ls src/*.c | grep -v 'src/main.c') -lpthread
+status=0
+for n in ${*:-1000 100000 1000000}; do
+    f=bench/data/model_$n.nn
+    [ -f "$f" ] || bench/data/gen "$n" --seed 1 --comments 10 --ws 2 > "$f"
+    bench/data/bench --repeat 5 ${SAVE:+--save} --baseline bench/baseline.txt --out bench/data/out.py "$f" || status=1
+done
+exit $status
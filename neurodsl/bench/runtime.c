@@ -0,0 +1,120 @@
+// runtime: throughput and latency of runtime/nnrt.c on one generated model,
+// swept over worker counts and micro-batch sizes.
+//
+//   gcc -O3 -march=native -Iinclude -DNN_MODEL='"model.c"' bench/runtime.c runtime/nnrt.c src/threadpool.c -lpthread -lm
+//   runtime [--requests N] [--threads 1,2,4] [--batch 1,4,16,64] [--delay US] [--rate R] [--no-pin]
+//
+// Inputs are submitted from the main thread, as fast as the queue takes
+// them or at R requests/s with --rate. Weights and inputs are random.
+// The first row is a plain nn_forward loop on the main thread for
+// reference. bench/runtime.sh generates the model and runs the sweep.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../runtime/nnrt.h"
+#include "../include/threadpool.h"
+
+#ifndef NN_MODEL
+#error "build with -DNN_MODEL='\"path/to/model.c\"' (neurodsl --target=c output)"
+#endif
+#include NN_MODEL
+
+#define N_INPUTS 64
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void sleep_until(double t) {
+    double d = t - now_s();
+    if (d <= 0.0) return;
+    struct timespec ts = { (time_t)d, (long)((d - (double)(time_t)d) * 1e9) };
+    nanosleep(&ts, NULL);
+}
+
+// comma separated positive integers; 0 entries are dropped
+static int parse_list(const char *s, int *out, int max) {
+    int n = 0;
+    while (*s && n < max) {
+        int v = atoi(s);
+        if (v > 0) out[n++] = v;
+        const char *c = strchr(s, ',');
+        if (!c) break;
+        s = c + 1;
+    }
+    return n;
+}
+
+int main(int argc, char **argv) {
+    long requests = 20000;
+    int threads[16], nthreads = 0, batches[16], nbatches = 0, pin = 1;
+    double delay_us = 200.0, rate = 0.0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--requests") == 0 && i + 1 < argc) requests = atol(argv[++i]);
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) nthreads = parse_list(argv[++i], threads, 16);
+        else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) nbatches = parse_list(argv[++i], batches, 16);
+        else if (strcmp(argv[i], "--delay") == 0 && i + 1 < argc) delay_us = atof(argv[++i]);
+        else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) rate = atof(argv[++i]);
+        else if (strcmp(argv[i], "--no-pin") == 0) pin = 0;
+        else { fprintf(stderr, "unknown option %s\n", argv[i]); return 1; }
+    }
+    if (nthreads == 0) {
+        int ncpu = tp_default_threads();
+        for (int t = 1; t < ncpu && nthreads < 15; t *= 2) threads[nthreads++] = t;
+        threads[nthreads++] = ncpu;
+    }
+    if (nbatches == 0) {
+        static const int def[] = { 1, 4, 16, 64 };
+        for (int i = 0; i < 4; i++) batches[nbatches++] = def[i];
+    }
+
+    float *blob = (float*)malloc(sizeof(float) * (NN_PARAM_COUNT > 0 ? NN_PARAM_COUNT : 1));
+    float *xs = (float*)malloc(sizeof(float) * NN_IN_SIZE * N_INPUTS);
+    float *ys = (float*)malloc(sizeof(float) * NN_OUT_SIZE * (size_t)requests);
+    void *scratch = malloc(NN_SCRATCH_BYTES > 0 ? NN_SCRATCH_BYTES : 1);
+    srand(1);
+    for (long i = 0; i < NN_PARAM_COUNT; i++) blob[i] = ((float)rand() / RAND_MAX - 0.5f) * 0.1f;
+    for (long i = 0; i < NN_IN_SIZE * N_INPUTS; i++) xs[i] = (float)rand() / RAND_MAX;
+    nn_weights w;
+    nn_bind_weights(&w, blob);
+
+    long direct = requests < 2000 ? requests : 2000;
+    double t0 = now_s();
+    for (long i = 0; i < direct; i++) nn_forward(&w, xs + (i % N_INPUTS) * NN_IN_SIZE, ys + i * NN_OUT_SIZE, scratch);
+    double direct_rps = direct / (now_s() - t0);
+    printf("model: %d -> %d floats, %ld B scratch per worker; %ld requests per run, max delay %.0f us%s\n",
+           NN_IN_SIZE, NN_OUT_SIZE, (long)NN_SCRATCH_BYTES, requests, delay_us, rate > 0.0 ? "" : ", submitted as fast as possible");
+    printf("%-8s %-6s %12s %9s %10s %10s %10s %7s\n", "threads", "batch", "req/s", "speedup", "p50 us", "p99 us", "mean batch", "busy");
+    printf("%-8s %-6s %12.0f %9s %10s %10s %10s %7s\n", "direct", "-", direct_rps, "1.00x", "-", "-", "-", "-");
+
+    NnrtModel m = { nn_forward_batch, &w, NN_IN_SIZE, NN_OUT_SIZE, NN_SCRATCH_BYTES };
+    for (int ti = 0; ti < nthreads; ti++) {
+        for (int bi = 0; bi < nbatches; bi++) {
+            NnrtConfig c;
+            nnrt_config_default(&c);
+            c.threads = threads[ti];
+            c.max_batch = batches[bi];
+            c.max_delay_us = delay_us;
+            c.pin = pin;
+            Nnrt *rt = nnrt_create(&m, &c);
+            if (!rt) { fprintf(stderr, "nnrt_create failed\n"); return 1; }
+            double start = now_s();
+            for (long i = 0; i < requests; i++) {
+                if (rate > 0.0) sleep_until(start + i / rate);
+                nnrt_submit(rt, xs + (i % N_INPUTS) * NN_IN_SIZE, ys + i * NN_OUT_SIZE, NULL, NULL);
+            }
+            nnrt_drain(rt);
+            NnrtStats s;
+            nnrt_stats(rt, &s);
+            nnrt_destroy(rt);
+            printf("%-8d %-6d %12.0f %8.2fx %10.0f %10.0f %10.1f %6.0f%%\n",
+                   threads[ti], batches[bi], s.throughput, s.throughput / direct_rps, s.p50_us, s.p99_us, s.mean_batch, 100.0 * s.busy);
+        }
+    }
+    free(blob); free(xs); free(ys); free(scratch);
+    return 0;
+}
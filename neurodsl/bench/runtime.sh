@@ -0,0 +1,16 @@
+#!/bin/sh
+# Throughput and latency of the batched runtime (runtime/nnrt.c) on one
+# model, swept over worker counts and micro-batch sizes.
+#
+#   bench/runtime.sh [MODEL.nn] [bench/runtime options]
+set -e
+cd "$(dirname "$0")/.."
+model=${1:-examples/example.nn}
+[ $# -gt 0 ] && shift
+mkdir -p bench/data/runtime
+gcc -O2 -Iinclude -o bench/data/neurodsl src/*.c -lpthread
+bench/data/neurodsl --out-dir bench/data/runtime --target=c "$model" > /dev/null
+stem=$(basename "$model" | sed 's/\.[^.]*$//')
+cc -O3 -march=native -Iinclude -DNN_MODEL="\"data/runtime/$stem.c\"" -o bench/data/runtime/runtime \
+    bench/runtime.c runtime/nnrt.c src/threadpool.c -lpthread -lm
+bench/data/runtime/runtime "$@"
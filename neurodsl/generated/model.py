@@ -1,29 +1,87 @@
-import os
-os.environ['TF_CPP_MIN_LOG_LEVEL']='2'
-import numpy as np
-import tensorflow as tf
-from tensorflow.keras import layers, models
-
-def build_model():
-    model = models.Sequential()
-    model.add(layers.Input(shape=(28, 28, 1)))
-    model.add(layers.Conv2D(32, (3, 3), activation='relu', padding='same'))
-    model.add(layers.MaxPooling2D(pool_size=(2,2)))
-    model.add(layers.Flatten())
-    model.add(layers.Dense(64, activation='relu'))
-    model.add(layers.Dense(10, activation='softmax'))
-    return model
-
-if __name__ == '__main__':
-    model = build_model()
-    model.summary()
-    model.compile(optimizer='adam', loss='categorical_crossentropy', metrics=['accuracy'])
-    from tensorflow.keras.datasets import mnist
-    (x_train, y_train), (x_test, y_test) = mnist.load_data()
-    x_train = x_train.reshape(-1, 28, 28, 1).astype('float32') / 255.0
-    x_test  = x_test.reshape(-1, 28, 28, 1).astype('float32') / 255.0
-    y_train = tf.keras.utils.to_categorical(y_train, 10)
-    y_test  = tf.keras.utils.to_categorical(y_test, 10)
-    model.fit(x_train, y_train, epochs=2, batch_size=64, validation_split=0.1)
-    loss, acc = model.evaluate(x_test, y_test)
-    print('Test loss:', loss, 'Test accuracy:', acc)
+import os
+os.environ['TF_CPP_MIN_LOG_LEVEL']='2'
+import numpy as np
+import tensorflow as tf
+from tensorflow.keras import layers, models
+
+def build_model():
+    model = models.Sequential()
+    model.add(layers.Input(shape=(28, 28, 1)))
+    model.add(layers.Conv2D(32, (3, 3), activation='relu', padding='same'))
+    model.add(layers.MaxPooling2D(pool_size=(2,2)))
+    model.add(layers.Flatten())
+    model.add(layers.Dense(64, activation='relu'))
+    model.add(layers.Dense(10, activation='softmax'))
+    return model
+
+def preprocess(x, y):
+    # works on single examples and on whole batches
+    x = tf.reshape(tf.cast(x, tf.float32) / 255.0, tf.concat([tf.shape(y), [28, 28, 1]], 0))
+    return x, tf.one_hot(tf.cast(y, tf.int32), 10)
+
+def make_dataset(x, y, training):
+    ds = tf.data.Dataset.from_tensor_slices((x, y))
+    if training:
+        ds = ds.shuffle(len(x))
+    ds = ds.batch(64).map(preprocess, num_parallel_calls=tf.data.AUTOTUNE)
+    return ds.prefetch(tf.data.AUTOTUNE)
+
+def round_sat(v):
+    # nnq_sat: clamp to +-127, round half away from zero
+    v = np.clip(v, -127.0, 127.0)
+    return np.trunc(v + np.copysign(0.5, v))
+
+NNW_LAYERS = 6   # layers in the network; weight file tensors are keyed by layer index
+NNW_FIRST = 1    # network index of model.layers[0]
+
+def export_weights(model, path, calib=None, fp16=False, int8=False):
+    """Write the weights as a weight file (.nnw) that the generated C code maps and uses in
+    place. float32 kernels and biases always; fp16 adds half precision kernels, int8 adds int8
+    kernels with per-output-channel scales and calib the int8 calibration."""
+    import struct
+    tensors = []  # (layer, role, dtype, array); roles kernel 0, bias 1, scale 2, calib 3
+    for k, layer in enumerate(model.layers):
+        for role, v in enumerate(layer.get_weights()[:2]):
+            v = np.asarray(v, '<f4')
+            tensors.append((k + NNW_FIRST, role, 0, v))
+            if role == 0 and fp16:
+                tensors.append((k + NNW_FIRST, role, 1, v.astype('<f2')))
+            if role == 0 and int8:
+                s = np.abs(v).reshape(-1, v.shape[-1]).max(axis=0) / 127.0
+                s[s == 0] = 1.0
+                tensors.append((k + NNW_FIRST, role, 2, round_sat(v / s).astype('i1')))
+                tensors.append((k + NNW_FIRST, 2, 0, s.astype('<f4')))
+    if calib is not None:
+        tensors.append((NNW_LAYERS, 3, 0, np.asarray(calib, '<f4')))
+    align = lambda n: (n + 63) // 64 * 64
+    offsets, records = [], []
+    end = data = align(64 + 32 * len(tensors))
+    for layer, role, dtype, v in tensors:
+        offsets.append(end)
+        records.append(struct.pack('<IHBB4IQ', layer, role, dtype, v.ndim, *(list(v.shape) + [0] * (4 - v.ndim)), end))
+        end = align(end + v.nbytes)
+    flags = (1 if fp16 else 0) | (2 if int8 else 0) | (4 if calib is not None else 0)
+    with open(path, 'wb') as f:
+        f.write(struct.pack('<8s6I4Q', b'NDSLWTS', 1, 0x01020304, 64, NNW_LAYERS, len(tensors), flags, 64, data, end, 0))
+        f.write(b''.join(records))
+        for (_, _, _, v), off in zip(tensors, offsets):
+            f.seek(off)
+            f.write(v.tobytes())
+        f.truncate(end)
+    print('Wrote %d tensors (%d bytes) to %s' % (len(tensors), end, path))
+
+if __name__ == '__main__':
+    model = build_model()
+    model.summary()
+    model.compile(optimizer='adam', loss='categorical_crossentropy', metrics=['accuracy'])
+    from tensorflow.keras.datasets import mnist
+    (x_train, y_train), (x_test, y_test) = mnist.load_data()
+    n_val = len(x_train) // 10
+    train_ds = make_dataset(x_train[:-n_val], y_train[:-n_val], True)
+    val_ds = make_dataset(x_train[-n_val:], y_train[-n_val:], False)
+    model.fit(train_ds, epochs=2, validation_data=val_ds)
+    loss, acc = model.evaluate(make_dataset(x_test, y_test, False))
+    print('Test loss:', loss, 'Test accuracy:', acc)
+    # trained weights for the C backend, beside this script as <script>.nnw (model.py writes
+    # model.nnw): nn_map_weights(&wf, &w, "model.nnw")
+    export_weights(model, os.path.splitext(os.path.abspath(__file__))[0] + '.nnw')
@@ -0,0 +1,88 @@
+# NeuroDSL grammar, LL(1).
+#
+# tools/llgen reads this file, computes FIRST/FOLLOW sets and writes the
+# predictive parse table to include/grammar.h and src/grammar.c:
+#
+#   gcc tools/llgen.c -o llgen && ./llgen grammar/neurodsl.g include/grammar.h src/grammar.c
+#
+# UPPER names are terminals (TokenType values without the TOK_ prefix),
+# lower names are nonterminals and @names are semantic actions run by
+# parser.c when they reach the top of the parse stack. An empty
+# alternative is epsilon.
+
+%start program
+
+# reserved words and the token the lexer returns for them
+%keyword network   NETWORK
+%keyword input     INPUT
+%keyword conv2d    CONV2D
+%keyword maxpool2d MAXPOOL2D
+%keyword flatten   FLATTEN
+%keyword dense     DENSE
+%keyword output    OUTPUT
+%keyword train     TRAIN
+
+# parameter names; the lexer tags matching identifiers with PARAM_<NAME>
+%param filters kernel size units activation
+%param optimizer loss epochs dataset
+%param batch_size prefetch cache shuffle_buffer mixed_precision jit_compile
+
+# any number of networks and train blocks; a train block names the network
+# it configures, or without a name applies to the network just before it
+program     : block blocks EOF ;
+
+blocks      : block blocks
+            | ;
+
+block       : NETWORK IDENTIFIER @model_begin LBRACE layers RBRACE
+            | TRAIN train_for @train_begin LBRACE train_items RBRACE ;
+
+train_for   : IDENTIFIER @train_name
+            | ;
+
+layers      : layer layers
+            | ;
+
+layer       : INPUT @input_begin LPAREN dim comma_opt dim comma_opt dim rparen_opt
+            | CONV2D @layer_begin params
+            | MAXPOOL2D @layer_begin params
+            | FLATTEN @layer_begin
+            | DENSE @layer_begin params
+            | OUTPUT @layer_begin params ;
+
+dim         : NUMBER @input_dim ;
+
+params      : param params
+            | ;
+
+param       : IDENTIFIER @param_name EQUALS value @layer_param comma_opt ;
+
+train_items : train_item train_items
+            | ;
+
+train_item  : IDENTIFIER @param_name sep value @train_param comma_opt ;
+
+sep         : COLON
+            | EQUALS ;
+
+# a list [a, b, c] or a range a..b sweeps the parameter over its values
+value       : scalar
+            | LBRACKET scalars RBRACKET ;
+
+scalars     : scalar comma_opt scalars
+            | ;
+
+scalar      : NUMBER @value_item range_opt
+            | IDENTIFIER @value_item ;
+
+range_opt   : DOTDOT NUMBER @value_range
+            | ;
+
+comma_opt   : COMMA
+            | ;
+
+rparen_opt  : RPAREN
+            | ;
+
+# on a token with no table entry these nonterminals warn and skip it
+%recover layers train_items
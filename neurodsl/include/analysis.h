@@ -0,0 +1,43 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <stdio.h>
+#include "ast.h"
+
+// Static shape inference and cost model over a ModelAST. Shapes follow the
+// Keras semantics of the generated Python: conv2d keeps h and w ('same'
+// padding), maxpool2d floors h/size and w/size, dense acts on the last axis.
+typedef struct {
+    int h, w, c;    // rank 1 tensors use c only (h = w = 1)
+    int rank;       // 3 or 1
+} TensorShape;
+
+typedef struct {
+    TensorShape in, out;
+    long long params;
+    long long macs;         // multiply-accumulates
+    long long flops;        // 2 per MAC plus comparisons for pooling
+    long long act_bytes;    // float32 output activation
+} LayerCost;
+
+typedef struct {
+    LayerCost *layers;      // one per ModelAST layer, arena-owned
+    int n;
+    TensorShape input;      // from the input layer, 28x28x1 when absent
+    long long params, macs, flops;
+    long long act_bytes;        // sum over all layer outputs
+    long long peak_act_bytes;   // largest input+output pair live at once
+} ModelCost;
+
+#define ANALYSIS_DEFAULT_INPUT { 28, 28, 1, 3 }
+
+int analyze_model(Arena *a, FILE *diag, const ModelAST *m, ModelCost *out); // 0 on success, shape errors go to diag
+// the steps of analyze_model: layer i on the running shape (updated), then its share of the totals
+int analyze_layer(FILE *diag, const Layer *L, int i, TensorShape *shape, LayerCost *lc);   // error count
+void cost_accumulate(ModelCost *c, const Layer *L, const LayerCost *lc);
+long long shape_size(TensorShape s);
+void cost_print_table(FILE *f, const ModelAST *m, const ModelCost *c);
+void cost_print_json(FILE *f, const ModelAST *m, const ModelCost *c);
+const char *layer_type_name(LayerType t);
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Bump allocator for everything a compilation builds. Allocations are never
+// freed individually; the whole arena is reset or released at once.
+typedef struct ArenaChunk ArenaChunk;
+
+typedef struct {
+    ArenaChunk *head;       // current chunk, older chunks chained behind it
+    void *last;             // most recent allocation (can be grown in place)
+    size_t n_allocs;        // allocation count since init/reset
+    size_t bytes;           // bytes handed out since init/reset
+    size_t n_chunks;        // chunks currently held (each one malloc)
+} Arena;
+
+void arena_init(Arena *a);
+void *arena_alloc(Arena *a, size_t n);                      // zeroed, 16-byte aligned
+void *arena_grow(Arena *a, void *p, size_t old_n, size_t new_n); // in place when p is the last allocation
+char *arena_strndup(Arena *a, const char *s, size_t n);
+void arena_reset(Arena *a);     // drop all allocations, keep the first chunk for reuse
+void arena_release(Arena *a);   // free every chunk
+
+// String interning: equal strings share one arena copy, so they can be
+// compared by pointer.
+typedef struct {
+    const char **slots;
+    size_t cap, count;
+} Interner;
+
+const char *intern(Interner *in, Arena *a, const char *s, size_t n);
+void interner_reset(Interner *in);
+void interner_free(Interner *in);
+
+#endif
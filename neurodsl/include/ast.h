@@ -1,47 +1,104 @@
-#ifndef AST_H
-#define AST_H
-
-typedef enum {
-    LAYER_INPUT,
-    LAYER_CONV2D,
-    LAYER_MAXPOOL2D,
-    LAYER_FLATTEN,
-    LAYER_DENSE,
-    LAYER_OUTPUT
-} LayerType;
-
-typedef struct Layer {
-    LayerType type;
-    // parameters
-    int i_ch, i_h, i_w;     // input shape (channels, height, width)
-    int filters;
-    int kernel;
-    int pool_size;
-    int units;
-    char activation[32];
-    struct Layer *next;
-} Layer;
-
-typedef struct {
-    char name[64];
-    Layer *layers;
-} ModelAST;
-
-typedef struct {
-    char optimizer[32];
-    char loss[64];
-    int epochs;
-    char dataset[64];     // NEW: dataset name, e.g., "mnist"
-} TrainAST;
-
-typedef struct {
-    ModelAST *model;
-    TrainAST train;
-} ProgramAST;
-
-// helpers
-Layer *layer_new();
-void layer_free_all(Layer *head);
-void model_free(ModelAST *m);
-
-#endif
+#ifndef AST_H
+#define AST_H
+
+#include "arena.h"
+
+typedef enum {
+    LAYER_INPUT,
+    LAYER_CONV2D,
+    LAYER_MAXPOOL2D,
+    LAYER_FLATTEN,
+    LAYER_DENSE,
+    LAYER_OUTPUT
+} LayerType;
+
+// One fixed-size record per layer; only the parameters of its own kind are stored.
+typedef struct {
+    const char *activation;     // interned, NULL when not given
+    union {
+        struct { int ch, h, w; } input;     // input shape (channels, height, width)
+        struct { int filters, kernel; } conv;
+        struct { int size; } pool;
+        struct { int units; } dense;        // dense and output
+    } p;
+    LayerType type;
+    int line;                   // source line, 1-based; 0 when unknown
+} Layer;
+
+typedef struct {
+    const char *name;
+    Layer *layers;      // contiguous, n_layers long, arena-owned
+    int n_layers;
+    int cap_layers;
+} ModelAST;
+
+#define TRAIN_PREFETCH_AUTO 0       // tf.data.AUTOTUNE
+#define TRAIN_PREFETCH_NONE (-1)    // prefetch: 0
+
+typedef enum {
+    PRECISION_FLOAT32,
+    PRECISION_MIXED_FLOAT16,    // mixed_precision: true | float16
+    PRECISION_MIXED_BFLOAT16    // mixed_precision: bfloat16, the faster one on CPUs
+} TrainPrecision;
+
+typedef struct {
+    char optimizer[32];
+    char loss[64];
+    int epochs;
+    char dataset[64];     // NEW: dataset name, e.g., "mnist"
+    // input pipeline and training performance; 0 means the codegen default
+    int batch_size;
+    int prefetch;         // batches, or one of TRAIN_PREFETCH_*
+    int cache;            // cache the preprocessed training set after the first epoch
+    int shuffle_buffer;   // default: the whole training set
+    TrainPrecision mixed_precision;
+    int jit_compile;      // XLA-compile the training step
+} TrainAST;
+
+// A parameter value as the parser accepted it: numbers, booleans and
+// enums in num, identifiers (interned) in str.
+typedef struct {
+    int num;
+    const char *str;    // NULL for numbers
+} ParamValue;
+
+#define SWEEP_MAX_VALUES 65536         // values on one axis (a range a..b)
+#define SWEEP_MAX_VARIANTS 1000000     // variants of one network
+
+// A swept parameter, written as a list [a, b, c] or a range a..b. The
+// variants of a network are the cartesian product of its axes with the
+// last axis varying fastest; values[0] is what the network itself holds.
+typedef struct {
+    int layer;          // layer index, -1 for a train option
+    int param;          // ParamId (grammar.h)
+    ParamValue *values; // n of them, arena-owned
+    int n;
+} SweepAxis;
+
+// one network block and the train options that apply to it
+typedef struct {
+    ModelAST *model;
+    TrainAST train;     // epochs = 1 and codegen defaults when no train block configures it
+    SweepAxis *axes;    // arena-owned, n_axes of them; none for a plain network
+    int n_axes;
+} NetworkAST;
+
+typedef struct {
+    NetworkAST *nets;   // in source order, arena-owned
+    int n_nets;
+} ProgramAST;
+
+// helpers; all AST memory comes from the compilation's arena
+ModelAST *model_new(Arena *a, const char *name, size_t name_len);
+Layer *model_add_layer(ModelAST *m, Arena *a, LayerType type);
+void layer_set_param(Layer *l, int param, const ParamValue *v);     // a value the parser accepted for l
+void train_set_param(TrainAST *t, int param, const ParamValue *v);
+
+// effective parameters: the value every backend uses when the source leaves one out
+int layer_filters(const Layer *l);          // conv2d, default 32
+int layer_kernel(const Layer *l);           // conv2d, default 3
+int layer_pool(const Layer *l);             // maxpool2d, default 2
+int layer_units(const Layer *l);            // dense 64, output 10
+const char *layer_activation(const Layer *l); // relu, output softmax
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef ASTBIN_H
+#define ASTBIN_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ast.h"
+#include "compile.h"
+
+// Binary AST (--emit=ast-bin, *.nab). Position independent: everything is
+// addressed by byte offsets from the start of the file, so a mapping can be
+// read in place. Fields are in the writer's byte order; the endian word
+// lets a reader on the other kind of host reject the file.
+//
+//   header        AstBinHeader, 96 bytes (72 in version 1)
+//   layer table   n_layers records of layer_stride bytes, 8-byte aligned
+//   string table  NUL-terminated strings; offset 0 is always "" (absent)
+//
+// Readers accept any layer_stride >= sizeof(AstBinLayer), so later versions
+// can append fields to a record without breaking older tools.
+
+#define ASTBIN_MAGIC "NDSLAST"      // 8 bytes with the NUL
+#define ASTBIN_VERSION 2             // 2: train pipeline options
+#define ASTBIN_ENDIAN 0x01020304u   // reads back byte-swapped on a big-endian host
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t endian;
+    uint32_t header_size;
+    uint32_t layer_stride;
+    uint32_t n_layers;
+    uint32_t name;              // string offsets
+    uint64_t layers_off;
+    uint64_t strings_off;
+    uint64_t strings_size;
+    uint32_t optimizer, loss, dataset;
+    int32_t epochs;
+    // version 2
+    int32_t batch_size, prefetch, cache, shuffle_buffer, mixed_precision, jit_compile;
+} AstBinHeader;
+
+#define ASTBIN_HEADER_V1 72
+
+typedef struct {
+    uint32_t type;              // LayerType
+    uint32_t activation;        // string offset, 0 when not given
+    int32_t p[3];               // input ch,h,w; conv filters,kernel; pool size; dense units
+    uint32_t line;              // source line, 0 when unknown (always 0 before it was recorded)
+} AstBinLayer;
+
+// A validated view of a binary AST in memory. Nothing is copied: the
+// accessors read the buffer directly.
+typedef struct {
+    const char *base;
+    size_t size;
+    const AstBinHeader *h;
+    void *map;                  // astbin_open's mapping, NULL for astbin_view
+} AstBin;
+
+int astbin_is(const char *data, size_t size);       // starts with the magic
+int astbin_view(AstBin *b, const char *data, size_t size, FILE *diag); // checks header and bounds; 0 on success
+int astbin_open(AstBin *b, const char *path, FILE *diag);   // mmap path and view it
+void astbin_close(AstBin *b);
+
+const AstBinLayer *astbin_layer(const AstBin *b, uint32_t i);
+const char *astbin_str(const AstBin *b, uint32_t off);      // "" for offsets out of range
+
+int astbin_write(CompileContext *ctx, const ModelAST *m, const TrainAST *t); // ctx->out or out_path, 0 on success
+int astbin_load(CompileContext *ctx, const AstBin *b, ProgramAST *prog);     // AST in ctx->arena for the backends
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+// On-disk cache of generated outputs, keyed by a hash of the source bytes,
+// the compiler version and the codegen options (plus the output stem for a
+// source that may sweep, whose manifest names its files). One file per entry,
+// <dir>/<key>.out; a source with several outputs (networks, sweep
+// variants) keeps all of them in one bundle entry, so a hit restores the
+// whole set. An
+// entry's mtime is its last use, and the oldest entries are evicted once
+// the directory grows past max_bytes. Safe to share between the threads
+// of a batch compile.
+typedef struct {
+    char dir[1024];
+    unsigned long long max_bytes;
+    unsigned long long total_bytes;     // approximate size of all entries
+    unsigned long hits, misses, stores, evictions;
+    pthread_mutex_t mu;
+} CompileCache;
+
+int cache_open(CompileCache *c, const char *dir, unsigned long long max_bytes); // creates dir; 0 on success
+void cache_close(CompileCache *c);      // folds this run's counters into <dir>/stats
+
+uint64_t hash64(const void *data, size_t len, uint64_t seed);
+uint64_t cache_key(const void *src, size_t len, const char *options_key);
+
+// 0 on hit; *outputs is the number of files written (a bundle's go to compile_output_path names)
+int cache_fetch(CompileCache *c, uint64_t key, const char *out_path, int *outputs);
+void cache_store(CompileCache *c, uint64_t key, const char *out_path); // copy a fresh output into the cache
+void cache_store_bundle(CompileCache *c, uint64_t key, const char *out_path, const char *const *suffixes, int n);
+void cache_print_stats(CompileCache *c, FILE *f);
+
+int make_dirs(const char *dir);         // mkdir -p; 0 when dir exists afterwards
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef CODEGEN_H
+#define CODEGEN_H
+
+#include "ast.h"
+#include "compile.h"
+
+// Weight file (.nnw): written by the generated Keras script after training,
+// mapped and used in place by the generated C. Little-endian; the endian
+// word reads back byte-swapped on a big-endian host.
+//
+//   header   64 bytes: magic[8], version, endian, header_size, n_layers,
+//            n_tensors, flags (u32 each), tensors_off, data_off, file_size (u64)
+//   tensors  n_tensors records of 32 bytes: layer (u32), role (u16),
+//            dtype (u8), rank (u8), dims[4] (u32), offset (u64)
+//   data     each tensor at an NNW_ALIGN-aligned offset
+//
+// Tensors are keyed by their layer's index in ModelAST and n_layers must
+// match the network. Float32 kernels (Keras layouts) and biases are always
+// there; fp16 kernels, int8 kernels with per-output-channel scales and the
+// int8 calibration (layer n_layers, n_layers + 1 values) are optional.
+#define NNW_MAGIC "NDSLWTS"
+#define NNW_VERSION 1
+#define NNW_ENDIAN 0x01020304u
+#define NNW_ALIGN 64
+#define NNW_HEADER 64
+#define NNW_RECORD 32
+enum { NNW_KERNEL, NNW_BIAS, NNW_SCALE, NNW_CALIB };            // role
+enum { NNW_F32, NNW_F16, NNW_I8 };                              // dtype
+enum { NNW_HAS_F16 = 1, NNW_HAS_I8 = 2, NNW_HAS_CALIB = 4 };    // flags
+
+void codegen_options_key(const CodegenOptions *o, char *buf, size_t n); // stable text form of o
+int generate_code(CompileContext *ctx, ModelAST *m, TrainAST *t);   // dispatch on ctx->opts.target
+int generate_python(CompileContext *ctx, ModelAST *m, TrainAST *t); // writes ctx->out or ctx->out_path, 0 on success
+int generate_c(CompileContext *ctx, ModelAST *m, TrainAST *t);      // codegen_c.c: self-contained forward pass
+FILE *codegen_open(CompileContext *ctx);                            // ctx->out, or out_path opened for writing
+int codegen_close(CompileContext *ctx, FILE *f, const char *what);  // finish the output, "Generated <what> model at ..."
+void codegen_c_workspace(const ModelAST *m, const ModelCost *c, const FusedModel *fm, size_t *ws); // per-layer temporaries of the C kernels
+
+#endif
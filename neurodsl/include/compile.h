@@ -0,0 +1,71 @@
+#ifndef COMPILE_H
+#define COMPILE_H
+
+#include <stdio.h>
+#include "lexer.h"
+#include "arena.h"
+#include "cache.h"
+#include "analysis.h"
+#include "stats.h"
+#include "fuse.h"
+
+#define NEURODSL_VERSION "0.3.0"
+
+typedef enum {
+    TARGET_PYTHON,      // Keras script
+    TARGET_C,           // native forward pass (codegen_c.c)
+    TARGET_AST_BIN      // --emit=ast-bin: the parsed AST itself (astbin.h)
+} CodegenTarget;
+
+// --report selections
+enum {
+    REPORT_COST = 1,        // per-layer cost table on stdout
+    REPORT_COST_JSON = 2,   // the same as JSON on stdout
+    REPORT_MEMORY = 4       // static activation memory plan
+};
+
+typedef enum {
+    QUANT_NONE,
+    QUANT_INT8          // --quantize=int8: post-training int8 inference path
+} QuantMode;
+
+// Options that change the generated code; all of them are part of the cache key.
+typedef struct {
+    CodegenTarget target;
+    int no_fuse;            // --no-fuse: one kernel per layer
+    QuantMode quantize;
+    int profile;            // --profile: timing instrumentation in the Keras script
+    int profile_first, profile_last;    // training steps the TensorFlow profiler traces
+} CodegenOptions;
+
+#define PROFILE_FIRST_STEP 10   // past tracing and warm-up
+#define PROFILE_LAST_STEP 20
+
+// Everything one compilation needs. Nothing in the lexer, parser or codegen
+// is global, so separate contexts can run on separate threads.
+typedef struct {
+    const char *in_path;    // DSL source, "-" for stdin
+    const char *out_path;   // generated file; <stem>_<name>.<ext> beside it per network or variant when there are several
+    FILE *diag;             // parse diagnostics (stderr by default)
+    FILE *out;              // when set, codegen writes here instead of opening out_path
+    int quiet;              // no progress messages on stdout
+    CodegenOptions opts;
+    CompileCache *cache;    // optional, may be shared between contexts
+    int report;             // REPORT_* bits
+    int jobs;               // threads for the outputs of a multi-output source, 0 = one per CPU
+    int outputs;            // files the last compile wrote or restored from the cache
+    CompileStats *stats;    // --time-passes/--stats; NULL means nothing is measured
+    LexerState lex;
+    Arena arena;            // owns the AST; released in one step after codegen
+    Interner strings;       // interned identifiers (activations)
+    ModelCost cost;         // shapes and costs from analyze_model, read by codegen
+    FusedModel fused;       // ops from fuse_model, read by codegen
+} CompileContext;
+
+void compile_ctx_init(CompileContext *ctx, const char *in_path, const char *out_path);
+int compile_file(CompileContext *ctx);   // lex, parse and generate; 0 on success
+int compile_source(CompileContext *ctx, const char *src, size_t len); // the same for source already in memory
+void compile_ctx_free(CompileContext *ctx);
+void compile_output_path(const char *out_path, const char *suffix, char *buf, size_t n); // out_path, its extension replaced by suffix
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef FUSE_H
+#define FUSE_H
+
+#include "ast.h"
+#include "arena.h"
+
+// Layer fusion. The layer chain is regrouped into ops that a backend runs
+// as one kernel; a tensor inside an op is never written to memory.
+typedef enum {
+    FOP_INPUT,          // the input layer, no code
+    FOP_CONV,           // conv2d + activation
+    FOP_CONV_POOL,      // conv2d + activation + maxpool2d; the conv output is never stored
+    FOP_POOL,           // maxpool2d on its own
+    FOP_FLATTEN,        // flatten that could not be folded into the next op
+    FOP_DENSE           // dense or output + activation, reading through a folded flatten
+} FusedKind;
+
+typedef struct {
+    FusedKind kind;
+    int first, last;    // layers covered; the op's result is layer last's output
+} FusedOp;
+
+typedef struct {
+    FusedOp *ops;       // arena-owned, in layer order
+    int n;
+} FusedModel;
+
+// enable = 0 gives one op per layer (--no-fuse)
+int fuse_model(Arena *a, const ModelAST *m, int enable, FusedModel *out);
+const char *fused_kind_name(FusedKind k);
+
+#endif
@@ -0,0 +1,82 @@
+// Generated by tools/llgen.c from grammar/neurodsl.g. Do not edit.
+#ifndef GRAMMAR_H
+#define GRAMMAR_H
+
+#include <stddef.h>
+#include "lexer.h"
+
+typedef enum {
+    NT_PROGRAM,
+    NT_BLOCK,
+    NT_BLOCKS,
+    NT_LAYERS,
+    NT_TRAIN_FOR,
+    NT_TRAIN_ITEMS,
+    NT_LAYER,
+    NT_DIM,
+    NT_COMMA_OPT,
+    NT_RPAREN_OPT,
+    NT_PARAMS,
+    NT_PARAM,
+    NT_VALUE,
+    NT_TRAIN_ITEM,
+    NT_SEP,
+    NT_SCALAR,
+    NT_SCALARS,
+    NT_RANGE_OPT,
+    NT_COUNT
+} Nonterminal;
+
+typedef enum {
+    ACT_MODEL_BEGIN,
+    ACT_TRAIN_BEGIN,
+    ACT_TRAIN_NAME,
+    ACT_INPUT_BEGIN,
+    ACT_LAYER_BEGIN,
+    ACT_INPUT_DIM,
+    ACT_PARAM_NAME,
+    ACT_LAYER_PARAM,
+    ACT_TRAIN_PARAM,
+    ACT_VALUE_ITEM,
+    ACT_VALUE_RANGE,
+    ACT_COUNT
+} Action;
+
+// identifiers the lexer recognises as parameter names (Token.param)
+typedef enum {
+    PARAM_NONE,
+    PARAM_FILTERS,
+    PARAM_KERNEL,
+    PARAM_SIZE,
+    PARAM_UNITS,
+    PARAM_ACTIVATION,
+    PARAM_OPTIMIZER,
+    PARAM_LOSS,
+    PARAM_EPOCHS,
+    PARAM_DATASET,
+    PARAM_BATCH_SIZE,
+    PARAM_PREFETCH,
+    PARAM_CACHE,
+    PARAM_SHUFFLE_BUFFER,
+    PARAM_MIXED_PRECISION,
+    PARAM_JIT_COMPILE,
+    PARAM_COUNT
+} ParamId;
+
+// parse stack symbols: TokenType values, then nonterminals, then actions
+#define LL_NT(x) (TOK_COUNT + (x))
+#define LL_ACT(x) (TOK_COUNT + NT_COUNT + (x))
+#define LL_START LL_NT(NT_PROGRAM)
+
+extern const unsigned char ll_table[NT_COUNT][TOK_COUNT];  // production + 1, 0 = no entry
+extern const unsigned char ll_default[NT_COUNT];           // epsilon production + 1 of nullable nonterminals
+extern const unsigned char ll_recover[NT_COUNT];           // skip unexpected tokens here
+extern const unsigned short ll_rhs_start[];                // production p is ll_rhs[ll_rhs_start[p] .. ll_rhs_start[p + 1])
+extern const unsigned short ll_rhs[];                      // right-hand sides, reversed for pushing
+extern const char *const ll_nt_name[NT_COUNT];
+extern const char *const param_name[PARAM_COUNT];
+
+// keyword and parameter name lookup for an identifier span; sets *param
+TokenType lookup_word(const char *s, size_t n, unsigned int *param);
+
+#endif
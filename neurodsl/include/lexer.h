@@ -1,38 +1,74 @@
-#ifndef LEXER_H
-#define LEXER_H
-
-#include <stdio.h>
-
-typedef enum {
-    TOK_NETWORK,
-    TOK_LBRACE,     // {
-    TOK_RBRACE,     // }
-    TOK_INPUT,
-    TOK_CONV2D,
-    TOK_MAXPOOL2D,
-    TOK_FLATTEN,
-    TOK_DENSE,
-    TOK_OUTPUT,
-    TOK_TRAIN,
-    TOK_IDENTIFIER,
-    TOK_NUMBER,
-    TOK_EQUALS,
-    TOK_COMMA,
-    TOK_LPAREN,     // (
-    TOK_RPAREN,     // )
-    TOK_COLON,      // :
-    TOK_EOF,
-    TOK_UNKNOWN
-} TokenType;
-
-typedef struct {
-    TokenType type;
-    char text[128];
-} Token;
-
-void lexer_init_file(const char *path);
-Token lexer_peek();      // lookahead (one token)
-Token lexer_next();      // consume and return next token
-void lexer_free();
-
-#endif
+#ifndef LEXER_H
+#define LEXER_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+typedef enum {
+    TOK_NETWORK,
+    TOK_LBRACE,     // {
+    TOK_RBRACE,     // }
+    TOK_INPUT,
+    TOK_CONV2D,
+    TOK_MAXPOOL2D,
+    TOK_FLATTEN,
+    TOK_DENSE,
+    TOK_OUTPUT,
+    TOK_TRAIN,
+    TOK_IDENTIFIER,
+    TOK_NUMBER,
+    TOK_EQUALS,
+    TOK_COMMA,
+    TOK_LPAREN,     // (
+    TOK_RPAREN,     // )
+    TOK_COLON,      // :
+    TOK_LBRACKET,   // [
+    TOK_RBRACKET,   // ]
+    TOK_DOTDOT,     // ..
+    TOK_EOF,
+    TOK_UNKNOWN,
+    TOK_COUNT
+} TokenType;
+
+// A token is a span into the lexer's source buffer; no text is copied.
+// Use lexer_text() to get at the bytes (not NUL-terminated).
+typedef struct {
+    TokenType type;
+    unsigned int offset;    // byte offset into the source buffer
+    unsigned int len;       // length in bytes
+    unsigned int param;     // ParamId (grammar.h) for identifiers naming a parameter, else 0
+} Token;
+
+// All lexer state lives here so independent inputs can be lexed on
+// different threads. The whole input is held in one buffer: an mmap of the
+// file when possible, otherwise a heap copy (stdin, pipes, or platforms
+// without mmap).
+typedef struct {
+    const char *src;
+    size_t len;
+    size_t pos;
+    int mapped;
+    int borrowed;           // src belongs to the caller (lexer_init_buffer)
+    Token lookahead;
+    int lookahead_valid;
+} LexerState;
+
+// printf helpers: printf("'" TOK_FMT "'", TOK_ARG(lx, t))
+#define TOK_FMT "%.*s"
+#define TOK_ARG(lx, t) (int)(t).len, lexer_text((lx), &(t))
+
+int lexer_init_file(LexerState *lx, const char *path);  // "-" reads stdin; 0 on success
+int lexer_init_buffer(LexerState *lx, const char *src, size_t len); // lex src in place; it must outlive lx
+Token lexer_peek(LexerState *lx);      // lookahead (one token)
+Token lexer_next(LexerState *lx);      // consume and return next token
+void lexer_rewind(LexerState *lx);     // back to the first token of the same buffer
+void lexer_free(LexerState *lx);
+
+// token helpers
+const char *token_type_name(TokenType t);                                 // for diagnostics, e.g. "'{'"
+const char *lexer_text(const LexerState *lx, const Token *t);
+int token_is(const LexerState *lx, const Token *t, const char *s);        // span equals s
+int token_int(const LexerState *lx, const Token *t);                      // atoi on the span, -1 past INT_MAX
+void token_copy(const LexerState *lx, const Token *t, char *dst, size_t n); // NUL-terminated, truncated
+
+#endif
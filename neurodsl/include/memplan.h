@@ -0,0 +1,44 @@
+#ifndef MEMPLAN_H
+#define MEMPLAN_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "ast.h"
+#include "analysis.h"
+#include "fuse.h"
+
+// Static activation memory plan for one forward pass. Every intermediate
+// tensor gets a lifetime along the layer chain (from the layer that writes
+// it to the last layer that reads it) and an aligned offset inside a single
+// scratch block; tensors whose lifetimes do not overlap share bytes.
+// flatten is a view of its input and never gets memory of its own.
+
+#define MEMPLAN_ALIGN 64
+#define MEMPLAN_EXTERNAL ((size_t)-1)   // caller-owned: the input x or the final output y
+#define MEMPLAN_FUSED ((size_t)-2)      // consumed inside a fused op, never stored
+
+// generic planner input: one entry per tensor
+typedef struct {
+    size_t bytes;
+    int first, last;    // steps during which the tensor is live, inclusive
+    int alias_of;       // -1, or the tensor this one is a view of
+    int external;       // caller-owned, not placed
+    size_t offset;      // result
+} PlanTensor;
+
+typedef struct {
+    size_t *offset;     // per layer: offset of its output, MEMPLAN_EXTERNAL for x/y
+    size_t *ws_offset;  // per layer: offset of its workspace (0 when it has none)
+    size_t peak;        // scratch bytes needed for one inference
+    size_t naive;       // one buffer per tensor, no reuse
+    size_t fused;       // activation bytes that fusion keeps out of memory
+} MemPlan;
+
+size_t memplan_solve(PlanTensor *t, int n, size_t align); // assigns offsets, returns peak bytes
+
+// plan a model; workspace[i] is per-layer temporary memory (may be NULL),
+// fm the ops the backend runs (NULL: one per layer)
+int plan_model(Arena *a, const ModelAST *m, const ModelCost *c, const size_t *workspace, const FusedModel *fm, MemPlan *out);
+void memplan_print(FILE *f, const ModelAST *m, const ModelCost *c, const MemPlan *p);
+
+#endif
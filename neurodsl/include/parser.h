@@ -1,8 +1,19 @@
-#ifndef PARSER_H
-#define PARSER_H
-
-#include "ast.h"
-
-int parse_program(ProgramAST *prog); // returns 0 on success, nonzero on error
-
-#endif
+#ifndef PARSER_H
+#define PARSER_H
+
+#include "ast.h"
+#include "compile.h"
+
+int parse_program(CompileContext *ctx, ProgramAST *prog); // returns 0 on success, nonzero on error
+int parse_check(CompileContext *ctx);   // syntax only: no AST, no diagnostics
+
+// The same over tokens already lexed from ctx->lex's buffer (reparse.c);
+// the lexer only supplies their text. parse_tokens takes a whole program,
+// ending in TOK_EOF. parse_layers appends the layer statements of a slice
+// of one network body to model, line being the source line at byte
+// line_pos (at or before the slice); nonzero, with nothing reported, when
+// the slice is not a run of whole statements.
+int parse_tokens(CompileContext *ctx, const Token *toks, int n, ProgramAST *prog);
+int parse_layers(CompileContext *ctx, const Token *toks, int n, ModelAST *model, size_t line_pos, int line);
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef REPARSE_H
+#define REPARSE_H
+
+#include <stdio.h>
+#include "ast.h"
+#include "compile.h"
+
+// Incremental re-parsing for an editor that sends every edit. A document
+// keeps the source, its tokens, the ProgramAST and each network's shapes
+// and costs. An edit re-lexes from the start of its line until the new
+// tokens line up with the old ones again, re-parses only the layer
+// statements those tokens belong to, splices them into the network's layers
+// and re-runs shape inference from the first changed layer until a layer's
+// output shape is what it was before. Edits a layer slice cannot absorb
+// (network names, braces, train blocks, sweeps, text that does not parse)
+// parse the whole document again.
+
+typedef struct {
+    size_t offset;          // byte offset into the current text
+    size_t removed;         // bytes removed there
+    const char *text;       // inserted in their place
+    size_t inserted;
+} TextEdit;
+
+typedef struct {
+    int full;               // the whole document was parsed
+    int tokens;             // tokens lexed
+    int layers_parsed;      // layer statements parsed
+    int layers_analyzed;    // layers whose shapes and costs were recomputed
+    double seconds;
+} ReparseStats;
+
+// where one network's layers are in the token stream, and their analysis
+typedef struct {
+    int open, close;        // token indices of the body's braces
+    int open_line;          // source line of the opening brace
+    int *kw;                // token index of each layer's first token
+    unsigned char *errors;  // shape errors per layer
+    int cap;                // of kw, errors and cost.layers
+    ModelCost cost;         // cost.layers is malloc'd here, not in the arena
+    int n_errors;
+} ReparseNet;
+
+typedef struct {
+    CompileContext ctx;     // the arena and strings own the AST; ctx.lex reads src
+    char *src;
+    size_t len, cap;
+    Token *toks;            // the last one is TOK_EOF
+    int n_toks, cap_toks;
+    Token *fresh;           // tokens lexed by the current edit
+    int n_fresh, cap_fresh;
+    ProgramAST prog;
+    ReparseNet *nets;       // one per prog.nets
+    int ok;                 // the text parses; otherwise prog is empty until an edit fixes it
+    size_t arena_full;      // arena bytes right after the last whole parse
+} ReparseDoc;
+
+// 0 when the text parses and every network's shapes check out; diagnostics go to diag
+int reparse_open(ReparseDoc *d, const char *src, size_t len, FILE *diag);
+int reparse_edit(ReparseDoc *d, const TextEdit *e, ReparseStats *st);  // the same after e; st may be NULL
+void reparse_free(ReparseDoc *d);
+
+#endif
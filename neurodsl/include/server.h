@@ -0,0 +1,27 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "compile.h"
+
+// Compile server on a Unix domain socket. A connection carries any number
+// of requests, one after another:
+//
+//   request:  COMPILE <python|c|ast-bin> <source bytes> <options> <name>\n<source>
+//   response: OK|ERR <code bytes> <diagnostic bytes>\n<code><diagnostics>
+//
+// <options> is "-" or a comma-separated list of no-fuse, int8 and
+// profile=FIRST:LAST. They go into the compile and the cache key, and a
+// request with an option the server does not know fails rather than
+// compiling without it. <name> is only used in diagnostics. One thread polls the open
+// connections and queues each request that arrives on the worker pool, so a
+// worker serves one request and then takes whichever connection is ready
+// next: --jobs bounds concurrent compiles, not clients. Each worker keeps one
+// warm CompileContext (arena, interner) for its whole life, and finished
+// results are kept in a shared in-memory LRU keyed by source and options.
+
+#define SERVER_MAX_SOURCE (64u << 20)
+
+int serve(const char *sock_path, int workers, unsigned long long cache_bytes);  // runs until SIGINT/SIGTERM
+int client_compile(const char *sock_path, const char *in_path, const CodegenOptions *opts); // code to stdout, diagnostics to stderr
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+
+// Per-phase timings and counters for --time-passes / --stats. Nothing is
+// measured unless a compilation has a CompileStats attached, so the cost
+// with the flags off is one pointer test per phase.
+typedef enum {
+    PHASE_READ,         // open + mmap/read of the source
+    PHASE_LEX,          // standalone token pass
+    PHASE_PARSE,        // recognizer pass over the same tokens, no actions
+    PHASE_AST,          // rest of the real parse: the actions building the AST
+    PHASE_ANALYZE,      // shape inference and cost model
+    PHASE_MEMPLAN,      // activation memory plan
+    PHASE_CODEGEN,      // code generation, excluding the memory plan
+    PHASE_COUNT
+} Phase;
+
+typedef struct {
+    double t[PHASE_COUNT];      // seconds, summed over files
+    long long files;
+    long long in_bytes;
+    long long tokens;
+    long long layers;
+    long long arena_allocs;     // allocations served by the AST arena
+    long long arena_bytes;
+    long long arena_chunks;     // malloc'd arena blocks held at the end of each compile
+    long long out_bytes;        // generated code
+} CompileStats;
+
+// --time-passes / --stats output selection
+enum {
+    STATS_TIMES = 1,
+    STATS_COUNTERS = 2,
+    STATS_JSON = 4
+};
+
+double stats_now(void);     // monotonic seconds
+void stats_add(CompileStats *dst, const CompileStats *src);
+void stats_print(FILE *f, const CompileStats *s, int mode);
+
+#endif
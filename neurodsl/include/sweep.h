@@ -0,0 +1,34 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <stdio.h>
+#include "ast.h"
+#include "analysis.h"
+
+// Hyperparameter sweeps. A network with SweepAxis entries stands for the
+// cartesian product of their values. Variants are numbered 0..count-1 with
+// the last axis varying fastest, and each is built only when asked for, so
+// a sweep costs one parse however many variants it has.
+
+long long sweep_count(const NetworkAST *n);     // 1 for a plain network
+// variant v as a plain network: its own layer array and name in a, swept values applied
+int sweep_variant(const NetworkAST *n, long long v, Arena *a, ModelAST *m, TrainAST *t);
+void sweep_name(const NetworkAST *n, long long v, char *buf, size_t len);  // <network>_<v>, zero-padded
+// one tab-separated line per variant under a header naming the axes; the
+// file column is prefix, variant name, suffix (e.g. "model_", ".py")
+void sweep_write_manifest(FILE *f, const NetworkAST *n, const char *prefix, const char *suffix);
+
+// Analysis shared between variants. Layer chains are hash-consed into a
+// prefix trie: a node is one layer after one particular prefix, holding
+// that layer's cost and the running totals. Variants that agree on their
+// first k layers share k nodes, so each distinct prefix is analysed and
+// stored once. Safe to use from several threads.
+typedef struct SweepTrie SweepTrie;
+
+SweepTrie *sweep_trie_new(void);
+// analyze_model through the trie; a shape error is reported once, by the first variant to reach it
+int sweep_analyze(SweepTrie *t, FILE *diag, Arena *a, const ModelAST *m, ModelCost *out);
+void sweep_trie_counts(SweepTrie *t, long long *nodes, long long *layers);  // distinct nodes, layers walked
+void sweep_trie_free(SweepTrie *t);
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+// Fixed-size work-stealing thread pool. Each worker owns a deque: it pops
+// its own newest task first and, when empty, steals the oldest task from
+// another worker. Tasks submitted from outside the pool are dealt
+// round-robin across the deques.
+
+typedef void (*tp_fn)(void *arg);
+typedef struct ThreadPool ThreadPool;
+
+ThreadPool *tp_create(int nthreads);
+void tp_submit(ThreadPool *tp, tp_fn fn, void *arg);
+void tp_wait(ThreadPool *tp);        // block until every submitted task has finished
+void tp_destroy(ThreadPool *tp);     // waits, then joins the workers
+int tp_worker_id(void);              // index of the calling worker, -1 outside any pool
+int tp_default_threads(void);        // online CPU count
+int tp_pin_workers(ThreadPool *tp);  // worker i to the i-th CPU this process may run on; -1 where unsupported
+
+#endif
@@ -0,0 +1,277 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "nnidx.h"
+
+#define NNIDX_ALIGN 64
+
+struct NnidxLoader {
+    NnidxConfig c;
+    size_t begin, end;          // image range
+    size_t in_size;             // floats per image
+    NnidxBatch *slots;          // max(slots, 1) of them
+    float *x;                   // their images, one aligned block each
+    int *y;
+    int n_slots;
+    // the next batch to decode
+    size_t next_image;
+    int next_pass;
+
+    pthread_mutex_t mu;
+    pthread_cond_t full_cv;     // a batch was decoded, or the decoder finished
+    pthread_cond_t empty_cv;    // a slot was released, or stop
+    long long produced, taken, released;
+    int holding;                // the caller holds batch taken - 1
+    int finished, stop;
+    int threaded;
+    pthread_t decoder;
+
+    double t_start, wait_s, decode_s;
+    long long images, batches;
+};
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void *alloc64(size_t n) {
+    void *p = NULL;
+    n = (n + NNIDX_ALIGN - 1) / NNIDX_ALIGN * NNIDX_ALIGN;
+    return posix_memalign(&p, NNIDX_ALIGN, n ? n : NNIDX_ALIGN) == 0 ? p : NULL;
+}
+
+static unsigned be32(const unsigned char *p) {
+    return (unsigned)p[0] << 24 | (unsigned)p[1] << 16 | (unsigned)p[2] << 8 | p[3];
+}
+
+const char *nnidx_open(NnidxFile *f, const char *path) {
+    memset(f, 0, sizeof(*f));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return "cannot open the file";
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 4) { close(fd); return "not an IDX file"; }
+    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return "mmap failed";
+    const unsigned char *b = (const unsigned char*)p;
+    size_t size = (size_t)st.st_size;
+    const char *err = NULL;
+    int rank = b[3];
+    if (b[0] != 0 || b[1] != 0) err = b[0] == 0x1f && b[1] == 0x8b ? "gzip-compressed; gunzip it first" : "not an IDX file";
+    else if (b[2] != NNIDX_UBYTE) err = "not an unsigned byte IDX file";
+    else if (rank < 1 || rank > 4 || size < 4 + 4 * (size_t)rank) err = "bad IDX header";
+    if (!err) {
+        f->type = b[2];
+        f->rank = rank;
+        f->item_size = 1;
+        for (int i = 0; i < rank; i++) {
+            unsigned d = be32(b + 4 + 4 * i);
+            if (d > 0x7fffffffu) { err = "bad IDX header"; break; }
+            f->dims[i] = (int)d;
+            if (i > 0) f->item_size *= d;
+        }
+    }
+    if (!err) {
+        f->count = (size_t)f->dims[0];
+        size_t head = 4 + 4 * (size_t)rank;
+        if (f->item_size && f->count > (size - head) / f->item_size) err = "file shorter than its header says";
+        f->data = b + head;
+    }
+    if (err) {
+        munmap(p, size);
+        memset(f, 0, sizeof(*f));
+        return err;
+    }
+    f->map = p;
+    f->map_size = size;
+    madvise(p, size, MADV_SEQUENTIAL);
+    return NULL;
+}
+
+void nnidx_close(NnidxFile *f) {
+    if (f->map) munmap(f->map, f->map_size);
+    memset(f, 0, sizeof(*f));
+}
+
+void nnidx_config_default(NnidxConfig *c) {
+    memset(c, 0, sizeof(*c));
+    c->batch = 64;
+    c->slots = 2;
+    c->passes = 1;
+    c->scale = 1.0f / 255.0f;
+}
+
+// the next batch into b; 0 when every pass is done. Runs on one thread at a time.
+static int decode_next(NnidxLoader *l, NnidxBatch *b) {
+    const NnidxConfig *c = &l->c;
+    if (l->next_image >= l->end) {
+        if (c->passes && l->next_pass + 1 >= c->passes) return 0;
+        l->next_pass++;
+        l->next_image = l->begin;
+    }
+    size_t n = l->end - l->next_image;
+    if (n > (size_t)c->batch) n = (size_t)c->batch;
+    // pixels are h x w x c in the file as in the model input, so one image is one run
+    const unsigned char *src = c->images->data + l->next_image * l->in_size;
+    float *x = (float*)b->x;
+    size_t total = n * l->in_size;
+    float scale = c->scale, offset = c->offset;
+    for (size_t i = 0; i < total; i++) x[i] = (float)src[i] * scale + offset;
+    if (c->labels) {
+        const unsigned char *lab = c->labels->data + l->next_image * c->labels->item_size;
+        int *y = (int*)b->y;
+        for (size_t i = 0; i < n; i++) y[i] = lab[i * c->labels->item_size];
+    }
+    b->n = (int)n;
+    b->first = l->next_image;
+    b->pass = l->next_pass;
+    l->next_image += n;
+    return 1;
+}
+
+static void *decoder_main(void *arg) {
+    NnidxLoader *l = (NnidxLoader*)arg;
+    for (;;) {
+        pthread_mutex_lock(&l->mu);
+        while (!l->stop && l->produced - l->released >= l->n_slots) pthread_cond_wait(&l->empty_cv, &l->mu);
+        int stop = l->stop;
+        NnidxBatch *b = &l->slots[l->produced % l->n_slots];
+        pthread_mutex_unlock(&l->mu);
+        // the slot is free and only this thread fills slots, so it decodes unlocked
+        double t0 = now_s();
+        if (stop || !decode_next(l, b)) break;
+        double dt = now_s() - t0;
+        pthread_mutex_lock(&l->mu);
+        l->decode_s += dt;
+        l->produced++;
+        pthread_cond_signal(&l->full_cv);
+        pthread_mutex_unlock(&l->mu);
+    }
+    pthread_mutex_lock(&l->mu);
+    l->finished = 1;
+    pthread_cond_broadcast(&l->full_cv);
+    pthread_mutex_unlock(&l->mu);
+    return NULL;
+}
+
+NnidxLoader *nnidx_create(const NnidxConfig *c, const char **err) {
+    static const char *no_memory = "out of memory";
+    const char *e = NULL;
+    size_t in_size = (size_t)c->h * c->w * c->c;
+    const NnidxFile *im = c->images;
+    if (!im || !im->map) e = "no image file";
+    else if (c->h <= 0 || c->w <= 0 || c->c <= 0 || c->batch <= 0 || c->slots < 0 || c->passes < 0) e = "bad loader config";
+    else if (im->item_size != in_size || (im->rank >= 3 && (im->dims[1] != c->h || im->dims[2] != c->w)))
+        e = "image size does not match the model input";
+    else if (c->labels && (!c->labels->map || c->labels->count != im->count)) e = "label and image files have different counts";
+    else if (c->first >= im->count || (c->count && c->count > im->count - c->first)) e = "image range outside the file";
+    if (e) { if (err) *err = e; return NULL; }
+
+    NnidxLoader *l = (NnidxLoader*)calloc(1, sizeof(NnidxLoader));
+    if (!l) { if (err) *err = no_memory; return NULL; }
+    l->c = *c;
+    l->begin = c->first;
+    l->end = c->count ? c->first + c->count : im->count;
+    l->in_size = in_size;
+    l->next_image = l->begin;
+    l->n_slots = c->slots > 0 ? c->slots : 1;
+    l->slots = (NnidxBatch*)calloc((size_t)l->n_slots, sizeof(NnidxBatch));
+    size_t xs = (size_t)c->batch * in_size * sizeof(float);
+    xs = (xs + NNIDX_ALIGN - 1) / NNIDX_ALIGN * NNIDX_ALIGN;
+    l->x = (float*)alloc64(xs * (size_t)l->n_slots);
+    l->y = (int*)calloc((size_t)c->batch * (size_t)l->n_slots, sizeof(int));
+    if (!l->slots || !l->x || !l->y) {
+        free(l->slots); free(l->x); free(l->y); free(l);
+        if (err) *err = no_memory;
+        return NULL;
+    }
+    for (int i = 0; i < l->n_slots; i++) {
+        l->slots[i].x = (const float*)((char*)l->x + xs * (size_t)i);
+        l->slots[i].y = c->labels ? l->y + (size_t)c->batch * i : NULL;
+    }
+    pthread_mutex_init(&l->mu, NULL);
+    pthread_cond_init(&l->full_cv, NULL);
+    pthread_cond_init(&l->empty_cv, NULL);
+    l->t_start = now_s();
+    if (c->slots > 0) {
+        if (pthread_create(&l->decoder, NULL, decoder_main, l) != 0) {
+            nnidx_destroy(l);
+            if (err) *err = "cannot start the decoding thread";
+            return NULL;
+        }
+        l->threaded = 1;
+    }
+    return l;
+}
+
+int nnidx_next(NnidxLoader *l, NnidxBatch *b) {
+    double t0 = now_s();
+    if (!l->threaded) {
+        // slots 0: decode here, into the one slot
+        if (!decode_next(l, &l->slots[0])) return 1;
+        *b = l->slots[0];
+        double dt = now_s() - t0;
+        pthread_mutex_lock(&l->mu);
+        l->wait_s += dt;
+        l->decode_s += dt;
+        l->images += b->n;
+        l->batches++;
+        pthread_mutex_unlock(&l->mu);
+        return 0;
+    }
+    pthread_mutex_lock(&l->mu);
+    if (l->holding) {
+        l->released++;
+        l->holding = 0;
+        pthread_cond_signal(&l->empty_cv);
+    }
+    while (l->taken == l->produced && !l->finished) pthread_cond_wait(&l->full_cv, &l->mu);
+    if (l->taken == l->produced) {
+        pthread_mutex_unlock(&l->mu);
+        return 1;
+    }
+    *b = l->slots[l->taken % l->n_slots];
+    l->taken++;
+    l->holding = 1;
+    l->wait_s += now_s() - t0;
+    l->images += b->n;
+    l->batches++;
+    pthread_mutex_unlock(&l->mu);
+    return 0;
+}
+
+void nnidx_stats(NnidxLoader *l, NnidxStats *out) {
+    pthread_mutex_lock(&l->mu);
+    out->images = l->images;
+    out->batches = l->batches;
+    out->wait_s = l->wait_s;
+    out->decode_s = l->decode_s;
+    pthread_mutex_unlock(&l->mu);
+    out->seconds = now_s() - l->t_start;
+    out->images_per_s = out->seconds > 0.0 ? out->images / out->seconds : 0.0;
+}
+
+void nnidx_destroy(NnidxLoader *l) {
+    if (!l) return;
+    if (l->threaded) {
+        pthread_mutex_lock(&l->mu);
+        l->stop = 1;
+        pthread_cond_broadcast(&l->empty_cv);
+        pthread_mutex_unlock(&l->mu);
+        pthread_join(l->decoder, NULL);
+    }
+    pthread_cond_destroy(&l->full_cv);
+    pthread_cond_destroy(&l->empty_cv);
+    pthread_mutex_destroy(&l->mu);
+    free(l->slots);
+    free(l->x);
+    free(l->y);
+    free(l);
+}
@@ -0,0 +1,73 @@
+#ifndef NNIDX_H
+#define NNIDX_H
+
+#include <stddef.h>
+
+// IDX dataset reader (the MNIST file format) for native evaluation and
+// calibration with models built with --target=c. Files are mapped, never
+// read into memory as a whole, and must already be on disk uncompressed
+// (gunzip the .gz downloads). A loader decodes uint8 images straight into
+// float batches in the model's input layout (NHWC, NN_IN_H x NN_IN_W x
+// NN_IN_C), scaled the way the generated Keras script scales them. With
+// slots >= 2 a background thread decodes ahead of the caller, so the
+// forward pass of one batch overlaps the decoding of the next. POSIX only
+// (mmap, posix_memalign).
+//
+//   gcc -O3 -march=native -Iinclude app.c generated/model.c runtime/nnidx.c -lpthread -lm
+
+#define NNIDX_UBYTE 0x08        // element type of the MNIST files, the only one read
+
+// a mapped IDX file: big-endian header 0, 0, type, rank, then rank dims
+typedef struct {
+    const unsigned char *data;  // first item
+    int type;
+    int rank;
+    int dims[4];                // dims[0] items of dims[1] x ... bytes
+    size_t count;               // dims[0]
+    size_t item_size;           // bytes per item
+    void *map;
+    size_t map_size;
+} NnidxFile;
+
+typedef struct {
+    const NnidxFile *images;    // n images of h x w (x c) pixels
+    const NnidxFile *labels;    // n labels, or NULL
+    int h, w, c;                // model input: NN_IN_H, NN_IN_W, NN_IN_C
+    size_t first, count;        // images [first, first + count); count 0 = to the end
+    int batch;                  // images per batch (default 64)
+    int slots;                  // batches decoded ahead (default 2); 0 decodes inside nnidx_next
+    int passes;                 // passes over the images, 0 = until nnidx_destroy (default 1)
+    float scale, offset;        // x = pixel * scale + offset (default 1/255, 0)
+} NnidxConfig;
+
+// one decoded batch, valid until the next nnidx_next
+typedef struct {
+    const float *x;             // n * h * w * c floats, 64-byte aligned
+    const int *y;               // n labels, NULL without a label file
+    int n;                      // the last batch of a pass may be short
+    size_t first;               // file index of its first image
+    int pass;
+} NnidxBatch;
+
+typedef struct {
+    long long images, batches;
+    double seconds;             // wall time since nnidx_create
+    double images_per_s;
+    double wait_s;              // time nnidx_next spent waiting for (or decoding) a batch
+    double decode_s;            // time spent decoding
+} NnidxStats;
+
+typedef struct NnidxLoader NnidxLoader;
+
+// NULL on success, else what is wrong with the file
+const char *nnidx_open(NnidxFile *f, const char *path);
+void nnidx_close(NnidxFile *f);
+
+void nnidx_config_default(NnidxConfig *c);
+// NULL and *err set when the files do not fit the config (or on allocation failure)
+NnidxLoader *nnidx_create(const NnidxConfig *c, const char **err);
+int nnidx_next(NnidxLoader *l, NnidxBatch *b);  // 0 with the next batch, 1 when every pass is done
+void nnidx_stats(NnidxLoader *l, NnidxStats *out);
+void nnidx_destroy(NnidxLoader *l);         // stops the decoding thread; batches become invalid
+
+#endif
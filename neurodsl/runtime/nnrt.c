@@ -0,0 +1,296 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include "nnrt.h"
+#include "../include/threadpool.h"
+
+#define NNRT_HIST 256           // latency buckets, 8 per power of two of microseconds
+#define NNRT_ALIGN 64
+
+typedef struct {
+    const float *x;
+    float *y;
+    nnrt_done_fn done;
+    void *arg;
+    double t_submit;
+} Request;
+
+typedef struct Batch {
+    struct Nnrt *rt;
+    int n;
+    Request *req;               // [max_batch]
+    float *x, *y;               // [max_batch][in_size], [max_batch][out_size]
+} Batch;
+
+// one worker's counters, written only by that worker under its own lock
+typedef struct {
+    pthread_mutex_t mu;
+    long long requests, batches;
+    long long hist[NNRT_HIST];
+    double busy, max_us;
+    void *scratch;
+} Worker;
+
+struct Nnrt {
+    NnrtModel m;
+    NnrtConfig c;
+    ThreadPool *tp;
+    Worker *w;
+    int pinned;
+    double t_start;
+
+    pthread_mutex_t mu;
+    pthread_cond_t req_cv;      // an input was queued, or stop
+    pthread_cond_t space_cv;    // the queue has room
+    pthread_cond_t slot_cv;     // a batch slot came back
+    pthread_cond_t done_cv;     // completed caught up with submitted
+    Request *q;                 // ring of c.queue inputs
+    int head, count;
+    Batch *slots;
+    Batch **free_slots;
+    int n_free, n_slots;
+    long long submitted, completed;
+    int stop;
+    pthread_t batcher;
+};
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void *alloc64(size_t n) {
+    void *p = NULL;
+    n = (n + NNRT_ALIGN - 1) / NNRT_ALIGN * NNRT_ALIGN;
+    return posix_memalign(&p, NNRT_ALIGN, n ? n : NNRT_ALIGN) == 0 ? p : NULL;
+}
+
+static int hist_bucket(double us) {
+    if (us < 1.0) return 0;
+    int b = 1 + (int)(log2(us) * 8.0);
+    return b < NNRT_HIST ? b : NNRT_HIST - 1;
+}
+
+// upper bound of a bucket in microseconds
+static double hist_upper(int b) {
+    return b == 0 ? 1.0 : exp2(b / 8.0);
+}
+
+void nnrt_config_default(NnrtConfig *c) {
+    memset(c, 0, sizeof(*c));
+    c->pin = 1;
+    c->max_batch = 16;
+    c->max_delay_us = 200.0;
+    c->queue = 4096;
+}
+
+static void run_batch(void *arg) {
+    Batch *b = (Batch*)arg;
+    Nnrt *rt = b->rt;
+    const NnrtModel *m = &rt->m;
+    Worker *w = &rt->w[tp_worker_id()];
+    for (int i = 0; i < b->n; i++) memcpy(b->x + i * m->in_size, b->req[i].x, m->in_size * sizeof(float));
+    double t0 = now_s();
+    m->forward_batch(m->weights, b->x, b->y, b->n, w->scratch);
+    double t1 = now_s();
+    for (int i = 0; i < b->n; i++) memcpy(b->req[i].y, b->y + i * m->out_size, m->out_size * sizeof(float));
+    double t2 = now_s();
+
+    pthread_mutex_lock(&w->mu);
+    w->requests += b->n;
+    w->batches++;
+    w->busy += t1 - t0;
+    for (int i = 0; i < b->n; i++) {
+        double us = (t2 - b->req[i].t_submit) * 1e6;
+        w->hist[hist_bucket(us)]++;
+        if (us > w->max_us) w->max_us = us;
+    }
+    pthread_mutex_unlock(&w->mu);
+    for (int i = 0; i < b->n; i++) if (b->req[i].done) b->req[i].done(b->req[i].arg, b->req[i].y);
+
+    int n = b->n;
+    pthread_mutex_lock(&rt->mu);
+    rt->free_slots[rt->n_free++] = b;
+    rt->completed += n;
+    pthread_cond_signal(&rt->slot_cv);
+    if (rt->completed == rt->submitted) pthread_cond_broadcast(&rt->done_cv);
+    pthread_mutex_unlock(&rt->mu);
+}
+
+static void deadline_ts(double t, struct timespec *ts) {
+    ts->tv_sec = (time_t)t;
+    ts->tv_nsec = (long)((t - (double)ts->tv_sec) * 1e9);
+    if (ts->tv_nsec >= 1000000000L) { ts->tv_sec++; ts->tv_nsec -= 1000000000L; }
+}
+
+// A batch opens with the oldest queued input and closes when max_batch
+// inputs are queued or that input's deadline passes, whichever is first.
+// Under load batches fill at once; at low rates an input waits at most
+// max_delay_us before running alone.
+static void *batcher_main(void *arg) {
+    Nnrt *rt = (Nnrt*)arg;
+    pthread_mutex_lock(&rt->mu);
+    for (;;) {
+        while (rt->count == 0 && !rt->stop) pthread_cond_wait(&rt->req_cv, &rt->mu);
+        if (rt->count == 0) break;
+        double deadline = rt->q[rt->head].t_submit + rt->c.max_delay_us * 1e-6;
+        while (rt->count < rt->c.max_batch && !rt->stop && now_s() < deadline) {
+            struct timespec ts;
+            deadline_ts(deadline, &ts);
+            pthread_cond_timedwait(&rt->req_cv, &rt->mu, &ts);
+        }
+        while (rt->n_free == 0) pthread_cond_wait(&rt->slot_cv, &rt->mu);
+        Batch *b = rt->free_slots[--rt->n_free];
+        b->n = rt->count < rt->c.max_batch ? rt->count : rt->c.max_batch;
+        for (int i = 0; i < b->n; i++) b->req[i] = rt->q[(rt->head + i) % rt->c.queue];
+        rt->head = (rt->head + b->n) % rt->c.queue;
+        rt->count -= b->n;
+        pthread_cond_broadcast(&rt->space_cv);
+        pthread_mutex_unlock(&rt->mu);
+        tp_submit(rt->tp, run_batch, b);
+        pthread_mutex_lock(&rt->mu);
+    }
+    pthread_mutex_unlock(&rt->mu);
+    return NULL;
+}
+
+Nnrt *nnrt_create(const NnrtModel *m, const NnrtConfig *cfg) {
+    Nnrt *rt = (Nnrt*)calloc(1, sizeof(Nnrt));
+    if (!rt) return NULL;
+    rt->m = *m;
+    nnrt_config_default(&rt->c);
+    if (cfg) rt->c = *cfg;
+    if (rt->c.threads < 1) rt->c.threads = tp_default_threads();
+    if (rt->c.max_batch < 1) rt->c.max_batch = 1;
+    if (rt->c.queue < rt->c.max_batch) rt->c.queue = rt->c.max_batch;
+    int nt = rt->c.threads, mb = rt->c.max_batch;
+
+    // two slots per worker: one running, one being filled behind it
+    rt->n_slots = 2 * nt;
+    rt->w = (Worker*)alloc64(sizeof(Worker) * (size_t)nt);
+    rt->q = (Request*)calloc((size_t)rt->c.queue, sizeof(Request));
+    rt->slots = (Batch*)calloc((size_t)rt->n_slots, sizeof(Batch));
+    rt->free_slots = (Batch**)calloc((size_t)rt->n_slots, sizeof(Batch*));
+    int ok = rt->w && rt->q && rt->slots && rt->free_slots;
+    if (rt->w) memset(rt->w, 0, sizeof(Worker) * (size_t)nt);
+    for (int i = 0; ok && i < nt; i++) {
+        pthread_mutex_init(&rt->w[i].mu, NULL);
+        rt->w[i].scratch = alloc64(m->scratch_bytes);
+        ok = rt->w[i].scratch != NULL;
+    }
+    for (int i = 0; ok && i < rt->n_slots; i++) {
+        Batch *b = &rt->slots[i];
+        b->rt = rt;
+        b->req = (Request*)calloc((size_t)mb, sizeof(Request));
+        b->x = (float*)alloc64(sizeof(float) * m->in_size * (size_t)mb);
+        b->y = (float*)alloc64(sizeof(float) * m->out_size * (size_t)mb);
+        ok = b->req && b->x && b->y;
+        rt->free_slots[rt->n_free++] = b;
+    }
+    if (!ok) {
+        for (int i = 0; rt->slots && i < rt->n_slots; i++) { free(rt->slots[i].req); free(rt->slots[i].x); free(rt->slots[i].y); }
+        for (int i = 0; rt->w && i < nt; i++) free(rt->w[i].scratch);
+        free(rt->w); free(rt->q); free(rt->slots); free(rt->free_slots); free(rt);
+        return NULL;
+    }
+
+    pthread_mutex_init(&rt->mu, NULL);
+    pthread_condattr_t ca;
+    pthread_condattr_init(&ca);
+#ifndef _WIN32
+    pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);    // deadlines come from now_s
+#endif
+    pthread_cond_init(&rt->req_cv, &ca);
+    pthread_condattr_destroy(&ca);
+    pthread_cond_init(&rt->space_cv, NULL);
+    pthread_cond_init(&rt->slot_cv, NULL);
+    pthread_cond_init(&rt->done_cv, NULL);
+    rt->tp = tp_create(nt);
+    rt->pinned = rt->c.pin && tp_pin_workers(rt->tp) == 0;
+    rt->t_start = now_s();
+    pthread_create(&rt->batcher, NULL, batcher_main, rt);
+    return rt;
+}
+
+int nnrt_submit(Nnrt *rt, const float *x, float *y, nnrt_done_fn done, void *arg) {
+    pthread_mutex_lock(&rt->mu);
+    while (rt->count == rt->c.queue && !rt->stop) pthread_cond_wait(&rt->space_cv, &rt->mu);
+    if (rt->stop) { pthread_mutex_unlock(&rt->mu); return 1; }
+    Request *r = &rt->q[(rt->head + rt->count) % rt->c.queue];
+    r->x = x; r->y = y; r->done = done; r->arg = arg;
+    r->t_submit = now_s();
+    rt->count++;
+    rt->submitted++;
+    // the batcher only cares about the first input and a full batch
+    if (rt->count == 1 || rt->count == rt->c.max_batch) pthread_cond_signal(&rt->req_cv);
+    pthread_mutex_unlock(&rt->mu);
+    return 0;
+}
+
+void nnrt_drain(Nnrt *rt) {
+    pthread_mutex_lock(&rt->mu);
+    while (rt->completed != rt->submitted) pthread_cond_wait(&rt->done_cv, &rt->mu);
+    pthread_mutex_unlock(&rt->mu);
+}
+
+void nnrt_stats(Nnrt *rt, NnrtStats *out) {
+    long long hist[NNRT_HIST] = {0};
+    memset(out, 0, sizeof(*out));
+    double busy = 0.0;
+    for (int i = 0; i < rt->c.threads; i++) {
+        Worker *w = &rt->w[i];
+        pthread_mutex_lock(&w->mu);
+        out->requests += w->requests;
+        out->batches += w->batches;
+        busy += w->busy;
+        if (w->max_us > out->max_us) out->max_us = w->max_us;
+        for (int b = 0; b < NNRT_HIST; b++) hist[b] += w->hist[b];
+        pthread_mutex_unlock(&w->mu);
+    }
+    out->seconds = now_s() - rt->t_start;
+    out->throughput = out->seconds > 0.0 ? out->requests / out->seconds : 0.0;
+    out->mean_batch = out->batches ? (double)out->requests / out->batches : 0.0;
+    out->busy = out->seconds > 0.0 ? busy / (out->seconds * rt->c.threads) : 0.0;
+    out->pinned = rt->pinned;
+    long long seen = 0, p50 = (out->requests + 1) / 2, p99 = (out->requests * 99 + 99) / 100;
+    for (int b = 0; b < NNRT_HIST && out->requests; b++) {
+        seen += hist[b];
+        if (out->p50_us == 0.0 && seen >= p50) out->p50_us = hist_upper(b);
+        if (out->p99_us == 0.0 && seen >= p99) { out->p99_us = hist_upper(b); break; }
+    }
+    if (out->p99_us > out->max_us) out->p99_us = out->max_us;
+    if (out->p50_us > out->max_us) out->p50_us = out->max_us;
+}
+
+void nnrt_print_stats(const NnrtStats *s) {
+    printf("%lld requests in %lld batches (mean %.1f), %.0f req/s, latency p50 %.0f us p99 %.0f us max %.0f us, workers %.0f%% busy%s\n",
+           s->requests, s->batches, s->mean_batch, s->throughput, s->p50_us, s->p99_us, s->max_us, 100.0 * s->busy, s->pinned ? ", pinned" : "");
+}
+
+void nnrt_destroy(Nnrt *rt) {
+    if (!rt) return;
+    nnrt_drain(rt);
+    pthread_mutex_lock(&rt->mu);
+    rt->stop = 1;
+    pthread_cond_broadcast(&rt->req_cv);
+    pthread_cond_broadcast(&rt->space_cv);
+    pthread_mutex_unlock(&rt->mu);
+    pthread_join(rt->batcher, NULL);
+    tp_destroy(rt->tp);
+    for (int i = 0; i < rt->n_slots; i++) { free(rt->slots[i].req); free(rt->slots[i].x); free(rt->slots[i].y); }
+    for (int i = 0; i < rt->c.threads; i++) {
+        pthread_mutex_destroy(&rt->w[i].mu);
+        free(rt->w[i].scratch);
+    }
+    pthread_mutex_destroy(&rt->mu);
+    pthread_cond_destroy(&rt->req_cv);
+    pthread_cond_destroy(&rt->space_cv);
+    pthread_cond_destroy(&rt->slot_cv);
+    pthread_cond_destroy(&rt->done_cv);
+    free(rt->w); free(rt->q); free(rt->slots); free(rt->free_slots);
+    free(rt);
+}
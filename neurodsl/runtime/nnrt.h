@@ -0,0 +1,61 @@
+#ifndef NNRT_H
+#define NNRT_H
+
+#include <stddef.h>
+
+// Batched inference runtime for models built with --target=c. Callers
+// submit single inputs from any thread; a batcher thread groups them into
+// micro-batches, closing a batch when it is full or when its oldest input
+// has waited max_delay_us, and runs each batch through the model's
+// nn_forward_batch on a work-stealing pool (include/threadpool.h) whose
+// workers can be pinned to CPUs. Every worker owns one scratch block and
+// batches live in a fixed set of slots, so nothing is allocated after
+// nnrt_create. POSIX only (posix_memalign, pthread_condattr_setclock).
+//
+//   gcc -O3 -march=native -Iinclude app.c generated/model.c runtime/nnrt.c src/threadpool.c -lpthread -lm
+
+typedef void (*nnrt_forward_fn)(const void *weights, const float *x, float *y, int n, void *scratch);
+typedef void (*nnrt_done_fn)(void *arg, float *y);
+
+// a generated model: nn_forward_batch (or nn_forward_q8_batch) and its constants
+typedef struct {
+    nnrt_forward_fn forward_batch;
+    const void *weights;        // bound nn_weights (nn_qweights for the int8 path)
+    size_t in_size;             // NN_IN_SIZE
+    size_t out_size;            // NN_OUT_SIZE
+    size_t scratch_bytes;       // NN_SCRATCH_BYTES (NN_Q_SCRATCH_BYTES)
+} NnrtModel;
+
+typedef struct {
+    int threads;                // workers; 0 = one per CPU
+    int pin;                    // pin worker i to CPU i
+    int max_batch;              // largest micro-batch (default 16)
+    double max_delay_us;        // longest an input waits for a batch to fill (default 200)
+    int queue;                  // queued inputs before nnrt_submit blocks (default 4096)
+} NnrtConfig;
+
+// counters since nnrt_create; latencies are submit to output written
+typedef struct {
+    long long requests, batches;
+    double mean_batch;
+    double seconds;             // wall time since nnrt_create
+    double throughput;          // requests/s over that time
+    double p50_us, p99_us, max_us;
+    double busy;                // fraction of worker time spent in forward passes
+    int pinned;                 // workers were pinned
+} NnrtStats;
+
+typedef struct Nnrt Nnrt;
+
+void nnrt_config_default(NnrtConfig *c);
+Nnrt *nnrt_create(const NnrtModel *m, const NnrtConfig *c);   // NULL on allocation failure
+// Queue one input. x is read and y written by a worker, so both must stay
+// valid until done(arg, y) runs on that worker (done may be NULL). Blocks
+// while the queue is full; 1 after nnrt_destroy has started.
+int nnrt_submit(Nnrt *rt, const float *x, float *y, nnrt_done_fn done, void *arg);
+void nnrt_drain(Nnrt *rt);                  // wait until every submitted input has its output
+void nnrt_stats(Nnrt *rt, NnrtStats *out);
+void nnrt_print_stats(const NnrtStats *s);  // one line on stdout
+void nnrt_destroy(Nnrt *rt);                // drains, then stops the batcher and the workers
+
+#endif
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/analysis.h"
+
+const char *layer_type_name(LayerType t) {
+    static const char *names[] = { "input", "conv2d", "maxpool2d", "flatten", "dense", "output" };
+    return (unsigned)t < sizeof(names) / sizeof(names[0]) ? names[t] : "?";
+}
+
+long long shape_size(TensorShape s) {
+    return (long long)s.h * s.w * s.c;
+}
+
+int analyze_layer(FILE *diag, const Layer *L, int i, TensorShape *shape, LayerCost *lc) {
+    TensorShape cur = *shape;
+    int errors = 0;
+    memset(lc, 0, sizeof(*lc));
+    lc->in = cur;
+    switch (L->type) {
+        case LAYER_INPUT:
+            if (i != 0) { fprintf(diag, "Error: layer %d: input must be the first layer\n", i); errors++; break; }
+            cur.h = L->p.input.h; cur.w = L->p.input.w; cur.c = L->p.input.ch; cur.rank = 3;
+            if (cur.h <= 0 || cur.w <= 0 || cur.c <= 0) { fprintf(diag, "Error: layer %d: input shape (%d, %d, %d) must be positive\n", i, cur.c, cur.h, cur.w); errors++; }
+            lc->in = cur;
+            break;
+        case LAYER_CONV2D: {
+            if (cur.rank != 3) { fprintf(diag, "Error: layer %d: conv2d needs an (h, w, c) input but gets a flat vector of %d\n", i, cur.c); errors++; break; }
+            long long k = layer_kernel(L), f = layer_filters(L);
+            cur.c = (int)f;
+            lc->params = k * k * lc->in.c * f + f;
+            lc->macs = (long long)cur.h * cur.w * f * k * k * lc->in.c;
+            lc->flops = 2 * lc->macs;
+            break;
+        }
+        case LAYER_MAXPOOL2D: {
+            if (cur.rank != 3) { fprintf(diag, "Error: layer %d: maxpool2d needs an (h, w, c) input but gets a flat vector of %d\n", i, cur.c); errors++; break; }
+            int s = layer_pool(L);
+            if (s > cur.h || s > cur.w) { fprintf(diag, "Error: layer %d: pool size %d is larger than its %dx%d input\n", i, s, cur.h, cur.w); errors++; break; }
+            cur.h /= s; cur.w /= s;
+            lc->flops = shape_size(cur) * ((long long)s * s - 1);
+            break;
+        }
+        case LAYER_FLATTEN:
+            cur.c = (int)shape_size(cur); cur.h = cur.w = 1; cur.rank = 1;
+            break;
+        case LAYER_DENSE:
+        case LAYER_OUTPUT: {
+            // on an unflattened input Keras applies the kernel to the last axis
+            long long u = layer_units(L), rows = (long long)cur.h * cur.w;
+            lc->params = (long long)lc->in.c * u + u;
+            lc->macs = rows * lc->in.c * u;
+            lc->flops = 2 * lc->macs;
+            cur.c = (int)u;
+            break;
+        }
+    }
+    lc->out = cur;
+    lc->act_bytes = shape_size(cur) * (long long)sizeof(float);
+    *shape = cur;
+    return errors;
+}
+
+void cost_accumulate(ModelCost *c, const Layer *L, const LayerCost *lc) {
+    if (L->type == LAYER_INPUT) c->input = lc->out;
+    c->params += lc->params;
+    c->macs += lc->macs;
+    c->flops += lc->flops;
+    if (L->type != LAYER_FLATTEN) c->act_bytes += lc->act_bytes;
+    long long live = L->type == LAYER_FLATTEN ? lc->act_bytes : shape_size(lc->in) * (long long)sizeof(float) + lc->act_bytes;
+    if (live > c->peak_act_bytes) c->peak_act_bytes = live;
+}
+
+int analyze_model(Arena *a, FILE *diag, const ModelAST *m, ModelCost *out) {
+    memset(out, 0, sizeof(*out));
+    out->n = m->n_layers;
+    out->layers = (LayerCost*)arena_alloc(a, sizeof(LayerCost) * (size_t)(m->n_layers ? m->n_layers : 1));
+    if (!out->layers) return 1;
+
+    TensorShape cur = ANALYSIS_DEFAULT_INPUT;
+    int errors = 0;
+    for (int i = 0; i < m->n_layers; i++) {
+        errors += analyze_layer(diag, &m->layers[i], i, &cur, &out->layers[i]);
+        cost_accumulate(out, &m->layers[i], &out->layers[i]);
+    }
+    if (m->n_layers == 0 || m->layers[0].type != LAYER_INPUT) {
+        TensorShape d = ANALYSIS_DEFAULT_INPUT;
+        out->input = d;
+    }
+    return errors;
+}
+
+static void shape_str(TensorShape s, char *buf, size_t n) {
+    if (s.rank == 1) snprintf(buf, n, "(%d)", s.c);
+    else snprintf(buf, n, "(%d, %d, %d)", s.h, s.w, s.c);
+}
+
+void cost_print_table(FILE *f, const ModelAST *m, const ModelCost *c) {
+    char in[48], out[48];
+    fprintf(f, "Cost report for network %s\n", m->name);
+    fprintf(f, "%-5s %-10s %-16s %-16s %12s %14s %14s %12s\n", "#", "layer", "input", "output", "params", "MACs", "FLOPs", "act bytes");
+    for (int i = 0; i < c->n; i++) {
+        const LayerCost *lc = &c->layers[i];
+        shape_str(lc->in, in, sizeof(in));
+        shape_str(lc->out, out, sizeof(out));
+        fprintf(f, "%-5d %-10s %-16s %-16s %12lld %14lld %14lld %12lld\n", i, layer_type_name(m->layers[i].type), in, out, lc->params, lc->macs, lc->flops, lc->act_bytes);
+    }
+    fprintf(f, "%-5s %-10s %-16s %-16s %12lld %14lld %14lld %12lld\n", "", "total", "", "", c->params, c->macs, c->flops, c->act_bytes);
+    fprintf(f, "peak live activations: %lld bytes\n", c->peak_act_bytes);
+}
+
+static void shape_json(FILE *f, TensorShape s) {
+    if (s.rank == 1) fprintf(f, "[%d]", s.c);
+    else fprintf(f, "[%d, %d, %d]", s.h, s.w, s.c);
+}
+
+void cost_print_json(FILE *f, const ModelAST *m, const ModelCost *c) {
+    fprintf(f, "{\"network\": \"%s\", \"input\": ", m->name);
+    shape_json(f, c->input);
+    fprintf(f, ", \"layers\": [");
+    for (int i = 0; i < c->n; i++) {
+        const LayerCost *lc = &c->layers[i];
+        fprintf(f, "%s\n  {\"index\": %d, \"line\": %d, \"type\": \"%s\", \"input\": ", i ? "," : "", i, m->layers[i].line, layer_type_name(m->layers[i].type));
+        shape_json(f, lc->in);
+        fprintf(f, ", \"output\": ");
+        shape_json(f, lc->out);
+        fprintf(f, ", \"params\": %lld, \"macs\": %lld, \"flops\": %lld, \"activation_bytes\": %lld}", lc->params, lc->macs, lc->flops, lc->act_bytes);
+    }
+    fprintf(f, "],\n \"total\": {\"params\": %lld, \"macs\": %lld, \"flops\": %lld, \"activation_bytes\": %lld, \"peak_activation_bytes\": %lld}}\n",
+            c->params, c->macs, c->flops, c->act_bytes, c->peak_act_bytes);
+}
@@ -0,0 +1,138 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "../include/arena.h"
+
+#define ARENA_ALIGN 16
+#define ARENA_MIN_CHUNK (64 * 1024)
+#define ARENA_MAX_CHUNK (16 * 1024 * 1024)
+
+struct ArenaChunk {
+    ArenaChunk *next;   // older chunk
+    size_t size;        // usable bytes in data
+    size_t used;
+    _Alignas(ARENA_ALIGN) unsigned char data[];
+};
+
+static size_t align_up(size_t n) { return (n + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1); }
+
+void arena_init(Arena *a) {
+    memset(a, 0, sizeof(*a));
+}
+
+static ArenaChunk *chunk_new(Arena *a, size_t need) {
+    size_t size = a->head ? a->head->size * 2 : ARENA_MIN_CHUNK;
+    if (size > ARENA_MAX_CHUNK) size = ARENA_MAX_CHUNK;
+    if (size < need) size = need;
+    ArenaChunk *c = (ArenaChunk*)malloc(sizeof(ArenaChunk) + size);
+    if (!c) return NULL;
+    c->size = size;
+    c->used = 0;
+    c->next = a->head;
+    a->head = c;
+    a->n_chunks++;
+    return c;
+}
+
+void *arena_alloc(Arena *a, size_t n) {
+    n = align_up(n ? n : 1);
+    ArenaChunk *c = a->head;
+    if (!c || c->size - c->used < n) {
+        c = chunk_new(a, n);
+        if (!c) return NULL;
+    }
+    void *p = c->data + c->used;
+    c->used += n;
+    memset(p, 0, n);
+    a->last = p;
+    a->n_allocs++;
+    a->bytes += n;
+    return p;
+}
+
+void *arena_grow(Arena *a, void *p, size_t old_n, size_t new_n) {
+    if (!p) return arena_alloc(a, new_n);
+    if (new_n <= old_n) return p;
+    ArenaChunk *c = a->head;
+    size_t old_a = align_up(old_n), new_a = align_up(new_n);
+    if (p == a->last && c && (unsigned char*)p + old_a == c->data + c->used && c->size - c->used >= new_a - old_a) {
+        memset((unsigned char*)p + old_n, 0, new_a - old_n);
+        c->used += new_a - old_a;
+        a->bytes += new_a - old_a;
+        return p;
+    }
+    void *q = arena_alloc(a, new_n);
+    if (q) memcpy(q, p, old_n);
+    return q;
+}
+
+char *arena_strndup(Arena *a, const char *s, size_t n) {
+    char *d = (char*)arena_alloc(a, n + 1);
+    if (d) memcpy(d, s, n);
+    return d;
+}
+
+void arena_reset(Arena *a) {
+    ArenaChunk *keep = a->head;
+    if (keep) {
+        ArenaChunk *c = keep->next;
+        while (c) { ArenaChunk *n = c->next; free(c); c = n; }
+        keep->next = NULL;
+        keep->used = 0;
+    }
+    a->last = NULL;
+    a->n_allocs = 0;
+    a->bytes = 0;
+    a->n_chunks = keep ? 1 : 0;
+}
+
+void arena_release(Arena *a) {
+    ArenaChunk *c = a->head;
+    while (c) { ArenaChunk *n = c->next; free(c); c = n; }
+    memset(a, 0, sizeof(*a));
+}
+
+// FNV-1a
+static uint64_t str_hash(const char *s, size_t n) {
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < n; i++) { h ^= (unsigned char)s[i]; h *= 1099511628211ULL; }
+    return h;
+}
+
+static void interner_rehash(Interner *in, size_t cap) {
+    const char **slots = (const char**)calloc(cap, sizeof(char*));
+    for (size_t i = 0; i < in->cap; i++) {
+        const char *s = in->slots[i];
+        if (!s) continue;
+        size_t j = str_hash(s, strlen(s)) & (cap - 1);
+        while (slots[j]) j = (j + 1) & (cap - 1);
+        slots[j] = s;
+    }
+    free(in->slots);
+    in->slots = slots;
+    in->cap = cap;
+}
+
+const char *intern(Interner *in, Arena *a, const char *s, size_t n) {
+    if ((in->count + 1) * 2 > in->cap) interner_rehash(in, in->cap ? in->cap * 2 : 32);
+    size_t j = str_hash(s, n) & (in->cap - 1);
+    while (in->slots[j]) {
+        const char *t = in->slots[j];
+        if (strncmp(t, s, n) == 0 && t[n] == '\0') return t;
+        j = (j + 1) & (in->cap - 1);
+    }
+    const char *d = arena_strndup(a, s, n);
+    in->slots[j] = d;
+    in->count++;
+    return d;
+}
+
+void interner_reset(Interner *in) {
+    if (in->slots) memset(in->slots, 0, in->cap * sizeof(char*));
+    in->count = 0;
+}
+
+void interner_free(Interner *in) {
+    free(in->slots);
+    memset(in, 0, sizeof(*in));
+}
@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/ast.h"
+#include "../include/grammar.h"
+
+ModelAST *model_new(Arena *a, const char *name, size_t name_len) {
+    ModelAST *m = (ModelAST*)arena_alloc(a, sizeof(ModelAST));
+    if (!m) return NULL;
+    m->name = arena_strndup(a, name, name_len);
+    return m;
+}
+
+// Layers live in one array that doubles inside the arena; while it is the
+// newest allocation it grows in place without copying.
+Layer *model_add_layer(ModelAST *m, Arena *a, LayerType type) {
+    if (m->n_layers == m->cap_layers) {
+        int cap = m->cap_layers ? m->cap_layers * 2 : 16;
+        Layer *nl = (Layer*)arena_grow(a, m->layers, (size_t)m->cap_layers * sizeof(Layer), (size_t)cap * sizeof(Layer));
+        if (!nl) return NULL;
+        m->layers = nl;
+        m->cap_layers = cap;
+    }
+    Layer *l = &m->layers[m->n_layers++];
+    l->type = type;
+    return l;
+}
+
+void layer_set_param(Layer *l, int param, const ParamValue *v) {
+    switch (param) {
+        case PARAM_FILTERS: l->p.conv.filters = v->num; break;
+        case PARAM_KERNEL: l->p.conv.kernel = v->num; break;
+        case PARAM_SIZE: l->p.pool.size = v->num; break;
+        case PARAM_UNITS: l->p.dense.units = v->num; break;
+        case PARAM_ACTIVATION: l->activation = v->str; break;
+    }
+}
+
+void train_set_param(TrainAST *t, int param, const ParamValue *v) {
+    switch (param) {
+        case PARAM_OPTIMIZER: snprintf(t->optimizer, sizeof(t->optimizer), "%s", v->str); break;
+        case PARAM_LOSS: snprintf(t->loss, sizeof(t->loss), "%s", v->str); break;
+        case PARAM_DATASET: snprintf(t->dataset, sizeof(t->dataset), "%s", v->str); break;
+        case PARAM_EPOCHS: t->epochs = v->num; break;
+        case PARAM_BATCH_SIZE: t->batch_size = v->num; break;
+        case PARAM_PREFETCH: t->prefetch = v->num; break;
+        case PARAM_CACHE: t->cache = v->num; break;
+        case PARAM_SHUFFLE_BUFFER: t->shuffle_buffer = v->num; break;
+        case PARAM_MIXED_PRECISION: t->mixed_precision = (TrainPrecision)v->num; break;
+        case PARAM_JIT_COMPILE: t->jit_compile = v->num; break;
+    }
+}
+
+int layer_filters(const Layer *l) { return l->p.conv.filters ? l->p.conv.filters : 32; }
+int layer_kernel(const Layer *l) { return l->p.conv.kernel ? l->p.conv.kernel : 3; }
+int layer_pool(const Layer *l) { return l->p.pool.size ? l->p.pool.size : 2; }
+
+int layer_units(const Layer *l) {
+    if (l->p.dense.units) return l->p.dense.units;
+    return l->type == LAYER_OUTPUT ? 10 : 64;
+}
+
+const char *layer_activation(const Layer *l) {
+    if (l->activation) return l->activation;
+    return l->type == LAYER_OUTPUT ? "softmax" : "relu";
+}
@@ -0,0 +1,267 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "../include/astbin.h"
+#include "../include/codegen.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define ASTBIN_LAYERS_OFF ((sizeof(AstBinHeader) + 7) & ~(size_t)7)
+
+int astbin_is(const char *data, size_t size) {
+    return size >= sizeof(ASTBIN_MAGIC) && memcmp(data, ASTBIN_MAGIC, sizeof(ASTBIN_MAGIC)) == 0;
+}
+
+static int bad(FILE *diag, const char *what) {
+    if (diag) fprintf(diag, "Error: binary AST: %s\n", what);
+    return 1;
+}
+
+// O(1): only the header and the section bounds are checked, never the
+// layers themselves, so opening does not depend on the model size.
+int astbin_view(AstBin *b, const char *data, size_t size, FILE *diag) {
+    memset(b, 0, sizeof(*b));
+    if (!astbin_is(data, size) || size < ASTBIN_HEADER_V1) return bad(diag, "bad magic");
+    if (((uintptr_t)data & 7) != 0) return bad(diag, "buffer is not 8-byte aligned");
+    const AstBinHeader *h = (const AstBinHeader*)data;
+    if (h->endian != ASTBIN_ENDIAN) return bad(diag, "written on a host of the other byte order");
+    if (h->version < 1 || h->version > ASTBIN_VERSION) return bad(diag, "unsupported version");
+    if (h->header_size < (h->version == 1 ? ASTBIN_HEADER_V1 : sizeof(AstBinHeader)) || h->layer_stride < sizeof(AstBinLayer) || (h->layer_stride & 3) != 0)
+        return bad(diag, "bad header or layer size");
+    if (h->layers_off < h->header_size || (h->layers_off & 7) != 0 || h->layers_off > size
+        || (uint64_t)h->n_layers * h->layer_stride > size - h->layers_off)
+        return bad(diag, "layer table out of bounds");
+    if (h->strings_off > size || h->strings_size == 0 || h->strings_size > size - h->strings_off
+        || data[h->strings_off] != '\0' || data[h->strings_off + h->strings_size - 1] != '\0')
+        return bad(diag, "string table out of bounds");
+    b->base = data;
+    b->size = size;
+    b->h = h;
+    return 0;
+}
+
+int astbin_open(AstBin *b, const char *path, FILE *diag) {
+    memset(b, 0, sizeof(*b));
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) { perror(path); return 1; }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) { close(fd); return bad(diag, "empty file"); }
+    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) { perror(path); return 1; }
+    if (astbin_view(b, (const char*)p, (size_t)st.st_size, diag) != 0) {
+        munmap(p, (size_t)st.st_size);
+        return 1;
+    }
+    b->map = p;
+    return 0;
+#else
+    (void)path;
+    return bad(diag, "astbin_open needs mmap; read the file and use astbin_view");
+#endif
+}
+
+void astbin_close(AstBin *b) {
+#ifndef _WIN32
+    if (b->map) munmap(b->map, b->size);
+#endif
+    memset(b, 0, sizeof(*b));
+}
+
+const AstBinLayer *astbin_layer(const AstBin *b, uint32_t i) {
+    return (const AstBinLayer*)(b->base + b->h->layers_off + (size_t)i * b->h->layer_stride);
+}
+
+const char *astbin_str(const AstBin *b, uint32_t off) {
+    if (off >= b->h->strings_size) return "";
+    return b->base + b->h->strings_off + off;
+}
+
+// String table under construction. Activations are interned, so they are
+// deduplicated by pointer.
+typedef struct {
+    char *buf;
+    size_t len, cap;
+    const char **keys;
+    uint32_t *offs;
+    size_t slots, count;
+} StrTab;
+
+static uint32_t strtab_add(StrTab *st, const char *s) {
+    if (!s || !*s) return 0;
+    size_t n = strlen(s) + 1;
+    if (st->len + n > st->cap) {
+        while (st->len + n > st->cap) st->cap *= 2;
+        st->buf = (char*)realloc(st->buf, st->cap);
+    }
+    memcpy(st->buf + st->len, s, n);
+    st->len += n;
+    return (uint32_t)(st->len - n);
+}
+
+static void strtab_rehash(StrTab *st) {
+    size_t old = st->slots;
+    const char **keys = st->keys;
+    uint32_t *offs = st->offs;
+    st->slots = old ? old * 2 : 64;
+    st->keys = (const char**)calloc(st->slots, sizeof(char*));
+    st->offs = (uint32_t*)calloc(st->slots, sizeof(uint32_t));
+    for (size_t j = 0; j < old; j++) {
+        if (!keys[j]) continue;
+        size_t i = ((uintptr_t)keys[j] >> 4) & (st->slots - 1);
+        while (st->keys[i]) i = (i + 1) & (st->slots - 1);
+        st->keys[i] = keys[j];
+        st->offs[i] = offs[j];
+    }
+    free(keys);
+    free(offs);
+}
+
+static uint32_t strtab_intern(StrTab *st, const char *s) {
+    if (!s) return 0;
+    if (2 * (st->count + 1) > st->slots) strtab_rehash(st);
+    size_t i = ((uintptr_t)s >> 4) & (st->slots - 1);
+    while (st->keys[i] && st->keys[i] != s) i = (i + 1) & (st->slots - 1);
+    if (!st->keys[i]) {
+        st->keys[i] = s;
+        st->offs[i] = strtab_add(st, s);
+        st->count++;
+    }
+    return st->offs[i];
+}
+
+int astbin_write(CompileContext *ctx, const ModelAST *m, const TrainAST *t) {
+    if (m->n_layers < 0 || (uint64_t)m->n_layers * sizeof(AstBinLayer) > UINT32_MAX) {
+        fprintf(ctx->diag, "Error: %s: too many layers for a binary AST\n", ctx->in_path);
+        return 1;
+    }
+    StrTab st;
+    memset(&st, 0, sizeof(st));
+    st.cap = 256;
+    st.buf = (char*)malloc(st.cap);
+    st.buf[st.len++] = '\0';
+
+    AstBinHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, ASTBIN_MAGIC, sizeof(ASTBIN_MAGIC));
+    h.version = ASTBIN_VERSION;
+    h.endian = ASTBIN_ENDIAN;
+    h.header_size = sizeof(AstBinHeader);
+    h.layer_stride = sizeof(AstBinLayer);
+    h.n_layers = (uint32_t)m->n_layers;
+    h.name = strtab_add(&st, m->name);
+    h.optimizer = strtab_add(&st, t->optimizer);
+    h.loss = strtab_add(&st, t->loss);
+    h.dataset = strtab_add(&st, t->dataset);
+    h.epochs = t->epochs;
+    h.batch_size = t->batch_size;
+    h.prefetch = t->prefetch;
+    h.cache = t->cache;
+    h.shuffle_buffer = t->shuffle_buffer;
+    h.mixed_precision = (int32_t)t->mixed_precision;
+    h.jit_compile = t->jit_compile;
+
+    AstBinLayer *ls = (AstBinLayer*)calloc((size_t)m->n_layers + 1, sizeof(AstBinLayer));
+    for (int i = 0; i < m->n_layers; i++) {
+        const Layer *l = &m->layers[i];
+        AstBinLayer *r = &ls[i];
+        r->type = (uint32_t)l->type;
+        r->activation = strtab_intern(&st, l->activation);
+        r->line = (uint32_t)l->line;
+        switch (l->type) {
+            case LAYER_INPUT: r->p[0] = l->p.input.ch; r->p[1] = l->p.input.h; r->p[2] = l->p.input.w; break;
+            case LAYER_CONV2D: r->p[0] = l->p.conv.filters; r->p[1] = l->p.conv.kernel; break;
+            case LAYER_MAXPOOL2D: r->p[0] = l->p.pool.size; break;
+            case LAYER_DENSE: case LAYER_OUTPUT: r->p[0] = l->p.dense.units; break;
+            default: break;
+        }
+    }
+    h.layers_off = ASTBIN_LAYERS_OFF;
+    h.strings_off = h.layers_off + (uint64_t)m->n_layers * sizeof(AstBinLayer);
+    h.strings_size = st.len;
+
+    static const char pad[8];
+    int rc = 1;
+    FILE *f = ctx->out ? ctx->out : fopen(ctx->out_path, "wb");
+    if (!f) perror(ctx->out_path);
+    else {
+        fwrite(&h, sizeof(h), 1, f);
+        fwrite(pad, 1, ASTBIN_LAYERS_OFF - sizeof(h), f);
+        fwrite(ls, sizeof(AstBinLayer), (size_t)m->n_layers, f);
+        fwrite(st.buf, 1, st.len, f);
+        rc = codegen_close(ctx, f, "binary AST");
+    }
+    free(ls);
+    free(st.buf);
+    free(st.keys);
+    free(st.offs);
+    return rc;
+}
+
+// Builds an ordinary AST for analysis and the code generators. Runs of
+// layers with the same activation offset share one intern lookup.
+int astbin_load(CompileContext *ctx, const AstBin *b, ProgramAST *prog) {
+    const AstBinHeader *h = b->h;
+    memset(prog, 0, sizeof(*prog));
+    const char *name = astbin_str(b, h->name);
+    ModelAST *m = model_new(&ctx->arena, name, strlen(name));
+    if (!m) return 1;
+    if (h->n_layers) {
+        m->layers = (Layer*)arena_alloc(&ctx->arena, (size_t)h->n_layers * sizeof(Layer));
+        if (!m->layers) return 1;
+    }
+    m->n_layers = m->cap_layers = (int)h->n_layers;
+    uint32_t last_off = 0;
+    const char *last_act = NULL;
+    for (uint32_t i = 0; i < h->n_layers; i++) {
+        const AstBinLayer *r = astbin_layer(b, i);
+        Layer *l = &m->layers[i];
+        if (r->type > LAYER_OUTPUT) {
+            fprintf(ctx->diag, "%s: layer %u has unknown type %u\n", ctx->in_path, i, r->type);
+            return 1;
+        }
+        l->type = (LayerType)r->type;
+        l->line = (int)r->line;
+        if (r->activation) {
+            if (r->activation != last_off) {
+                const char *s = astbin_str(b, r->activation);
+                last_act = intern(&ctx->strings, &ctx->arena, s, strlen(s));
+                last_off = r->activation;
+            }
+            l->activation = last_act;
+        }
+        switch (l->type) {
+            case LAYER_INPUT: l->p.input.ch = r->p[0]; l->p.input.h = r->p[1]; l->p.input.w = r->p[2]; break;
+            case LAYER_CONV2D: l->p.conv.filters = r->p[0]; l->p.conv.kernel = r->p[1]; break;
+            case LAYER_MAXPOOL2D: l->p.pool.size = r->p[0]; break;
+            case LAYER_DENSE: case LAYER_OUTPUT: l->p.dense.units = r->p[0]; break;
+            default: break;
+        }
+    }
+    NetworkAST *n = (NetworkAST*)arena_alloc(&ctx->arena, sizeof(NetworkAST));
+    if (!n) return 1;
+    prog->nets = n;
+    prog->n_nets = 1;
+    n->model = m;
+    snprintf(n->train.optimizer, sizeof(n->train.optimizer), "%s", astbin_str(b, h->optimizer));
+    snprintf(n->train.loss, sizeof(n->train.loss), "%s", astbin_str(b, h->loss));
+    snprintf(n->train.dataset, sizeof(n->train.dataset), "%s", astbin_str(b, h->dataset));
+    n->train.epochs = h->epochs;
+    if (h->version >= 2) {
+        n->train.batch_size = h->batch_size;
+        n->train.prefetch = h->prefetch;
+        n->train.cache = h->cache;
+        n->train.shuffle_buffer = h->shuffle_buffer;
+        n->train.mixed_precision = h->mixed_precision >= 0 && h->mixed_precision <= PRECISION_MIXED_BFLOAT16
+            ? (TrainPrecision)h->mixed_precision : PRECISION_FLOAT32;
+        n->train.jit_compile = h->jit_compile;
+    }
+    return 0;
+}
@@ -0,0 +1,313 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <dirent.h>
+#include <utime.h>
+#include <sys/stat.h>
+#include "../include/cache.h"
+#include "../include/compile.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#define make_dir(p) _mkdir(p)
+#else
+#include <unistd.h>
+#include <sys/file.h>
+#define make_dir(p) mkdir((p), 0777)
+#endif
+
+// ---- hashing (xxHash64) ----
+
+#define P1 11400714785074694791ULL
+#define P2 14029467366897019727ULL
+#define P3 1609587929392839161ULL
+#define P4 9650029242287828579ULL
+#define P5 2870177450012600261ULL
+
+static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+static uint64_t rd64(const unsigned char *p) { uint64_t v; memcpy(&v, p, 8); return v; }
+static uint32_t rd32(const unsigned char *p) { uint32_t v; memcpy(&v, p, 4); return v; }
+static uint64_t round64(uint64_t acc, uint64_t in) { acc += in * P2; acc = rotl(acc, 31); return acc * P1; }
+static uint64_t merge64(uint64_t acc, uint64_t v) { acc ^= round64(0, v); return acc * P1 + P4; }
+
+uint64_t hash64(const void *data, size_t len, uint64_t seed) {
+    const unsigned char *p = (const unsigned char*)data, *end = p + len;
+    uint64_t h;
+    if (len >= 32) {
+        uint64_t v1 = seed + P1 + P2, v2 = seed + P2, v3 = seed, v4 = seed - P1;
+        const unsigned char *limit = end - 32;
+        do {
+            v1 = round64(v1, rd64(p)); v2 = round64(v2, rd64(p + 8));
+            v3 = round64(v3, rd64(p + 16)); v4 = round64(v4, rd64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = merge64(h, v1); h = merge64(h, v2); h = merge64(h, v3); h = merge64(h, v4);
+    } else {
+        h = seed + P5;
+    }
+    h += (uint64_t)len;
+    for (; p + 8 <= end; p += 8) { h ^= round64(0, rd64(p)); h = rotl(h, 27) * P1 + P4; }
+    if (p + 4 <= end) { h ^= (uint64_t)rd32(p) * P1; h = rotl(h, 23) * P2 + P3; p += 4; }
+    for (; p < end; p++) { h ^= (*p) * P5; h = rotl(h, 11) * P1; }
+    h ^= h >> 33; h *= P2; h ^= h >> 29; h *= P3; h ^= h >> 32;
+    return h;
+}
+
+uint64_t cache_key(const void *src, size_t len, const char *options_key) {
+    // compiler identity: version plus build time, so a rebuilt compiler never reuses stale output
+    static const char ident[] = NEURODSL_VERSION " " __DATE__ " " __TIME__;
+    uint64_t seed = hash64(ident, sizeof(ident) - 1, 0);
+    seed = hash64(options_key, strlen(options_key), seed);
+    return hash64(src, len, seed);
+}
+
+// ---- entries ----
+
+static void entry_path(CompileCache *c, uint64_t key, char *out, size_t n) {
+    snprintf(out, n, "%s/%016llx.out", c->dir, (unsigned long long)key);
+}
+
+// copies limit bytes (all of in when limit is ~0ULL); -1 on a short read or failed write
+static int copy_stream(FILE *in, FILE *out, unsigned long long limit, unsigned long long *size) {
+    char buf[1 << 16];
+    unsigned long long total = 0;
+    int rc = 0;
+    while (total < limit) {
+        size_t want = limit - total < sizeof(buf) ? (size_t)(limit - total) : sizeof(buf);
+        size_t n = fread(buf, 1, want, in);
+        if (n == 0) break;
+        if (fwrite(buf, 1, n, out) != n) { rc = -1; break; }
+        total += n;
+    }
+    if (ferror(in) || (limit != ~0ULL && total != limit)) rc = -1;
+    if (size) *size = total;
+    return rc;
+}
+
+static int copy_file(const char *from, const char *to, unsigned long long *size) {
+    FILE *in = fopen(from, "rb");
+    if (!in) return -1;
+    FILE *out = fopen(to, "wb");
+    if (!out) { fclose(in); return -1; }
+    int rc = copy_stream(in, out, ~0ULL, size);
+    fclose(in);
+    if (fclose(out) != 0) rc = -1;
+    return rc;
+}
+
+// Bundle entry: the magic line, then per output a "<suffix> <bytes>" line
+// followed by that many bytes. The suffix replaces the extension of the
+// output path (compile_output_path), so an entry works for any stem.
+#define BUNDLE_MAGIC "NDSLBNDL\n"
+#define BUNDLE_MAGIC_LEN 9
+
+static int write_bundle(const char *out_path, const char *const *suffixes, int n, const char *to, unsigned long long *size) {
+    FILE *out = fopen(to, "wb");
+    if (!out) return -1;
+    int rc = fwrite(BUNDLE_MAGIC, 1, BUNDLE_MAGIC_LEN, out) == BUNDLE_MAGIC_LEN ? 0 : -1;
+    char path[1200];
+    for (int i = 0; i < n && rc == 0; i++) {
+        compile_output_path(out_path, suffixes[i], path, sizeof(path));
+        struct stat st;
+        FILE *in = stat(path, &st) == 0 ? fopen(path, "rb") : NULL;
+        if (!in) { rc = -1; break; }
+        fprintf(out, "%s %llu\n", suffixes[i], (unsigned long long)st.st_size);
+        rc = copy_stream(in, out, (unsigned long long)st.st_size, NULL);
+        fclose(in);
+    }
+    long end = ftell(out);
+    if (fclose(out) != 0) rc = -1;
+    if (size) *size = end > 0 ? (unsigned long long)end : 0;
+    return rc;
+}
+
+typedef struct {
+    char name[32];
+    unsigned long long size;
+    time_t mtime;
+} Entry;
+
+static int cmp_mtime(const void *a, const void *b) {
+    time_t x = ((const Entry*)a)->mtime, y = ((const Entry*)b)->mtime;
+    return x < y ? -1 : x > y;
+}
+
+// list <key>.out entries; returns count, *out is malloc'd
+static size_t scan_entries(CompileCache *c, Entry **out, unsigned long long *total) {
+    size_t n = 0, cap = 0;
+    Entry *es = NULL;
+    *total = 0;
+    DIR *d = opendir(c->dir);
+    if (d) {
+        struct dirent *de;
+        char path[1200];
+        while ((de = readdir(d)) != NULL) {
+            size_t len = strlen(de->d_name);
+            if (len != 20 || strcmp(de->d_name + 16, ".out") != 0) continue;
+            struct stat st;
+            snprintf(path, sizeof(path), "%s/%s", c->dir, de->d_name);
+            if (stat(path, &st) != 0) continue;
+            if (n == cap) { cap = cap ? cap * 2 : 256; es = (Entry*)realloc(es, cap * sizeof(Entry)); }
+            memcpy(es[n].name, de->d_name, len + 1);
+            es[n].size = (unsigned long long)st.st_size;
+            es[n].mtime = st.st_mtime;
+            *total += es[n].size;
+            n++;
+        }
+        closedir(d);
+    }
+    *out = es;
+    return n;
+}
+
+// delete least recently used entries until the cache is back under 90% of its bound
+static void evict(CompileCache *c) {
+    Entry *es;
+    unsigned long long total;
+    size_t n = scan_entries(c, &es, &total);
+    qsort(es, n, sizeof(Entry), cmp_mtime);
+    unsigned long long target = c->max_bytes / 10 * 9;
+    char path[1200];
+    for (size_t i = 0; i < n && total > target; i++) {
+        snprintf(path, sizeof(path), "%s/%s", c->dir, es[i].name);
+        if (remove(path) == 0) { total -= es[i].size; c->evictions++; }
+    }
+    c->total_bytes = total;
+    free(es);
+}
+
+int make_dirs(const char *dir) {
+    char tmp[1024];
+    snprintf(tmp, sizeof(tmp), "%s", dir);
+    for (char *p = tmp + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        make_dir(tmp);
+        *p = '/';
+    }
+    if (make_dir(tmp) != 0 && errno != EEXIST) { perror(dir); return 1; }
+    return 0;
+}
+
+int cache_open(CompileCache *c, const char *dir, unsigned long long max_bytes) {
+    memset(c, 0, sizeof(*c));
+    snprintf(c->dir, sizeof(c->dir), "%s", dir);
+    c->max_bytes = max_bytes;
+    if (make_dirs(dir) != 0) return 1;
+    Entry *es;
+    scan_entries(c, &es, &c->total_bytes);
+    free(es);
+    pthread_mutex_init(&c->mu, NULL);
+    return 0;
+}
+
+// writes each output of a bundle entry beside out_path; returns the count, -1 on a damaged entry
+static int read_bundle(FILE *in, const char *out_path) {
+    char line[1100], suffix[1024], path[1200];
+    unsigned long long size;
+    int n = 0;
+    while (fgets(line, sizeof(line), in)) {
+        if (sscanf(line, "%1023s %llu", suffix, &size) != 2 || strpbrk(suffix, "/\\")) return -1;
+        compile_output_path(out_path, suffix, path, sizeof(path));
+        FILE *out = fopen(path, "wb");
+        if (!out) return -1;
+        int rc = copy_stream(in, out, size, NULL);
+        if (fclose(out) != 0 || rc != 0) return -1;
+        n++;
+    }
+    return n > 0 ? n : -1;
+}
+
+int cache_fetch(CompileCache *c, uint64_t key, const char *out_path, int *outputs) {
+    char path[1200], magic[BUNDLE_MAGIC_LEN];
+    entry_path(c, key, path, sizeof(path));
+    int n = -1;
+    FILE *in = fopen(path, "rb");
+    if (in) {
+        if (fread(magic, 1, BUNDLE_MAGIC_LEN, in) == BUNDLE_MAGIC_LEN && memcmp(magic, BUNDLE_MAGIC, BUNDLE_MAGIC_LEN) == 0) {
+            n = read_bundle(in, out_path);
+        } else {
+            rewind(in);
+            FILE *out = fopen(out_path, "wb");
+            if (out) {
+                n = copy_stream(in, out, ~0ULL, NULL) == 0 ? 1 : -1;
+                if (fclose(out) != 0) n = -1;
+            }
+        }
+        fclose(in);
+    }
+    int hit = n > 0;
+    if (hit) utime(path, NULL);     // mark as most recently used
+    if (outputs) *outputs = hit ? n : 0;
+    pthread_mutex_lock(&c->mu);
+    if (hit) c->hits++; else c->misses++;
+    pthread_mutex_unlock(&c->mu);
+    return hit ? 0 : 1;
+}
+
+// write under a private name and rename, so readers never see a partial entry
+static void store_entry(CompileCache *c, uint64_t key, const char *out_path, const char *const *suffixes, int n) {
+    char path[1200], tmp[1300];
+    static unsigned long seq = 0;
+    entry_path(c, key, path, sizeof(path));
+    pthread_mutex_lock(&c->mu);
+    unsigned long id = seq++;
+    pthread_mutex_unlock(&c->mu);
+    snprintf(tmp, sizeof(tmp), "%s.%ld.%lu.tmp", path, (long)getpid(), id);
+    unsigned long long size = 0;
+    int rc = suffixes ? write_bundle(out_path, suffixes, n, tmp, &size) : copy_file(out_path, tmp, &size);
+    if (rc != 0 || rename(tmp, path) != 0) { remove(tmp); return; }
+    pthread_mutex_lock(&c->mu);
+    c->stores++;
+    c->total_bytes += size;
+    if (c->max_bytes && c->total_bytes > c->max_bytes) evict(c);
+    pthread_mutex_unlock(&c->mu);
+}
+
+void cache_store(CompileCache *c, uint64_t key, const char *out_path) {
+    store_entry(c, key, out_path, NULL, 1);
+}
+
+void cache_store_bundle(CompileCache *c, uint64_t key, const char *out_path, const char *const *suffixes, int n) {
+    store_entry(c, key, out_path, suffixes, n);
+}
+
+// cumulative counters: "hits misses stores evictions" in <dir>/stats
+void cache_close(CompileCache *c) {
+    char path[1100];
+    snprintf(path, sizeof(path), "%s/stats", c->dir);
+    FILE *f = fopen(path, "a+");
+    if (f) {
+#ifndef _WIN32
+        flock(fileno(f), LOCK_EX);
+#endif
+        unsigned long h = 0, m = 0, s = 0, e = 0;
+        rewind(f);
+        if (fscanf(f, "%lu %lu %lu %lu", &h, &m, &s, &e) != 4) h = m = s = e = 0;
+        FILE *w = fopen(path, "w");
+        if (w) {
+            fprintf(w, "%lu %lu %lu %lu\n", h + c->hits, m + c->misses, s + c->stores, e + c->evictions);
+            fclose(w);
+        }
+        fclose(f);
+    }
+    pthread_mutex_destroy(&c->mu);
+}
+
+void cache_print_stats(CompileCache *c, FILE *f) {
+    unsigned long lookups = c->hits + c->misses;
+    fprintf(f, "cache %s: %lu hits, %lu misses (%.1f%% hit rate), %lu stored, %lu evicted, %.1f/%.1f MB\n",
+            c->dir, c->hits, c->misses, lookups ? 100.0 * c->hits / lookups : 0.0,
+            c->stores, c->evictions, c->total_bytes / 1048576.0, c->max_bytes / 1048576.0);
+    char path[1100];
+    snprintf(path, sizeof(path), "%s/stats", c->dir);
+    FILE *s = fopen(path, "r");
+    unsigned long h, m, st, e;
+    if (s && fscanf(s, "%lu %lu %lu %lu", &h, &m, &st, &e) == 4)
+        fprintf(f, "cache %s: all runs: %lu hits, %lu misses, %lu stored, %lu evicted\n", c->dir, h, m, st, e);
+    if (s) fclose(s);
+}
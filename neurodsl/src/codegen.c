@@ -1,105 +1,392 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include "../include/ast.h"
-
-static const char *out_path = "generated/model.py";
-
-void generate_python(ModelAST *m, TrainAST *t) {
-    FILE *f = fopen(out_path, "w");
-    if (!f) { perror("fopen"); return; }
-
-    fprintf(f, "import os\n");
-    fprintf(f, "os.environ['TF_CPP_MIN_LOG_LEVEL']='2'\n");
-    fprintf(f, "import numpy as np\n");
-    fprintf(f, "import tensorflow as tf\n");
-    fprintf(f, "from tensorflow.keras import layers, models\n\n");
-
-    fprintf(f, "def build_model():\n");
-    fprintf(f, "    model = models.Sequential()\n");
-
-    // find input shape if present first layer is input
-    Layer *p = m->layers;
-    if (p && p->type == LAYER_INPUT) {
-        fprintf(f, "    model.add(layers.Input(shape=(%d, %d, %d)))\n", p->i_h, p->i_w, p->i_ch);
-        p = p->next;
-    }
-
-    for (; p; p = p->next) {
-        switch (p->type) {
-            case LAYER_CONV2D:
-                {
-                    int filt = p->filters? p->filters : 32;
-                    int k = p->kernel? p->kernel : 3;
-                    const char *act = p->activation[0]? p->activation : "relu";
-                    fprintf(f, "    model.add(layers.Conv2D(%d, (%d, %d), activation='%s', padding='same'))\n", filt, k, k, act);
-                }
-                break;
-            case LAYER_MAXPOOL2D:
-                {
-                    int s = p->pool_size? p->pool_size : 2;
-                    fprintf(f, "    model.add(layers.MaxPooling2D(pool_size=(%d,%d)))\n", s, s);
-                } break;
-            case LAYER_FLATTEN:
-                fprintf(f, "    model.add(layers.Flatten())\n"); break;
-            case LAYER_DENSE:
-                {
-                    int u = p->units? p->units : 64;
-                    const char *act = p->activation[0]? p->activation : "relu";
-                    fprintf(f, "    model.add(layers.Dense(%d, activation='%s'))\n", u, act);
-                } break;
-            case LAYER_OUTPUT:
-                {
-                    int u = p->units? p->units : 10;
-                    const char *act = p->activation[0]? p->activation : "softmax";
-                    fprintf(f, "    model.add(layers.Dense(%d, activation='%s'))\n", u, act);
-                } break;
-            default: break;
-        }
-    }
-
-    fprintf(f, "    return model\n\n");
-
-    // compile and training block
-    fprintf(f, "if __name__ == '__main__':\n");
-    fprintf(f, "    model = build_model()\n");
-    fprintf(f, "    model.summary()\n");
-    const char *opt = t->optimizer[0]? t->optimizer : "adam";
-    const char *loss = t->loss[0]? t->loss : "categorical_crossentropy";
-    int epochs = t->epochs? t->epochs : 1;
-    fprintf(f, "    model.compile(optimizer='%s', loss='%s', metrics=['accuracy'])\n", opt, loss);
-
-    // If dataset == "mnist", emit MNIST loader
-    if (t->dataset[0] && strcasecmp(t->dataset, "mnist") == 0) {
-        fprintf(f, "    from tensorflow.keras.datasets import mnist\n");
-        fprintf(f, "    (x_train, y_train), (x_test, y_test) = mnist.load_data()\n");
-        // detect input shape
-        Layer *inp = m->layers;
-        int h=28,w=28,ch=1;
-        if (inp && inp->type==LAYER_INPUT) { ch = inp->i_ch; h = inp->i_h; w = inp->i_w; }
-        // reshape/pad single-channel if needed
-        if (ch == 1) {
-            fprintf(f, "    x_train = x_train.reshape(-1, %d, %d, 1).astype('float32') / 255.0\n", h, w);
-            fprintf(f, "    x_test  = x_test.reshape(-1, %d, %d, 1).astype('float32') / 255.0\n", h, w);
-        } else {
-            fprintf(f, "    x_train = x_train.reshape(-1, %d, %d, %d).astype('float32') / 255.0\n", h, w, ch);
-            fprintf(f, "    x_test  = x_test.reshape(-1, %d, %d, %d).astype('float32') / 255.0\n", h, w, ch);
-        }
-        fprintf(f, "    y_train = tf.keras.utils.to_categorical(y_train, 10)\n");
-        fprintf(f, "    y_test  = tf.keras.utils.to_categorical(y_test, 10)\n");
-        fprintf(f, "    model.fit(x_train, y_train, epochs=%d, batch_size=64, validation_split=0.1)\n", epochs);
-        fprintf(f, "    loss, acc = model.evaluate(x_test, y_test)\n");
-        fprintf(f, "    print('Test loss:', loss, 'Test accuracy:', acc)\n");
-    } else {
-        // fallback: random data (existing behavior)
-        Layer *inp = m->layers;
-        int h=28,w=28,ch=1;
-        if (inp && inp->type==LAYER_INPUT) { ch = inp->i_ch; h = inp->i_h; w = inp->i_w; }
-        fprintf(f, "    x = np.random.rand(100, %d, %d, %d).astype(np.float32)\n", h, w, ch);
-        fprintf(f, "    y = tf.keras.utils.to_categorical(np.random.randint(0,10,size=(100,)), num_classes=10)\n");
-        fprintf(f, "    model.fit(x,y, epochs=%d, batch_size=16)\n", epochs);
-    }
-
-    fclose(f);
-    printf("Generated Python model at %s\n", out_path);
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/ast.h"
+#include "../include/codegen.h"
+#include "../include/astbin.h"
+#include "../include/analysis.h"
+
+void codegen_options_key(const CodegenOptions *o, char *buf, size_t n) {
+    static const char *targets[] = { "python", "c", "ast-bin" };
+    int len = snprintf(buf, n, "target=%s%s%s", targets[o->target], o->no_fuse ? " no-fuse" : "", o->quantize == QUANT_INT8 ? " int8" : "");
+    if (o->profile && o->target == TARGET_PYTHON && len >= 0 && (size_t)len < n) snprintf(buf + len, n - (size_t)len, " profile=%d:%d", o->profile_first, o->profile_last);
+}
+
+FILE *codegen_open(CompileContext *ctx) {
+    if (ctx->out) return ctx->out;
+    FILE *f = fopen(ctx->out_path, "w");
+    if (!f) perror(ctx->out_path);
+    return f;
+}
+
+int codegen_close(CompileContext *ctx, FILE *f, const char *what) {
+    if (f == ctx->out) return ferror(f) ? 1 : 0;
+    if (fclose(f) != 0) { perror(ctx->out_path); return 1; }
+    if (!ctx->quiet) printf("Generated %s model at %s\n", what, ctx->out_path);
+    return 0;
+}
+
+// --profile: a step timer callback with a TensorFlow profiler trace window,
+// input pipeline and per-layer forward timing, all written to one JSON file
+// whose layer entries carry the DSL layer index and source line
+static void emit_profiler(FILE *f, CompileContext *ctx, const ModelAST *m, int first, int batch) {
+    const CodegenOptions *o = &ctx->opts;
+    fprintf(f, "import json\n");
+    fprintf(f, "import time\n\n");
+    fprintf(f, "PROFILE_NETWORK = '%s'\n", m->name);
+    fprintf(f, "PROFILE_BATCH = %d\n", batch);
+    fprintf(f, "PROFILE_TRACE = (%d, %d)  # first and last training step the TensorFlow profiler traces\n", o->profile_first, o->profile_last);
+    fprintf(f, "PROFILE_INPUT = (0, %d)  # (DSL layer index, source line) charged with the input pipeline\n", first ? m->layers[0].line : 0);
+    fprintf(f, "# (DSL layer index, source line, type, FLOPs per example) of each entry of model.layers\n");
+    fprintf(f, "PROFILE_LAYERS = [\n");
+    for (int i = first; i < m->n_layers; i++)
+        fprintf(f, "    (%d, %d, '%s', %lld),\n", i, m->layers[i].line, layer_type_name(m->layers[i].type), ctx->cost.layers ? ctx->cost.layers[i].flops : 0LL);
+    fprintf(f, "]\n\n");
+    fprintf(f, "class StepProfiler(tf.keras.callbacks.Callback):\n");
+    fprintf(f, "    \"\"\"Wall time and examples/s of every training step and epoch. Traces the steps in\n");
+    fprintf(f, "    PROFILE_TRACE with the TensorFlow profiler (open logdir in TensorBoard).\"\"\"\n");
+    fprintf(f, "    def __init__(self, examples, logdir):\n");
+    fprintf(f, "        super().__init__()\n");
+    fprintf(f, "        self.examples, self.logdir = examples, logdir\n");
+    fprintf(f, "        self.epochs, self.steps = [], []\n");
+    fprintf(f, "        self.step, self.tracing = 0, False\n");
+    fprintf(f, "    def on_epoch_begin(self, epoch, logs=None):\n");
+    fprintf(f, "        self.epoch_start = self.step_end = time.perf_counter()\n");
+    fprintf(f, "        self.epoch_steps = 0\n");
+    fprintf(f, "    def on_train_batch_begin(self, batch, logs=None):\n");
+    fprintf(f, "        if self.step == PROFILE_TRACE[0]:\n");
+    fprintf(f, "            tf.profiler.experimental.start(self.logdir)\n");
+    fprintf(f, "            self.tracing = True\n");
+    fprintf(f, "        self.step_start = time.perf_counter()\n");
+    fprintf(f, "    def on_train_batch_end(self, batch, logs=None):\n");
+    fprintf(f, "        self.step_end = time.perf_counter()\n");
+    fprintf(f, "        dt = self.step_end - self.step_start\n");
+    fprintf(f, "        self.steps.append({'epoch': len(self.epochs), 'step': batch, 'seconds': dt,\n");
+    fprintf(f, "                           'examples_per_sec': PROFILE_BATCH / dt if dt > 0 else 0.0})\n");
+    fprintf(f, "        if self.tracing and self.step == PROFILE_TRACE[1]:\n");
+    fprintf(f, "            self.stop_trace()\n");
+    fprintf(f, "        self.step += 1\n");
+    fprintf(f, "        self.epoch_steps += 1\n");
+    fprintf(f, "    def on_epoch_end(self, epoch, logs=None):\n");
+    fprintf(f, "        dt = self.step_end - self.epoch_start  # training steps only, not validation\n");
+    fprintf(f, "        self.epochs.append({'epoch': epoch, 'seconds': dt, 'steps': self.epoch_steps,\n");
+    fprintf(f, "                            'examples_per_sec': self.examples / dt if dt > 0 else 0.0})\n");
+    fprintf(f, "    def on_train_end(self, logs=None):\n");
+    fprintf(f, "        if self.tracing:  # training ended inside the window\n");
+    fprintf(f, "            self.stop_trace()\n");
+    fprintf(f, "    def stop_trace(self):\n");
+    fprintf(f, "        tf.profiler.experimental.stop()\n");
+    fprintf(f, "        self.tracing = False\n\n");
+    fprintf(f, "def profile_pipeline(ds, batches=50):\n");
+    fprintf(f, "    \"\"\"The input pipeline on its own: batches/s with no training step to wait for.\"\"\"\n");
+    fprintf(f, "    n, start = 0, time.perf_counter()\n");
+    fprintf(f, "    for _ in ds.take(batches):\n");
+    fprintf(f, "        n += 1\n");
+    fprintf(f, "    dt = time.perf_counter() - start\n");
+    fprintf(f, "    return {'index': PROFILE_INPUT[0], 'line': PROFILE_INPUT[1], 'batches': n, 'seconds': dt,\n");
+    fprintf(f, "            'examples_per_sec': n * PROFILE_BATCH / dt if dt > 0 else 0.0}\n\n");
+    fprintf(f, "def profile_layers(model, x, repeats=20):\n");
+    fprintf(f, "    \"\"\"Forward time of every layer on the sample batch x, each layer compiled on its own and\n");
+    fprintf(f, "    fed the previous layer's output; the best of three rounds of repeats calls.\"\"\"\n");
+    fprintf(f, "    h, rows = tf.convert_to_tensor(x), []\n");
+    fprintf(f, "    for layer, (index, line, kind, flops) in zip(model.layers, PROFILE_LAYERS):\n");
+    fprintf(f, "        fn = tf.function(lambda t, layer=layer: layer(t, training=False))\n");
+    fprintf(f, "        out = fn(h)  # trace and warm up\n");
+    fprintf(f, "        best = float('inf')\n");
+    fprintf(f, "        for _ in range(3):\n");
+    fprintf(f, "            start = time.perf_counter()\n");
+    fprintf(f, "            for _ in range(repeats):\n");
+    fprintf(f, "                out = fn(h)\n");
+    fprintf(f, "            out.numpy()  # wait for the device\n");
+    fprintf(f, "            best = min(best, (time.perf_counter() - start) / repeats)\n");
+    fprintf(f, "        n = int(h.shape[0])\n");
+    fprintf(f, "        rows.append({'index': index, 'line': line, 'type': kind, 'keras': layer.name,\n");
+    fprintf(f, "                     'output_shape': list(out.shape[1:]), 'params': layer.count_params(), 'seconds': best,\n");
+    fprintf(f, "                     'examples_per_sec': n / best if best > 0 else 0.0,\n");
+    fprintf(f, "                     'gflops': flops * n / best / 1e9 if best > 0 else 0.0})\n");
+    fprintf(f, "        h = out\n");
+    fprintf(f, "    total = sum(r['seconds'] for r in rows) or 1.0\n");
+    fprintf(f, "    for r in rows:\n");
+    fprintf(f, "        r['share'] = r['seconds'] / total\n");
+    fprintf(f, "    return rows\n\n");
+    fprintf(f, "def write_profile(path, timer, pipeline, rows):\n");
+    fprintf(f, "    \"\"\"Layers are keyed '<index>:<line>', the DSL layer index and its line in the source.\"\"\"\n");
+    fprintf(f, "    report = {'network': PROFILE_NETWORK, 'batch_size': PROFILE_BATCH,\n");
+    fprintf(f, "              'trace': {'first_step': PROFILE_TRACE[0], 'last_step': PROFILE_TRACE[1], 'logdir': timer.logdir},\n");
+    fprintf(f, "              'epochs': timer.epochs, 'steps': timer.steps, 'input_pipeline': pipeline,\n");
+    fprintf(f, "              'layers': {'%%d:%%d' %% (r['index'], r['line']): r for r in rows}}\n");
+    fprintf(f, "    with open(path, 'w') as f:\n");
+    fprintf(f, "        json.dump(report, f, indent=1)\n");
+    fprintf(f, "    for r in sorted(rows, key=lambda r: -r['seconds'])[:3]:\n");
+    fprintf(f, "        print('layer %%d (line %%d, %%s): %%.3f ms per batch of %%d, %%.0f%%%% of the forward pass' %%\n");
+    fprintf(f, "              (r['index'], r['line'], r['type'], r['seconds'] * 1e3, PROFILE_BATCH, r['share'] * 100))\n");
+    fprintf(f, "    if timer.epochs:\n");
+    fprintf(f, "        print('input pipeline %%.0f examples/s, training %%.0f examples/s' %%\n");
+    fprintf(f, "              (pipeline['examples_per_sec'], timer.epochs[-1]['examples_per_sec']))\n");
+    fprintf(f, "    print('Wrote profile to', path)\n\n");
+}
+
+int generate_python(CompileContext *ctx, ModelAST *m, TrainAST *t) {
+    FILE *f = codegen_open(ctx);
+    if (!f) return 1;
+
+    fprintf(f, "import os\n");
+    fprintf(f, "os.environ['TF_CPP_MIN_LOG_LEVEL']='2'\n");
+    fprintf(f, "import numpy as np\n");
+    fprintf(f, "import tensorflow as tf\n");
+    fprintf(f, "from tensorflow.keras import layers, models\n\n");
+
+    fprintf(f, "def build_model():\n");
+    fprintf(f, "    model = models.Sequential()\n");
+
+    // find input shape if present first layer is input
+    int i = 0;
+    Layer *inp = m->n_layers > 0 && m->layers[0].type == LAYER_INPUT ? &m->layers[0] : NULL;
+    if (inp) {
+        fprintf(f, "    model.add(layers.Input(shape=(%d, %d, %d)))\n", inp->p.input.h, inp->p.input.w, inp->p.input.ch);
+        i = 1;
+    }
+
+    for (; i < m->n_layers; i++) {
+        Layer *p = &m->layers[i];
+        switch (p->type) {
+            case LAYER_CONV2D:
+                {
+                    int filt = layer_filters(p);
+                    int k = layer_kernel(p);
+                    const char *act = layer_activation(p);
+                    fprintf(f, "    model.add(layers.Conv2D(%d, (%d, %d), activation='%s', padding='same'))\n", filt, k, k, act);
+                }
+                break;
+            case LAYER_MAXPOOL2D:
+                {
+                    int s = layer_pool(p);
+                    fprintf(f, "    model.add(layers.MaxPooling2D(pool_size=(%d,%d)))\n", s, s);
+                } break;
+            case LAYER_FLATTEN:
+                fprintf(f, "    model.add(layers.Flatten())\n"); break;
+            case LAYER_DENSE:
+                {
+                    int u = layer_units(p);
+                    const char *act = layer_activation(p);
+                    fprintf(f, "    model.add(layers.Dense(%d, activation='%s'))\n", u, act);
+                } break;
+            case LAYER_OUTPUT:
+                {
+                    int u = layer_units(p);
+                    const char *act = layer_activation(p);
+                    // keep the softmax in float32 under a mixed precision policy
+                    fprintf(f, "    model.add(layers.Dense(%d, activation='%s'%s))\n", u, act, t->mixed_precision ? ", dtype='float32'" : "");
+                } break;
+            default: break;
+        }
+    }
+
+    fprintf(f, "    return model\n\n");
+
+    // tf.data input pipeline: the uint8 images go into the graph as they
+    // are, and casting, scaling, reshaping and one-hot encoding run there
+    int mnist = t->dataset[0] && strcasecmp(t->dataset, "mnist") == 0;
+    int h = 28, w = 28, ch = 1;
+    if (inp) { ch = inp->p.input.ch; h = inp->p.input.h; w = inp->p.input.w; }
+    const Layer *last = m->n_layers > 0 ? &m->layers[m->n_layers - 1] : NULL;
+    int classes = last && last->type == LAYER_OUTPUT ? layer_units(last) : 10;
+    int batch = t->batch_size > 0 ? t->batch_size : mnist ? 64 : 16;
+    char shuffle[32];
+    if (t->shuffle_buffer > 0) snprintf(shuffle, sizeof(shuffle), "%d", t->shuffle_buffer);
+    else snprintf(shuffle, sizeof(shuffle), "len(x)");
+    fprintf(f, "def preprocess(x, y):\n");
+    fprintf(f, "    # works on single examples and on whole batches\n");
+    fprintf(f, "    x = tf.reshape(tf.cast(x, tf.float32) / 255.0, tf.concat([tf.shape(y), [%d, %d, %d]], 0))\n", h, w, ch);
+    fprintf(f, "    return x, tf.one_hot(tf.cast(y, tf.int32), %d)\n\n", classes);
+    fprintf(f, "def make_dataset(x, y, training):\n");
+    fprintf(f, "    ds = tf.data.Dataset.from_tensor_slices((x, y))\n");
+    if (t->cache) {
+        fprintf(f, "    if training:\n");
+        fprintf(f, "        # preprocess once and keep the result for every later epoch\n");
+        fprintf(f, "        ds = ds.map(preprocess, num_parallel_calls=tf.data.AUTOTUNE).cache()\n");
+        fprintf(f, "        ds = ds.shuffle(%s).batch(%d)\n", shuffle, batch);
+        fprintf(f, "    else:\n");
+        fprintf(f, "        ds = ds.batch(%d).map(preprocess, num_parallel_calls=tf.data.AUTOTUNE)\n", batch);
+    } else {
+        fprintf(f, "    if training:\n");
+        fprintf(f, "        ds = ds.shuffle(%s)\n", shuffle);
+        fprintf(f, "    ds = ds.batch(%d).map(preprocess, num_parallel_calls=tf.data.AUTOTUNE)\n", batch);
+    }
+    if (t->prefetch == TRAIN_PREFETCH_AUTO) fprintf(f, "    return ds.prefetch(tf.data.AUTOTUNE)\n\n");
+    else if (t->prefetch > 0) fprintf(f, "    return ds.prefetch(%d)\n\n", t->prefetch);
+    else fprintf(f, "    return ds\n\n");
+
+    // weight file export, the layout include/codegen.h describes
+    fprintf(f, "def round_sat(v):\n");
+    fprintf(f, "    # nnq_sat: clamp to +-127, round half away from zero\n");
+    fprintf(f, "    v = np.clip(v, -127.0, 127.0)\n");
+    fprintf(f, "    return np.trunc(v + np.copysign(0.5, v))\n\n");
+    fprintf(f, "NNW_LAYERS = %d   # layers in the network; weight file tensors are keyed by layer index\n", m->n_layers);
+    fprintf(f, "NNW_FIRST = %d    # network index of model.layers[0]\n\n", inp ? 1 : 0);
+    fprintf(f, "def export_weights(model, path, calib=None, fp16=False, int8=False):\n");
+    fprintf(f, "    \"\"\"Write the weights as a weight file (.nnw) that the generated C code maps and uses in\n");
+    fprintf(f, "    place. float32 kernels and biases always; fp16 adds half precision kernels, int8 adds int8\n");
+    fprintf(f, "    kernels with per-output-channel scales and calib the int8 calibration.\"\"\"\n");
+    fprintf(f, "    import struct\n");
+    fprintf(f, "    tensors = []  # (layer, role, dtype, array); roles kernel %d, bias %d, scale %d, calib %d\n", NNW_KERNEL, NNW_BIAS, NNW_SCALE, NNW_CALIB);
+    fprintf(f, "    for k, layer in enumerate(model.layers):\n");
+    fprintf(f, "        for role, v in enumerate(layer.get_weights()[:2]):\n");
+    fprintf(f, "            v = np.asarray(v, '<f4')\n");
+    fprintf(f, "            tensors.append((k + NNW_FIRST, role, %d, v))\n", NNW_F32);
+    fprintf(f, "            if role == %d and fp16:\n", NNW_KERNEL);
+    fprintf(f, "                tensors.append((k + NNW_FIRST, role, %d, v.astype('<f2')))\n", NNW_F16);
+    fprintf(f, "            if role == %d and int8:\n", NNW_KERNEL);
+    fprintf(f, "                s = np.abs(v).reshape(-1, v.shape[-1]).max(axis=0) / 127.0\n");
+    fprintf(f, "                s[s == 0] = 1.0\n");
+    fprintf(f, "                tensors.append((k + NNW_FIRST, role, %d, round_sat(v / s).astype('i1')))\n", NNW_I8);
+    fprintf(f, "                tensors.append((k + NNW_FIRST, %d, %d, s.astype('<f4')))\n", NNW_SCALE, NNW_F32);
+    fprintf(f, "    if calib is not None:\n");
+    fprintf(f, "        tensors.append((NNW_LAYERS, %d, %d, np.asarray(calib, '<f4')))\n", NNW_CALIB, NNW_F32);
+    fprintf(f, "    align = lambda n: (n + %d) // %d * %d\n", NNW_ALIGN - 1, NNW_ALIGN, NNW_ALIGN);
+    fprintf(f, "    offsets, records = [], []\n");
+    fprintf(f, "    end = data = align(%d + %d * len(tensors))\n", NNW_HEADER, NNW_RECORD);
+    fprintf(f, "    for layer, role, dtype, v in tensors:\n");
+    fprintf(f, "        offsets.append(end)\n");
+    fprintf(f, "        records.append(struct.pack('<IHBB4IQ', layer, role, dtype, v.ndim, *(list(v.shape) + [0] * (4 - v.ndim)), end))\n");
+    fprintf(f, "        end = align(end + v.nbytes)\n");
+    fprintf(f, "    flags = (%d if fp16 else 0) | (%d if int8 else 0) | (%d if calib is not None else 0)\n", NNW_HAS_F16, NNW_HAS_I8, NNW_HAS_CALIB);
+    fprintf(f, "    with open(path, 'wb') as f:\n");
+    fprintf(f, "        f.write(struct.pack('<8s6I4Q', b'%s', %d, 0x%08x, %d, NNW_LAYERS, len(tensors), flags, %d, data, end, 0))\n",
+            NNW_MAGIC, NNW_VERSION, NNW_ENDIAN, NNW_HEADER, NNW_HEADER);
+    fprintf(f, "        f.write(b''.join(records))\n");
+    fprintf(f, "        for (_, _, _, v), off in zip(tensors, offsets):\n");
+    fprintf(f, "            f.seek(off)\n");
+    fprintf(f, "            f.write(v.tobytes())\n");
+    fprintf(f, "        f.truncate(end)\n");
+    fprintf(f, "    print('Wrote %%d tensors (%%d bytes) to %%s' %% (len(tensors), end, path))\n\n");
+
+    // int8 post-training quantization: the same per-channel weight and
+    // per-tensor activation scheme as the C int8 path, simulated in float
+    int q8 = ctx->opts.quantize == QUANT_INT8;
+    if (q8) {
+        int first = inp ? 1 : 0, nq = 0;
+        fprintf(f, "# Keras layers whose output the C int8 path stores as int8 (op outputs, after fusion)\n");
+        fprintf(f, "QUANT_AFTER = {");
+        for (int k = 0; k < ctx->fused.n; k++) {
+            const FusedOp *op = &ctx->fused.ops[k];
+            if (op->kind == FOP_INPUT || op->kind == FOP_FLATTEN || op->last == m->n_layers - 1) continue;
+            fprintf(f, "%s%d", nq++ ? ", " : "", op->last - first);
+        }
+        fprintf(f, "%s}\n\n", nq ? "" : "-1");
+        fprintf(f, "def calibrate_int8(model, x):\n");
+        fprintf(f, "    \"\"\"Abs-max of the input and of every layer output over a representative batch, in\n");
+        fprintf(f, "    the order nn_quantize reads them.\"\"\"\n");
+        fprintf(f, "    h = np.asarray(x, np.float32)\n");
+        fprintf(f, "    ranges = [float(np.max(np.abs(h)))] * %d\n", 1 + first);
+        fprintf(f, "    for layer in model.layers:\n");
+        fprintf(f, "        h = layer(h)\n");
+        fprintf(f, "        ranges.append(float(np.max(np.abs(h))))\n");
+        fprintf(f, "    return ranges\n\n");
+        fprintf(f, "def fake_quant(h, r):\n");
+        fprintf(f, "    s = r / 127.0 if r > 0 else 1.0\n");
+        fprintf(f, "    return round_sat(h / s) * s\n\n");
+        fprintf(f, "def int8_predict(model, ranges, x, batch=256):\n");
+        fprintf(f, "    \"\"\"Predictions of the int8 path: per-output-channel int8 weights, and int8\n");
+        fprintf(f, "    activations wherever the C code stores them.\"\"\"\n");
+        fprintf(f, "    q = tf.keras.models.clone_model(model)\n");
+        fprintf(f, "    weights = []\n");
+        fprintf(f, "    for v in model.get_weights():\n");
+        fprintf(f, "        if v.ndim > 1:  # kernels; biases stay 32-bit\n");
+        fprintf(f, "            s = np.abs(v).reshape(-1, v.shape[-1]).max(axis=0) / 127.0\n");
+        fprintf(f, "            s[s == 0] = 1.0\n");
+        fprintf(f, "            v = round_sat(v / s) * s\n");
+        fprintf(f, "        weights.append(v)\n");
+        fprintf(f, "    q.set_weights(weights)\n");
+        fprintf(f, "    out = []\n");
+        fprintf(f, "    for i in range(0, len(x), batch):\n");
+        fprintf(f, "        h = fake_quant(np.asarray(x[i:i + batch], np.float32), ranges[0])\n");
+        fprintf(f, "        for k, layer in enumerate(q.layers):\n");
+        fprintf(f, "            h = layer(h).numpy()\n");
+        fprintf(f, "            if k in QUANT_AFTER:\n");
+        fprintf(f, "                h = fake_quant(h, ranges[k + %d])\n", 1 + first);
+        fprintf(f, "        out.append(h)\n");
+        fprintf(f, "    return np.concatenate(out)\n\n");
+    }
+
+    int prof = ctx->opts.profile;
+    if (prof) emit_profiler(f, ctx, m, inp ? 1 : 0, batch);
+
+    // compile and training block
+    fprintf(f, "if __name__ == '__main__':\n");
+    if (t->mixed_precision == PRECISION_MIXED_FLOAT16) fprintf(f, "    tf.keras.mixed_precision.set_global_policy('mixed_float16')\n");
+    else if (t->mixed_precision == PRECISION_MIXED_BFLOAT16) fprintf(f, "    tf.keras.mixed_precision.set_global_policy('mixed_bfloat16')\n");
+    fprintf(f, "    model = build_model()\n");
+    fprintf(f, "    model.summary()\n");
+    const char *opt = t->optimizer[0]? t->optimizer : "adam";
+    const char *loss = t->loss[0]? t->loss : "categorical_crossentropy";
+    int epochs = t->epochs? t->epochs : 1;
+    fprintf(f, "    model.compile(optimizer='%s', loss='%s', metrics=['accuracy']%s)\n", opt, loss, t->jit_compile ? ", jit_compile=True" : "");
+
+    // If dataset == "mnist", emit MNIST loader
+    if (mnist) {
+        fprintf(f, "    from tensorflow.keras.datasets import mnist\n");
+        fprintf(f, "    (x_train, y_train), (x_test, y_test) = mnist.load_data()\n");
+        fprintf(f, "    n_val = len(x_train) // 10\n");
+        fprintf(f, "    train_ds = make_dataset(x_train[:-n_val], y_train[:-n_val], True)\n");
+        fprintf(f, "    val_ds = make_dataset(x_train[-n_val:], y_train[-n_val:], False)\n");
+        if (prof) {
+            fprintf(f, "    profile_out = os.path.splitext(os.path.abspath(__file__))[0]\n");
+            fprintf(f, "    timer = StepProfiler(len(x_train) - n_val, profile_out + '_trace')\n");
+            fprintf(f, "    model.fit(train_ds, epochs=%d, validation_data=val_ds, callbacks=[timer])\n", epochs);
+        } else {
+            fprintf(f, "    model.fit(train_ds, epochs=%d, validation_data=val_ds)\n", epochs);
+        }
+        fprintf(f, "    loss, acc = model.evaluate(make_dataset(x_test, y_test, False))\n");
+        fprintf(f, "    print('Test loss:', loss, 'Test accuracy:', acc)\n");
+        if (prof) {
+            fprintf(f, "    x_sample, _ = next(iter(val_ds))\n");
+            fprintf(f, "    write_profile(profile_out + '_profile.json', timer, profile_pipeline(train_ds), profile_layers(model, x_sample))\n");
+        }
+        if (q8) {
+            fprintf(f, "    # int8: calibrate on a representative slice of the training set, then compare with float32\n");
+            fprintf(f, "    x_rep, _ = preprocess(x_train[:512], y_train[:512])\n");
+            fprintf(f, "    ranges = calibrate_int8(model, x_rep)\n");
+            fprintf(f, "    x_chk, _ = preprocess(x_test[:2000], y_test[:2000])\n");
+            fprintf(f, "    p_float = np.argmax(model.predict(x_chk, verbose=0), 1)\n");
+            fprintf(f, "    p_int8 = np.argmax(int8_predict(model, ranges, x_chk), 1)\n");
+            fprintf(f, "    print('First 2000 test images: float32 accuracy %%.4f, int8 accuracy %%.4f, top-1 agreement %%.4f' %%\n");
+            fprintf(f, "          (np.mean(p_float == y_test[:2000]), np.mean(p_int8 == y_test[:2000]), np.mean(p_float == p_int8)))\n");
+        }
+    } else {
+        // fallback: random data (existing behavior)
+        fprintf(f, "    x = np.random.randint(0, 256, size=(100, %d, %d, %d), dtype=np.uint8)\n", h, w, ch);
+        fprintf(f, "    y = np.random.randint(0, %d, size=(100,))\n", classes);
+        if (prof) {
+            fprintf(f, "    profile_out = os.path.splitext(os.path.abspath(__file__))[0]\n");
+            fprintf(f, "    timer = StepProfiler(len(x), profile_out + '_trace')\n");
+            fprintf(f, "    model.fit(make_dataset(x, y, True), epochs=%d, callbacks=[timer])\n", epochs);
+            fprintf(f, "    x_sample, _ = next(iter(make_dataset(x, y, False)))\n");
+            fprintf(f, "    write_profile(profile_out + '_profile.json', timer, profile_pipeline(make_dataset(x, y, True)), profile_layers(model, x_sample))\n");
+        } else {
+            fprintf(f, "    model.fit(make_dataset(x, y, True), epochs=%d)\n", epochs);
+        }
+        if (q8) {
+            fprintf(f, "    x_rep, _ = preprocess(x, y)\n");
+            fprintf(f, "    ranges = calibrate_int8(model, x_rep)\n");
+            fprintf(f, "    p_float = np.argmax(model.predict(x_rep, verbose=0), 1)\n");
+            fprintf(f, "    p_int8 = np.argmax(int8_predict(model, ranges, x_rep), 1)\n");
+            fprintf(f, "    print('int8 top-1 agreement with float32: %%.4f' %% np.mean(p_float == p_int8))\n");
+        }
+    }
+    // named after the script, so scripts sharing a directory (batches, networks, sweep variants) keep their own
+    fprintf(f, "    # trained weights for the C backend, beside this script as <script>.nnw (model.py writes\n");
+    fprintf(f, "    # model.nnw): nn_map_weights(&wf, &w, \"model.nnw\")\n");
+    fprintf(f, "    export_weights(model, os.path.splitext(os.path.abspath(__file__))[0] + '.nnw'%s%s%s)\n",
+            q8 ? ", calib=ranges" : "", t->mixed_precision == PRECISION_MIXED_FLOAT16 ? ", fp16=True" : "", q8 ? ", int8=True" : "");
+
+    return codegen_close(ctx, f, "Python");
+}
+
+int generate_code(CompileContext *ctx, ModelAST *m, TrainAST *t) {
+    switch (ctx->opts.target) {
+        case TARGET_C: return generate_c(ctx, m, t);
+        case TARGET_AST_BIN: return astbin_write(ctx, m, t);
+        default: return generate_python(ctx, m, t);
+    }
+}
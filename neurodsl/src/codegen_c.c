@@ -0,0 +1,1064 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/ast.h"
+#include "../include/codegen.h"
+#include "../include/analysis.h"
+#include "../include/memplan.h"
+
+// Native backend: one C file with a forward pass whose shapes, kernel sizes
+// and loop bounds are all literals, so the C compiler can unroll and
+// vectorize. Tensors are NHWC and weights use the Keras layouts (conv HWIO,
+// dense [in][out]) so trained Keras weights can be bound without reordering.
+
+#define GEMM_BLOCK_P 64     // output pixels per im2col block
+#define GEMM_BLOCK_K 256    // reduction depth per GEMM pass
+
+enum { ACT_LINEAR, ACT_RELU, ACT_SIGMOID, ACT_TANH, ACT_SOFTMAX, ACT_COUNT };
+
+static int act_id(const char *name) {
+    if (strcmp(name, "relu") == 0) return ACT_RELU;
+    if (strcmp(name, "sigmoid") == 0) return ACT_SIGMOID;
+    if (strcmp(name, "tanh") == 0) return ACT_TANH;
+    if (strcmp(name, "softmax") == 0) return ACT_SOFTMAX;
+    if (strcmp(name, "linear") == 0) return ACT_LINEAR;
+    return -1;
+}
+
+static const char *act_fn[ACT_COUNT] = { NULL, "nn_relu", "nn_sigmoid", "nn_tanh", "nn_softmax" };
+
+static void emit_activations(FILE *f, const int *used) {
+    if (used[ACT_RELU])
+        fprintf(f, "static void nn_relu(float *x, int n) { for (int i = 0; i < n; i++) x[i] = x[i] > 0.0f ? x[i] : 0.0f; }\n");
+    if (used[ACT_SIGMOID])
+        fprintf(f, "static void nn_sigmoid(float *x, int n) { for (int i = 0; i < n; i++) x[i] = 1.0f / (1.0f + expf(-x[i])); }\n");
+    if (used[ACT_TANH])
+        fprintf(f, "static void nn_tanh(float *x, int n) { for (int i = 0; i < n; i++) x[i] = tanhf(x[i]); }\n");
+    if (used[ACT_SOFTMAX]) {
+        fprintf(f, "static void nn_softmax(float *x, int n) {\n");
+        fprintf(f, "    float m = x[0], s = 0.0f;\n");
+        fprintf(f, "    for (int i = 1; i < n; i++) m = x[i] > m ? x[i] : m;\n");
+        fprintf(f, "    for (int i = 0; i < n; i++) { x[i] = expf(x[i] - m); s += x[i]; }\n");
+        fprintf(f, "    for (int i = 0; i < n; i++) x[i] /= s;\n");
+        fprintf(f, "}\n");
+    }
+    fprintf(f, "\n");
+}
+
+// pixels of one fused conv2d+maxpool2d band: the pool window rows, cut to the columns pooling reads
+static int pool_band(const ModelCost *c, int pool, int s) {
+    return s * c->layers[pool].out.w * s;
+}
+
+// im2col part of a fused conv2d+maxpool2d workspace, a multiple of 64 bytes so the band after it stays aligned
+static size_t conv_pool_col_bytes(const ModelAST *m, const ModelCost *c, const FusedOp *op) {
+    const Layer *L = &m->layers[op->first];
+    size_t kk = (size_t)layer_kernel(L) * layer_kernel(L) * c->layers[op->first].in.c;
+    size_t band = (size_t)pool_band(c, op->last, layer_pool(&m->layers[op->last]));
+    size_t bp = band < GEMM_BLOCK_P ? band : GEMM_BLOCK_P;
+    return (bp * kk * sizeof(float) + 63) / 64 * 64;
+}
+
+void codegen_c_workspace(const ModelAST *m, const ModelCost *c, const FusedModel *fm, size_t *ws) {
+    for (int i = 0; i < m->n_layers; i++) ws[i] = 0;
+    for (int k = 0; k < fm->n; k++) {
+        const FusedOp *op = &fm->ops[k];
+        const Layer *L = &m->layers[op->first];
+        if (op->kind != FOP_CONV && op->kind != FOP_CONV_POOL) continue;
+        size_t kk = (size_t)layer_kernel(L) * layer_kernel(L) * c->layers[op->first].in.c;
+        if (op->kind == FOP_CONV) {
+            ws[op->first] = GEMM_BLOCK_P * kk * sizeof(float);
+        } else {
+            // an im2col block plus the band of conv output the pool reads
+            size_t band = (size_t)pool_band(c, op->last, layer_pool(&m->layers[op->last]));
+            ws[op->first] = conv_pool_col_bytes(m, c, op) + band * (size_t)c->layers[op->first].out.c * sizeof(float);
+        }
+    }
+}
+
+// conv2d, stride 1, 'same' padding, as blocked im2col + GEMM
+static void emit_conv(FILE *f, int idx, TensorShape in, TensorShape out, int k, int act) {
+    int P = out.h * out.w, C = in.c, F = out.c, KK = k * k * C, pad = (k - 1) / 2;
+    fprintf(f, "/* layer %d: conv2d %dx%dx%d -> %dx%dx%d, kernel %dx%d, same padding */\n", idx, in.h, in.w, C, out.h, out.w, F, k, k);
+    fprintf(f, "static void nn_layer%d(const float *restrict x, const float *restrict w, const float *restrict b, float *restrict y, float *restrict col) {\n", idx);
+    fprintf(f, "    for (int p0 = 0; p0 < %d; p0 += %d) {\n", P, GEMM_BLOCK_P);
+    fprintf(f, "        const int pn = %d - p0 < %d ? %d - p0 : %d;\n", P, GEMM_BLOCK_P, P, GEMM_BLOCK_P);
+    fprintf(f, "        /* im2col: one row of %d values per output pixel, ordered (kh, kw, c) like the kernel */\n", KK);
+    fprintf(f, "        for (int p = 0; p < pn; p++) {\n");
+    fprintf(f, "            const int oh = (p0 + p) / %d, ow = (p0 + p) %% %d;\n", out.w, out.w);
+    fprintf(f, "            float *row = col + p * %d;\n", KK);
+    fprintf(f, "            for (int kh = 0; kh < %d; kh++) {\n", k);
+    fprintf(f, "                const int ih = oh + kh - %d;\n", pad);
+    fprintf(f, "                for (int kw = 0; kw < %d; kw++) {\n", k);
+    fprintf(f, "                    const int iw = ow + kw - %d;\n", pad);
+    fprintf(f, "                    float *d = row + (kh * %d + kw) * %d;\n", k, C);
+    fprintf(f, "                    if (ih < 0 || ih >= %d || iw < 0 || iw >= %d) { for (int c = 0; c < %d; c++) d[c] = 0.0f; }\n", in.h, in.w, C);
+    fprintf(f, "                    else { const float *s = x + (ih * %d + iw) * %d; for (int c = 0; c < %d; c++) d[c] = s[c]; }\n", in.w, C, C);
+    fprintf(f, "                }\n");
+    fprintf(f, "            }\n");
+    fprintf(f, "        }\n");
+    fprintf(f, "        /* GEMM: y[p][f] = b[f] + sum_k col[p][k] * w[k][f], blocked over k */\n");
+    fprintf(f, "        float *yb = y + p0 * %d;\n", F);
+    fprintf(f, "        for (int p = 0; p < pn; p++) for (int f = 0; f < %d; f++) yb[p * %d + f] = b[f];\n", F, F);
+    fprintf(f, "        for (int k0 = 0; k0 < %d; k0 += %d) {\n", KK, GEMM_BLOCK_K);
+    fprintf(f, "            const int kn = %d - k0 < %d ? %d - k0 : %d;\n", KK, GEMM_BLOCK_K, KK, GEMM_BLOCK_K);
+    fprintf(f, "            for (int p = 0; p < pn; p++) {\n");
+    fprintf(f, "                float *yr = yb + p * %d;\n", F);
+    fprintf(f, "                const float *cr = col + p * %d + k0;\n", KK);
+    fprintf(f, "                for (int kk = 0; kk < kn; kk++) {\n");
+    fprintf(f, "                    const float a = cr[kk];\n");
+    fprintf(f, "                    const float *wr = w + (k0 + kk) * %d;\n", F);
+    fprintf(f, "                    for (int f = 0; f < %d; f++) yr[f] += a * wr[f];\n", F);
+    fprintf(f, "                }\n");
+    fprintf(f, "            }\n");
+    fprintf(f, "        }\n");
+    // softmax normalizes each pixel over its filters, as Keras does; the rest are elementwise
+    if (act == ACT_SOFTMAX) fprintf(f, "        for (int p = 0; p < pn; p++) nn_softmax(yb + p * %d, %d);\n", F, F);
+    else if (act != ACT_LINEAR) fprintf(f, "        %s(yb, pn * %d);\n", act_fn[act], F);
+    fprintf(f, "    }\n");
+    fprintf(f, "}\n\n");
+}
+
+// conv2d + activation + maxpool2d in one kernel. The conv output is computed
+// one band of pool window rows at a time into the workspace and pooled from
+// there, so the full pre-pool activation is never written. Each conv output
+// is the same sum in the same order as in emit_conv.
+static void emit_conv_pool(FILE *f, int idx, TensorShape in, TensorShape conv, TensorShape out, int k, int act, int s) {
+    int C = in.c, F = conv.c, KK = k * k * C, pad = (k - 1) / 2, Wc = out.w * s, BP = s * Wc;
+    int blk = BP < GEMM_BLOCK_P ? BP : GEMM_BLOCK_P;
+    fprintf(f, "/* layers %d-%d: conv2d %dx%dx%d -> %dx%dx%d, kernel %dx%d, same padding, fused with maxpool2d %dx%d -> %dx%dx%d */\n",
+            idx, idx + 1, in.h, in.w, C, conv.h, conv.w, F, k, k, s, s, out.h, out.w, F);
+    fprintf(f, "/* band: %d conv rows x %d columns x %d filters, right after the %d-float im2col block */\n", s, Wc, F, blk * KK);
+    fprintf(f, "static void nn_layer%d(const float *restrict x, const float *restrict w, const float *restrict b, float *restrict y, float *restrict col, float *restrict band) {\n", idx);
+    fprintf(f, "    for (int ph = 0; ph < %d; ph++) {\n", out.h);
+    fprintf(f, "        for (int p0 = 0; p0 < %d; p0 += %d) {\n", BP, GEMM_BLOCK_P);
+    fprintf(f, "            const int pn = %d - p0 < %d ? %d - p0 : %d;\n", BP, GEMM_BLOCK_P, BP, GEMM_BLOCK_P);
+    fprintf(f, "            for (int p = 0; p < pn; p++) {\n");
+    fprintf(f, "                const int oh = ph * %d + (p0 + p) / %d, ow = (p0 + p) %% %d;\n", s, Wc, Wc);
+    fprintf(f, "                float *row = col + p * %d;\n", KK);
+    fprintf(f, "                for (int kh = 0; kh < %d; kh++) {\n", k);
+    fprintf(f, "                    const int ih = oh + kh - %d;\n", pad);
+    fprintf(f, "                    for (int kw = 0; kw < %d; kw++) {\n", k);
+    fprintf(f, "                        const int iw = ow + kw - %d;\n", pad);
+    fprintf(f, "                        float *d = row + (kh * %d + kw) * %d;\n", k, C);
+    fprintf(f, "                        if (ih < 0 || ih >= %d || iw < 0 || iw >= %d) { for (int c = 0; c < %d; c++) d[c] = 0.0f; }\n", in.h, in.w, C);
+    fprintf(f, "                        else { const float *s = x + (ih * %d + iw) * %d; for (int c = 0; c < %d; c++) d[c] = s[c]; }\n", in.w, C, C);
+    fprintf(f, "                    }\n");
+    fprintf(f, "                }\n");
+    fprintf(f, "            }\n");
+    fprintf(f, "            float *yb = band + p0 * %d;\n", F);
+    fprintf(f, "            for (int p = 0; p < pn; p++) for (int f = 0; f < %d; f++) yb[p * %d + f] = b[f];\n", F, F);
+    fprintf(f, "            for (int k0 = 0; k0 < %d; k0 += %d) {\n", KK, GEMM_BLOCK_K);
+    fprintf(f, "                const int kn = %d - k0 < %d ? %d - k0 : %d;\n", KK, GEMM_BLOCK_K, KK, GEMM_BLOCK_K);
+    fprintf(f, "                for (int p = 0; p < pn; p++) {\n");
+    fprintf(f, "                    float *yr = yb + p * %d;\n", F);
+    fprintf(f, "                    const float *cr = col + p * %d + k0;\n", KK);
+    fprintf(f, "                    for (int kk = 0; kk < kn; kk++) {\n");
+    fprintf(f, "                        const float a = cr[kk];\n");
+    fprintf(f, "                        const float *wr = w + (k0 + kk) * %d;\n", F);
+    fprintf(f, "                        for (int f = 0; f < %d; f++) yr[f] += a * wr[f];\n", F);
+    fprintf(f, "                    }\n");
+    fprintf(f, "                }\n");
+    fprintf(f, "            }\n");
+    if (act == ACT_SOFTMAX) fprintf(f, "            for (int p = 0; p < pn; p++) nn_softmax(yb + p * %d, %d);\n", F, F);
+    else if (act != ACT_LINEAR) fprintf(f, "            %s(yb, pn * %d);\n", act_fn[act], F);
+    fprintf(f, "        }\n");
+    fprintf(f, "        /* pool the band into output row ph */\n");
+    fprintf(f, "        for (int pw = 0; pw < %d; pw++) {\n", out.w);
+    fprintf(f, "            float *d = y + (ph * %d + pw) * %d;\n", out.w, F);
+    fprintf(f, "            const float *s0 = band + pw * %d;\n", s * F);
+    fprintf(f, "            for (int c = 0; c < %d; c++) d[c] = s0[c];\n", F);
+    fprintf(f, "            for (int i = 0; i < %d; i++) {\n", s);
+    fprintf(f, "                for (int j = 0; j < %d; j++) {\n", s);
+    fprintf(f, "                    const float *sp = s0 + (i * %d + j) * %d;\n", Wc, F);
+    fprintf(f, "                    for (int c = 0; c < %d; c++) d[c] = sp[c] > d[c] ? sp[c] : d[c];\n", F);
+    fprintf(f, "                }\n");
+    fprintf(f, "            }\n");
+    fprintf(f, "        }\n");
+    fprintf(f, "    }\n");
+    fprintf(f, "}\n\n");
+}
+
+// maxpool2d, 'valid' padding, stride = pool size
+static void emit_pool(FILE *f, int idx, TensorShape in, TensorShape out, int s) {
+    int C = in.c;
+    fprintf(f, "/* layer %d: maxpool2d %dx%dx%d -> %dx%dx%d, pool %dx%d */\n", idx, in.h, in.w, C, out.h, out.w, C, s, s);
+    fprintf(f, "static void nn_layer%d(const float *restrict x, float *restrict y) {\n", idx);
+    fprintf(f, "    for (int oh = 0; oh < %d; oh++) {\n", out.h);
+    fprintf(f, "        for (int ow = 0; ow < %d; ow++) {\n", out.w);
+    fprintf(f, "            float *d = y + (oh * %d + ow) * %d;\n", out.w, C);
+    fprintf(f, "            const float *s0 = x + (oh * %d * %d + ow * %d) * %d;\n", s, in.w, s, C);
+    fprintf(f, "            for (int c = 0; c < %d; c++) d[c] = s0[c];\n", C);
+    fprintf(f, "            for (int i = 0; i < %d; i++) {\n", s);
+    fprintf(f, "                for (int j = 0; j < %d; j++) {\n", s);
+    fprintf(f, "                    const float *sp = s0 + (i * %d + j) * %d;\n", in.w, C);
+    fprintf(f, "                    for (int c = 0; c < %d; c++) d[c] = sp[c] > d[c] ? sp[c] : d[c];\n", C);
+    fprintf(f, "                }\n");
+    fprintf(f, "            }\n");
+    fprintf(f, "        }\n");
+    fprintf(f, "    }\n");
+    fprintf(f, "}\n\n");
+}
+
+// dense / output: y = act(x W + b), W is [in][out]
+static void emit_dense(FILE *f, int idx, const char *kind, int n_in, int n_out, int act) {
+    fprintf(f, "/* layer %d: %s %d -> %d */\n", idx, kind, n_in, n_out);
+    fprintf(f, "static void nn_layer%d(const float *restrict x, const float *restrict w, const float *restrict b, float *restrict y) {\n", idx);
+    fprintf(f, "    for (int j = 0; j < %d; j++) y[j] = b[j];\n", n_out);
+    fprintf(f, "    for (int i = 0; i < %d; i++) {\n", n_in);
+    fprintf(f, "        const float a = x[i];\n");
+    fprintf(f, "        const float *wr = w + i * %d;\n", n_out);
+    fprintf(f, "        for (int j = 0; j < %d; j++) y[j] += a * wr[j];\n", n_out);
+    fprintf(f, "    }\n");
+    if (act != ACT_LINEAR) fprintf(f, "    %s(y, %d);\n", act_fn[act], n_out);
+    fprintf(f, "}\n\n");
+}
+
+// the op sequence of nn_forward; with calib set each op output's abs-max is
+// also folded into calib[1 + layer], which is how nn_calibrate runs it
+static void emit_forward_ops(FILE *f, const char *ind, const ModelAST *m, const ModelCost *c, const FusedModel *fm, const MemPlan *plan, int calib) {
+    int n = m->n_layers;
+    char src[16] = "x", dst[16];
+    for (int k = 0; k < fm->n; k++) {
+        const FusedOp *op = &fm->ops[k];
+        int i = op->first, j = op->last;
+        int last = j == n - 1;
+        if (op->kind == FOP_INPUT) continue;
+        snprintf(dst, sizeof(dst), last ? "y" : "t%d", j);
+        if (!last && op->kind != FOP_FLATTEN) fprintf(f, "%sfloat *%s = (float*)(s + %zu);\n", ind, dst, plan->offset[j]);
+        switch (op->kind) {
+            case FOP_CONV: fprintf(f, "%snn_layer%d(%s, w->l%d_w, w->l%d_b, %s, (float*)(s + %zu));\n", ind, i, src, i, i, dst, plan->ws_offset[i]); break;
+            case FOP_CONV_POOL:
+                fprintf(f, "%snn_layer%d(%s, w->l%d_w, w->l%d_b, %s, (float*)(s + %zu), (float*)(s + %zu));\n",
+                        ind, i, src, i, i, dst, plan->ws_offset[i], plan->ws_offset[i] + conv_pool_col_bytes(m, c, op));
+                break;
+            case FOP_POOL: fprintf(f, "%snn_layer%d(%s, %s);\n", ind, i, src, dst); break;
+            case FOP_FLATTEN:
+                if (last) fprintf(f, "%sfor (int i = 0; i < NN_OUT_SIZE; i++) y[i] = %s[i];\n", ind, src);
+                else fprintf(f, "%sconst float *%s = %s;   /* flatten: view, no copy */\n", ind, dst, src);
+                break;
+            case FOP_DENSE:
+                if (i != j) fprintf(f, "%s/* layer %d: flatten folded into layer %d, which reads %s directly */\n", ind, i, j, src);
+                fprintf(f, "%snn_layer%d(%s, w->l%d_w, w->l%d_b, %s);\n", ind, j, src, j, j, dst);
+                break;
+            default: break;
+        }
+        if (calib) fprintf(f, "%snnq_absmax(&calib[%d], %s, %lld);\n", ind, 1 + j, dst, shape_size(c->layers[j].out));
+        memcpy(src, dst, sizeof(src));
+    }
+}
+
+// nn_view_weights / nn_map_weights: check a .nnw file against the shapes
+// baked into this model and point nn_weights at its float32 tensors
+static void emit_weight_file(FILE *f, const ModelAST *m, const ModelCost *c, int first) {
+    int n = m->n_layers, nt = 0;
+    fprintf(f, "/* ---- weight file (.nnw) written by the generated Keras script: float32 tensors are used in place ---- */\n");
+    fprintf(f, "#define NN_LAYER_COUNT %d   /* layers in the network, the file's tensor keys */\n", n);
+    fprintf(f, "typedef struct {\n");
+    fprintf(f, "    void *map;              /* nn_map_weights' mapping, NULL after nn_view_weights */\n");
+    fprintf(f, "    size_t size;\n");
+    fprintf(f, "    const float *calib;     /* NN_LAYER_COUNT + 1 int8 calibration values, NULL when the file has none */\n");
+    fprintf(f, "    int layer;              /* layer of the offending tensor after an error, else -1 */\n");
+    fprintf(f, "} nn_weight_file;\n\n");
+    fprintf(f, "static const struct { unsigned layer, role, rank, dims[4]; } nn_wtab[] = {\n");
+    for (int i = first; i < n; i++) {
+        const Layer *L = &m->layers[i];
+        TensorShape in = c->layers[i].in, out = c->layers[i].out;
+        if (L->type == LAYER_CONV2D) {
+            int k = layer_kernel(L);
+            fprintf(f, "    { %d, %d, 4, { %d, %d, %d, %d } },\n", i, NNW_KERNEL, k, k, in.c, out.c);
+        } else if (L->type == LAYER_DENSE || L->type == LAYER_OUTPUT) {
+            fprintf(f, "    { %d, %d, 2, { %d, %d, 0, 0 } },\n", i, NNW_KERNEL, in.c, out.c);
+        } else {
+            continue;
+        }
+        fprintf(f, "    { %d, %d, 1, { %d, 0, 0, 0 } },\n", i, NNW_BIAS, out.c);
+        nt += 2;
+    }
+    if (nt == 0) fprintf(f, "    { 0, 0, 0, { 0, 0, 0, 0 } },   /* unused: no parameters */\n");
+    fprintf(f, "};\n");
+    fprintf(f, "#define NN_WTENSORS %d\n\n", nt);
+
+    fprintf(f, "static uint32_t nnw_u32(const unsigned char *p) { uint32_t v; memcpy(&v, p, 4); return v; }\n");
+    fprintf(f, "static uint64_t nnw_u64(const unsigned char *p) { uint64_t v; memcpy(&v, p, 8); return v; }\n\n");
+    fprintf(f, "/* check a whole weight file in memory (%d-byte aligned) against this network and bind w to it;\n", NNW_ALIGN);
+    fprintf(f, "   nothing is copied. NULL on success, else what is wrong */\n");
+    fprintf(f, "const char *nn_view_weights(nn_weight_file *wf, nn_weights *w, const void *data, size_t size) {\n");
+    fprintf(f, "    const unsigned char *p = (const unsigned char*)data;\n");
+    if (nt) {
+        fprintf(f, "    const float **slot[NN_WTENSORS] = {");
+        for (int i = first, k = 0; i < n; i++) {
+            LayerType ty = m->layers[i].type;
+            if (ty != LAYER_CONV2D && ty != LAYER_DENSE && ty != LAYER_OUTPUT) continue;
+            fprintf(f, "%s&w->l%d_w, &w->l%d_b", k++ ? ", " : " ", i, i);
+        }
+        fprintf(f, " };\n");
+        fprintf(f, "    int found[NN_WTENSORS] = { 0 };\n");
+    } else {
+        fprintf(f, "    (void)w;\n");
+    }
+    fprintf(f, "    wf->map = NULL; wf->size = size; wf->calib = NULL; wf->layer = -1;\n");
+    fprintf(f, "    if (size < %d || memcmp(p, \"%s\", 8) != 0) return \"not a weight file\";\n", NNW_HEADER, NNW_MAGIC);
+    fprintf(f, "    if ((uintptr_t)p %% %d != 0) return \"buffer is not %d-byte aligned\";\n", NNW_ALIGN, NNW_ALIGN);
+    fprintf(f, "    if (nnw_u32(p + 12) != 0x%08xu) return \"written on a host of the other byte order\";\n", NNW_ENDIAN);
+    fprintf(f, "    if (nnw_u32(p + 8) != %d) return \"unsupported version\";\n", NNW_VERSION);
+    fprintf(f, "    if (nnw_u32(p + 20) != NN_LAYER_COUNT) return \"written for a network with a different number of layers\";\n");
+    fprintf(f, "    uint32_t nt = nnw_u32(p + 24);\n");
+    fprintf(f, "    uint64_t toff = nnw_u64(p + 32);\n");
+    fprintf(f, "    if (nnw_u32(p + 16) < %d || nnw_u64(p + 48) != size) return \"bad header or truncated file\";\n", NNW_HEADER);
+    fprintf(f, "    if (toff < %d || toff > size || (uint64_t)nt * %d > size - toff) return \"tensor table out of bounds\";\n", NNW_HEADER, NNW_RECORD);
+    fprintf(f, "    for (uint32_t i = 0; i < nt; i++) {\n");
+    fprintf(f, "        const unsigned char *r = p + toff + (size_t)i * %d;\n", NNW_RECORD);
+    fprintf(f, "        uint32_t layer = nnw_u32(r), role = (uint32_t)r[4] | (uint32_t)r[5] << 8, dtype = r[6], rank = r[7], dims[4];\n");
+    fprintf(f, "        uint64_t off = nnw_u64(r + 24), bytes = dtype == %d ? 4 : dtype == %d ? 2 : 1;\n", NNW_F32, NNW_F16);
+    fprintf(f, "        wf->layer = (int)layer;\n");
+    fprintf(f, "        if (rank > 4 || dtype > %d) return \"bad tensor record\";\n", NNW_I8);
+    fprintf(f, "        for (uint32_t d = 0; d < rank; d++) {\n");
+    fprintf(f, "            dims[d] = nnw_u32(r + 8 + 4 * d);\n");
+    fprintf(f, "            if (dims[d] && bytes > size / dims[d]) return \"tensor out of bounds\";\n");
+    fprintf(f, "            bytes *= dims[d];\n");
+    fprintf(f, "        }\n");
+    fprintf(f, "        if (off %% %d != 0 || off > size || bytes > size - off) return \"tensor out of bounds or misaligned\";\n", NNW_ALIGN);
+    fprintf(f, "        if (dtype != %d) continue;   /* fp16 and int8 sections are for other readers */\n", NNW_F32);
+    fprintf(f, "        if (role == %d && layer == NN_LAYER_COUNT && rank == 1 && dims[0] == NN_LAYER_COUNT + 1)\n", NNW_CALIB);
+    fprintf(f, "            wf->calib = (const float*)(p + off);\n");
+    if (nt) {
+        fprintf(f, "        for (int k = 0; k < NN_WTENSORS; k++) {\n");
+        fprintf(f, "            if (nn_wtab[k].layer != layer || nn_wtab[k].role != role) continue;\n");
+        fprintf(f, "            if (nn_wtab[k].rank != rank || memcmp(nn_wtab[k].dims, dims, rank * 4) != 0) return \"tensor shape does not match the network\";\n");
+        fprintf(f, "            *slot[k] = (const float*)(p + off);\n");
+        fprintf(f, "            found[k] = 1;\n");
+        fprintf(f, "        }\n");
+    }
+    fprintf(f, "    }\n");
+    if (nt) {
+        fprintf(f, "    for (int k = 0; k < NN_WTENSORS; k++)\n");
+        fprintf(f, "        if (!found[k]) { wf->layer = (int)nn_wtab[k].layer; return nn_wtab[k].role == %d ? \"float32 kernel missing\" : \"float32 bias missing\"; }\n", NNW_KERNEL);
+    }
+    fprintf(f, "    wf->layer = -1;\n");
+    fprintf(f, "    return NULL;\n");
+    fprintf(f, "}\n\n");
+
+    fprintf(f, "/* map path read-only and shared, so processes serving the same model share its pages,\n");
+    fprintf(f, "   then nn_view_weights it; nn_unmap_weights when w is no longer used */\n");
+    fprintf(f, "const char *nn_map_weights(nn_weight_file *wf, nn_weights *w, const char *path) {\n");
+    fprintf(f, "#ifndef _WIN32\n");
+    fprintf(f, "    wf->map = NULL; wf->layer = -1;\n");
+    fprintf(f, "    int fd = open(path, O_RDONLY);\n");
+    fprintf(f, "    if (fd < 0) return \"cannot open the file\";\n");
+    fprintf(f, "    struct stat st;\n");
+    fprintf(f, "    if (fstat(fd, &st) != 0 || st.st_size < %d) { close(fd); return \"not a weight file\"; }\n", NNW_HEADER);
+    fprintf(f, "    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);\n");
+    fprintf(f, "    close(fd);\n");
+    fprintf(f, "    if (p == MAP_FAILED) return \"mmap failed\";\n");
+    fprintf(f, "    const char *err = nn_view_weights(wf, w, p, (size_t)st.st_size);\n");
+    fprintf(f, "    if (err) { munmap(p, (size_t)st.st_size); return err; }\n");
+    fprintf(f, "    wf->map = p;\n");
+    fprintf(f, "    return NULL;\n");
+    fprintf(f, "#else\n");
+    fprintf(f, "    (void)wf; (void)w; (void)path;\n");
+    fprintf(f, "    return \"nn_map_weights needs mmap; read the file into aligned memory and use nn_view_weights\";\n");
+    fprintf(f, "#endif\n");
+    fprintf(f, "}\n\n");
+    fprintf(f, "void nn_unmap_weights(nn_weight_file *wf) {\n");
+    fprintf(f, "#ifndef _WIN32\n");
+    fprintf(f, "    if (wf->map) munmap(wf->map, wf->size);\n");
+    fprintf(f, "#endif\n");
+    fprintf(f, "    wf->map = NULL;\n");
+    fprintf(f, "}\n\n");
+}
+
+// nn_bench_load: nn_map_weights with the error and the time it took on stdout
+static void emit_bench_load(FILE *f) {
+    fprintf(f, "static int nn_bench_load(nn_weight_file *wf, nn_weights *w, const char *path) {\n");
+    fprintf(f, "    struct timespec t0, t1;\n");
+    fprintf(f, "    clock_gettime(CLOCK_MONOTONIC, &t0);\n");
+    fprintf(f, "    const char *err = nn_map_weights(wf, w, path);\n");
+    fprintf(f, "    clock_gettime(CLOCK_MONOTONIC, &t1);\n");
+    fprintf(f, "    if (err) {\n");
+    fprintf(f, "        if (wf->layer >= 0) fprintf(stderr, \"%%s: layer %%d: %%s\\n\", path, wf->layer, err);\n");
+    fprintf(f, "        else fprintf(stderr, \"%%s: %%s\\n\", path, err);\n");
+    fprintf(f, "        return 1;\n");
+    fprintf(f, "    }\n");
+    fprintf(f, "    printf(\"%%s: %%zu bytes mapped and checked in %%.1f us\\n\", path, wf->size,\n");
+    fprintf(f, "           ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / 1e3);\n");
+    fprintf(f, "    return 0;\n");
+    fprintf(f, "}\n");
+}
+
+static void emit_bench_main(FILE *f) {
+    fprintf(f, "#ifdef NN_BENCH\n");
+    fprintf(f, "/* cc -O3 -march=native -DNN_BENCH model.c -lm && ./a.out [iterations [<script>.nnw]]\n");
+    fprintf(f, "   random weights unless the weight file a Keras script writes beside itself (model.py writes model.nnw)\n");
+    fprintf(f, "   is given */\n");
+    fprintf(f, "#include <stdio.h>\n#include <stdlib.h>\n#include <time.h>\n");
+    emit_bench_load(f);
+    fprintf(f, "int main(int argc, char **argv) {\n");
+    fprintf(f, "    int iters = argc > 1 ? atoi(argv[1]) : 1000;\n");
+    fprintf(f, "    float *blob = (float*)malloc(sizeof(float) * NN_PARAM_COUNT);\n");
+    fprintf(f, "    float *x = (float*)malloc(sizeof(float) * NN_IN_SIZE), y[NN_OUT_SIZE];\n");
+    fprintf(f, "    void *scratch = malloc(NN_SCRATCH_BYTES);\n");
+    fprintf(f, "    srand(1);\n");
+    fprintf(f, "    for (long i = 0; i < NN_PARAM_COUNT; i++) blob[i] = ((float)rand() / RAND_MAX - 0.5f) * 0.1f;\n");
+    fprintf(f, "    for (long i = 0; i < NN_IN_SIZE; i++) x[i] = (float)rand() / RAND_MAX;\n");
+    fprintf(f, "    nn_weights w;\n");
+    fprintf(f, "    nn_weight_file wf = { 0 };\n");
+    fprintf(f, "    nn_bind_weights(&w, blob);\n");
+    fprintf(f, "    if (argc > 2 && nn_bench_load(&wf, &w, argv[2]) != 0) return 1;\n");
+    fprintf(f, "    for (int i = 0; i < 10; i++) nn_forward(&w, x, y, scratch);\n");
+    fprintf(f, "    struct timespec t0, t1;\n");
+    fprintf(f, "    clock_gettime(CLOCK_MONOTONIC, &t0);\n");
+    fprintf(f, "    for (int i = 0; i < iters; i++) nn_forward(&w, x, y, scratch);\n");
+    fprintf(f, "    clock_gettime(CLOCK_MONOTONIC, &t1);\n");
+    fprintf(f, "    double us = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / 1e3 / iters;\n");
+    fprintf(f, "    printf(\"nn_forward: %%.2f us/inference (%%d iterations), y[0] = %%f\\n\", us, iters, y[0]);\n");
+    fprintf(f, "    nn_unmap_weights(&wf);\n");
+    fprintf(f, "    free(blob); free(x); free(scratch);\n");
+    fprintf(f, "    return 0;\n");
+    fprintf(f, "}\n");
+    fprintf(f, "#endif\n");
+}
+
+// ---- int8 path (--quantize=int8) ----
+//
+// Post-training quantization: weights are symmetric int8 per output channel,
+// activations symmetric int8 per tensor with scales from calibration abs-max
+// values. Only op outputs are stored, so a fused conv2d+maxpool2d quantizes
+// once after pooling. Accumulation is int32; the requantization (bias add,
+// scale, activation, saturate) runs in each kernel's epilogue. The inner
+// products go through one GEMM kernel picked at run time for the CPU; it
+// vectorizes over output channels, so short reductions (a first conv2d with
+// one input channel) cost no horizontal sums.
+
+#define Q8_FBLOCK 32    // output channels per GEMM kernel step
+
+static int q8_kpad(int k) { return (k + 3) / 4 * 4; }
+static int q8_fpad(int f) { return (f + Q8_FBLOCK - 1) / Q8_FBLOCK * Q8_FBLOCK; }
+static size_t q8_align64(size_t n) { return (n + 63) / 64 * 64; }
+
+// requantization of a kernel output needs no float activation first
+static int q8_merged(int act) { return act == ACT_LINEAR || act == ACT_RELU; }
+
+static void emit_q8_runtime(FILE *f) {
+    fprintf(f, "/* ---- int8 path ---- */\n\n");
+    fprintf(f, "/* c[rows][Fp] = a[rows][Kp] * w, w packed [Kp/4][Fp][4] so four reduction steps of\n");
+    fprintf(f, "   every output channel are adjacent; Kp is a multiple of 4, Fp of %d. zp: 128 * the\n", Q8_FBLOCK);
+    fprintf(f, "   column sums of w, for kernels that bias a into unsigned range */\n");
+    fprintf(f, "typedef void (*nn_gemm_fn)(const int8_t *a, int rows, int Kp, const int8_t *w, const int32_t *zp, int Fp, int32_t *c);\n\n");
+    fprintf(f, "static void nn_gemm_scalar(const int8_t *a, int rows, int Kp, const int8_t *w, const int32_t *zp, int Fp, int32_t *c) {\n");
+    fprintf(f, "    (void)zp;\n");
+    fprintf(f, "    for (int p = 0; p < rows; p++) {\n");
+    fprintf(f, "        int32_t *cr = c + p * Fp;\n");
+    fprintf(f, "        for (int f = 0; f < Fp; f++) cr[f] = 0;\n");
+    fprintf(f, "        for (int k = 0; k < Kp; k += 4) {\n");
+    fprintf(f, "            const int8_t *ar = a + p * Kp + k, *wk = w + k * Fp;\n");
+    fprintf(f, "            for (int f = 0; f < Fp; f++)\n");
+    fprintf(f, "                cr[f] += ar[0] * wk[4 * f] + ar[1] * wk[4 * f + 1] + ar[2] * wk[4 * f + 2] + ar[3] * wk[4 * f + 3];\n");
+    fprintf(f, "        }\n");
+    fprintf(f, "    }\n");
+    fprintf(f, "}\n\n");
+    fprintf(f, "#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))\n");
+    fprintf(f, "#define NN_X86 1\n");
+    fprintf(f, "#include <immintrin.h>\n");
+    fprintf(f, "/* PMADDWD on sign-extended bytes gives pair sums per channel; HADD finishes them */\n");
+    fprintf(f, "__attribute__((target(\"sse4.1\")))\n");
+    fprintf(f, "static void nn_gemm_sse4(const int8_t *a, int rows, int Kp, const int8_t *w, const int32_t *zp, int Fp, int32_t *c) {\n");
+    fprintf(f, "    (void)zp;\n");
+    fprintf(f, "    for (int p = 0; p < rows; p++) {\n");
+    fprintf(f, "        for (int f0 = 0; f0 < Fp; f0 += 16) {\n");
+    fprintf(f, "            __m128i acc[8];\n");
+    fprintf(f, "            for (int j = 0; j < 8; j++) acc[j] = _mm_setzero_si128();\n");
+    fprintf(f, "            for (int k = 0; k < Kp; k += 4) {\n");
+    fprintf(f, "                int32_t a4;\n");
+    fprintf(f, "                memcpy(&a4, a + p * Kp + k, 4);\n");
+    fprintf(f, "                const __m128i va = _mm_cvtepi8_epi16(_mm_set1_epi32(a4));\n");
+    fprintf(f, "                const int8_t *wk = w + k * Fp + 4 * f0;\n");
+    fprintf(f, "                for (int j = 0; j < 8; j++)\n");
+    fprintf(f, "                    acc[j] = _mm_add_epi32(acc[j], _mm_madd_epi16(va, _mm_cvtepi8_epi16(_mm_loadl_epi64((const __m128i*)(wk + 8 * j)))));\n");
+    fprintf(f, "            }\n");
+    fprintf(f, "            for (int j = 0; j < 8; j += 2) _mm_storeu_si128((__m128i*)(c + p * Fp + f0 + 2 * j), _mm_hadd_epi32(acc[j], acc[j + 1]));\n");
+    fprintf(f, "        }\n");
+    fprintf(f, "    }\n");
+    fprintf(f, "}\n\n");
+    fprintf(f, "__attribute__((target(\"avx2\")))\n");
+    fprintf(f, "static void nn_gemm_avx2(const int8_t *a, int rows, int Kp, const int8_t *w, const int32_t *zp, int Fp, int32_t *c) {\n");
+    fprintf(f, "    (void)zp;\n");
+    fprintf(f, "    for (int p = 0; p < rows; p++) {\n");
+    fprintf(f, "        for (int f0 = 0; f0 < Fp; f0 += 32) {\n");
+    fprintf(f, "            __m256i acc[8];\n");
+    fprintf(f, "            for (int j = 0; j < 8; j++) acc[j] = _mm256_setzero_si256();\n");
+    fprintf(f, "            for (int k = 0; k < Kp; k += 4) {\n");
+    fprintf(f, "                int32_t a4;\n");
+    fprintf(f, "                memcpy(&a4, a + p * Kp + k, 4);\n");
+    fprintf(f, "                const __m256i va = _mm256_cvtepi8_epi16(_mm_set1_epi32(a4));\n");
+    fprintf(f, "                const int8_t *wk = w + k * Fp + 4 * f0;\n");
+    fprintf(f, "                for (int j = 0; j < 8; j++)\n");
+    fprintf(f, "                    acc[j] = _mm256_add_epi32(acc[j], _mm256_madd_epi16(va, _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(wk + 16 * j)))));\n");
+    fprintf(f, "            }\n");
+    fprintf(f, "            for (int j = 0; j < 8; j += 2) {\n");
+    fprintf(f, "                const __m256i h = _mm256_permute4x64_epi64(_mm256_hadd_epi32(acc[j], acc[j + 1]), 0xd8);\n");
+    fprintf(f, "                _mm256_storeu_si256((__m256i*)(c + p * Fp + f0 + 4 * j), h);\n");
+    fprintf(f, "            }\n");
+    fprintf(f, "        }\n");
+    fprintf(f, "    }\n");
+    fprintf(f, "}\n\n");
+    fprintf(f, "/* VPDPBUSD multiplies unsigned by signed bytes: a is biased by 128 into unsigned\n");
+    fprintf(f, "   range and the accumulators start at -zp to take it back out */\n");
+    fprintf(f, "__attribute__((target(\"avx512f,avx512bw,avx512vnni\")))\n");
+    fprintf(f, "static void nn_gemm_vnni(const int8_t *a, int rows, int Kp, const int8_t *w, const int32_t *zp, int Fp, int32_t *c) {\n");
+    fprintf(f, "    const __m512i flip = _mm512_set1_epi32((int)0x80808080u);\n");
+    fprintf(f, "    for (int p = 0; p < rows; p++) {\n");
+    fprintf(f, "        for (int f0 = 0; f0 < Fp; f0 += 32) {\n");
+    fprintf(f, "            __m512i c0 = _mm512_sub_epi32(_mm512_setzero_si512(), _mm512_loadu_si512((const void*)(zp + f0)));\n");
+    fprintf(f, "            __m512i c1 = _mm512_sub_epi32(_mm512_setzero_si512(), _mm512_loadu_si512((const void*)(zp + f0 + 16)));\n");
+    fprintf(f, "            for (int k = 0; k < Kp; k += 4) {\n");
+    fprintf(f, "                int32_t a4;\n");
+    fprintf(f, "                memcpy(&a4, a + p * Kp + k, 4);\n");
+    fprintf(f, "                const __m512i va = _mm512_xor_si512(_mm512_set1_epi32(a4), flip);\n");
+    fprintf(f, "                const int8_t *wk = w + k * Fp + 4 * f0;\n");
+    fprintf(f, "                c0 = _mm512_dpbusd_epi32(c0, va, _mm512_loadu_si512((const void*)wk));\n");
+    fprintf(f, "                c1 = _mm512_dpbusd_epi32(c1, va, _mm512_loadu_si512((const void*)(wk + 64)));\n");
+    fprintf(f, "            }\n");
+    fprintf(f, "            _mm512_storeu_si512((void*)(c + p * Fp + f0), c0);\n");
+    fprintf(f, "            _mm512_storeu_si512((void*)(c + p * Fp + f0 + 16), c1);\n");
+    fprintf(f, "        }\n");
+    fprintf(f, "    }\n");
+    fprintf(f, "}\n");
+    fprintf(f, "#endif\n\n");
+
+    fprintf(f, "/* clamp, then round half away from zero; no libm call, so the epilogue loops vectorize */\n");
+    fprintf(f, "static int8_t nnq_sat(float v) {\n");
+    fprintf(f, "    v = v > 127.0f ? 127.0f : v < -127.0f ? -127.0f : v;\n");
+    fprintf(f, "    return (int8_t)(int)(v + (v < 0.0f ? -0.5f : 0.5f));\n");
+    fprintf(f, "}\n\n");
+    fprintf(f, "static void nnq_absmax(float *m, const float *x, long n) {\n");
+    fprintf(f, "    for (long i = 0; i < n; i++) *m = fabsf(x[i]) > *m ? fabsf(x[i]) : *m;\n");
+    fprintf(f, "}\n\n");
+    fprintf(f, "/* w is [K][F] (the Keras layout), one scale per output channel. m turns an accumulator\n");
+    fprintf(f, "   into the output scale, or into real values when the kernel still has to apply a\n");
+    fprintf(f, "   float activation or write float output. Returns the output scale. */\n");
+    fprintf(f, "static float nnq_pack(int8_t *wq, int32_t *zp, int32_t *bq, float *m, const float *w, const float *b,\n");
+    fprintf(f, "                      int K, int Kp, int F, int Fp, float s_in, float amax_out, int requant) {\n");
+    fprintf(f, "    const float s_out = amax_out > 0.0f ? amax_out / 127.0f : 1.0f;\n");
+    fprintf(f, "    memset(wq, 0, (size_t)Kp * Fp);\n");
+    fprintf(f, "    memset(zp, 0, sizeof(int32_t) * Fp);\n");
+    fprintf(f, "    for (int f = 0; f < F; f++) {\n");
+    fprintf(f, "        float a = 0.0f;\n");
+    fprintf(f, "        for (int k = 0; k < K; k++) a = fabsf(w[k * F + f]) > a ? fabsf(w[k * F + f]) : a;\n");
+    fprintf(f, "        const float sw = a > 0.0f ? a / 127.0f : 1.0f;\n");
+    fprintf(f, "        for (int k = 0; k < K; k++) {\n");
+    fprintf(f, "            const int8_t v = nnq_sat(w[k * F + f] / sw);\n");
+    fprintf(f, "            wq[(k & ~3) * Fp + 4 * f + (k & 3)] = v;\n");
+    fprintf(f, "            zp[f] += 128 * v;\n");
+    fprintf(f, "        }\n");
+    fprintf(f, "        bq[f] = (int32_t)lrintf(b[f] / (s_in * sw));\n");
+    fprintf(f, "        m[f] = requant ? s_in * sw / s_out : s_in * sw;\n");
+    fprintf(f, "    }\n");
+    fprintf(f, "    return s_out;\n");
+    fprintf(f, "}\n\n");
+}
+
+// the int8 store of one kernel output v, or the float store when the op writes y
+static void emit_q8_store(FILE *f, const char *ind, const char *d, int L, int act, int merged, int float_out) {
+    if (float_out) fprintf(f, "%s%s = v;\n", ind, d);
+    else if (merged && act == ACT_RELU) fprintf(f, "%s%s = nnq_sat(v > 0.0f ? v : 0.0f);\n", ind, d);
+    else if (merged) fprintf(f, "%s%s = nnq_sat(v);\n", ind, d);
+    else if (act == ACT_SIGMOID) fprintf(f, "%s%s = nnq_sat(q->l%d_os / (1.0f + expf(-v)));\n", ind, d, L);
+    else if (act == ACT_TANH) fprintf(f, "%s%s = nnq_sat(tanhf(v) * q->l%d_os);\n", ind, d, L);
+    else fprintf(f, "%s%s = nnq_sat((v > 0.0f ? v : 0.0f) * q->l%d_os);\n", ind, d, L);
+}
+
+static void emit_q8_im2col(FILE *f, const char *ind, TensorShape in, int k, int Kp, const char *oh) {
+    int C = in.c, KK = k * k * C, pad = (k - 1) / 2;
+    fprintf(f, "%sint8_t *row = col + p * %d;\n", ind, Kp);
+    fprintf(f, "%sfor (int kh = 0; kh < %d; kh++) {\n", ind, k);
+    fprintf(f, "%s    const int ih = %s + kh - %d;\n", ind, oh, pad);
+    fprintf(f, "%s    for (int kw = 0; kw < %d; kw++) {\n", ind, k);
+    fprintf(f, "%s        const int iw = ow + kw - %d;\n", ind, pad);
+    fprintf(f, "%s        int8_t *d = row + (kh * %d + kw) * %d;\n", ind, k, C);
+    fprintf(f, "%s        if (ih < 0 || ih >= %d || iw < 0 || iw >= %d) { for (int c = 0; c < %d; c++) d[c] = 0; }\n", ind, in.h, in.w, C);
+    fprintf(f, "%s        else { const int8_t *s = x + (ih * %d + iw) * %d; for (int c = 0; c < %d; c++) d[c] = s[c]; }\n", ind, in.w, C, C);
+    fprintf(f, "%s    }\n", ind);
+    fprintf(f, "%s}\n", ind);
+    if (Kp > KK) fprintf(f, "%sfor (int c = %d; c < %d; c++) row[c] = 0;\n", ind, KK, Kp);
+}
+
+// epilogue of a GEMM block: accumulators plus bias, scaled, stored; one row when rows is 0
+static void emit_q8_epilogue(FILE *f, const char *ind, int rows, int L, int F, int Fp, int act, int merged, int float_out, const char *ot, const char *dst) {
+    char in2[32];
+    if (rows) {
+        fprintf(f, "%sfor (int p = 0; p < pn; p++) {\n", ind);
+        fprintf(f, "%s    const int32_t *ar = acc + p * %d;\n", ind, Fp);
+        fprintf(f, "%s    %s *d = %s + p * %d;\n", ind, ot, dst, F);
+        snprintf(in2, sizeof(in2), "%s    ", ind);
+    } else {
+        fprintf(f, "%sconst int32_t *ar = acc;\n", ind);
+        fprintf(f, "%s%s *d = %s;\n", ind, ot, dst);
+        snprintf(in2, sizeof(in2), "%s", ind);
+    }
+    fprintf(f, "%sfor (int f = 0; f < %d; f++) {\n", in2, F);
+    fprintf(f, "%s    const float v = (float)(ar[f] + q->l%d_b[f]) * q->l%d_m[f];\n", in2, L, L);
+    char in3[40];
+    snprintf(in3, sizeof(in3), "%s    ", in2);
+    emit_q8_store(f, in3, "d[f]", L, act, merged, float_out);
+    fprintf(f, "%s}\n", in2);
+    if (float_out && act != ACT_LINEAR) fprintf(f, "%s%s(d, %d);\n", in2, act_fn[act], F);
+    if (rows) fprintf(f, "%s}\n", ind);
+}
+
+static void emit_q8_conv(FILE *f, int idx, TensorShape in, TensorShape out, int k, int act, int float_out) {
+    int P = out.h * out.w, F = out.c, Kp = q8_kpad(k * k * in.c), Fp = q8_fpad(F);
+    const char *ot = float_out ? "float" : "int8_t";
+    fprintf(f, "/* layer %d: conv2d %dx%dx%d -> %dx%dx%d, kernel %dx%d, int8 */\n", idx, in.h, in.w, in.c, out.h, out.w, F, k, k);
+    fprintf(f, "static void nnq_layer%d(const nn_qweights *restrict q, const int8_t *restrict x, %s *restrict y, int8_t *restrict col, int32_t *restrict acc) {\n", idx, ot);
+    fprintf(f, "    for (int p0 = 0; p0 < %d; p0 += %d) {\n", P, GEMM_BLOCK_P);
+    fprintf(f, "        const int pn = %d - p0 < %d ? %d - p0 : %d;\n", P, GEMM_BLOCK_P, P, GEMM_BLOCK_P);
+    fprintf(f, "        for (int p = 0; p < pn; p++) {\n");
+    fprintf(f, "            const int oh = (p0 + p) / %d, ow = (p0 + p) %% %d;\n", out.w, out.w);
+    emit_q8_im2col(f, "            ", in, k, Kp, "oh");
+    fprintf(f, "        }\n");
+    fprintf(f, "        q->gemm(col, pn, %d, q->l%d_w, q->l%d_z, %d, acc);\n", Kp, idx, idx, Fp);
+    char dst[32];
+    snprintf(dst, sizeof(dst), "(y + p0 * %d)", F);
+    emit_q8_epilogue(f, "        ", 1, idx, F, Fp, act, q8_merged(act) && !float_out, float_out, ot, dst);
+    fprintf(f, "    }\n");
+    fprintf(f, "}\n\n");
+}
+
+// the conv output of one band goes to float, the activation and pooling run
+// there, and only the pooled value is quantized
+static void emit_q8_conv_pool(FILE *f, int idx, TensorShape in, TensorShape conv, TensorShape out, int k, int act, int s, int float_out) {
+    int F = conv.c, Kp = q8_kpad(k * k * in.c), Fp = q8_fpad(F), Wc = out.w * s, BP = s * Wc;
+    const char *ot = float_out ? "float" : "int8_t";
+    fprintf(f, "/* layers %d-%d: conv2d %dx%dx%d -> %dx%dx%d, kernel %dx%d, fused with maxpool2d %dx%d -> %dx%dx%d, int8 */\n",
+            idx, idx + 1, in.h, in.w, in.c, conv.h, conv.w, F, k, k, s, s, out.h, out.w, F);
+    fprintf(f, "static void nnq_layer%d(const nn_qweights *restrict q, const int8_t *restrict x, %s *restrict y, int8_t *restrict col, int32_t *restrict acc, float *restrict band) {\n", idx, ot);
+    fprintf(f, "    for (int ph = 0; ph < %d; ph++) {\n", out.h);
+    fprintf(f, "        for (int p0 = 0; p0 < %d; p0 += %d) {\n", BP, GEMM_BLOCK_P);
+    fprintf(f, "            const int pn = %d - p0 < %d ? %d - p0 : %d;\n", BP, GEMM_BLOCK_P, BP, GEMM_BLOCK_P);
+    fprintf(f, "            for (int p = 0; p < pn; p++) {\n");
+    fprintf(f, "                const int oh = ph * %d + (p0 + p) / %d, ow = (p0 + p) %% %d;\n", s, Wc, Wc);
+    emit_q8_im2col(f, "                ", in, k, Kp, "oh");
+    fprintf(f, "            }\n");
+    fprintf(f, "            q->gemm(col, pn, %d, q->l%d_w, q->l%d_z, %d, acc);\n", Kp, idx, idx, Fp);
+    char dst[32];
+    snprintf(dst, sizeof(dst), "(band + p0 * %d)", F);
+    emit_q8_epilogue(f, "            ", 1, idx, F, Fp, act, 0, 1, "float", dst);
+    fprintf(f, "        }\n");
+    fprintf(f, "        for (int pw = 0; pw < %d; pw++) {\n", out.w);
+    fprintf(f, "            %s *d = y + (ph * %d + pw) * %d;\n", ot, out.w, F);
+    fprintf(f, "            const float *s0 = band + pw * %d;\n", s * F);
+    fprintf(f, "            for (int c = 0; c < %d; c++) {\n", F);
+    fprintf(f, "                float v = s0[c];\n");
+    fprintf(f, "                for (int i = 0; i < %d; i++)\n", s);
+    fprintf(f, "                    for (int j = 0; j < %d; j++) { const float u = s0[(i * %d + j) * %d + c]; v = u > v ? u : v; }\n", s, Wc, F);
+    if (float_out) fprintf(f, "                d[c] = v;\n");
+    else fprintf(f, "                d[c] = nnq_sat(v * q->l%d_os);\n", idx);
+    fprintf(f, "            }\n");
+    fprintf(f, "        }\n");
+    fprintf(f, "    }\n");
+    fprintf(f, "}\n\n");
+}
+
+// max commutes with a positive scale, so pooling runs on the int8 values
+static void emit_q8_pool(FILE *f, int idx, TensorShape in, TensorShape out, int s) {
+    int C = in.c;
+    fprintf(f, "/* layer %d: maxpool2d %dx%dx%d -> %dx%dx%d, pool %dx%d, int8 */\n", idx, in.h, in.w, C, out.h, out.w, C, s, s);
+    fprintf(f, "static void nnq_layer%d(const int8_t *restrict x, int8_t *restrict y) {\n", idx);
+    fprintf(f, "    for (int oh = 0; oh < %d; oh++) {\n", out.h);
+    fprintf(f, "        for (int ow = 0; ow < %d; ow++) {\n", out.w);
+    fprintf(f, "            int8_t *d = y + (oh * %d + ow) * %d;\n", out.w, C);
+    fprintf(f, "            const int8_t *s0 = x + (oh * %d * %d + ow * %d) * %d;\n", s, in.w, s, C);
+    fprintf(f, "            for (int c = 0; c < %d; c++) d[c] = s0[c];\n", C);
+    fprintf(f, "            for (int i = 0; i < %d; i++) {\n", s);
+    fprintf(f, "                for (int j = 0; j < %d; j++) {\n", s);
+    fprintf(f, "                    const int8_t *sp = s0 + (i * %d + j) * %d;\n", in.w, C);
+    fprintf(f, "                    for (int c = 0; c < %d; c++) d[c] = sp[c] > d[c] ? sp[c] : d[c];\n", C);
+    fprintf(f, "                }\n");
+    fprintf(f, "            }\n");
+    fprintf(f, "        }\n");
+    fprintf(f, "    }\n");
+    fprintf(f, "}\n\n");
+}
+
+// one GEMM row; x is read up to a multiple of 4, nn_forward_q8 zeroes the bytes past n_in
+static void emit_q8_dense(FILE *f, int idx, const char *kind, int n_in, int n_out, int act, int float_out) {
+    int Kp = q8_kpad(n_in), Fp = q8_fpad(n_out);
+    const char *ot = float_out ? "float" : "int8_t";
+    fprintf(f, "/* layer %d: %s %d -> %d, int8 */\n", idx, kind, n_in, n_out);
+    fprintf(f, "static void nnq_layer%d(const nn_qweights *restrict q, const int8_t *restrict x, %s *restrict y, int32_t *restrict acc) {\n", idx, ot);
+    fprintf(f, "    q->gemm(x, 1, %d, q->l%d_w, q->l%d_z, %d, acc);\n", Kp, idx, idx, Fp);
+    emit_q8_epilogue(f, "    ", 0, idx, n_out, Fp, act, q8_merged(act) && !float_out, float_out, ot, "y");
+    fprintf(f, "}\n\n");
+}
+
+// weight matrix of a parametric layer as the int8 kernels see it: K inputs, F outputs
+static int q8_param_layer(const ModelAST *m, const ModelCost *c, int i, int *K, int *F) {
+    const Layer *L = &m->layers[i];
+    if (L->type == LAYER_CONV2D) *K = layer_kernel(L) * layer_kernel(L) * c->layers[i].in.c;
+    else if (L->type == LAYER_DENSE || L->type == LAYER_OUTPUT) *K = c->layers[i].in.c;
+    else return 0;
+    *F = c->layers[i].out.c;
+    return 1;
+}
+
+static void emit_q8(FILE *f, CompileContext *ctx, const ModelAST *m, const FusedModel *fm, const MemPlan *plan, const int *acts, int first) {
+    const ModelCost *c = &ctx->cost;
+    const LayerCost *lc = c->layers;
+    int n = m->n_layers;
+
+    // scratch: two int8 tensors in ping-pong, an im2col block, the GEMM
+    // accumulators and the float band of a fused conv2d+maxpool2d
+    long long act_max = shape_size(c->input);
+    size_t col = 0, acc = 0, band = 0, qbytes = 0;
+    for (int k = 0; k < fm->n; k++) {
+        const FusedOp *op = &fm->ops[k];
+        int L = op->kind == FOP_DENSE ? op->last : op->first, K, F;
+        if (shape_size(lc[op->last].out) > act_max) act_max = shape_size(lc[op->last].out);
+        if (!q8_param_layer(m, c, L, &K, &F)) continue;
+        size_t rows = 1;
+        if (op->kind == FOP_CONV) rows = GEMM_BLOCK_P;
+        if (op->kind == FOP_CONV_POOL) {
+            size_t b = (size_t)pool_band(c, op->last, layer_pool(&m->layers[op->last]));
+            rows = b < GEMM_BLOCK_P ? b : GEMM_BLOCK_P;
+            if (b * (size_t)F * sizeof(float) > band) band = b * (size_t)F * sizeof(float);
+        }
+        if (op->kind != FOP_DENSE && rows * (size_t)q8_kpad(K) > col) col = rows * (size_t)q8_kpad(K);
+        if (rows * (size_t)q8_fpad(F) * 4 > acc) acc = rows * (size_t)q8_fpad(F) * 4;
+        qbytes += q8_align64((size_t)q8_kpad(K) * (size_t)q8_fpad(F)) + q8_align64((size_t)q8_fpad(F) * 4) + 2 * q8_align64((size_t)F * 4);
+    }
+    size_t buf = q8_align64((size_t)act_max + 4);   // dense reads up to 3 bytes past its input
+    col = q8_align64(col);
+    acc = q8_align64(acc);
+
+    emit_q8_runtime(f);
+    fprintf(f, "#define NN_CALIB_COUNT %d   /* input, then one abs-max per layer output */\n", n + 1);
+    fprintf(f, "#define NN_QWEIGHT_BYTES %zu\n", qbytes);
+    fprintf(f, "#define NN_Q_SCRATCH_BYTES %zu\n\n", 2 * buf + col + acc + band);
+    fprintf(f, "typedef struct {\n");
+    fprintf(f, "    const char *isa;    /* GEMM kernel in use, see nn_q_set_isa */\n");
+    fprintf(f, "    nn_gemm_fn gemm;\n");
+    fprintf(f, "    float in_scale;     /* input float to int8 */\n");
+    fprintf(f, "    float out_scale;    /* int8 to output float, when y is dequantized from a stored tensor */\n");
+    for (int i = first; i < n; i++) {
+        int K, F;
+        if (!q8_param_layer(m, c, i, &K, &F)) continue;
+        fprintf(f, "    int8_t *l%d_w;       /* [%d][%d][4] from [%d][%d], zero padded */\n", i, q8_kpad(K) / 4, q8_fpad(F), K, F);
+        fprintf(f, "    int32_t *l%d_z;      /* [%d] 128 * column sums */\n", i, q8_fpad(F));
+        fprintf(f, "    int32_t *l%d_b;      /* [%d] in accumulator scale */\n", i, F);
+        fprintf(f, "    float *l%d_m;        /* [%d] accumulator to output scale */\n", i, F);
+        fprintf(f, "    float l%d_os;        /* 1 / output scale */\n", i);
+    }
+    fprintf(f, "} nn_qweights;\n\n");
+
+    fprintf(f, "/* pick the GEMM kernel by name (\"scalar\", \"sse4.1\", \"avx2\", \"avx512-vnni\"), or the best\n");
+    fprintf(f, "   this CPU runs for NULL; 1 if the CPU cannot run the one asked for. All give the same results. */\n");
+    fprintf(f, "int nn_q_set_isa(nn_qweights *q, const char *isa) {\n");
+    fprintf(f, "#ifdef NN_X86\n");
+    fprintf(f, "    __builtin_cpu_init();\n");
+    fprintf(f, "    if ((!isa || strcmp(isa, \"avx512-vnni\") == 0) && __builtin_cpu_supports(\"avx512vnni\") && __builtin_cpu_supports(\"avx512bw\")) { q->gemm = nn_gemm_vnni; q->isa = \"avx512-vnni\"; return 0; }\n");
+    fprintf(f, "    if ((!isa || strcmp(isa, \"avx2\") == 0) && __builtin_cpu_supports(\"avx2\")) { q->gemm = nn_gemm_avx2; q->isa = \"avx2\"; return 0; }\n");
+    fprintf(f, "    if ((!isa || strcmp(isa, \"sse4.1\") == 0) && __builtin_cpu_supports(\"sse4.1\")) { q->gemm = nn_gemm_sse4; q->isa = \"sse4.1\"; return 0; }\n");
+    fprintf(f, "#endif\n");
+    fprintf(f, "    if (!isa || strcmp(isa, \"scalar\") == 0) { q->gemm = nn_gemm_scalar; q->isa = \"scalar\"; return 0; }\n");
+    fprintf(f, "    return 1;\n");
+    fprintf(f, "}\n\n");
+
+    for (int k = 0; k < fm->n; k++) {
+        const FusedOp *op = &fm->ops[k];
+        int i = op->first, j = op->last, last = j == n - 1;
+        const Layer *L = &m->layers[i];
+        switch (op->kind) {
+            case FOP_CONV: emit_q8_conv(f, i, lc[i].in, lc[i].out, layer_kernel(L), acts[i], last); break;
+            case FOP_CONV_POOL: emit_q8_conv_pool(f, i, lc[i].in, lc[i].out, lc[j].out, layer_kernel(L), acts[i], layer_pool(&m->layers[j]), last); break;
+            case FOP_POOL: emit_q8_pool(f, i, lc[i].in, lc[i].out, layer_pool(L)); break;
+            case FOP_DENSE:
+                emit_q8_dense(f, j, m->layers[j].type == LAYER_OUTPUT ? "output" : "dense", lc[j].in.c, lc[j].out.c, acts[j], last);
+                break;
+            default: break;
+        }
+    }
+
+    // scales follow the op sequence: each op's output scale is the next op's input scale
+    fprintf(f, "/* quantize w for nn_forward_q8. calib: NN_CALIB_COUNT abs-max values from nn_calibrate or the\n");
+    fprintf(f, "   generated Keras script; mem: NN_QWEIGHT_BYTES, 64-byte aligned, referenced by q afterwards */\n");
+    fprintf(f, "void nn_quantize(nn_qweights *q, const nn_weights *w, const float *calib, void *mem) {\n");
+    fprintf(f, "    unsigned char *p = (unsigned char*)mem;\n");
+    fprintf(f, "    float s = calib[0] > 0.0f ? calib[0] / 127.0f : 1.0f;\n");
+    fprintf(f, "    q->in_scale = 1.0f / s;\n");
+    if (qbytes == 0) fprintf(f, "    (void)w; (void)p;\n");
+    size_t off = 0;
+    for (int k = 0; k < fm->n; k++) {
+        const FusedOp *op = &fm->ops[k];
+        int L = op->kind == FOP_DENSE ? op->last : op->first, K, F;
+        if (!q8_param_layer(m, c, L, &K, &F)) continue;
+        int Kp = q8_kpad(K), Fp = q8_fpad(F);
+        int requant = op->kind != FOP_CONV_POOL && op->last != n - 1 && q8_merged(acts[L]);
+        size_t wb = q8_align64((size_t)Kp * (size_t)Fp), zb = q8_align64((size_t)Fp * 4), vb = q8_align64((size_t)F * 4);
+        fprintf(f, "    q->l%d_w = (int8_t*)(p + %zu); q->l%d_z = (int32_t*)(p + %zu);\n", L, off, L, off + wb);
+        fprintf(f, "    q->l%d_b = (int32_t*)(p + %zu); q->l%d_m = (float*)(p + %zu);\n", L, off + wb + zb, L, off + wb + zb + vb);
+        fprintf(f, "    s = nnq_pack(q->l%d_w, q->l%d_z, q->l%d_b, q->l%d_m, w->l%d_w, w->l%d_b, %d, %d, %d, %d, s, calib[%d], %d);\n",
+                L, L, L, L, L, L, K, Kp, F, Fp, 1 + op->last, requant);
+        fprintf(f, "    q->l%d_os = 1.0f / s;\n", L);
+        off += wb + zb + 2 * vb;
+    }
+    fprintf(f, "    q->out_scale = s;\n");
+    fprintf(f, "    nn_q_set_isa(q, NULL);\n");
+    fprintf(f, "}\n\n");
+
+    fprintf(f, "/* calib[NN_CALIB_COUNT]: abs-max of the input and of every layer output over n inputs\n");
+    fprintf(f, "   (a representative sample of real data), running the float path; scratch: NN_SCRATCH_BYTES */\n");
+    fprintf(f, "void nn_calibrate(const nn_weights *w, const float *xs, int n, float *calib, void *scratch) {\n");
+    fprintf(f, "    unsigned char *s = (unsigned char*)scratch;\n");
+    if (plan->peak == 0) fprintf(f, "    (void)s;\n");
+    if (c->params == 0) fprintf(f, "    (void)w;\n");
+    fprintf(f, "    for (int i = 0; i < NN_CALIB_COUNT; i++) calib[i] = 0.0f;\n");
+    fprintf(f, "    for (int b = 0; b < n; b++) {\n");
+    fprintf(f, "        const float *x = xs + (size_t)b * NN_IN_SIZE;\n");
+    fprintf(f, "        float y[NN_OUT_SIZE];\n");
+    fprintf(f, "        nnq_absmax(&calib[0], x, NN_IN_SIZE);\n");
+    if (first) fprintf(f, "        calib[1] = calib[0];\n");
+    emit_forward_ops(f, "        ", m, c, fm, plan, 1);
+    fprintf(f, "    }\n");
+    fprintf(f, "}\n\n");
+
+    fprintf(f, "/* int8 inference: x and y as for nn_forward; scratch: NN_Q_SCRATCH_BYTES, 64-byte aligned */\n");
+    fprintf(f, "void nn_forward_q8(const nn_qweights *q, const float *x, float *y, void *scratch) {\n");
+    fprintf(f, "    unsigned char *s = (unsigned char*)scratch;\n");
+    int pingpong = 0;
+    for (int k = 0; k < fm->n; k++)
+        if (fm->ops[k].kind == FOP_POOL || (fm->ops[k].last != n - 1 && fm->ops[k].kind != FOP_INPUT && fm->ops[k].kind != FOP_FLATTEN)) pingpong = 1;
+    if (pingpong) fprintf(f, "    int8_t *a = (int8_t*)s, *b = (int8_t*)(s + %zu);\n", buf);
+    else fprintf(f, "    int8_t *a = (int8_t*)s;\n");
+    if (col) fprintf(f, "    int8_t *col = (int8_t*)(s + %zu);\n", 2 * buf);
+    if (acc) fprintf(f, "    int32_t *acc = (int32_t*)(s + %zu);\n", 2 * buf + col);
+    if (band) fprintf(f, "    float *band = (float*)(s + %zu);\n", 2 * buf + col + acc);
+    fprintf(f, "    for (int i = 0; i < NN_IN_SIZE; i++) a[i] = nnq_sat(x[i] * q->in_scale);\n");
+    const char *src = "a";
+    for (int k = 0; k < fm->n; k++) {
+        const FusedOp *op = &fm->ops[k];
+        int i = op->first, j = op->last, last = j == n - 1;
+        const char *other = src[0] == 'a' ? "b" : "a", *dst = last ? "y" : other;
+        int K = lc[j].in.c;
+        switch (op->kind) {
+            case FOP_CONV: fprintf(f, "    nnq_layer%d(q, %s, %s, col, acc);\n", i, src, dst); break;
+            case FOP_CONV_POOL: fprintf(f, "    nnq_layer%d(q, %s, %s, col, acc, band);\n", i, src, dst); break;
+            case FOP_POOL: fprintf(f, "    nnq_layer%d(%s, %s);\n", i, src, other); dst = other; break;
+            case FOP_FLATTEN: dst = src; break;     // a view
+            case FOP_DENSE:
+                if (K % 4) fprintf(f, "    for (int i = %d; i < %d; i++) %s[i] = 0;\n", K, q8_kpad(K), src);
+                fprintf(f, "    nnq_layer%d(q, %s, %s, acc);\n", j, src, dst);
+                break;
+            default: continue;
+        }
+        if (last && (op->kind == FOP_POOL || op->kind == FOP_FLATTEN))
+            fprintf(f, "    for (int i = 0; i < NN_OUT_SIZE; i++) y[i] = (float)%s[i] * q->out_scale;\n", dst);
+        src = dst;
+    }
+    fprintf(f, "}\n\n");
+    fprintf(f, "/* nn_forward_batch for the int8 path; q is an nn_qweights */\n");
+    fprintf(f, "void nn_forward_q8_batch(const void *q, const float *x, float *y, int n, void *scratch) {\n");
+    fprintf(f, "    for (int i = 0; i < n; i++) nn_forward_q8((const nn_qweights*)q, x + (size_t)i * NN_IN_SIZE, y + (size_t)i * NN_OUT_SIZE, scratch);\n");
+    fprintf(f, "}\n\n");
+}
+
+// like emit_bench_main, then int8 accuracy against float and the speed of every GEMM kernel
+static void emit_q8_bench_main(FILE *f) {
+    fprintf(f, "#ifdef NN_BENCH\n");
+    fprintf(f, "/* cc -O3 -march=native -DNN_BENCH model.c -lm && ./a.out [iterations [<script>.nnw]]\n");
+    fprintf(f, "   random weights and inputs unless the weight file a Keras script writes beside itself (model.py\n");
+    fprintf(f, "   writes model.nnw) is given; its calibration is used when it has one */\n");
+    fprintf(f, "#include <stdio.h>\n#include <stdlib.h>\n#include <time.h>\n");
+    emit_bench_load(f);
+    fprintf(f, "#define NN_CHECK 256\n");
+    fprintf(f, "static double nn_us(struct timespec t0, struct timespec t1, int iters) {\n");
+    fprintf(f, "    return ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / 1e3 / iters;\n");
+    fprintf(f, "}\n");
+    fprintf(f, "static int nn_argmax(const float *y) {\n");
+    fprintf(f, "    int k = 0;\n");
+    fprintf(f, "    for (int i = 1; i < NN_OUT_SIZE; i++) k = y[i] > y[k] ? i : k;\n");
+    fprintf(f, "    return k;\n");
+    fprintf(f, "}\n");
+    fprintf(f, "int main(int argc, char **argv) {\n");
+    fprintf(f, "    int iters = argc > 1 ? atoi(argv[1]) : 1000;\n");
+    fprintf(f, "    float *blob = (float*)malloc(sizeof(float) * NN_PARAM_COUNT), calib[NN_CALIB_COUNT];\n");
+    fprintf(f, "    float *xs = (float*)malloc(sizeof(float) * NN_IN_SIZE * NN_CHECK), *x = xs, y[NN_OUT_SIZE], yq[NN_OUT_SIZE], y0[NN_OUT_SIZE];\n");
+    fprintf(f, "    void *scratch = malloc(NN_SCRATCH_BYTES), *qscratch = malloc(NN_Q_SCRATCH_BYTES), *qmem = malloc(NN_QWEIGHT_BYTES);\n");
+    fprintf(f, "    srand(1);\n");
+    fprintf(f, "    for (long i = 0; i < NN_PARAM_COUNT; i++) blob[i] = ((float)rand() / RAND_MAX - 0.5f) * 0.1f;\n");
+    fprintf(f, "    for (long i = 0; i < NN_IN_SIZE * NN_CHECK; i++) xs[i] = (float)rand() / RAND_MAX;\n");
+    fprintf(f, "    nn_weights w;\n");
+    fprintf(f, "    nn_weight_file wf = { 0 };\n");
+    fprintf(f, "    nn_bind_weights(&w, blob);\n");
+    fprintf(f, "    if (argc > 2 && nn_bench_load(&wf, &w, argv[2]) != 0) return 1;\n");
+    fprintf(f, "    if (wf.calib) memcpy(calib, wf.calib, sizeof(calib));\n");
+    fprintf(f, "    else nn_calibrate(&w, xs, NN_CHECK / 4, calib, scratch);\n");
+    fprintf(f, "    for (int i = 0; i < 10; i++) nn_forward(&w, x, y, scratch);\n");
+    fprintf(f, "    struct timespec t0, t1;\n");
+    fprintf(f, "    clock_gettime(CLOCK_MONOTONIC, &t0);\n");
+    fprintf(f, "    for (int i = 0; i < iters; i++) nn_forward(&w, x, y, scratch);\n");
+    fprintf(f, "    clock_gettime(CLOCK_MONOTONIC, &t1);\n");
+    fprintf(f, "    double us = nn_us(t0, t1, iters);\n");
+    fprintf(f, "    printf(\"nn_forward: %%.2f us/inference (%%d iterations), y[0] = %%f\\n\", us, iters, y[0]);\n");
+    fprintf(f, "\n");
+    fprintf(f, "    nn_qweights q;\n");
+    fprintf(f, "    nn_quantize(&q, &w, calib, qmem);\n");
+    fprintf(f, "    int agree = 0;\n");
+    fprintf(f, "    float err = 0.0f, ref = 0.0f;\n");
+    fprintf(f, "    for (int k = 0; k < NN_CHECK; k++) {\n");
+    fprintf(f, "        nn_forward(&w, xs + (size_t)k * NN_IN_SIZE, y, scratch);\n");
+    fprintf(f, "        nn_forward_q8(&q, xs + (size_t)k * NN_IN_SIZE, yq, qscratch);\n");
+    fprintf(f, "        agree += nn_argmax(y) == nn_argmax(yq);\n");
+    fprintf(f, "        for (int i = 0; i < NN_OUT_SIZE; i++) {\n");
+    fprintf(f, "            err = fabsf(y[i] - yq[i]) > err ? fabsf(y[i] - yq[i]) : err;\n");
+    fprintf(f, "            ref = fabsf(y[i]) > ref ? fabsf(y[i]) : ref;\n");
+    fprintf(f, "        }\n");
+    fprintf(f, "    }\n");
+    fprintf(f, "    printf(\"int8 vs float32 on %%d inputs: top-1 agreement %%.1f%%%%, max |error| %%g (max |y| %%g)\\n\", NN_CHECK, 100.0 * agree / NN_CHECK, err, ref);\n");
+    fprintf(f, "    static const char *isas[] = { \"scalar\", \"sse4.1\", \"avx2\", \"avx512-vnni\" };\n");
+    fprintf(f, "    int differs = 0;\n");
+    fprintf(f, "    for (int k = 0; k < 4; k++) {\n");
+    fprintf(f, "        if (nn_q_set_isa(&q, isas[k]) != 0) { printf(\"nn_forward_q8 [%%s]: not supported here\\n\", isas[k]); continue; }\n");
+    fprintf(f, "        nn_forward_q8(&q, x, yq, qscratch);\n");
+    fprintf(f, "        int same = k == 0 || memcmp(y0, yq, sizeof(yq)) == 0;\n");
+    fprintf(f, "        if (k == 0) memcpy(y0, yq, sizeof(yq));\n");
+    fprintf(f, "        differs |= !same;\n");
+    fprintf(f, "        for (int i = 0; i < 10; i++) nn_forward_q8(&q, x, yq, qscratch);\n");
+    fprintf(f, "        clock_gettime(CLOCK_MONOTONIC, &t0);\n");
+    fprintf(f, "        for (int i = 0; i < iters; i++) nn_forward_q8(&q, x, yq, qscratch);\n");
+    fprintf(f, "        clock_gettime(CLOCK_MONOTONIC, &t1);\n");
+    fprintf(f, "        double uq = nn_us(t0, t1, iters);\n");
+    fprintf(f, "        printf(\"nn_forward_q8 [%%s]: %%.2f us/inference, %%.2fx float32%%s\\n\", isas[k], uq, us / uq, same ? \"\" : \", OUTPUT DIFFERS FROM SCALAR\");\n");
+    fprintf(f, "    }\n");
+    fprintf(f, "    nn_unmap_weights(&wf);\n");
+    fprintf(f, "    free(blob); free(xs); free(scratch); free(qscratch); free(qmem);\n");
+    fprintf(f, "    return differs;\n");
+    fprintf(f, "}\n");
+    fprintf(f, "#endif\n");
+}
+
+int generate_c(CompileContext *ctx, ModelAST *m, TrainAST *t) {
+    (void)t;
+    int n = m->n_layers;
+    const LayerCost *lc = ctx->cost.layers;    // shapes from analyze_model
+    TensorShape in_shape = ctx->cost.input;
+    int *acts = (int*)calloc((size_t)n + 1, sizeof(int));
+    int used[ACT_COUNT] = {0};
+
+    // the input layer is optional; everything else must be something this backend runs
+    int first = n > 0 && m->layers[0].type == LAYER_INPUT ? 1 : 0;
+    int q8 = ctx->opts.quantize == QUANT_INT8;
+    int rc = 0;
+    for (int i = first; i < n && rc == 0; i++) {
+        Layer *L = &m->layers[i];
+        if (L->type == LAYER_CONV2D || L->type == LAYER_DENSE || L->type == LAYER_OUTPUT) {
+            acts[i] = act_id(layer_activation(L));
+            if (acts[i] < 0) { fprintf(ctx->diag, "Error: layer %d: activation '%s' is not supported by --target=c\n", i, layer_activation(L)); rc = 1; break; }
+            used[acts[i]] = 1;
+            if (q8 && acts[i] == ACT_SOFTMAX && (i != n - 1 || L->type == LAYER_CONV2D)) {
+                fprintf(ctx->diag, "Error: layer %d: --quantize=int8 supports softmax only on the last dense layer\n", i); rc = 1; break;
+            }
+        }
+        if ((L->type == LAYER_DENSE || L->type == LAYER_OUTPUT) && lc[i].in.rank != 1) {
+            fprintf(ctx->diag, "Error: layer %d: --target=c needs 'flatten' before dense\n", i); rc = 1;
+        }
+    }
+    if (rc == 0 && n <= first) { fprintf(ctx->diag, "Error: network %s has no layers to run\n", m->name); rc = 1; }
+    if (rc != 0) { free(acts); return rc; }
+
+    // activations and im2col blocks share one scratch block laid out by the memory planner:
+    // buffers whose lifetimes do not overlap reuse the same bytes, flatten is a view
+    size_t *ws = (size_t*)calloc((size_t)n + 1, sizeof(size_t));
+    const FusedModel *fm = &ctx->fused;
+    codegen_c_workspace(m, &ctx->cost, fm, ws);
+    MemPlan plan;
+    double t0 = ctx->stats ? stats_now() : 0.0;
+    int planned = plan_model(&ctx->arena, m, &ctx->cost, ws, fm, &plan);
+    if (ctx->stats) ctx->stats->t[PHASE_MEMPLAN] += stats_now() - t0;
+    if (planned != 0) { free(ws); free(acts); return 1; }
+
+    FILE *f = codegen_open(ctx);
+    if (!f) { free(ws); free(acts); return 1; }
+
+    fprintf(f, "/* Generated by neurodsl from network %s. Forward pass only, float32%s, NHWC. */\n", m->name, q8 ? " and int8" : "");
+    fprintf(f, "#include <stddef.h>\n#include <stdint.h>\n#include <string.h>\n#include <math.h>\n");
+    fprintf(f, "#ifndef _WIN32\n#include <fcntl.h>\n#include <unistd.h>\n#include <sys/mman.h>\n#include <sys/stat.h>\n#endif\n");
+    fprintf(f, "\n");
+    fprintf(f, "#define NN_IN_H %d\n#define NN_IN_W %d\n#define NN_IN_C %d\n", in_shape.h, in_shape.w, in_shape.c);
+    fprintf(f, "#define NN_IN_SIZE %lld\n", shape_size(in_shape));
+    fprintf(f, "#define NN_OUT_SIZE %lld\n", shape_size(lc[n - 1].out));
+    fprintf(f, "#define NN_SCRATCH_BYTES %zu   /* planned; %zu without buffer reuse */\n", plan.peak, plan.naive);
+
+    // weights: one pointer pair per parametric layer, Keras layouts
+    fprintf(f, "\ntypedef struct {\n");
+    for (int i = first; i < n; i++) {
+        Layer *L = &m->layers[i];
+        TensorShape in = lc[i].in, out = lc[i].out;
+        if (L->type == LAYER_CONV2D) {
+            int k = layer_kernel(L);
+            fprintf(f, "    const float *l%d_w;   /* conv2d kernel [%d][%d][%d][%d] */\n", i, k, k, in.c, out.c);
+            fprintf(f, "    const float *l%d_b;   /* [%d] */\n", i, out.c);
+        } else if (L->type == LAYER_DENSE || L->type == LAYER_OUTPUT) {
+            fprintf(f, "    const float *l%d_w;   /* dense kernel [%d][%d] */\n", i, in.c, out.c);
+            fprintf(f, "    const float *l%d_b;   /* [%d] */\n", i, out.c);
+        }
+    }
+    fprintf(f, "} nn_weights;\n\n");
+    fprintf(f, "#define NN_PARAM_COUNT %lldL\n\n", ctx->cost.params);
+
+    fprintf(f, "/* point w at a packed blob holding each layer's kernel then bias, in layer order */\n");
+    fprintf(f, "void nn_bind_weights(nn_weights *w, const float *blob) {\n");
+    for (int i = first; i < n; i++) {
+        Layer *L = &m->layers[i];
+        TensorShape in = lc[i].in, out = lc[i].out;
+        long nw;
+        if (L->type == LAYER_CONV2D) nw = (long)layer_kernel(L) * layer_kernel(L) * in.c * out.c;
+        else if (L->type == LAYER_DENSE || L->type == LAYER_OUTPUT) nw = (long)in.c * out.c;
+        else continue;
+        fprintf(f, "    w->l%d_w = blob; blob += %ld;\n", i, nw);
+        fprintf(f, "    w->l%d_b = blob; blob += %d;\n", i, out.c);
+    }
+    fprintf(f, "}\n\n");
+    emit_weight_file(f, m, &ctx->cost, first);
+
+    // one kernel per fused op, named after the op's first computing layer
+    emit_activations(f, used);
+    for (int k = 0; k < fm->n; k++) {
+        const FusedOp *op = &fm->ops[k];
+        int i = op->first, j = op->last;
+        Layer *L = &m->layers[i];
+        switch (op->kind) {
+            case FOP_CONV: emit_conv(f, i, lc[i].in, lc[i].out, layer_kernel(L), acts[i]); break;
+            case FOP_CONV_POOL: emit_conv_pool(f, i, lc[i].in, lc[i].out, lc[j].out, layer_kernel(L), acts[i], layer_pool(&m->layers[j])); break;
+            case FOP_POOL: emit_pool(f, i, lc[i].in, lc[i].out, layer_pool(L)); break;
+            case FOP_DENSE:
+                emit_dense(f, j, m->layers[j].type == LAYER_OUTPUT ? "output" : "dense", lc[j].in.c, lc[j].out.c, acts[j]);
+                break;
+            default: break;
+        }
+    }
+
+    // forward pass
+    fprintf(f, "/* x: NN_IN_SIZE floats (h, w, c); y: NN_OUT_SIZE floats; scratch: NN_SCRATCH_BYTES, 64-byte aligned */\n");
+    fprintf(f, "void nn_forward(const nn_weights *w, const float *x, float *y, void *scratch) {\n");
+    fprintf(f, "    unsigned char *s = (unsigned char*)scratch;\n");
+    if (plan.peak == 0) fprintf(f, "    (void)s;\n");
+    if (ctx->cost.params == 0) fprintf(f, "    (void)w;\n");
+    if (first == 0) fprintf(f, "    /* no input layer: defaults to 28x28x1 */\n");
+    emit_forward_ops(f, "    ", m, &ctx->cost, fm, &plan, 0);
+    fprintf(f, "}\n\n");
+    fprintf(f, "/* n inputs back to back in x, n outputs in y, one scratch block reused for each.\n");
+    fprintf(f, "   w is an nn_weights; void so runtime/nnrt.h can hold any model */\n");
+    fprintf(f, "void nn_forward_batch(const void *w, const float *x, float *y, int n, void *scratch) {\n");
+    fprintf(f, "    for (int i = 0; i < n; i++) nn_forward((const nn_weights*)w, x + (size_t)i * NN_IN_SIZE, y + (size_t)i * NN_OUT_SIZE, scratch);\n");
+    fprintf(f, "}\n\n");
+    if (q8) {
+        emit_q8(f, ctx, m, fm, &plan, acts, first);
+        emit_q8_bench_main(f);
+    } else {
+        emit_bench_main(f);
+    }
+
+    free(ws); free(acts);
+    return codegen_close(ctx, f, "C");
+}
@@ -0,0 +1,396 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include "../include/compile.h"
+#include "../include/parser.h"
+#include "../include/codegen.h"
+#include "../include/memplan.h"
+#include "../include/astbin.h"
+#include "../include/threadpool.h"
+#include "../include/sweep.h"
+
+void compile_ctx_init(CompileContext *ctx, const char *in_path, const char *out_path) {
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->in_path = in_path;
+    ctx->out_path = out_path;
+    ctx->diag = stderr;
+}
+
+// With stats on, a lex-only pass and a recognize-only pass (which lexes as
+// it goes) run before the real parse. Parsing is charged the difference of
+// the two, and AST construction whatever the real parse costs on top of the
+// recognizer.
+static void time_front_end(CompileContext *ctx, CompileStats *st, double *lex, double *parse) {
+    double t0 = stats_now();
+    long long n = 0;
+    while (lexer_next(&ctx->lex).type != TOK_EOF) n++;
+    double t1 = stats_now();
+    lexer_rewind(&ctx->lex);
+    parse_check(ctx);
+    double t2 = stats_now();
+    lexer_rewind(&ctx->lex);
+    *lex = t1 - t0;
+    *parse = t2 - t1 > *lex ? t2 - t1 - *lex : 0.0;
+    st->tokens += n;
+}
+
+static void stats_end(CompileContext *ctx, CompileStats *st) {
+    st->arena_allocs += (long long)ctx->arena.n_allocs;
+    st->arena_bytes += (long long)ctx->arena.bytes;
+    st->arena_chunks += (long long)ctx->arena.n_chunks;
+}
+
+// the file name part of a path, and its extension ("" when it has none)
+static const char *output_base(const char *path) {
+    const char *base = strrchr(path, '/');
+    const char *bs = strrchr(path, '\\');
+    if (bs && (!base || bs > base)) base = bs;
+    return base ? base + 1 : path;
+}
+
+static const char *output_ext(const char *path) {
+    const char *base = output_base(path);
+    const char *dot = strrchr(base, '.');
+    return dot && dot != base ? dot : base + strlen(base);
+}
+
+// analysis, reports and codegen for one network; the results live in
+// ctx->arena. Sweep variants analyse through their network's trie.
+static int compile_network(CompileContext *ctx, ModelAST *model, TrainAST *train, SweepTrie *trie) {
+    CompileStats *st = ctx->stats;
+    double t0 = 0.0;
+
+    // shape inference and cost model; shape mismatches are compile errors
+    if (st) {
+        st->layers += model->n_layers;
+        t0 = stats_now();
+    }
+    int analyzed = trie ? sweep_analyze(trie, ctx->diag, &ctx->arena, model, &ctx->cost)
+                        : analyze_model(&ctx->arena, ctx->diag, model, &ctx->cost);
+    if (analyzed == 0) analyzed = fuse_model(&ctx->arena, model, !ctx->opts.no_fuse, &ctx->fused);
+    if (st) st->t[PHASE_ANALYZE] += stats_now() - t0;
+    if (analyzed != 0) {
+        fprintf(ctx->diag, "%s: Shape check failed for %s.\n", ctx->in_path, model->name);
+        return 1;
+    }
+    if (ctx->report) {
+        // keep a whole report together when batch jobs print concurrently
+#ifndef _WIN32
+        flockfile(stdout);
+#endif
+        if (ctx->report & REPORT_COST) cost_print_table(stdout, model, &ctx->cost);
+        if (ctx->report & REPORT_COST_JSON) cost_print_json(stdout, model, &ctx->cost);
+        if (ctx->report & REPORT_MEMORY) {
+            // plan as the C backend would, including its im2col blocks
+            size_t *ws = (size_t*)calloc((size_t)model->n_layers + 1, sizeof(size_t));
+            codegen_c_workspace(model, &ctx->cost, &ctx->fused, ws);
+            MemPlan plan;
+            if (st) t0 = stats_now();
+            int planned = plan_model(&ctx->arena, model, &ctx->cost, ws, &ctx->fused, &plan);
+            if (st) st->t[PHASE_MEMPLAN] += stats_now() - t0;
+            if (planned == 0) memplan_print(stdout, model, &ctx->cost, &plan);
+            free(ws);
+        }
+#ifndef _WIN32
+        funlockfile(stdout);
+#endif
+    }
+
+    // generate code; a C target plans memory inside codegen and charges that to PHASE_MEMPLAN
+    double plan_before = st ? st->t[PHASE_MEMPLAN] : 0.0;
+    long out_before = st && ctx->out ? ftell(ctx->out) : 0;
+    if (st) t0 = stats_now();
+    int rc = generate_code(ctx, model, train);
+    if (st) {
+        st->t[PHASE_CODEGEN] += stats_now() - t0 - (st->t[PHASE_MEMPLAN] - plan_before);
+        struct stat sb;
+        if (rc == 0 && ctx->out) st->out_bytes += ftell(ctx->out) - out_before;
+        else if (rc == 0 && stat(ctx->out_path, &sb) == 0) st->out_bytes += (long long)sb.st_size;
+    }
+    return rc;
+}
+
+void compile_output_path(const char *out_path, const char *suffix, char *buf, size_t n) {
+    const char *ext = output_ext(out_path);
+    snprintf(buf, n, "%.*s%s", (int)(ext - out_path), out_path, suffix);
+}
+
+// "_<name><ext>", the suffix of one network's or variant's output
+static void output_suffix(const char *out_path, const char *name, char *buf, size_t n) {
+    snprintf(buf, n, "_%s%s", name, output_ext(out_path));
+}
+
+// Every network and sweep variant of a source, numbered in source order.
+// Workers claim outputs one at a time, so variants are built, analysed and
+// written as a stream with one in memory per worker.
+typedef struct {
+    CompileContext *ctx;
+    ProgramAST *prog;
+    long long *first;       // first output of each network, n_nets + 1 entries
+    SweepTrie **tries;      // per network, NULL without sweeps
+    pthread_mutex_t mu;
+    long long next;         // next output to claim
+    int failed;
+} Emit;
+
+typedef struct {
+    Emit *e;
+    CompileStats stats;
+} EmitWorker;
+
+static void run_emit(void *arg) {
+    EmitWorker *w = (EmitWorker*)arg;
+    Emit *e = w->e;
+    CompileContext *parent = e->ctx;
+    char out[1200], suffix[600];
+    CompileContext c;
+    compile_ctx_init(&c, parent->in_path, out);
+    c.diag = parent->diag;
+    c.quiet = parent->quiet;
+    c.opts = parent->opts;
+    c.report = parent->report;
+    if (parent->stats) c.stats = &w->stats;
+    int failed = 0, k = 0;
+    for (;;) {
+        pthread_mutex_lock(&e->mu);
+        long long i = e->next++;
+        pthread_mutex_unlock(&e->mu);
+        if (i >= e->first[e->prog->n_nets]) break;
+        while (e->first[k + 1] <= i) k++;
+        NetworkAST *net = &e->prog->nets[k];
+        ModelAST vm, *m = net->model;
+        TrainAST vt, *t = &net->train;
+        if (net->n_axes) {
+            if (sweep_variant(net, i - e->first[k], &c.arena, &vm, &vt) != 0) { failed++; continue; }
+            m = &vm;
+            t = &vt;
+        }
+        output_suffix(parent->out_path, m->name, suffix, sizeof(suffix));
+        compile_output_path(parent->out_path, suffix, out, sizeof(out));
+        if (compile_network(&c, m, t, e->tries[k]) != 0) failed++;
+        if (c.stats) stats_end(&c, c.stats);
+        arena_reset(&c.arena);
+    }
+    compile_ctx_free(&c);
+    pthread_mutex_lock(&e->mu);
+    e->failed += failed;
+    pthread_mutex_unlock(&e->mu);
+}
+
+// one manifest per swept network, <stem>_<network>.sweep
+static int write_manifests(CompileContext *ctx, ProgramAST *prog) {
+    const char *base = output_base(ctx->out_path), *ext = output_ext(ctx->out_path);
+    char prefix[600], suffix[600], path[1200];
+    snprintf(prefix, sizeof(prefix), "%.*s_", (int)(ext - base), base);
+    for (int k = 0; k < prog->n_nets; k++) {
+        NetworkAST *net = &prog->nets[k];
+        if (!net->n_axes) continue;
+        snprintf(suffix, sizeof(suffix), "_%s.sweep", net->model->name);
+        compile_output_path(ctx->out_path, suffix, path, sizeof(path));
+        FILE *f = fopen(path, "wb");
+        if (!f) { perror(path); return 1; }
+        sweep_write_manifest(f, net, prefix, ext);
+        if (fclose(f) != 0) { perror(path); return 1; }
+        if (!ctx->quiet) printf("Wrote %lld variants of %s to %s\n", sweep_count(net), net->model->name, path);
+    }
+    return 0;
+}
+
+// every network and variant to its own <stem>_<name>.<ext> on ctx->jobs threads
+static int compile_outputs(CompileContext *ctx, ProgramAST *prog, long long total) {
+    if (ctx->out) {
+        fprintf(ctx->diag, "%s: %lld outputs need one file each; compile the file to disk instead\n", ctx->in_path, total);
+        return 1;
+    }
+    if (write_manifests(ctx, prog) != 0) return 1;
+    Emit e;
+    memset(&e, 0, sizeof(e));
+    e.ctx = ctx;
+    e.prog = prog;
+    e.first = (long long*)calloc((size_t)prog->n_nets + 1, sizeof(long long));
+    e.tries = (SweepTrie**)calloc((size_t)prog->n_nets, sizeof(SweepTrie*));
+    pthread_mutex_init(&e.mu, NULL);
+    for (int k = 0; k < prog->n_nets; k++) {
+        e.first[k + 1] = e.first[k] + sweep_count(&prog->nets[k]);
+        if (prog->nets[k].n_axes) e.tries[k] = sweep_trie_new();
+    }
+    int threads = ctx->jobs > 0 ? ctx->jobs : tp_default_threads();
+    if (threads > total) threads = (int)total;
+    EmitWorker *ws = (EmitWorker*)calloc((size_t)threads, sizeof(EmitWorker));
+    for (int i = 0; i < threads; i++) ws[i].e = &e;
+    if (threads <= 1) {
+        run_emit(&ws[0]);
+    } else {
+        ThreadPool *tp = tp_create(threads);
+        for (int i = 0; i < threads; i++) tp_submit(tp, run_emit, &ws[i]);
+        tp_destroy(tp);
+    }
+    for (int i = 0; i < threads && ctx->stats; i++) stats_add(ctx->stats, &ws[i].stats);
+    for (int k = 0; k < prog->n_nets; k++) {
+        if (!e.tries[k]) continue;
+        long long nodes, layers;
+        sweep_trie_counts(e.tries[k], &nodes, &layers);
+        if (!ctx->quiet) printf("Sweep %s: %lld layers in %lld variants, %lld analysed\n",
+                                prog->nets[k].model->name, layers, sweep_count(&prog->nets[k]), nodes);
+        sweep_trie_free(e.tries[k]);
+    }
+    pthread_mutex_destroy(&e.mu);
+    free(ws);
+    free(e.tries);
+    free(e.first);
+    return e.failed ? 1 : 0;
+}
+
+// the files compile_outputs writes, as suffixes for a cache bundle
+static char **output_suffixes(CompileContext *ctx, ProgramAST *prog, long long total, int *n) {
+    int cap = (int)total + prog->n_nets, k = 0;
+    char **sfx = (char**)calloc((size_t)cap, sizeof(char*));
+    char name[600], buf[700];
+    for (int i = 0; sfx && i < prog->n_nets; i++) {
+        NetworkAST *net = &prog->nets[i];
+        if (!net->n_axes) {
+            output_suffix(ctx->out_path, net->model->name, buf, sizeof(buf));
+            sfx[k++] = strdup(buf);
+            continue;
+        }
+        snprintf(buf, sizeof(buf), "_%s.sweep", net->model->name);
+        sfx[k++] = strdup(buf);
+        for (long long v = 0, c = sweep_count(net); v < c; v++) {
+            sweep_name(net, v, name, sizeof(name));
+            output_suffix(ctx->out_path, name, buf, sizeof(buf));
+            sfx[k++] = strdup(buf);
+        }
+    }
+    *n = k;
+    return sfx;
+}
+
+// Values only become sweep axes through '[' or '..', and a binary AST has no
+// axes; a source with neither cannot sweep. Comments may make this say yes
+// when it need not.
+static int may_sweep(const char *src, size_t len) {
+    if (astbin_is(src, len)) return 0;
+    if (memchr(src, '[', len)) return 1;
+    for (const char *p = src, *end = src + len; (p = (const char*)memchr(p, '.', (size_t)(end - p))) && p + 1 < end; p++)
+        if (p[1] == '.') return 1;
+    return 0;
+}
+
+// everything after the source is in ctx->lex; frees the lexer before returning
+static int compile_loaded(CompileContext *ctx) {
+    CompileStats *st = ctx->stats;
+    double t0 = 0.0;
+    ctx->outputs = 0;
+    if (st) {
+        st->files++;
+        st->in_bytes += (long long)ctx->lex.len;
+    }
+
+    // a cache hit reuses the stored output without parsing at all
+    // reports go to stdout and ctx->out is not a file, so neither can be replayed
+    int cached = ctx->cache && !ctx->report && !ctx->out;
+    uint64_t key = 0;
+    if (cached) {
+        char opts[900];
+        codegen_options_key(&ctx->opts, opts, sizeof(opts));
+        // a sweep manifest lists its files by the output stem, so it is only reused for the same stem
+        if (may_sweep(ctx->lex.src, ctx->lex.len)) {
+            const char *base = output_base(ctx->out_path), *ext = output_ext(ctx->out_path);
+            size_t used = strlen(opts);
+            snprintf(opts + used, sizeof(opts) - used, " stem=%.*s", (int)(ext - base), base);
+        }
+        key = cache_key(ctx->lex.src, ctx->lex.len, opts);
+        int outputs = 0;
+        if (cache_fetch(ctx->cache, key, ctx->out_path, &outputs) == 0) {
+            if (!ctx->quiet && outputs == 1) printf("Reused cached output for %s at %s\n", ctx->in_path, ctx->out_path);
+            else if (!ctx->quiet) printf("Reused cached output for %s: %d files beside %s\n", ctx->in_path, outputs, ctx->out_path);
+            ctx->outputs = outputs;
+            lexer_free(&ctx->lex);
+            return 0;
+        }
+    }
+
+    ProgramAST prog;
+    int parsed;
+    int binary = astbin_is(ctx->lex.src, ctx->lex.len);
+    if (binary) {
+        // a binary AST (--emit=ast-bin) skips lexing and parsing
+        AstBin bin;
+        if (st) t0 = stats_now();
+        parsed = astbin_view(&bin, ctx->lex.src, ctx->lex.len, ctx->diag) != 0 || astbin_load(ctx, &bin, &prog) != 0;
+        if (st) st->t[PHASE_AST] += stats_now() - t0;
+    } else {
+        double t_lex = 0.0, t_parse = 0.0;
+        if (st) {
+            time_front_end(ctx, st, &t_lex, &t_parse);
+            t0 = stats_now();
+        }
+        parsed = parse_program(ctx, &prog);
+        if (st) {
+            double ast = stats_now() - t0 - t_lex - t_parse;
+            st->t[PHASE_LEX] += t_lex;
+            st->t[PHASE_PARSE] += t_parse;
+            st->t[PHASE_AST] += ast > 0 ? ast : 0.0;
+        }
+    }
+    if (parsed != 0) {
+        fprintf(ctx->diag, "%s: %s failed.\n", ctx->in_path, binary ? "Loading" : "Parsing");
+        if (st) stats_end(ctx, st);
+        arena_reset(&ctx->arena);
+        interner_reset(&ctx->strings);
+        lexer_free(&ctx->lex);
+        return 1;
+    }
+
+    if (!ctx->quiet) {
+        if (prog.n_nets == 1) printf("%s succeeded. Model name: %s\n", binary ? "Loading" : "Parsing", prog.nets[0].model->name);
+        else {
+            printf("%s succeeded. %d networks:", binary ? "Loading" : "Parsing", prog.n_nets);
+            for (int i = 0; i < prog.n_nets; i++) printf(" %s", prog.nets[i].model->name);
+            printf("\n");
+        }
+    }
+
+    long long total = 0;
+    for (int i = 0; i < prog.n_nets; i++) total += sweep_count(&prog.nets[i]);
+    int rc = total == 1 ? compile_network(ctx, prog.nets[0].model, &prog.nets[0].train, NULL) : compile_outputs(ctx, &prog, total);
+    if (rc == 0) {
+        ctx->outputs = (int)total;
+        for (int i = 0; total > 1 && i < prog.n_nets; i++) ctx->outputs += prog.nets[i].n_axes ? 1 : 0;
+    }
+    if (rc == 0 && cached && total == 1) cache_store(ctx->cache, key, ctx->out_path);
+    else if (rc == 0 && cached) {
+        int n = 0;
+        char **suffixes = output_suffixes(ctx, &prog, total, &n);
+        if (suffixes) cache_store_bundle(ctx->cache, key, ctx->out_path, (const char *const *)suffixes, n);
+        for (int i = 0; suffixes && i < n; i++) free(suffixes[i]);
+        free(suffixes);
+    }
+
+    // free ast
+    if (st) stats_end(ctx, st);
+    arena_reset(&ctx->arena);
+    interner_reset(&ctx->strings);
+    lexer_free(&ctx->lex);
+    return rc;
+}
+
+int compile_file(CompileContext *ctx) {
+    double t0 = ctx->stats ? stats_now() : 0.0;
+    if (lexer_init_file(&ctx->lex, ctx->in_path) != 0) return 1;
+    if (ctx->stats) ctx->stats->t[PHASE_READ] += stats_now() - t0;
+    return compile_loaded(ctx);
+}
+
+int compile_source(CompileContext *ctx, const char *src, size_t len) {
+    if (lexer_init_buffer(&ctx->lex, src, len) != 0) return 1;
+    return compile_loaded(ctx);
+}
+
+void compile_ctx_free(CompileContext *ctx) {
+    lexer_free(&ctx->lex);
+    arena_release(&ctx->arena);
+    interner_free(&ctx->strings);
+}
@@ -0,0 +1,40 @@
+#include <stdio.h>
+#include <string.h>
+#include "../include/fuse.h"
+
+const char *fused_kind_name(FusedKind k) {
+    static const char *names[] = { "input", "conv2d", "conv2d+maxpool2d", "maxpool2d", "flatten", "dense" };
+    return (unsigned)k < sizeof(names) / sizeof(names[0]) ? names[k] : "?";
+}
+
+// Greedy left to right. Activations already belong to their conv2d or
+// dense layer, so the only groups are conv2d followed by maxpool2d and a
+// flatten followed by dense (flatten is a reshape of a contiguous NHWC
+// tensor, so the dense kernel reads the same bytes).
+int fuse_model(Arena *a, const ModelAST *m, int enable, FusedModel *out) {
+    int n = m->n_layers;
+    out->n = 0;
+    out->ops = (FusedOp*)arena_alloc(a, sizeof(FusedOp) * (size_t)(n > 0 ? n : 1));
+    if (!out->ops) return 1;
+    for (int i = 0; i < n; i++) {
+        LayerType t = m->layers[i].type;
+        LayerType next = i + 1 < n ? m->layers[i + 1].type : LAYER_INPUT;
+        FusedOp *op = &out->ops[out->n++];
+        op->first = op->last = i;
+        switch (t) {
+            case LAYER_INPUT: op->kind = FOP_INPUT; break;
+            case LAYER_CONV2D:
+                op->kind = FOP_CONV;
+                if (enable && next == LAYER_MAXPOOL2D) { op->kind = FOP_CONV_POOL; op->last = ++i; }
+                break;
+            case LAYER_MAXPOOL2D: op->kind = FOP_POOL; break;
+            case LAYER_FLATTEN:
+                op->kind = FOP_FLATTEN;
+                if (enable && (next == LAYER_DENSE || next == LAYER_OUTPUT)) { op->kind = FOP_DENSE; op->last = ++i; }
+                break;
+            case LAYER_DENSE:
+            case LAYER_OUTPUT: op->kind = FOP_DENSE; break;
+        }
+    }
+    return 0;
+}
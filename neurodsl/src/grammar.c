@@ -0,0 +1,191 @@
+// Generated by tools/llgen.c from grammar/neurodsl.g. Do not edit.
+#include <string.h>
+#include "../include/grammar.h"
+
+/*
+ * program      FIRST  { NETWORK TRAIN }
+ *              FOLLOW { EOF }
+ * block        FIRST  { NETWORK TRAIN }
+ *              FOLLOW { NETWORK TRAIN EOF }
+ * blocks       FIRST  { NETWORK TRAIN } nullable
+ *              FOLLOW { EOF }
+ * layers       FIRST  { INPUT CONV2D MAXPOOL2D FLATTEN DENSE OUTPUT } nullable
+ *              FOLLOW { RBRACE }
+ * train_for    FIRST  { IDENTIFIER } nullable
+ *              FOLLOW { LBRACE }
+ * train_items  FIRST  { IDENTIFIER } nullable
+ *              FOLLOW { RBRACE }
+ * layer        FIRST  { INPUT CONV2D MAXPOOL2D FLATTEN DENSE OUTPUT }
+ *              FOLLOW { INPUT CONV2D MAXPOOL2D FLATTEN DENSE OUTPUT RBRACE }
+ * dim          FIRST  { NUMBER }
+ *              FOLLOW { INPUT CONV2D MAXPOOL2D FLATTEN DENSE OUTPUT RBRACE NUMBER COMMA RPAREN }
+ * comma_opt    FIRST  { COMMA } nullable
+ *              FOLLOW { INPUT CONV2D MAXPOOL2D FLATTEN DENSE OUTPUT IDENTIFIER RBRACE NUMBER RBRACKET }
+ * rparen_opt   FIRST  { RPAREN } nullable
+ *              FOLLOW { INPUT CONV2D MAXPOOL2D FLATTEN DENSE OUTPUT RBRACE }
+ * params       FIRST  { IDENTIFIER } nullable
+ *              FOLLOW { INPUT CONV2D MAXPOOL2D FLATTEN DENSE OUTPUT RBRACE }
+ * param        FIRST  { IDENTIFIER }
+ *              FOLLOW { INPUT CONV2D MAXPOOL2D FLATTEN DENSE OUTPUT IDENTIFIER RBRACE }
+ * value        FIRST  { IDENTIFIER NUMBER LBRACKET }
+ *              FOLLOW { INPUT CONV2D MAXPOOL2D FLATTEN DENSE OUTPUT IDENTIFIER RBRACE COMMA }
+ * train_item   FIRST  { IDENTIFIER }
+ *              FOLLOW { IDENTIFIER RBRACE }
+ * sep          FIRST  { EQUALS COLON }
+ *              FOLLOW { IDENTIFIER NUMBER LBRACKET }
+ * scalar       FIRST  { IDENTIFIER NUMBER }
+ *              FOLLOW { INPUT CONV2D MAXPOOL2D FLATTEN DENSE OUTPUT IDENTIFIER RBRACE NUMBER RBRACKET COMMA }
+ * scalars      FIRST  { IDENTIFIER NUMBER } nullable
+ *              FOLLOW { RBRACKET }
+ * range_opt    FIRST  { DOTDOT } nullable
+ *              FOLLOW { INPUT CONV2D MAXPOOL2D FLATTEN DENSE OUTPUT IDENTIFIER RBRACE NUMBER RBRACKET COMMA }
+ */
+
+const unsigned char ll_table[NT_COUNT][TOK_COUNT] = {
+    [NT_PROGRAM] = { [TOK_NETWORK] = 1, [TOK_TRAIN] = 1 },
+    [NT_BLOCK] = { [TOK_NETWORK] = 4, [TOK_TRAIN] = 5 },
+    [NT_BLOCKS] = { [TOK_NETWORK] = 2, [TOK_TRAIN] = 2, [TOK_EOF] = 3 },
+    [NT_LAYERS] = { [TOK_INPUT] = 8, [TOK_CONV2D] = 8, [TOK_MAXPOOL2D] = 8, [TOK_FLATTEN] = 8, [TOK_DENSE] = 8, [TOK_OUTPUT] = 8, [TOK_RBRACE] = 9 },
+    [NT_TRAIN_FOR] = { [TOK_IDENTIFIER] = 6, [TOK_LBRACE] = 7 },
+    [NT_TRAIN_ITEMS] = { [TOK_IDENTIFIER] = 20, [TOK_RBRACE] = 21 },
+    [NT_LAYER] = { [TOK_INPUT] = 10, [TOK_CONV2D] = 11, [TOK_MAXPOOL2D] = 12, [TOK_FLATTEN] = 13, [TOK_DENSE] = 14, [TOK_OUTPUT] = 15 },
+    [NT_DIM] = { [TOK_NUMBER] = 16 },
+    [NT_COMMA_OPT] = { [TOK_INPUT] = 34, [TOK_CONV2D] = 34, [TOK_MAXPOOL2D] = 34, [TOK_FLATTEN] = 34, [TOK_DENSE] = 34, [TOK_OUTPUT] = 34, [TOK_IDENTIFIER] = 34, [TOK_RBRACE] = 34, [TOK_NUMBER] = 34, [TOK_RBRACKET] = 34, [TOK_COMMA] = 33 },
+    [NT_RPAREN_OPT] = { [TOK_INPUT] = 36, [TOK_CONV2D] = 36, [TOK_MAXPOOL2D] = 36, [TOK_FLATTEN] = 36, [TOK_DENSE] = 36, [TOK_OUTPUT] = 36, [TOK_RBRACE] = 36, [TOK_RPAREN] = 35 },
+    [NT_PARAMS] = { [TOK_INPUT] = 18, [TOK_CONV2D] = 18, [TOK_MAXPOOL2D] = 18, [TOK_FLATTEN] = 18, [TOK_DENSE] = 18, [TOK_OUTPUT] = 18, [TOK_IDENTIFIER] = 17, [TOK_RBRACE] = 18 },
+    [NT_PARAM] = { [TOK_IDENTIFIER] = 19 },
+    [NT_VALUE] = { [TOK_IDENTIFIER] = 25, [TOK_NUMBER] = 25, [TOK_LBRACKET] = 26 },
+    [NT_TRAIN_ITEM] = { [TOK_IDENTIFIER] = 22 },
+    [NT_SEP] = { [TOK_EQUALS] = 24, [TOK_COLON] = 23 },
+    [NT_SCALAR] = { [TOK_IDENTIFIER] = 30, [TOK_NUMBER] = 29 },
+    [NT_SCALARS] = { [TOK_IDENTIFIER] = 27, [TOK_NUMBER] = 27, [TOK_RBRACKET] = 28 },
+    [NT_RANGE_OPT] = { [TOK_INPUT] = 32, [TOK_CONV2D] = 32, [TOK_MAXPOOL2D] = 32, [TOK_FLATTEN] = 32, [TOK_DENSE] = 32, [TOK_OUTPUT] = 32, [TOK_IDENTIFIER] = 32, [TOK_RBRACE] = 32, [TOK_NUMBER] = 32, [TOK_RBRACKET] = 32, [TOK_DOTDOT] = 31, [TOK_COMMA] = 32 },
+};
+
+const unsigned char ll_default[NT_COUNT] = {
+    [NT_BLOCKS] = 3,
+    [NT_TRAIN_FOR] = 7,
+    [NT_LAYERS] = 9,
+    [NT_PARAMS] = 18,
+    [NT_TRAIN_ITEMS] = 21,
+    [NT_SCALARS] = 28,
+    [NT_RANGE_OPT] = 32,
+    [NT_COMMA_OPT] = 34,
+    [NT_RPAREN_OPT] = 36,
+};
+
+const unsigned char ll_recover[NT_COUNT] = {
+    [NT_LAYERS] = 1,
+    [NT_TRAIN_ITEMS] = 1,
+};
+
+const unsigned short ll_rhs_start[] = { 0, 3, 5, 5, 11, 17, 19, 19, 21, 21, 30, 33, 36, 38, 41, 44, 46, 48, 48, 54, 56, 56, 62, 63, 64, 65, 68, 71, 71, 74, 76, 79, 79, 80, 80, 81, 81 };
+
+const unsigned short ll_rhs[] = {
+    // 0: program -> block blocks EOF
+    TOK_EOF, LL_NT(NT_BLOCKS), LL_NT(NT_BLOCK),
+    // 1: blocks -> block blocks
+    LL_NT(NT_BLOCKS), LL_NT(NT_BLOCK),
+    // 2: blocks -> (empty)
+    // 3: block -> NETWORK IDENTIFIER @model_begin LBRACE layers RBRACE
+    TOK_RBRACE, LL_NT(NT_LAYERS), TOK_LBRACE, LL_ACT(ACT_MODEL_BEGIN), TOK_IDENTIFIER, TOK_NETWORK,
+    // 4: block -> TRAIN train_for @train_begin LBRACE train_items RBRACE
+    TOK_RBRACE, LL_NT(NT_TRAIN_ITEMS), TOK_LBRACE, LL_ACT(ACT_TRAIN_BEGIN), LL_NT(NT_TRAIN_FOR), TOK_TRAIN,
+    // 5: train_for -> IDENTIFIER @train_name
+    LL_ACT(ACT_TRAIN_NAME), TOK_IDENTIFIER,
+    // 6: train_for -> (empty)
+    // 7: layers -> layer layers
+    LL_NT(NT_LAYERS), LL_NT(NT_LAYER),
+    // 8: layers -> (empty)
+    // 9: layer -> INPUT @input_begin LPAREN dim comma_opt dim comma_opt dim rparen_opt
+    LL_NT(NT_RPAREN_OPT), LL_NT(NT_DIM), LL_NT(NT_COMMA_OPT), LL_NT(NT_DIM), LL_NT(NT_COMMA_OPT), LL_NT(NT_DIM), TOK_LPAREN, LL_ACT(ACT_INPUT_BEGIN), TOK_INPUT,
+    // 10: layer -> CONV2D @layer_begin params
+    LL_NT(NT_PARAMS), LL_ACT(ACT_LAYER_BEGIN), TOK_CONV2D,
+    // 11: layer -> MAXPOOL2D @layer_begin params
+    LL_NT(NT_PARAMS), LL_ACT(ACT_LAYER_BEGIN), TOK_MAXPOOL2D,
+    // 12: layer -> FLATTEN @layer_begin
+    LL_ACT(ACT_LAYER_BEGIN), TOK_FLATTEN,
+    // 13: layer -> DENSE @layer_begin params
+    LL_NT(NT_PARAMS), LL_ACT(ACT_LAYER_BEGIN), TOK_DENSE,
+    // 14: layer -> OUTPUT @layer_begin params
+    LL_NT(NT_PARAMS), LL_ACT(ACT_LAYER_BEGIN), TOK_OUTPUT,
+    // 15: dim -> NUMBER @input_dim
+    LL_ACT(ACT_INPUT_DIM), TOK_NUMBER,
+    // 16: params -> param params
+    LL_NT(NT_PARAMS), LL_NT(NT_PARAM),
+    // 17: params -> (empty)
+    // 18: param -> IDENTIFIER @param_name EQUALS value @layer_param comma_opt
+    LL_NT(NT_COMMA_OPT), LL_ACT(ACT_LAYER_PARAM), LL_NT(NT_VALUE), TOK_EQUALS, LL_ACT(ACT_PARAM_NAME), TOK_IDENTIFIER,
+    // 19: train_items -> train_item train_items
+    LL_NT(NT_TRAIN_ITEMS), LL_NT(NT_TRAIN_ITEM),
+    // 20: train_items -> (empty)
+    // 21: train_item -> IDENTIFIER @param_name sep value @train_param comma_opt
+    LL_NT(NT_COMMA_OPT), LL_ACT(ACT_TRAIN_PARAM), LL_NT(NT_VALUE), LL_NT(NT_SEP), LL_ACT(ACT_PARAM_NAME), TOK_IDENTIFIER,
+    // 22: sep -> COLON
+    TOK_COLON,
+    // 23: sep -> EQUALS
+    TOK_EQUALS,
+    // 24: value -> scalar
+    LL_NT(NT_SCALAR),
+    // 25: value -> LBRACKET scalars RBRACKET
+    TOK_RBRACKET, LL_NT(NT_SCALARS), TOK_LBRACKET,
+    // 26: scalars -> scalar comma_opt scalars
+    LL_NT(NT_SCALARS), LL_NT(NT_COMMA_OPT), LL_NT(NT_SCALAR),
+    // 27: scalars -> (empty)
+    // 28: scalar -> NUMBER @value_item range_opt
+    LL_NT(NT_RANGE_OPT), LL_ACT(ACT_VALUE_ITEM), TOK_NUMBER,
+    // 29: scalar -> IDENTIFIER @value_item
+    LL_ACT(ACT_VALUE_ITEM), TOK_IDENTIFIER,
+    // 30: range_opt -> DOTDOT NUMBER @value_range
+    LL_ACT(ACT_VALUE_RANGE), TOK_NUMBER, TOK_DOTDOT,
+    // 31: range_opt -> (empty)
+    // 32: comma_opt -> COMMA
+    TOK_COMMA,
+    // 33: comma_opt -> (empty)
+    // 34: rparen_opt -> RPAREN
+    TOK_RPAREN,
+    // 35: rparen_opt -> (empty)
+    0
+};
+
+const char *const ll_nt_name[NT_COUNT] = { "program", "block", "blocks", "layers", "train_for", "train_items", "layer", "dim", "comma_opt", "rparen_opt", "params", "param", "value", "train_item", "sep", "scalar", "scalars", "range_opt" };
+
+const char *const param_name[PARAM_COUNT] = { "", "filters", "kernel", "size", "units", "activation", "optimizer", "loss", "epochs", "dataset", "batch_size", "prefetch", "cache", "shuffle_buffer", "mixed_precision", "jit_compile" };
+
+// perfect hash of the 23 keywords and parameter names, found by llgen
+#define WORD_HASH(s, n) (((unsigned char)(s)[0] * 1u + (unsigned char)(s)[(n) - 1] * 16u + (unsigned)(n) * 0u) & 63u)
+
+static const struct { unsigned char len, tok, param; char text[16]; } word_table[64] = {
+    [30] = { 7, TOK_NETWORK, PARAM_NONE, "network" },
+    [41] = { 5, TOK_INPUT, PARAM_NONE, "input" },
+    [35] = { 6, TOK_CONV2D, PARAM_NONE, "conv2d" },
+    [45] = { 9, TOK_MAXPOOL2D, PARAM_NONE, "maxpool2d" },
+    [6] = { 7, TOK_FLATTEN, PARAM_NONE, "flatten" },
+    [52] = { 5, TOK_DENSE, PARAM_NONE, "dense" },
+    [47] = { 6, TOK_OUTPUT, PARAM_NONE, "output" },
+    [20] = { 5, TOK_TRAIN, PARAM_NONE, "train" },
+    [22] = { 7, TOK_IDENTIFIER, PARAM_FILTERS, "filters" },
+    [43] = { 6, TOK_IDENTIFIER, PARAM_KERNEL, "kernel" },
+    [3] = { 4, TOK_IDENTIFIER, PARAM_SIZE, "size" },
+    [37] = { 5, TOK_IDENTIFIER, PARAM_UNITS, "units" },
+    [1] = { 10, TOK_IDENTIFIER, PARAM_ACTIVATION, "activation" },
+    [15] = { 9, TOK_IDENTIFIER, PARAM_OPTIMIZER, "optimizer" },
+    [28] = { 4, TOK_IDENTIFIER, PARAM_LOSS, "loss" },
+    [21] = { 6, TOK_IDENTIFIER, PARAM_EPOCHS, "epochs" },
+    [36] = { 7, TOK_IDENTIFIER, PARAM_DATASET, "dataset" },
+    [50] = { 10, TOK_IDENTIFIER, PARAM_BATCH_SIZE, "batch_size" },
+    [48] = { 8, TOK_IDENTIFIER, PARAM_PREFETCH, "prefetch" },
+    [51] = { 5, TOK_IDENTIFIER, PARAM_CACHE, "cache" },
+    [19] = { 14, TOK_IDENTIFIER, PARAM_SHUFFLE_BUFFER, "shuffle_buffer" },
+    [13] = { 15, TOK_IDENTIFIER, PARAM_MIXED_PRECISION, "mixed_precision" },
+    [58] = { 11, TOK_IDENTIFIER, PARAM_JIT_COMPILE, "jit_compile" },
+};
+
+TokenType lookup_word(const char *s, size_t n, unsigned int *param) {
+    *param = PARAM_NONE;
+    if (n == 0 || n > 15) return TOK_IDENTIFIER;
+    unsigned h = WORD_HASH(s, n);
+    if (word_table[h].len != n || memcmp(word_table[h].text, s, n) != 0) return TOK_IDENTIFIER;
+    *param = word_table[h].param;
+    return (TokenType)word_table[h].tok;
+}
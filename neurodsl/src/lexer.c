@@ -1,121 +1,336 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <ctype.h>
-#include "lexer.h"
-
-static FILE *infile = NULL;
-static Token lookahead;
-static int lookahead_valid = 0;
-
-static void token_set(Token *t, TokenType tp, const char *txt) {
-    t->type = tp;
-    if (txt) strncpy(t->text, txt, sizeof(t->text)-1);
-    else t->text[0] = '\0';
-}
-
-void lexer_init_file(const char *path) {
-    if (infile) fclose(infile);
-    infile = fopen(path, "r");
-    if (!infile) {
-        perror("fopen");
-        exit(1);
-    }
-    lookahead_valid = 0;
-}
-
-void lexer_free() {
-    if (infile) { fclose(infile); infile = NULL; }
-    lookahead_valid = 0;
-}
-
-// helper to read next raw token string (skips whitespace, comments)
-static int read_char() { return fgetc(infile); }
-static void unread_char(int c) { if (c != EOF) ungetc(c, infile); }
-
-static void skip_ws_and_comments() {
-    int c;
-    while ((c = read_char()) != EOF) {
-        if (isspace(c)) continue;
-        if (c == '#') { // comment to line end
-            while ((c = read_char()) != EOF && c != '\n');
-            continue;
-        }
-        unread_char(c);
-        break;
-    }
-}
-
-static Token tokenize_next() {
-    Token tok;
-    token_set(&tok, TOK_EOF, "");
-    if (!infile) return tok;
-    skip_ws_and_comments();
-    int c = read_char();
-    if (c == EOF) { token_set(&tok, TOK_EOF, "EOF"); return tok; }
-
-    // single char tokens
-    if (c == '{') { token_set(&tok, TOK_LBRACE, "{"); return tok; }
-    if (c == '}') { token_set(&tok, TOK_RBRACE, "}"); return tok; }
-    if (c == '(') { token_set(&tok, TOK_LPAREN, "("); return tok; }
-    if (c == ')') { token_set(&tok, TOK_RPAREN, ")"); return tok; }
-    if (c == ',') { token_set(&tok, TOK_COMMA, ","); return tok; }
-    if (c == '=') { token_set(&tok, TOK_EQUALS, "="); return tok; }
-    if (c == ':') { token_set(&tok, TOK_COLON, ":"); return tok; }
-
-    // identifier or keyword
-    if (isalpha(c)) {
-        char buf[128]; int i = 0;
-        buf[i++] = (char)c;
-        while ((c = read_char()) != EOF && (isalnum(c) || c == '_' )) {
-            if (i < (int)sizeof(buf)-1) buf[i++] = (char)c;
-        }
-        unread_char(c);
-        buf[i] = '\0';
-        // keywords
-        if (strcmp(buf, "network") == 0) token_set(&tok, TOK_NETWORK, buf);
-        else if (strcmp(buf, "input") == 0) token_set(&tok, TOK_INPUT, buf);
-        else if (strcmp(buf, "conv2d") == 0) token_set(&tok, TOK_CONV2D, buf);
-        else if (strcmp(buf, "maxpool2d") == 0) token_set(&tok, TOK_MAXPOOL2D, buf);
-        else if (strcmp(buf, "flatten") == 0) token_set(&tok, TOK_FLATTEN, buf);
-        else if (strcmp(buf, "dense") == 0) token_set(&tok, TOK_DENSE, buf);
-        else if (strcmp(buf, "output") == 0) token_set(&tok, TOK_OUTPUT, buf);
-        else if (strcmp(buf, "train") == 0) token_set(&tok, TOK_TRAIN, buf);
-        else { token_set(&tok, TOK_IDENTIFIER, buf); }
-        return tok;
-    }
-
-    // number
-    if (isdigit(c)) {
-        char buf[64]; int i = 0;
-        buf[i++] = (char)c;
-        while ((c = read_char()) != EOF && isdigit(c)) {
-            if (i < (int)sizeof(buf)-1) buf[i++] = (char)c;
-        }
-        unread_char(c);
-        buf[i] = '\0';
-        token_set(&tok, TOK_NUMBER, buf);
-        return tok;
-    }
-
-    // fallback
-    char s[2] = {(char)c,'\0'};
-    token_set(&tok, TOK_UNKNOWN, s);
-    return tok;
-}
-
-Token lexer_peek() {
-    if (!lookahead_valid) {
-        lookahead = tokenize_next();
-        lookahead_valid = 1;
-    }
-    return lookahead;
-}
-
-Token lexer_next() {
-    if (lookahead_valid) {
-        lookahead_valid = 0;
-        return lookahead;
-    }
-    return tokenize_next();
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include "lexer.h"
+#include "../include/grammar.h"
+
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// Character classes are tested in bulk: a block of bytes is compared
+// against the class at once, giving one bit per byte, and the first byte
+// outside the class is the lowest clear bit. Most runs (a token, the
+// indentation before one) are shorter than 16 bytes, so the first block is
+// always 16 bytes of SSE2; AVX2 builds (-mavx2, -march=native) continue
+// long runs 32 bytes at a time. Without SSE2, and for the tail of the
+// buffer, bytes are classified one at a time.
+#if defined(__GNUC__) && defined(__SSE2__)
+#define SCAN_SSE2
+#include <emmintrin.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#endif
+
+// the C locale's isspace, isdigit, isalpha and isalnum-or-underscore as one table
+enum { CC_SPACE = 1, CC_DIGIT = 2, CC_ALPHA = 4, CC_WORD = 8 };
+static const unsigned char char_class[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 0, 0, 0, 0, 0, 0,
+    0, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12,
+    12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 0, 0, 0, 0, 8,
+    0, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12,
+    12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+static inline int is_space(unsigned char c) { return char_class[c] & CC_SPACE; }
+static inline int is_digit(unsigned char c) { return char_class[c] & CC_DIGIT; }
+static inline int is_alpha(unsigned char c) { return char_class[c] & CC_ALPHA; }
+static inline int is_word(unsigned char c) { return char_class[c] & CC_WORD; }
+
+#ifdef SCAN_SSE2
+// bytes of x in [lo, hi], unsigned
+static inline __m128i range16(__m128i x, char lo, char hi) {
+    return _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(x, _mm_set1_epi8(lo)), x), _mm_cmpeq_epi8(_mm_min_epu8(x, _mm_set1_epi8(hi)), x));
+}
+static inline unsigned space16(const char *p) {
+    __m128i x = _mm_loadu_si128((const __m128i*)p);
+    return (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(' ')), range16(x, '\t', '\r')));
+}
+static inline unsigned digit16(const char *p) {
+    return (unsigned)_mm_movemask_epi8(range16(_mm_loadu_si128((const __m128i*)p), '0', '9'));
+}
+static inline unsigned word16(const char *p) {
+    __m128i x = _mm_loadu_si128((const __m128i*)p);
+    __m128i m = _mm_or_si128(range16(_mm_or_si128(x, _mm_set1_epi8(0x20)), 'a', 'z'), range16(x, '0', '9'));
+    return (unsigned)_mm_movemask_epi8(_mm_or_si128(m, _mm_cmpeq_epi8(x, _mm_set1_epi8('_'))));
+}
+#ifdef __AVX2__
+static inline __m256i range32(__m256i x, char lo, char hi) {
+    return _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(x, _mm256_set1_epi8(lo)), x), _mm256_cmpeq_epi8(_mm256_min_epu8(x, _mm256_set1_epi8(hi)), x));
+}
+static inline unsigned space32(const char *p) {
+    __m256i x = _mm256_loadu_si256((const __m256i*)p);
+    return (unsigned)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(' ')), range32(x, '\t', '\r')));
+}
+static inline unsigned digit32(const char *p) {
+    return (unsigned)_mm256_movemask_epi8(range32(_mm256_loadu_si256((const __m256i*)p), '0', '9'));
+}
+static inline unsigned word32(const char *p) {
+    __m256i x = _mm256_loadu_si256((const __m256i*)p);
+    __m256i m = _mm256_or_si256(range32(_mm256_or_si256(x, _mm256_set1_epi8(0x20)), 'a', 'z'), range32(x, '0', '9'));
+    return (unsigned)_mm256_movemask_epi8(_mm256_or_si256(m, _mm256_cmpeq_epi8(x, _mm256_set1_epi8('_'))));
+}
+#define SCAN_WIDE(cls) \
+        for (; pos + 32 <= len; pos += 32) { \
+            unsigned m = ~cls##32(s + pos); \
+            if (m) return pos + (size_t)__builtin_ctz(m); \
+        }
+#else
+#define SCAN_WIDE(cls)
+#endif
+#endif
+
+// scan_<cls>: first position at or after pos whose byte is not in the class, or len
+#ifdef SCAN_SSE2
+#define SCAN_FN(cls) \
+    static inline size_t scan_##cls(const char *s, size_t pos, size_t len) { \
+        if (pos + 16 <= len) { \
+            unsigned m = ~cls##16(s + pos) & 0xffffu; \
+            if (m) return pos + (size_t)__builtin_ctz(m); \
+            pos += 16; \
+        } \
+        SCAN_WIDE(cls) \
+        for (; pos + 16 <= len; pos += 16) { \
+            unsigned m = ~cls##16(s + pos) & 0xffffu; \
+            if (m) return pos + (size_t)__builtin_ctz(m); \
+        } \
+        while (pos < len && is_##cls((unsigned char)s[pos])) pos++; \
+        return pos; \
+    }
+#else
+#define SCAN_FN(cls) \
+    static inline size_t scan_##cls(const char *s, size_t pos, size_t len) { \
+        while (pos < len && is_##cls((unsigned char)s[pos])) pos++; \
+        return pos; \
+    }
+#endif
+SCAN_FN(space)
+SCAN_FN(word)
+SCAN_FN(digit)
+
+static void token_set(Token *t, TokenType tp, size_t start, size_t end) {
+    t->type = tp;
+    t->offset = (unsigned int)start;
+    t->len = (unsigned int)(end - start);
+    t->param = 0;
+}
+
+// read everything from f into a heap buffer
+static int read_all(LexerState *lx, FILE *f) {
+    size_t cap = 1 << 16, n = 0;
+    char *buf = (char*)malloc(cap);
+    if (!buf) return -1;
+    while (1) {
+        if (n == cap) {
+            char *nb = (char*)realloc(buf, cap * 2);
+            if (!nb) { free(buf); return -1; }
+            buf = nb; cap *= 2;
+        }
+        size_t got = fread(buf + n, 1, cap - n, f);
+        n += got;
+        if (got == 0) break;
+    }
+    if (ferror(f)) { free(buf); return -1; }
+    lx->src = buf; lx->len = n; lx->mapped = 0;
+    return 0;
+}
+
+#ifndef _WIN32
+// map a regular file; returns 0 on success, nonzero to fall back to reading
+static int map_file(LexerState *lx, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) { close(fd); return -1; }
+    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return -1;
+    madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+    lx->src = (const char*)p; lx->len = (size_t)st.st_size; lx->mapped = 1;
+    return 0;
+}
+#endif
+
+int lexer_init_file(LexerState *lx, const char *path) {
+    memset(lx, 0, sizeof(*lx));
+    int is_stdin = strcmp(path, "-") == 0;
+#ifndef _WIN32
+    if (is_stdin || map_file(lx, path) != 0)
+#endif
+    {
+        FILE *f = is_stdin ? stdin : fopen(path, "rb");
+        if (!f) { perror(path); return 1; }
+        int rc = read_all(lx, f);
+        if (!is_stdin) fclose(f);
+        if (rc != 0) { perror(path); return 1; }
+    }
+    // token offsets are 32-bit
+    if (lx->len > UINT_MAX) {
+        fprintf(stderr, "Error: %s is larger than 4 GiB\n", path);
+        lexer_free(lx);
+        return 1;
+    }
+    return 0;
+}
+
+int lexer_init_buffer(LexerState *lx, const char *src, size_t len) {
+    memset(lx, 0, sizeof(*lx));
+    if (len > UINT_MAX) { fprintf(stderr, "Error: source is larger than 4 GiB\n"); return 1; }
+    lx->src = src;
+    lx->len = len;
+    lx->borrowed = 1;
+    return 0;
+}
+
+void lexer_free(LexerState *lx) {
+    if (lx->src && !lx->borrowed) {
+#ifndef _WIN32
+        if (lx->mapped) munmap((void*)lx->src, lx->len);
+        else
+#endif
+        free((void*)lx->src);
+    }
+    memset(lx, 0, sizeof(*lx));
+}
+
+const char *token_type_name(TokenType t) {
+    static const char *const names[TOK_COUNT] = {
+        [TOK_NETWORK] = "'network'", [TOK_LBRACE] = "'{'", [TOK_RBRACE] = "'}'",
+        [TOK_INPUT] = "'input'", [TOK_CONV2D] = "'conv2d'", [TOK_MAXPOOL2D] = "'maxpool2d'",
+        [TOK_FLATTEN] = "'flatten'", [TOK_DENSE] = "'dense'", [TOK_OUTPUT] = "'output'",
+        [TOK_TRAIN] = "'train'", [TOK_IDENTIFIER] = "identifier", [TOK_NUMBER] = "number",
+        [TOK_EQUALS] = "'='", [TOK_COMMA] = "','", [TOK_LPAREN] = "'('", [TOK_RPAREN] = "')'",
+        [TOK_COLON] = "':'", [TOK_LBRACKET] = "'['", [TOK_RBRACKET] = "']'", [TOK_DOTDOT] = "'..'",
+        [TOK_EOF] = "end of file", [TOK_UNKNOWN] = "unknown character",
+    };
+    return (unsigned)t < TOK_COUNT ? names[t] : "?";
+}
+
+const char *lexer_text(const LexerState *lx, const Token *t) {
+    if (t->type == TOK_EOF) return "EOF";
+    return lx->src + t->offset;
+}
+
+int token_is(const LexerState *lx, const Token *t, const char *s) {
+    size_t n = strlen(s);
+    return t->len == n && memcmp(lexer_text(lx, t), s, n) == 0;
+}
+
+int token_int(const LexerState *lx, const Token *t) {
+    const char *p = lexer_text(lx, t);
+    long long v = 0;
+    for (unsigned int i = 0; i < t->len && isdigit((unsigned char)p[i]); i++) {
+        v = v * 10 + (p[i] - '0');
+        if (v > INT_MAX) return -1;
+    }
+    return (int)v;
+}
+
+void token_copy(const LexerState *lx, const Token *t, char *dst, size_t n) {
+    if (n == 0) return;
+    size_t k = t->len < n - 1 ? t->len : n - 1;
+    memcpy(dst, lexer_text(lx, t), k);
+    dst[k] = '\0';
+}
+
+static void skip_ws_and_comments(LexerState *lx) {
+    const char *src = lx->src;
+    size_t pos = lx->pos, len = lx->len;
+    while (pos < len) {
+        pos = scan_space(src, pos, len);
+        if (pos < len && src[pos] == '#') { // comment to line end
+            const char *nl = (const char*)memchr(src + pos, '\n', len - pos);
+            pos = nl ? (size_t)(nl - src) + 1 : len;
+            continue;
+        }
+        break;
+    }
+    lx->pos = pos;
+}
+
+static Token tokenize_next(LexerState *lx) {
+    Token tok;
+    token_set(&tok, TOK_EOF, lx->len, lx->len);
+    if (!lx->src) return tok;
+    skip_ws_and_comments(lx);
+    const char *src = lx->src;
+    size_t len = lx->len;
+    size_t pos = lx->pos;
+    if (pos >= len) { token_set(&tok, TOK_EOF, len, len + 3); return tok; }
+    size_t start = pos;
+    unsigned char c = (unsigned char)src[pos++];
+
+    // single char tokens
+    switch (c) {
+        case '{': token_set(&tok, TOK_LBRACE, start, pos); break;
+        case '}': token_set(&tok, TOK_RBRACE, start, pos); break;
+        case '(': token_set(&tok, TOK_LPAREN, start, pos); break;
+        case ')': token_set(&tok, TOK_RPAREN, start, pos); break;
+        case ',': token_set(&tok, TOK_COMMA, start, pos); break;
+        case '=': token_set(&tok, TOK_EQUALS, start, pos); break;
+        case ':': token_set(&tok, TOK_COLON, start, pos); break;
+        case '[': token_set(&tok, TOK_LBRACKET, start, pos); break;
+        case ']': token_set(&tok, TOK_RBRACKET, start, pos); break;
+        case '.':
+            if (pos < len && src[pos] == '.') pos++;
+            token_set(&tok, pos - start == 2 ? TOK_DOTDOT : TOK_UNKNOWN, start, pos);
+            break;
+        default:
+            if (is_alpha(c)) {
+                // identifier or keyword
+                pos = scan_word(src, pos, len);
+                unsigned int param;
+                TokenType tp = lookup_word(src + start, pos - start, &param);
+                token_set(&tok, tp, start, pos);
+                tok.param = param;
+            } else if (is_digit(c)) {
+                // number
+                pos = scan_digit(src, pos, len);
+                token_set(&tok, TOK_NUMBER, start, pos);
+            } else {
+                // fallback
+                token_set(&tok, TOK_UNKNOWN, start, pos);
+            }
+            break;
+    }
+    lx->pos = pos;
+    return tok;
+}
+
+Token lexer_peek(LexerState *lx) {
+    if (!lx->lookahead_valid) {
+        lx->lookahead = tokenize_next(lx);
+        lx->lookahead_valid = 1;
+    }
+    return lx->lookahead;
+}
+
+void lexer_rewind(LexerState *lx) {
+    lx->pos = 0;
+    lx->lookahead_valid = 0;
+}
+
+Token lexer_next(LexerState *lx) {
+    if (lx->lookahead_valid) {
+        lx->lookahead_valid = 0;
+        return lx->lookahead;
+    }
+    return tokenize_next(lx);
+}
@@ -1,36 +1,228 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include "lexer.h"
-#include "../include/parser.h"
-#include "../include/ast.h"
-
-// forward of codegen (declare)
-void generate_python(ModelAST *m, TrainAST *t);
-
-int main(int argc, char **argv) {
-    if (argc < 2) {
-        printf("Usage: %s <dsl-file>\nExample: %s examples/example.nn\n", argv[0], argv[0]);
-        return 1;
-    }
-    const char *path = argv[1];
-    lexer_init_file(path);
-
-    ProgramAST prog;
-    if (parse_program(&prog) != 0) {
-        fprintf(stderr, "Parsing failed.\n");
-        lexer_free();
-        return 1;
-    }
-
-    printf("Parsing succeeded. Model name: %s\n", prog.model->name);
-    // generate code
-    generate_python(prog.model, &prog.train);
-
-    // free ast
-    model_free(prog.model);
-    lexer_free();
-
-    printf("Done. Run: python generated/model.py (needs tensorflow installed).\n");
-    return 0;
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/compile.h"
+#include "../include/threadpool.h"
+#include "../include/server.h"
+
+// output extension per CodegenTarget
+static const char *target_ext[] = { "py", "c", "nab" };
+
+typedef struct {
+    CompileContext ctx;
+    CompileStats stats;
+    char out[1024];
+    int rc;
+} Job;
+
+static void usage(const char *prog) {
+    printf("Usage: %s [options] <dsl-file>...\n       %s --serve SOCKET [--jobs N]\n       %s --connect SOCKET [--target=python|c] [--emit=ast-bin] [--no-fuse] [--quantize=int8] [--profile[=A:B]] <dsl-file>\n"
+           "Example: %s examples/example.nn\n\n"
+           "Options:\n"
+           "  --jobs N            compile the inputs, or the networks and variants of one input, on N threads (0 = one per CPU)\n"
+           "  --out-dir DIR       batch output directory, created if missing (default generated)\n"
+           "  --target=python|c   code generator: Keras script or native C forward pass\n"
+           "  --no-fuse           keep every layer a separate kernel (no conv2d+maxpool2d fusion)\n"
+           "  --quantize=int8     add an int8 inference path (C) or int8 calibration and checks (Python)\n"
+           "  --profile[=A:B]     step, layer and input pipeline timing in the Keras script; traces steps A..B (10:20)\n"
+           "  --emit=ast-bin      write the parsed AST as a binary .nab file; it compiles like a source\n"
+           "  --cache-dir DIR     reuse outputs of unchanged inputs from DIR\n"
+           "  --cache-size MB     evict least recently used entries past MB (default 256)\n"
+           "  --cache-stats       print cache hit/miss statistics\n"
+           "  --report=cost       print per-layer shapes, params, MACs/FLOPs and activation bytes\n"
+           "  --report=cost-json  the same as JSON\n"
+           "  --report=memory     static activation memory plan against a no-reuse baseline\n"
+           "  --time-passes       print time spent in each compiler phase to stderr\n"
+           "  --stats[=json]      phase times plus token, layer, allocation and output counters\n"
+           "  --serve SOCKET      run a compile server on a Unix socket, --jobs workers\n"
+           "  --connect SOCKET    compile through a server; code to stdout, diagnostics to stderr\n", prog, prog, prog, prog);
+}
+
+// generated/<stem>.<ext> for batch mode
+static void batch_out_path(const char *dir, const char *in, const char *ext, char *out, size_t n) {
+    const char *base = strrchr(in, '/');
+    const char *bs = strrchr(in, '\\');
+    if (bs && (!base || bs > base)) base = bs;
+    base = base ? base + 1 : in;
+    const char *dot = strrchr(base, '.');
+    int stem = dot && dot != base ? (int)(dot - base) : (int)strlen(base);
+    snprintf(out, n, "%s/%.*s.%s", dir, stem, base, ext);
+}
+
+static void finish_cache(CompileCache *c, int print_stats) {
+    if (!c) return;
+    cache_close(c);
+    if (print_stats) cache_print_stats(c, stderr);
+}
+
+static int cmp_out(const void *a, const void *b) {
+    return strcmp(((const Job*)a)->out, ((const Job*)b)->out);
+}
+
+static void run_job(void *arg) {
+    Job *j = (Job*)arg;
+    j->rc = compile_file(&j->ctx);
+    compile_ctx_free(&j->ctx);
+}
+
+// options that travel in a --connect request; the rest only make sense locally
+static int forwardable(const char *arg) {
+    static const char *const prefixes[] = { "--connect", "--target=", "--emit=", "--no-fuse", "--quantize=", "--profile" };
+    for (size_t i = 0; i < sizeof(prefixes) / sizeof(prefixes[0]); i++)
+        if (strncmp(arg, prefixes[i], strlen(prefixes[i])) == 0) return 1;
+    return 0;
+}
+
+static int parse_target(const char *s, CodegenTarget *t) {
+    if (strcmp(s, "python") == 0) { *t = TARGET_PYTHON; return 0; }
+    if (strcmp(s, "c") == 0) { *t = TARGET_C; return 0; }
+    fprintf(stderr, "Unknown target '%s'\n", s);
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    int jobs = 0;
+    const char *out_dir = NULL;
+    const char *cache_dir = NULL;
+    unsigned long long cache_mb = 256;
+    int cache_stats = 0;
+    int report = 0;
+    int stats_mode = 0;
+    const char *serve_path = NULL, *connect_path = NULL;
+    CodegenOptions opts = { TARGET_PYTHON };
+    opts.profile_first = PROFILE_FIRST_STEP;
+    opts.profile_last = PROFILE_LAST_STEP;
+    const char **inputs = (const char**)calloc((size_t)argc, sizeof(char*));
+    int n_in = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) jobs = atoi(argv[++i]);
+        else if (strncmp(argv[i], "--jobs=", 7) == 0) jobs = atoi(argv[i] + 7);
+        else if (strcmp(argv[i], "--out-dir") == 0 && i + 1 < argc) out_dir = argv[++i];
+        else if (strncmp(argv[i], "--out-dir=", 10) == 0) out_dir = argv[i] + 10;
+        else if (strncmp(argv[i], "--target=", 9) == 0) { if (parse_target(argv[i] + 9, &opts.target)) return 1; }
+        else if (strcmp(argv[i], "--emit=ast-bin") == 0) opts.target = TARGET_AST_BIN;
+        else if (strcmp(argv[i], "--no-fuse") == 0) opts.no_fuse = 1;
+        else if (strcmp(argv[i], "--quantize=int8") == 0) opts.quantize = QUANT_INT8;
+        else if (strcmp(argv[i], "--profile") == 0) opts.profile = 1;
+        else if (strncmp(argv[i], "--profile=", 10) == 0) {
+            if (sscanf(argv[i] + 10, "%d:%d", &opts.profile_first, &opts.profile_last) != 2 || opts.profile_first < 0 || opts.profile_last < opts.profile_first) {
+                fprintf(stderr, "Bad --profile steps '%s', expected FIRST:LAST\n", argv[i] + 10);
+                return 1;
+            }
+            opts.profile = 1;
+        }
+        else if (strcmp(argv[i], "--cache-dir") == 0 && i + 1 < argc) cache_dir = argv[++i];
+        else if (strncmp(argv[i], "--cache-dir=", 12) == 0) cache_dir = argv[i] + 12;
+        else if (strcmp(argv[i], "--cache-size") == 0 && i + 1 < argc) cache_mb = strtoull(argv[++i], NULL, 10);
+        else if (strncmp(argv[i], "--cache-size=", 13) == 0) cache_mb = strtoull(argv[i] + 13, NULL, 10);
+        else if (strcmp(argv[i], "--cache-stats") == 0) cache_stats = 1;
+        else if (strcmp(argv[i], "--report=cost") == 0) report |= REPORT_COST;
+        else if (strcmp(argv[i], "--report=cost-json") == 0) report |= REPORT_COST_JSON;
+        else if (strcmp(argv[i], "--report=memory") == 0) report |= REPORT_MEMORY;
+        else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) serve_path = argv[++i];
+        else if (strcmp(argv[i], "--connect") == 0 && i + 1 < argc) connect_path = argv[++i];
+        else if (strcmp(argv[i], "--time-passes") == 0) stats_mode |= STATS_TIMES;
+        else if (strcmp(argv[i], "--stats") == 0) stats_mode |= STATS_TIMES | STATS_COUNTERS;
+        else if (strcmp(argv[i], "--stats=json") == 0) stats_mode |= STATS_TIMES | STATS_COUNTERS | STATS_JSON;
+        else if (argv[i][0] == '-' && argv[i][1] == '-') { fprintf(stderr, "Unknown option %s\n", argv[i]); usage(argv[0]); return 1; }
+        else inputs[n_in++] = argv[i];
+    }
+    if (serve_path) {
+        free(inputs);
+        return serve(serve_path, jobs, cache_mb * 1024 * 1024);
+    }
+    if (connect_path) {
+        if (n_in != 1) { usage(argv[0]); return 1; }
+        for (int i = 1; i < argc; i++) {
+            if (argv[i][0] == '-' && argv[i][1] == '-' && !forwardable(argv[i])) {
+                fprintf(stderr, "Error: --connect cannot forward %s; compile without --connect to use it\n", argv[i]);
+                free(inputs);
+                return 1;
+            }
+        }
+        int rc = client_compile(connect_path, inputs[0], &opts);
+        free(inputs);
+        return rc;
+    }
+    if (n_in == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    CompileCache cache, *cachep = NULL;
+    if (cache_dir) {
+        if (cache_open(&cache, cache_dir, cache_mb * 1024 * 1024) != 0) return 1;
+        cachep = &cache;
+    }
+
+    // single file: original behaviour, output at generated/model.py (model.c for --target=c)
+    if (n_in == 1 && jobs == 0 && !out_dir) {
+        char default_out[64];
+        snprintf(default_out, sizeof(default_out), "generated/model.%s", target_ext[opts.target]);
+        CompileContext ctx;
+        CompileStats stats;
+        memset(&stats, 0, sizeof(stats));
+        compile_ctx_init(&ctx, inputs[0], default_out);
+        ctx.opts = opts;
+        ctx.cache = cachep;
+        ctx.report = report;
+        if (stats_mode) ctx.stats = &stats;
+        int rc = compile_file(&ctx);
+        int outputs = ctx.outputs;
+        compile_ctx_free(&ctx);
+        if (stats_mode) stats_print(stderr, &stats, stats_mode);
+        free(inputs);
+        finish_cache(cachep, cache_stats);
+        if (rc != 0) return 1;
+        if (outputs > 1) printf("Done. Wrote %d files as generated/model_<name>.%s\n", outputs, target_ext[opts.target]);
+        else if (opts.target == TARGET_C) printf("Done. Build: cc -O3 -march=native -c %s\n", default_out);
+        else if (opts.target == TARGET_AST_BIN) printf("Done. Compile it like a source file: %s %s\n", argv[0], default_out);
+        else printf("Done. Run: python %s (needs tensorflow installed).\n", default_out);
+        return 0;
+    }
+
+    // batch: one context and one output file per input, compiled on a thread pool;
+    // threads the inputs leave idle go to the outputs inside each of them
+    if (!out_dir) out_dir = "generated";
+    if (make_dirs(out_dir) != 0) { free(inputs); finish_cache(cachep, 0); return 1; }
+    int threads = jobs > 0 ? jobs : tp_default_threads();
+    int net_jobs = n_in >= threads ? 1 : threads / n_in;
+    Job *js = (Job*)calloc((size_t)n_in, sizeof(Job));
+    for (int i = 0; i < n_in; i++) batch_out_path(out_dir, inputs[i], target_ext[opts.target], js[i].out, sizeof(js[i].out));
+    qsort(js, (size_t)n_in, sizeof(Job), cmp_out);
+    for (int i = 1; i < n_in; i++) {
+        if (strcmp(js[i].out, js[i-1].out) == 0) {
+            fprintf(stderr, "Error: two inputs map to the same output %s\n", js[i].out);
+            free(js); free(inputs);
+            finish_cache(cachep, 0);
+            return 1;
+        }
+    }
+    for (int i = 0; i < n_in; i++) batch_out_path(out_dir, inputs[i], target_ext[opts.target], js[i].out, sizeof(js[i].out));
+    for (int i = 0; i < n_in; i++) {
+        compile_ctx_init(&js[i].ctx, inputs[i], js[i].out);
+        js[i].ctx.opts = opts;
+        js[i].ctx.cache = cachep;
+        js[i].ctx.report = report;
+        js[i].ctx.jobs = net_jobs;
+        if (stats_mode) js[i].ctx.stats = &js[i].stats;
+    }
+
+    ThreadPool *tp = tp_create(threads);
+    for (int i = 0; i < n_in; i++) tp_submit(tp, run_job, &js[i]);
+    tp_destroy(tp);
+
+    int failed = 0;
+    CompileStats total;
+    memset(&total, 0, sizeof(total));
+    for (int i = 0; i < n_in; i++) {
+        if (js[i].rc != 0) failed++;
+        stats_add(&total, &js[i].stats);
+    }
+    if (stats_mode) stats_print(stderr, &total, stats_mode);
+    finish_cache(cachep, cache_stats);
+    printf("Done. Compiled %d/%d files into %s/\n", n_in - failed, n_in, out_dir);
+    free(js);
+    free(inputs);
+    return failed ? 1 : 0;
+}
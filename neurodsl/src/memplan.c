@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/memplan.h"
+
+static size_t align_to(size_t n, size_t a) { return (n + a - 1) / a * a; }
+
+static int root_of(const PlanTensor *t, int i) {
+    while (t[i].alias_of >= 0) i = t[i].alias_of;
+    return i;
+}
+
+// the sort key of one tensor, copied out so the comparator needs no shared
+// state (compiles run on several threads at once)
+typedef struct {
+    size_t bytes;
+    int first, index;
+} SizeKey;
+
+static int cmp_size_desc(const void *a, const void *b) {
+    const SizeKey *x = (const SizeKey*)a, *y = (const SizeKey*)b;
+    if (x->bytes != y->bytes) return x->bytes < y->bytes ? 1 : -1;
+    if (x->first != y->first) return x->first - y->first;
+    return x->index - y->index;
+}
+
+typedef struct { size_t lo, hi; } Range;
+static int cmp_range(const void *a, const void *b) {
+    size_t x = ((const Range*)a)->lo, y = ((const Range*)b)->lo;
+    return x < y ? -1 : x > y;
+}
+
+// Greedy by size: the largest tensors are placed first, each at the lowest
+// offset that does not collide with an already placed tensor whose lifetime
+// overlaps. Placed tensors are indexed by step, so a chain of n layers
+// plans in O(n log n).
+size_t memplan_solve(PlanTensor *t, int n, size_t align) {
+    int steps = 0;
+    for (int i = 0; i < n; i++) {
+        if (t[i].alias_of < 0) continue;
+        int r = root_of(t, i);
+        if (t[i].last > t[r].last) t[r].last = t[i].last;
+        if (t[i].first < t[r].first) t[r].first = t[i].first;
+    }
+    SizeKey *keys = (SizeKey*)malloc(sizeof(SizeKey) * (size_t)(n > 0 ? n : 1));
+    int *order = (int*)malloc(sizeof(int) * (size_t)(n > 0 ? n : 1));
+    int m = 0;
+    for (int i = 0; i < n; i++) {
+        if (t[i].last + 1 > steps) steps = t[i].last + 1;
+        if (t[i].alias_of < 0 && !t[i].external && t[i].bytes > 0) {
+            keys[m].bytes = t[i].bytes;
+            keys[m].first = t[i].first;
+            keys[m].index = i;
+            m++;
+        }
+    }
+    qsort(keys, (size_t)m, sizeof(SizeKey), cmp_size_desc);
+    for (int k = 0; k < m; k++) order[k] = keys[k].index;
+    free(keys);
+
+    // per-step lists of placed tensors
+    int *head = (int*)malloc(sizeof(int) * (size_t)(steps > 0 ? steps : 1));
+    for (int s = 0; s < steps; s++) head[s] = -1;
+    size_t pool_cap = 64, pool_n = 0;
+    int *node_t = (int*)malloc(sizeof(int) * pool_cap), *node_next = (int*)malloc(sizeof(int) * pool_cap);
+    int *seen = (int*)calloc((size_t)(n > 0 ? n : 1), sizeof(int));
+    size_t rcap = 64;
+    Range *rs = (Range*)malloc(sizeof(Range) * rcap);
+    size_t peak = 0;
+
+    for (int k = 0; k < m; k++) {
+        PlanTensor *x = &t[order[k]];
+        size_t size = align_to(x->bytes, align), nr = 0;
+        for (int s = x->first; s <= x->last; s++) {
+            for (int j = head[s]; j >= 0; j = node_next[j]) {
+                int o = node_t[j];
+                if (seen[o] == k + 1) continue;
+                seen[o] = k + 1;
+                if (nr == rcap) { rcap *= 2; rs = (Range*)realloc(rs, sizeof(Range) * rcap); }
+                rs[nr].lo = t[o].offset;
+                rs[nr].hi = t[o].offset + align_to(t[o].bytes, align);
+                nr++;
+            }
+        }
+        qsort(rs, nr, sizeof(Range), cmp_range);
+        size_t off = 0;
+        for (size_t j = 0; j < nr; j++) {
+            if (rs[j].lo >= off + size) break;
+            if (rs[j].hi > off) off = rs[j].hi;
+        }
+        x->offset = off;
+        if (off + size > peak) peak = off + size;
+        for (int s = x->first; s <= x->last; s++) {
+            if (pool_n == pool_cap) {
+                pool_cap *= 2;
+                node_t = (int*)realloc(node_t, sizeof(int) * pool_cap);
+                node_next = (int*)realloc(node_next, sizeof(int) * pool_cap);
+            }
+            node_t[pool_n] = order[k];
+            node_next[pool_n] = head[s];
+            head[s] = (int)pool_n++;
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        int r = root_of(t, i);
+        if (t[r].external) t[i].offset = MEMPLAN_EXTERNAL;
+        else if (r != i) t[i].offset = t[r].offset;
+        else if (t[i].bytes == 0) t[i].offset = 0;
+    }
+    free(order); free(head); free(node_t); free(node_next); free(seen); free(rs);
+    return peak;
+}
+
+int plan_model(Arena *a, const ModelAST *m, const ModelCost *c, const size_t *workspace, const FusedModel *fm, MemPlan *out) {
+    int n = m->n_layers, nt = n;
+    for (int i = 0; workspace && i < n; i++) if (workspace[i]) nt++;
+    PlanTensor *t = (PlanTensor*)calloc((size_t)(nt > 0 ? nt : 1), sizeof(PlanTensor));
+    if (!t) return 1;
+
+    // tensor i is the output of layer i, read by layer i + 1
+    int first = n > 0 && m->layers[0].type == LAYER_INPUT ? 1 : 0;
+    for (int i = 0; i < n; i++) {
+        PlanTensor *x = &t[i];
+        x->bytes = (size_t)c->layers[i].act_bytes;
+        x->first = i;
+        x->last = i == n - 1 ? i : i + 1;
+        x->alias_of = -1;
+        if (i < first || i == n - 1) x->external = 1;
+        else if (m->layers[i].type == LAYER_FLATTEN) {
+            if (i > 0) x->alias_of = i - 1;
+            else x->external = 1;       // view of x
+        }
+    }
+    // a fused op runs as one step: its output and workspace are live from
+    // its first layer on, and the tensors inside it take no memory
+    out->fused = 0;
+    for (int k = 0; fm && k < fm->n; k++) {
+        const FusedOp *op = &fm->ops[k];
+        if (op->first == op->last) continue;
+        t[op->last].first = op->first;
+        if (op->kind != FOP_CONV_POOL) continue;
+        for (int i = op->first; i < op->last; i++) {
+            out->fused += t[i].bytes;
+            t[i].bytes = 0;
+            t[i].external = 1;
+        }
+    }
+    int w = n;
+    for (int i = 0; workspace && i < n; i++) {
+        if (!workspace[i]) continue;
+        t[w].bytes = workspace[i];
+        t[w].first = t[w].last = i;
+        t[w].alias_of = -1;
+        w++;
+    }
+
+    out->peak = memplan_solve(t, nt, MEMPLAN_ALIGN);
+    out->naive = 0;
+    for (int i = 0; i < nt; i++)
+        if (t[i].alias_of < 0 && !t[i].external) out->naive += align_to(t[i].bytes, MEMPLAN_ALIGN);
+    out->offset = (size_t*)arena_alloc(a, sizeof(size_t) * (size_t)(n > 0 ? n : 1));
+    out->ws_offset = (size_t*)arena_alloc(a, sizeof(size_t) * (size_t)(n > 0 ? n : 1));
+    for (int i = 0; i < n; i++) out->offset[i] = t[i].offset;
+    for (int k = 0; fm && k < fm->n; k++)
+        if (fm->ops[k].kind == FOP_CONV_POOL)
+            for (int i = fm->ops[k].first; i < fm->ops[k].last; i++) out->offset[i] = MEMPLAN_FUSED;
+    w = n;
+    for (int i = 0; workspace && i < n; i++) if (workspace[i]) out->ws_offset[i] = t[w++].offset;
+    free(t);
+    return 0;
+}
+
+void memplan_print(FILE *f, const ModelAST *m, const ModelCost *c, const MemPlan *p) {
+    fprintf(f, "Memory plan for network %s (offsets in one %d-byte aligned scratch block)\n", m->name, MEMPLAN_ALIGN);
+    fprintf(f, "%-5s %-10s %12s %12s  %s\n", "#", "layer", "bytes", "offset", "note");
+    for (int i = 0; i < m->n_layers; i++) {
+        const char *note = "";
+        char off[32];
+        if (p->offset[i] == MEMPLAN_EXTERNAL) {
+            snprintf(off, sizeof(off), "-");
+            note = i == m->n_layers - 1 ? "caller's output" : "caller's input";
+        } else if (p->offset[i] == MEMPLAN_FUSED) {
+            snprintf(off, sizeof(off), "-");
+            note = "fused into the next layer, never stored";
+        } else {
+            snprintf(off, sizeof(off), "%zu", p->offset[i]);
+        }
+        if (m->layers[i].type == LAYER_FLATTEN && i != m->n_layers - 1) note = "view of previous layer";
+        fprintf(f, "%-5d %-10s %12lld %12s  %s\n", i, layer_type_name(m->layers[i].type), c->layers[i].act_bytes, off, note);
+    }
+    double saved = p->naive ? 100.0 * (1.0 - (double)p->peak / (double)p->naive) : 0.0;
+    fprintf(f, "planned peak: %zu bytes, naive sum of activations: %zu bytes (%.1f%% saved)\n", p->peak, p->naive, saved);
+    if (p->fused)
+        fprintf(f, "fusion: %zu activation bytes never stored, %zu fewer bytes written and read per inference\n", p->fused, 2 * p->fused);
+}
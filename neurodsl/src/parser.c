@@ -1,221 +1,499 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include "lexer.h"
-#include "../include/ast.h"
-#include "../include/parser.h"
-
-// helper prototypes
-static int expect(TokenType t, Token *out);
-static int accept(TokenType t, Token *out);
-
-// AST helpers
-Layer *layer_new() {
-    Layer *l = (Layer*)calloc(1, sizeof(Layer));
-    l->next = NULL;
-    l->i_ch = l->i_h = l->i_w = l->filters = l->kernel = l->pool_size = l->units = 0;
-    l->activation[0] = '\0';
-    return l;
-}
-void layer_free_all(Layer *head) {
-    Layer *p = head;
-    while (p) { Layer *n = p->next; free(p); p = n; }
-}
-void model_free(ModelAST *m) {
-    if (!m) return;
-    layer_free_all(m->layers);
-    free(m);
-}
-
-// accept/expect implementations
-static int accept(TokenType t, Token *out) {
-    Token la = lexer_peek();
-    if (la.type == t) {
-        Token got = lexer_next();
-        if (out) *out = got;
-        return 1;
-    }
-    return 0;
-}
-static int expect(TokenType t, Token *out) {
-    if (accept(t,out)) return 1;
-    Token la = lexer_peek();
-    fprintf(stderr,"Parse error: expected token type %d but got '%s'\n", t, la.text);
-    return 0;
-}
-
-// Parsing functions
-int parse_program(ProgramAST *prog) {
-    Token t;
-    // network <id> { layers... }
-    if (!accept(TOK_NETWORK, &t)) {
-        fprintf(stderr, "Error: expected 'network' at start\n"); return 1;
-    }
-    Token idtok;
-    if (!accept(TOK_IDENTIFIER, &idtok)) { fprintf(stderr,"Error: expected network name\n"); return 2; }
-    ModelAST *model = (ModelAST*)calloc(1,sizeof(ModelAST));
-    strncpy(model->name, idtok.text, sizeof(model->name)-1);
-    model->layers = NULL;
-    if (!accept(TOK_LBRACE, &t)) { fprintf(stderr,"Error: expected '{' after model name\n"); free(model); return 3; }
-
-    Layer *last = NULL;
-    // parse layers until RBRACE
-    while (1) {
-        Token la = lexer_peek();
-        if (la.type == TOK_RBRACE) { lexer_next(); break; }
-        if (la.type == TOK_EOF) { fprintf(stderr,"Unexpected EOF in model\n"); free(model); return 4; }
-
-        // input
-        if (la.type == TOK_INPUT) {
-            lexer_next(); // consume input
-            if (!accept(TOK_LPAREN, &t)) { fprintf(stderr,"Error: expected '(' after input\n"); free(model); return 5; }
-            Token n1,n2,n3;
-            if (!accept(TOK_NUMBER, &n1)) { fprintf(stderr,"Error: input needs numbers\n"); free(model); return 6; }
-            accept(TOK_COMMA, NULL);
-            if (!accept(TOK_NUMBER, &n2)) { fprintf(stderr,"Error: input needs 3 numbers\n"); free(model); return 7; }
-            accept(TOK_COMMA, NULL);
-            if (!accept(TOK_NUMBER, &n3)) { fprintf(stderr,"Error: input needs 3 numbers\n"); free(model); return 8; }
-            accept(TOK_RPAREN, NULL);
-            Layer *L = layer_new();
-            L->type = LAYER_INPUT;
-            L->i_ch = atoi(n1.text);
-            L->i_h  = atoi(n2.text);
-            L->i_w  = atoi(n3.text);
-            if (!last) model->layers = L; else last->next = L;
-            last = L;
-            continue;
-        }
-
-        // conv2d
-        if (la.type == TOK_CONV2D) {
-            lexer_next();
-            Layer *L = layer_new();
-            L->type = LAYER_CONV2D;
-            while (1) {
-                Token nxt = lexer_peek();
-                if (nxt.type == TOK_IDENTIFIER) {
-                    Token id = lexer_next();
-                    if (accept(TOK_EQUALS, NULL)) {
-                        Token val = lexer_next();
-                        if (val.type == TOK_NUMBER) {
-                            if (strcmp(id.text,"filters")==0) L->filters = atoi(val.text);
-                            else if (strcmp(id.text,"kernel")==0) L->kernel = atoi(val.text);
-                            else if (strcmp(id.text,"size")==0) L->pool_size = atoi(val.text);
-                            else if (strcmp(id.text,"units")==0) L->units = atoi(val.text);
-                        } else if (val.type == TOK_IDENTIFIER) {
-                            if (strcmp(id.text,"activation")==0) strncpy(L->activation, val.text, sizeof(L->activation)-1);
-                        }
-                        accept(TOK_COMMA, NULL);
-                        continue;
-                    } else {
-                        continue;
-                    }
-                }
-                break;
-            }
-            if (!last) model->layers = L; else last->next = L; last = L; continue;
-        }
-
-        // maxpool2d
-        if (la.type == TOK_MAXPOOL2D) {
-            lexer_next();
-            Layer *L = layer_new(); L->type = LAYER_MAXPOOL2D;
-            if (accept(TOK_IDENTIFIER, NULL) && accept(TOK_EQUALS, NULL)) {
-                Token v = lexer_next();
-                if (v.type == TOK_NUMBER) L->pool_size = atoi(v.text);
-            } else {
-                L->pool_size = 2;
-            }
-            if (!last) model->layers = L; else last->next = L; last = L; continue;
-        }
-
-        // flatten
-        if (la.type == TOK_FLATTEN) {
-            lexer_next();
-            Layer *L = layer_new(); L->type = LAYER_FLATTEN;
-            if (!last) model->layers = L; else last->next = L; last = L; continue;
-        }
-
-        // dense
-        if (la.type == TOK_DENSE) {
-            lexer_next();
-            Layer *L = layer_new(); L->type = LAYER_DENSE;
-            while (1) {
-                Token nxt = lexer_peek();
-                if (nxt.type == TOK_IDENTIFIER) {
-                    Token id = lexer_next();
-                    if (accept(TOK_EQUALS,NULL)) {
-                        Token val = lexer_next();
-                        if (val.type == TOK_NUMBER && strcmp(id.text,"units")==0) L->units = atoi(val.text);
-                        else if (val.type == TOK_IDENTIFIER && strcmp(id.text,"activation")==0) strncpy(L->activation, val.text, sizeof(L->activation)-1);
-                        accept(TOK_COMMA,NULL);
-                        continue;
-                    } else {
-                        continue;
-                    }
-                }
-                break;
-            }
-            if (!last) model->layers = L; else last->next = L; last = L; continue;
-        }
-
-        // output
-        if (la.type == TOK_OUTPUT) {
-            lexer_next();
-            Layer *L = layer_new(); L->type = LAYER_OUTPUT;
-            while (1) {
-                Token nxt = lexer_peek();
-                if (nxt.type == TOK_IDENTIFIER) {
-                    Token id = lexer_next();
-                    if (accept(TOK_EQUALS,NULL)) {
-                        Token val = lexer_next();
-                        if (val.type == TOK_NUMBER && strcmp(id.text,"units")==0) L->units = atoi(val.text);
-                        else if (val.type == TOK_IDENTIFIER && strcmp(id.text,"activation")==0) strncpy(L->activation, val.text, sizeof(L->activation)-1);
-                        accept(TOK_COMMA,NULL);
-                        continue;
-                    }
-                }
-                break;
-            }
-            if (!last) model->layers = L; else last->next = L; last = L; continue;
-        }
-
-        // unknown - warn and skip
-        fprintf(stderr, "Warning: unexpected token '%s' in model\n", la.text);
-        lexer_next();
-    } // end layers parse
-
-    // parse optional train block
-    Token p = lexer_peek();
-    TrainAST train;
-    train.optimizer[0]=0; train.loss[0]=0; train.epochs = 1; train.dataset[0]=0;
-    if (p.type == TOK_TRAIN) {
-        lexer_next();
-        if (!accept(TOK_LBRACE,NULL)) { fprintf(stderr,"Expected '{' after train\n"); }
-        // parse until }
-        while (1) {
-            Token nx = lexer_peek();
-            if (nx.type == TOK_RBRACE) { lexer_next(); break; }
-            if (nx.type == TOK_IDENTIFIER) {
-                Token id = lexer_next();
-                // accept either colon or equals after identifier
-                if (accept(TOK_COLON,NULL) || accept(TOK_EQUALS,NULL)) {
-                    Token v = lexer_next();
-                    if (strcmp(id.text,"optimizer")==0 && v.type==TOK_IDENTIFIER) strncpy(train.optimizer, v.text, sizeof(train.optimizer)-1);
-                    else if (strcmp(id.text,"loss")==0 && v.type==TOK_IDENTIFIER) strncpy(train.loss, v.text, sizeof(train.loss)-1);
-                    else if (strcmp(id.text,"epochs")==0 && v.type==TOK_NUMBER) train.epochs = atoi(v.text);
-                    else if (strcmp(id.text,"dataset")==0 && v.type==TOK_IDENTIFIER) strncpy(train.dataset, v.text, sizeof(train.dataset)-1);
-                    accept(TOK_COMMA,NULL);
-                    continue;
-                }
-            } else {
-                // skip token
-                lexer_next();
-            }
-        }
-    }
-
-    prog->model = model;
-    prog->train = train;
-    return 0;
-}
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lexer.h"
+#include "../include/ast.h"
+#include "../include/grammar.h"
+#include "../include/analysis.h"
+#include "../include/parser.h"
+#include "../include/sweep.h"
+
+// Table-driven LL(1) parser. The grammar lives in grammar/neurodsl.g and
+// tools/llgen turns it into the tables in grammar.c; this file only walks
+// them with an explicit stack and runs the @actions that build the AST.
+
+#define PARSE_STACK_MAX 256
+
+// one value of a parameter: a token, or the range lo..hi when range is set
+typedef struct {
+    Token tok;
+    int range, lo, hi;
+} ValueItem;
+
+typedef struct {
+    int net;
+    SweepAxis axis;
+} PendingAxis;
+
+typedef struct {
+    CompileContext *ctx;
+    LexerState *lx;
+    FILE *diag;         // NULL when only recognizing
+    int build;          // run the @actions
+    int failed;         // an action found an error
+    NetworkAST *nets;   // malloc'd while parsing, moved into the arena at the end
+    int n_nets, cap_nets;
+    Interner names;     // network names, to catch duplicates
+    ModelAST *model;    // network under construction
+    TrainAST *train;    // train block under construction
+    int train_net;      // the network it configures
+    ValueItem *items;   // values written for the current parameter
+    int n_items, cap_items;
+    PendingAxis *axes;  // sweeps, grouped by network at the end
+    int n_axes, cap_axes;
+    int named;          // the train block has a name (in train_name)
+    Token train_name;
+    Token last;         // most recently matched terminal
+    Token name;         // parameter name seen by @param_name
+    int layer;          // index of the layer under construction
+    int dim;            // next input dimension
+    size_t line_pos;    // source lines are counted up to here
+    int line;           // the line at line_pos
+    const Token *toks;  // token mode: walk these instead of lexing (parse_tokens, parse_layers)
+    int n_toks, tok_i;
+} ParseState;
+
+static void report(ParseState *ps, const char *fmt, ...) {
+    if (!ps->diag) return;
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(ps->diag, fmt, ap);
+    va_end(ap);
+}
+
+// 1-based line of t. Actions see tokens in source order, so the count
+// only ever moves forward.
+static int token_line(ParseState *ps, const Token *t) {
+    const char *s = ps->lx->src;
+    while (ps->line_pos < t->offset) {
+        const char *nl = (const char*)memchr(s + ps->line_pos, '\n', t->offset - ps->line_pos);
+        if (!nl) { ps->line_pos = t->offset; break; }
+        ps->line++;
+        ps->line_pos = (size_t)(nl - s) + 1;
+    }
+    return ps->line;
+}
+
+// The lookahead and consuming it. In token mode a closing brace stands in
+// past the last token, so a run of layer statements ends like a network body.
+static inline Token la_peek(ParseState *ps) {
+    if (!ps->toks) return lexer_peek(ps->lx);
+    if (ps->tok_i < ps->n_toks) return ps->toks[ps->tok_i];
+    Token t = { TOK_RBRACE, ps->n_toks ? ps->toks[ps->n_toks - 1].offset + ps->toks[ps->n_toks - 1].len : 0, 0, 0 };
+    return t;
+}
+
+static inline void la_next(ParseState *ps) {
+    if (ps->toks) ps->tok_i++;
+    else lexer_next(ps->lx);
+}
+
+static LayerType layer_for_token(TokenType t) {
+    switch (t) {
+        case TOK_CONV2D: return LAYER_CONV2D;
+        case TOK_MAXPOOL2D: return LAYER_MAXPOOL2D;
+        case TOK_FLATTEN: return LAYER_FLATTEN;
+        case TOK_DENSE: return LAYER_DENSE;
+        default: return LAYER_OUTPUT;
+    }
+}
+
+static void ignored_param(ParseState *ps, const char *where, const Token *v, int num) {
+    if (v) report(ps, "Warning: ignoring '" TOK_FMT "=" TOK_FMT "' in %s\n", TOK_ARG(ps->lx, ps->name), TOK_ARG(ps->lx, *v), where);
+    else report(ps, "Warning: ignoring '" TOK_FMT "=%d' in %s\n", TOK_ARG(ps->lx, ps->name), num, where);
+}
+
+// Turns one value of the current parameter into what layer L stores: v is
+// an identifier token, or NULL for the number num. -1 when L has no such
+// parameter or it does not take that kind of value.
+static int layer_value(ParseState *ps, const Layer *L, const Token *v, int num, ParamValue *out) {
+    out->num = num;
+    out->str = NULL;
+    switch (ps->name.param) {
+        case PARAM_FILTERS:
+        case PARAM_KERNEL: return L->type == LAYER_CONV2D && !v ? 0 : -1;
+        case PARAM_SIZE: return L->type == LAYER_MAXPOOL2D && !v ? 0 : -1;
+        case PARAM_UNITS: return (L->type == LAYER_DENSE || L->type == LAYER_OUTPUT) && !v ? 0 : -1;
+        case PARAM_ACTIVATION:
+            if (L->type == LAYER_MAXPOOL2D || !v) return -1;
+            out->str = intern(&ps->ctx->strings, &ps->ctx->arena, lexer_text(ps->lx, v), v->len);
+            return 0;
+    }
+    return -1;
+}
+
+// true/false or 1/0; -1 for anything else
+static int token_bool(const LexerState *lx, const Token *v) {
+    if (v->type == TOK_NUMBER) return token_int(lx, v) != 0;
+    if (token_is(lx, v, "true")) return 1;
+    if (token_is(lx, v, "false")) return 0;
+    return -1;
+}
+
+// the same for train options
+static int train_value(ParseState *ps, const Token *v, int num, ParamValue *out) {
+    out->num = num;
+    out->str = v ? intern(&ps->ctx->strings, &ps->ctx->arena, lexer_text(ps->lx, v), v->len) : NULL;
+    int b = v ? token_bool(ps->lx, v) : num != 0;
+    switch (ps->name.param) {
+        case PARAM_OPTIMIZER:
+        case PARAM_LOSS:
+        case PARAM_DATASET: return v ? 0 : -1;
+        case PARAM_EPOCHS:
+        case PARAM_BATCH_SIZE:
+        case PARAM_SHUFFLE_BUFFER: return v ? -1 : 0;
+        case PARAM_PREFETCH:
+            if (!v) { out->num = num ? num : TRAIN_PREFETCH_NONE; return 0; }
+            if (token_is(ps->lx, v, "auto")) { out->num = TRAIN_PREFETCH_AUTO; return 0; }
+            break;
+        case PARAM_CACHE:
+        case PARAM_JIT_COMPILE: if (b >= 0) { out->num = b; return 0; } break;
+        case PARAM_MIXED_PRECISION:
+            if (b >= 0) { out->num = b ? PRECISION_MIXED_FLOAT16 : PRECISION_FLOAT32; return 0; }
+            if (token_is(ps->lx, v, "float16")) { out->num = PRECISION_MIXED_FLOAT16; return 0; }
+            if (token_is(ps->lx, v, "bfloat16")) { out->num = PRECISION_MIXED_BFLOAT16; return 0; }
+            break;
+    }
+    return -1;
+}
+
+static void drop_axis(ParseState *ps, int net, int layer, int param) {
+    for (int i = 0; i < ps->n_axes; i++) {
+        PendingAxis *p = &ps->axes[i];
+        if (p->net == net && p->axis.layer == layer && p->axis.param == param) {
+            memmove(p, p + 1, (size_t)(ps->n_axes - i - 1) * sizeof(PendingAxis));
+            ps->n_axes--;
+            return;
+        }
+    }
+}
+
+// Assigns the values collected for the current parameter to a layer
+// (layer >= 0) or to the train options. The first accepted value goes into
+// the AST; with more than one the parameter becomes a sweep axis, replacing
+// any earlier axis for the same parameter.
+static void assign_param(ParseState *ps, int layer) {
+    Layer *L = layer >= 0 ? &ps->model->layers[layer] : NULL;
+    const char *where = L ? layer_type_name(L->type) : "train";
+    int net = L ? ps->n_nets - 1 : ps->train_net;
+    long long total = 0;
+    for (int i = 0; i < ps->n_items; i++) total += ps->items[i].range ? (long long)ps->items[i].hi - ps->items[i].lo + 1 : 1;
+    if (total == 0) {
+        report(ps, "Warning: ignoring '" TOK_FMT "=[]' in %s\n", TOK_ARG(ps->lx, ps->name), where);
+        return;
+    }
+    if (total > SWEEP_MAX_VALUES) {
+        report(ps, "Parse error: '" TOK_FMT "' takes %lld values, more than %d\n", TOK_ARG(ps->lx, ps->name), total, SWEEP_MAX_VALUES);
+        ps->failed = 1;
+        return;
+    }
+    ParamValue one, *vals = &one;
+    if (total > 1) vals = (ParamValue*)arena_alloc(&ps->ctx->arena, (size_t)total * sizeof(ParamValue));
+    if (!vals) { ps->failed = 1; return; }
+    int n = 0;
+    for (int i = 0; i < ps->n_items; i++) {
+        const ValueItem *it = &ps->items[i];
+        int lo = it->range ? it->lo : 0, hi = it->range ? it->hi : 0;
+        // long long: hi may be INT_MAX
+        for (long long k = lo; k <= hi; k++) {
+            const Token *v = !it->range && it->tok.type != TOK_NUMBER ? &it->tok : NULL;
+            int num = it->range ? (int)k : v ? 0 : token_int(ps->lx, &it->tok);
+            int ok = L ? layer_value(ps, L, v, num, &vals[n]) : train_value(ps, v, num, &vals[n]);
+            if (ok == 0) n++;
+            else ignored_param(ps, where, it->range ? NULL : &it->tok, num);
+        }
+    }
+    if (n == 0) return;
+    drop_axis(ps, net, layer, ps->name.param);
+    if (L) layer_set_param(L, ps->name.param, &vals[0]);
+    else train_set_param(ps->train, ps->name.param, &vals[0]);
+    if (n == 1) return;
+    if (ps->n_axes == ps->cap_axes) {
+        ps->cap_axes = ps->cap_axes ? ps->cap_axes * 2 : 8;
+        ps->axes = (PendingAxis*)realloc(ps->axes, (size_t)ps->cap_axes * sizeof(PendingAxis));
+    }
+    PendingAxis *p = &ps->axes[ps->n_axes++];
+    p->net = net;
+    p->axis.layer = layer;
+    p->axis.param = ps->name.param;
+    p->axis.values = vals;
+    p->axis.n = n;
+}
+
+// a number token's value; numbers that do not fit an int fail the parse
+static int number(ParseState *ps, const Token *t) {
+    int v = token_int(ps->lx, t);
+    if (v < 0) {
+        report(ps, "Parse error: number out of range: " TOK_FMT "\n", TOK_ARG(ps->lx, *t));
+        ps->failed = 1;
+    }
+    return v;
+}
+
+static void value_item(ParseState *ps) {
+    if (ps->n_items == ps->cap_items) {
+        ps->cap_items = ps->cap_items ? ps->cap_items * 2 : 8;
+        ps->items = (ValueItem*)realloc(ps->items, (size_t)ps->cap_items * sizeof(ValueItem));
+    }
+    ValueItem *it = &ps->items[ps->n_items++];
+    memset(it, 0, sizeof(*it));
+    it->tok = ps->last;
+    if (it->tok.type == TOK_NUMBER) number(ps, &it->tok);
+}
+
+// lo..hi; the low bound is the item just added
+static void value_range(ParseState *ps) {
+    ValueItem *it = &ps->items[ps->n_items - 1];
+    it->lo = token_int(ps->lx, &it->tok);
+    it->hi = number(ps, &ps->last);
+    if (ps->failed) return;
+    it->range = 1;
+    if (it->hi < it->lo) {
+        report(ps, "Parse error: empty range %d..%d\n", it->lo, it->hi);
+        ps->failed = 1;
+    } else if ((long long)it->hi - it->lo + 1 > SWEEP_MAX_VALUES) {
+        report(ps, "Parse error: range %d..%d has more than %d values\n", it->lo, it->hi, SWEEP_MAX_VALUES);
+        ps->failed = 1;
+    }
+}
+
+static void model_begin(ParseState *ps) {
+    Arena *arena = &ps->ctx->arena;
+    const char *name = lexer_text(ps->lx, &ps->last);
+    size_t before = ps->names.count;
+    intern(&ps->names, arena, name, ps->last.len);
+    if (ps->names.count == before) {
+        report(ps, "Parse error: network '" TOK_FMT "' is defined twice\n", TOK_ARG(ps->lx, ps->last));
+        ps->failed = 1;
+        return;
+    }
+    if (ps->n_nets == ps->cap_nets) {
+        ps->cap_nets = ps->cap_nets ? ps->cap_nets * 2 : 8;
+        ps->nets = (NetworkAST*)realloc(ps->nets, (size_t)ps->cap_nets * sizeof(NetworkAST));
+    }
+    NetworkAST *n = &ps->nets[ps->n_nets++];
+    memset(n, 0, sizeof(*n));
+    n->model = ps->model = model_new(arena, name, ps->last.len);
+    if (!n->model) { ps->n_nets--; ps->failed = 1; return; }
+    n->train.epochs = 1;
+}
+
+// a named train block configures that network, an unnamed one the network before it
+static void train_begin(ParseState *ps) {
+    int i = ps->n_nets - 1;
+    if (ps->named) {
+        const Token *t = &ps->train_name;
+        while (i >= 0 && !(strlen(ps->nets[i].model->name) == t->len &&
+                           memcmp(ps->nets[i].model->name, lexer_text(ps->lx, t), t->len) == 0)) i--;
+        if (i < 0) report(ps, "Parse error: train block for unknown network '" TOK_FMT "'\n", TOK_ARG(ps->lx, *t));
+    } else if (i < 0) {
+        report(ps, "Parse error: train block before any network\n");
+    }
+    ps->named = 0;
+    if (i < 0) { ps->failed = 1; return; }
+    ps->train = &ps->nets[i].train;
+    ps->train_net = i;
+}
+
+static void run_action(ParseState *ps, Action a) {
+    Arena *arena = &ps->ctx->arena;
+    switch (a) {
+        case ACT_MODEL_BEGIN: model_begin(ps); break;
+        case ACT_TRAIN_NAME: ps->train_name = ps->last; ps->named = 1; break;
+        case ACT_TRAIN_BEGIN: train_begin(ps); break;
+        case ACT_INPUT_BEGIN:
+            if (!model_add_layer(ps->model, arena, LAYER_INPUT)) { ps->failed = 1; break; }
+            ps->layer = ps->model->n_layers - 1;
+            ps->model->layers[ps->layer].line = token_line(ps, &ps->last);
+            ps->dim = 0;
+            break;
+        case ACT_INPUT_DIM: {
+            Layer *L = &ps->model->layers[ps->layer];
+            int v = number(ps, &ps->last);
+            if (ps->dim == 0) L->p.input.ch = v;
+            else if (ps->dim == 1) L->p.input.h = v;
+            else L->p.input.w = v;
+            ps->dim++;
+            break;
+        }
+        case ACT_LAYER_BEGIN:
+            if (!model_add_layer(ps->model, arena, layer_for_token(ps->last.type))) { ps->failed = 1; break; }
+            ps->layer = ps->model->n_layers - 1;
+            ps->model->layers[ps->layer].line = token_line(ps, &ps->last);
+            break;
+        case ACT_PARAM_NAME: ps->name = ps->last; ps->n_items = 0; break;
+        case ACT_VALUE_ITEM: value_item(ps); break;
+        case ACT_VALUE_RANGE: value_range(ps); break;
+        case ACT_LAYER_PARAM: assign_param(ps, ps->layer); break;
+        case ACT_TRAIN_PARAM: assign_param(ps, -1); break;
+        default: break;
+    }
+}
+
+static int ll_walk(ParseState *ps, unsigned start) {
+    LexerState *lx = ps->lx;
+    unsigned short stack[PARSE_STACK_MAX];
+    int sp = 0;
+    stack[sp++] = (unsigned short)start;
+    Token la = la_peek(ps);
+    while (sp > 0) {
+        unsigned sym = stack[--sp];
+        if (sym < TOK_COUNT) {
+            if (la.type != sym) {
+                report(ps, "Parse error: expected %s but got '" TOK_FMT "'\n", token_type_name((TokenType)sym), TOK_ARG(lx, la));
+                return 1;
+            }
+            ps->last = la;
+            la_next(ps);
+            la = la_peek(ps);
+            continue;
+        }
+        if (sym >= LL_ACT(0)) {
+            if (ps->build) {
+                run_action(ps, (Action)(sym - LL_ACT(0)));
+                if (ps->failed) return 1;
+            }
+            continue;
+        }
+
+        int nt = (int)sym - LL_NT(0);
+        int p = ll_table[nt][la.type];
+        if (!p) {
+            if (ll_recover[nt] && la.type != TOK_EOF) {
+                report(ps, "Warning: unexpected token '" TOK_FMT "' in %s\n", TOK_ARG(lx, la), ll_nt_name[nt]);
+                la_next(ps);
+                la = la_peek(ps);
+                sp++;
+                continue;
+            }
+            // a nullable nonterminal steps aside and lets the enclosing rule report the error
+            p = ll_default[nt];
+            if (!p) {
+                report(ps, "Parse error: unexpected '" TOK_FMT "' in %s\n", TOK_ARG(lx, la), ll_nt_name[nt]);
+                return 1;
+            }
+        }
+        const unsigned short *rhs = &ll_rhs[ll_rhs_start[p - 1]], *end = &ll_rhs[ll_rhs_start[p]];
+        if (sp + (end - rhs) > PARSE_STACK_MAX) { report(ps, "Parse error: nesting too deep\n"); return 1; }
+        while (rhs < end) stack[sp++] = *rhs++;
+    }
+    return 0;
+}
+
+static void build_init(ParseState *ps, CompileContext *ctx) {
+    memset(ps, 0, sizeof(*ps));
+    ps->ctx = ctx;
+    ps->lx = &ctx->lex;
+    ps->diag = ctx->diag;
+    ps->build = 1;
+    ps->line = 1;
+}
+
+static void build_free(ParseState *ps) {
+    free(ps->nets);
+    free(ps->items);
+    free(ps->axes);
+    interner_free(&ps->names);
+}
+
+// the program a build walk left in ps, once the walk returned rc
+// the variant of sweep n that would be called name, or -1; names are
+// <network>_<v> with v zero-padded, see sweep_name
+static long long variant_named(const NetworkAST *n, const char *name) {
+    size_t len = strlen(n->model->name), digits = strlen(name) - len - 1;
+    if (strlen(name) <= len + 1 || digits > 18 || memcmp(name, n->model->name, len) != 0 || name[len] != '_') return -1;
+    if (strspn(name + len + 1, "0123456789") != digits) return -1;
+    long long v = strtoll(name + len + 1, NULL, 10);
+    char buf[512];
+    if (v >= sweep_count(n)) return -1;
+    sweep_name(n, v, buf, sizeof(buf));
+    return strcmp(buf, name) == 0 ? v : -1;
+}
+
+static int program_finish(ParseState *ps, ProgramAST *prog, int rc) {
+    CompileContext *ctx = ps->ctx;
+    if (rc == 0) {
+        prog->nets = (NetworkAST*)arena_alloc(&ctx->arena, (size_t)ps->n_nets * sizeof(NetworkAST));
+        prog->n_nets = ps->n_nets;
+        if (prog->nets) memcpy(prog->nets, ps->nets, (size_t)ps->n_nets * sizeof(NetworkAST));
+        else rc = 1;
+    }
+    // each network's axes in source order
+    for (int i = 0; rc == 0 && i < ps->n_axes; i++) prog->nets[ps->axes[i].net].n_axes++;
+    for (int k = 0; rc == 0 && k < prog->n_nets; k++) {
+        NetworkAST *n = &prog->nets[k];
+        if (!n->n_axes) continue;
+        n->axes = (SweepAxis*)arena_alloc(&ctx->arena, (size_t)n->n_axes * sizeof(SweepAxis));
+        if (!n->axes) { rc = 1; break; }
+        long long variants = 1;
+        int j = 0;
+        for (int i = 0; i < ps->n_axes; i++) {
+            if (ps->axes[i].net != k) continue;
+            n->axes[j++] = ps->axes[i].axis;
+            variants *= ps->axes[i].axis.n;
+            if (variants > SWEEP_MAX_VARIANTS) break;
+        }
+        if (variants > SWEEP_MAX_VARIANTS) {
+            report(ps, "Parse error: network %s sweeps more than %d variants\n", n->model->name, SWEEP_MAX_VARIANTS);
+            rc = 1;
+        }
+    }
+    // a variant named like another network would write that network's files
+    for (int k = 0; rc == 0 && k < prog->n_nets; k++) {
+        const NetworkAST *n = &prog->nets[k];
+        for (int i = 0; n->n_axes && i < prog->n_nets; i++) {
+            long long v = variant_named(n, prog->nets[i].model->name);
+            if (v < 0) continue;
+            report(ps, "Parse error: variant %lld of network %s has the same name as network %s\n", v, n->model->name, prog->nets[i].model->name);
+            rc = 1;
+            break;
+        }
+    }
+    build_free(ps);
+    return rc;
+}
+
+int parse_program(CompileContext *ctx, ProgramAST *prog) {
+    ParseState ps;
+    build_init(&ps, ctx);
+    return program_finish(&ps, prog, ll_walk(&ps, LL_START));
+}
+
+int parse_tokens(CompileContext *ctx, const Token *toks, int n, ProgramAST *prog) {
+    ParseState ps;
+    build_init(&ps, ctx);
+    ps.toks = toks;
+    ps.n_toks = n;
+    return program_finish(&ps, prog, ll_walk(&ps, LL_START));
+}
+
+// A silent recognizing walk first, so a slice that is not a run of whole
+// statements reports nothing. Values can only become sweep axes through
+// '[' or '..', which the caller keeps out of the slice.
+int parse_layers(CompileContext *ctx, const Token *toks, int n, ModelAST *model, size_t line_pos, int line) {
+    ParseState ps;
+    memset(&ps, 0, sizeof(ps));
+    ps.ctx = ctx;
+    ps.lx = &ctx->lex;
+    ps.toks = toks;
+    ps.n_toks = n;
+    if (ll_walk(&ps, LL_NT(NT_LAYERS)) != 0 || ps.tok_i != n) return 1;
+    build_init(&ps, ctx);
+    ps.toks = toks;
+    ps.n_toks = n;
+    ps.model = model;
+    ps.line_pos = line_pos;
+    ps.line = line;
+    int rc = ll_walk(&ps, LL_NT(NT_LAYERS)) != 0 || ps.n_axes > 0;
+    build_free(&ps);
+    return rc;
+}
+
+int parse_check(CompileContext *ctx) {
+    ParseState ps;
+    memset(&ps, 0, sizeof(ps));
+    ps.ctx = ctx;
+    ps.lx = &ctx->lex;
+    return ll_walk(&ps, LL_START);
+}
@@ -0,0 +1,426 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/reparse.h"
+#include "../include/parser.h"
+#include "../include/stats.h"
+
+// Layers and their replacements are bump-allocated, so every edit leaves a
+// little garbage in the arena; past this multiple of what a whole parse
+// needs, the next edit parses the whole document into a fresh arena.
+#define REPARSE_COMPACT 4
+#define REPARSE_COMPACT_MIN (1 << 20)
+
+static int grow(void **p, int *cap, int need, size_t size) {
+    if (need <= *cap) return 0;
+    int n = *cap ? *cap : 64;
+    while (n < need) n *= 2;
+    void *q = realloc(*p, (size_t)n * size);
+    if (!q) return 1;
+    *p = q;
+    *cap = n;
+    return 0;
+}
+
+static int is_layer_token(TokenType t) {
+    return t >= TOK_INPUT && t <= TOK_OUTPUT;
+}
+
+// tokens that give a network or train block its structure, or make a sweep
+static int is_structural(TokenType t) {
+    switch (t) {
+        case TOK_NETWORK: case TOK_TRAIN: case TOK_LBRACE: case TOK_RBRACE:
+        case TOK_LBRACKET: case TOK_RBRACKET: case TOK_DOTDOT: case TOK_EOF: return 1;
+        default: return 0;
+    }
+}
+
+static int count_lines(const char *s, size_t n) {
+    int lines = 0;
+    for (const char *end = s + n; (s = (const char*)memchr(s, '\n', (size_t)(end - s))) != NULL; s++) lines++;
+    return lines;
+}
+
+static int shape_eq(TensorShape a, TensorShape b) {
+    return a.h == b.h && a.w == b.w && a.c == b.c && a.rank == b.rank;
+}
+
+// first index in [lo, hi) with kw[i] >= t
+static int lower_bound(const int *kw, int lo, int hi, int t) {
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (kw[mid] < t) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static void nets_free(ReparseDoc *d) {
+    for (int k = 0; d->nets && k < d->prog.n_nets; k++) {
+        free(d->nets[k].kw);
+        free(d->nets[k].errors);
+        free(d->nets[k].cost.layers);
+    }
+    free(d->nets);
+    d->nets = NULL;
+    memset(&d->prog, 0, sizeof(d->prog));
+}
+
+static void net_totals(ReparseNet *rn, const ModelAST *m) {
+    LayerCost *layers = rn->cost.layers;
+    memset(&rn->cost, 0, sizeof(rn->cost));
+    rn->cost.layers = layers;
+    rn->cost.n = m->n_layers;
+    for (int i = 0; i < m->n_layers; i++) cost_accumulate(&rn->cost, &m->layers[i], &layers[i]);
+    if (m->n_layers == 0 || m->layers[0].type != LAYER_INPUT) {
+        TensorShape s = ANALYSIS_DEFAULT_INPUT;
+        rn->cost.input = s;
+    }
+}
+
+// The totals once layers whose old costs summed to gone have been replaced
+// by layers whose costs sum to added. The sums move by the difference; the
+// peak needs a rescan only when a layer that may have set it went away, and
+// the input shape only when layer 0 or an input layer changed.
+static void update_totals(ReparseNet *rn, const ModelAST *m, const ModelCost *gone, const ModelCost *added, int rescan) {
+    ModelCost *c = &rn->cost;
+    // gone->input is set when an input layer went
+    if (rescan || gone->input.rank || gone->peak_act_bytes >= c->peak_act_bytes) {
+        net_totals(rn, m);
+        return;
+    }
+    c->n = m->n_layers;
+    c->params += added->params - gone->params;
+    c->macs += added->macs - gone->macs;
+    c->flops += added->flops - gone->flops;
+    c->act_bytes += added->act_bytes - gone->act_bytes;
+    if (added->peak_act_bytes > c->peak_act_bytes) c->peak_act_bytes = added->peak_act_bytes;
+}
+
+// Shapes and costs of layers [from, from + n), then of the layers after
+// them until one's output shape is the one it had before (from there on
+// nothing changes), then the totals. gone holds what the layers the new
+// ones replaced added to the totals, NULL to sum them all again. Returns
+// the layers analysed.
+static int analyze_from(ReparseDoc *d, ReparseNet *rn, const ModelAST *m, int from, int n, ModelCost *gone) {
+    ModelCost added;
+    memset(&added, 0, sizeof(added));
+    int rescan = !gone || from == 0;
+    TensorShape cur = ANALYSIS_DEFAULT_INPUT;
+    if (from > 0) cur = rn->cost.layers[from - 1].out;
+    int i = from;
+    while (i < m->n_layers) {
+        const Layer *L = &m->layers[i];
+        LayerCost *lc = &rn->cost.layers[i];
+        TensorShape before = lc->out;
+        if (gone && i >= from + n) cost_accumulate(gone, L, lc);
+        int e = analyze_layer(d->ctx.diag, L, i, &cur, lc);
+        rn->n_errors += e - rn->errors[i];
+        rn->errors[i] = (unsigned char)e;
+        cost_accumulate(&added, L, lc);
+        rescan |= L->type == LAYER_INPUT;
+        i++;
+        if (i > from + n && shape_eq(before, lc->out)) break;
+    }
+    if (gone) update_totals(rn, m, gone, &added, rescan);
+    else net_totals(rn, m);
+    return i - from;
+}
+
+// Finds each network body in the token stream of a program that parsed.
+// A layer keyword inside a body always starts a layer statement (anywhere
+// else in one it would be a syntax error), and the first '}' closes it.
+static int index_nets(ReparseDoc *d) {
+    d->nets = (ReparseNet*)calloc((size_t)(d->prog.n_nets ? d->prog.n_nets : 1), sizeof(ReparseNet));
+    if (!d->nets) return 1;
+    const Token *t = d->toks;
+    int i = 0, k = 0, line = 1;
+    size_t line_pos = 0;
+    while (t[i].type != TOK_EOF) {
+        int network = t[i].type == TOK_NETWORK;
+        while (t[i].type != TOK_LBRACE) i++;
+        if (!network) {
+            while (t[i].type != TOK_RBRACE) i++;
+            i++;
+            continue;
+        }
+        ReparseNet *rn = &d->nets[k];
+        const ModelAST *m = d->prog.nets[k++].model;
+        line += count_lines(d->src + line_pos, t[i].offset - line_pos);
+        line_pos = t[i].offset;
+        rn->open = i;
+        rn->open_line = line;
+        rn->cap = m->n_layers + 16;
+        rn->kw = (int*)malloc((size_t)rn->cap * sizeof(int));
+        rn->errors = (unsigned char*)calloc((size_t)rn->cap, 1);
+        rn->cost.layers = (LayerCost*)calloc((size_t)rn->cap, sizeof(LayerCost));
+        if (!rn->kw || !rn->errors || !rn->cost.layers) return 1;
+        int n = 0;
+        for (i++; t[i].type != TOK_RBRACE; i++)
+            if (is_layer_token(t[i].type) && n < m->n_layers) rn->kw[n++] = i;
+        if (n != m->n_layers) return 1;
+        rn->close = i++;
+        analyze_from(d, rn, m, 0, m->n_layers, NULL);
+    }
+    return 0;
+}
+
+static int lex_all(ReparseDoc *d, ReparseStats *st) {
+    if (lexer_init_buffer(&d->ctx.lex, d->src, d->len) != 0) return 1;
+    d->n_toks = 0;
+    for (;;) {
+        if (grow((void**)&d->toks, &d->cap_toks, d->n_toks + 1, sizeof(Token))) return 1;
+        Token t = lexer_next(&d->ctx.lex);
+        d->toks[d->n_toks++] = t;
+        if (t.type == TOK_EOF) break;
+    }
+    st->tokens += d->n_toks;
+    return 0;
+}
+
+static int parse_full(ReparseDoc *d, ReparseStats *st) {
+    nets_free(d);
+    arena_reset(&d->ctx.arena);
+    interner_reset(&d->ctx.strings);
+    st->full = 1;
+    d->ok = lex_all(d, st) == 0 && parse_tokens(&d->ctx, d->toks, d->n_toks, &d->prog) == 0;
+    if (d->ok) {
+        for (int k = 0; k < d->prog.n_nets; k++) st->layers_parsed += d->prog.nets[k].model->n_layers;
+        st->layers_analyzed = st->layers_parsed;
+        d->ok = index_nets(d) == 0;
+    }
+    if (!d->ok) nets_free(d);
+    d->arena_full = d->ctx.arena.bytes;
+    return d->ok ? 0 : 1;
+}
+
+static int doc_status(const ReparseDoc *d) {
+    if (!d->ok) return 1;
+    for (int k = 0; k < d->prog.n_nets; k++)
+        if (d->nets[k].n_errors) return 1;
+    return 0;
+}
+
+int reparse_open(ReparseDoc *d, const char *src, size_t len, FILE *diag) {
+    memset(d, 0, sizeof(*d));
+    compile_ctx_init(&d->ctx, NULL, NULL);
+    d->ctx.diag = diag;
+    d->cap = len + 1;
+    d->src = (char*)malloc(d->cap);
+    if (!d->src) return 1;
+    memcpy(d->src, src, len);
+    d->len = len;
+    ReparseStats st;
+    memset(&st, 0, sizeof(st));
+    parse_full(d, &st);
+    return doc_status(d);
+}
+
+// Re-lexes from the start of the edit's line until a token lands where an
+// old token after the removed bytes now sits: the lexer carries no state
+// from one token to the next and no token spans a newline, so from there on
+// the old tokens, shifted, are what lexing would produce. The fresh tokens
+// replace old tokens [*ta, *tb).
+static int relex(ReparseDoc *d, const TextEdit *e, int *ta, int *tb) {
+    size_t from = e->offset;
+    while (from > 0 && d->src[from - 1] != '\n') from--;
+    int lo = 0, hi = d->n_toks - 1;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (d->toks[mid].offset < from) lo = mid + 1;
+        else hi = mid;
+    }
+    *ta = lo;
+    size_t old_end = e->offset + e->removed, new_end = e->offset + e->inserted;
+    LexerState *lx = &d->ctx.lex;
+    lx->pos = from;
+    lx->lookahead_valid = 0;
+    d->n_fresh = 0;
+    int j = lo;
+    for (;;) {
+        Token t = lexer_next(lx);
+        if (t.offset >= new_end) {
+            size_t old = t.offset - new_end + old_end;
+            while (j < d->n_toks - 1 && d->toks[j].offset < old) j++;
+            if (d->toks[j].offset == old) { *tb = j; return 0; }
+        }
+        if (grow((void**)&d->fresh, &d->cap_fresh, d->n_fresh + 1, sizeof(Token))) return 1;
+        d->fresh[d->n_fresh++] = t;
+        if (t.type == TOK_EOF) { *tb = d->n_toks; return 0; }
+    }
+}
+
+// the network whose body holds old tokens [ta, tb), when the edit can stay inside it
+static int body_of(const ReparseDoc *d, int ta, int tb) {
+    int lo = 0, hi = d->prog.n_nets;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (d->nets[mid].open < ta) lo = mid + 1;
+        else hi = mid;
+    }
+    int k = lo - 1;
+    if (k < 0 || tb > d->nets[k].close || d->prog.nets[k].n_axes) return -1;
+    for (int i = ta; i < tb; i++)
+        if (is_structural(d->toks[i].type)) return -1;
+    for (int i = 0; i < d->n_fresh; i++)
+        if (is_structural(d->fresh[i].type)) return -1;
+    return k;
+}
+
+// the fresh tokens are the old ones moved, the edit having touched only
+// whitespace and comments
+static int same_tokens(const ReparseDoc *d, const TextEdit *e, int ta, int tb) {
+    if (d->n_fresh != tb - ta) return 0;
+    for (int i = 0; i < d->n_fresh; i++) {
+        const Token *o = &d->toks[ta + i], *f = &d->fresh[i];
+        if (o->type != f->type || o->len != f->len || o->param != f->param) return 0;
+        if (e->removed && o->offset < e->offset + e->removed && o->offset + o->len > e->offset) return 0;
+    }
+    return 1;
+}
+
+static int apply_text(ReparseDoc *d, const TextEdit *e) {
+    size_t len = d->len - e->removed + e->inserted;
+    if (len + 1 > d->cap) {
+        size_t cap = d->cap * 2 > len + 1 ? d->cap * 2 : len + 1;
+        char *s = (char*)realloc(d->src, cap);
+        if (!s) return 1;
+        d->src = s;
+        d->cap = cap;
+    }
+    memmove(d->src + e->offset + e->inserted, d->src + e->offset + e->removed, d->len - e->offset - e->removed);
+    if (e->inserted) memcpy(d->src + e->offset, e->text, e->inserted);
+    d->len = len;
+    return lexer_init_buffer(&d->ctx.lex, d->src, d->len);
+}
+
+static int net_reserve(ReparseNet *rn, int need) {
+    if (need <= rn->cap) return 0;
+    int cap = rn->cap * 2 > need ? rn->cap * 2 : need;
+    int *kw = (int*)realloc(rn->kw, (size_t)cap * sizeof(int));
+    if (kw) rn->kw = kw;
+    unsigned char *errors = (unsigned char*)realloc(rn->errors, (size_t)cap);
+    if (errors) rn->errors = errors;
+    LayerCost *layers = (LayerCost*)realloc(rn->cost.layers, (size_t)cap * sizeof(LayerCost));
+    if (layers) rn->cost.layers = layers;
+    if (!kw || !errors || !layers) return 1;
+    rn->cap = cap;
+    return 0;
+}
+
+// An edit whose tokens stay inside the body of network k: splices the
+// fresh tokens over old tokens [ta, tb), then re-parses the statements
+// they touch. Nonzero when the whole document has to be parsed instead.
+static int edit_body(ReparseDoc *d, const TextEdit *e, int k, int ta, int tb, int dl, ReparseStats *st) {
+    ReparseNet *rn = &d->nets[k];
+    ModelAST *m = d->prog.nets[k].model;
+    int n = m->n_layers;
+    int la = lower_bound(rn->kw, 0, n, ta);
+    int lb = lower_bound(rn->kw, la, n, tb);
+    int same = same_tokens(d, e, ta, tb);
+    // layers the edit only moves to another line
+    if (same && dl)
+        for (int i = la; i < lb; i++)
+            if (d->toks[rn->kw[i]].offset >= e->offset + e->removed) m->layers[i].line += dl;
+
+    long long delta = (long long)e->inserted - (long long)e->removed;
+    int dtok = d->n_fresh - (tb - ta);
+    if (grow((void**)&d->toks, &d->cap_toks, d->n_toks + dtok, sizeof(Token))) return 1;
+    memmove(d->toks + ta + d->n_fresh, d->toks + tb, (size_t)(d->n_toks - tb) * sizeof(Token));
+    if (d->n_fresh) memcpy(d->toks + ta, d->fresh, (size_t)d->n_fresh * sizeof(Token));
+    d->n_toks += dtok;
+    if (delta)
+        for (int i = ta + d->n_fresh; i < d->n_toks; i++) d->toks[i].offset = (unsigned)(d->toks[i].offset + delta);
+    rn->close += dtok;
+    for (int i = lb; (dtok || dl) && i < n; i++) {
+        rn->kw[i] += dtok;
+        m->layers[i].line += dl;
+    }
+    for (int j = k + 1; (dtok || dl) && j < d->prog.n_nets; j++) {
+        ReparseNet *r = &d->nets[j];
+        ModelAST *mj = d->prog.nets[j].model;
+        r->open += dtok;
+        r->close += dtok;
+        r->open_line += dl;
+        for (int i = 0; i < mj->n_layers; i++) {
+            r->kw[i] += dtok;
+            mj->layers[i].line += dl;
+        }
+    }
+    if (same) return 0;
+
+    // The statement before the damage can take over tokens that used to
+    // start one, so parsing restarts at it (or at the body's '{').
+    int first = la > 0 ? la - 1 : 0;
+    int s = la > 0 ? rn->kw[la - 1] : rn->open + 1;
+    int end = lb < n ? rn->kw[lb] : rn->close;
+    size_t line_pos = d->toks[la > 0 ? s : rn->open].offset;
+    int line = la > 0 ? m->layers[la - 1].line : rn->open_line;
+    ModelAST slice;
+    memset(&slice, 0, sizeof(slice));
+    if (parse_layers(&d->ctx, d->toks + s, end - s, &slice, line_pos, line) != 0) return 1;
+    st->layers_parsed = slice.n_layers;
+
+    int fresh = slice.n_layers, tail = n - lb, total = first + fresh + tail;
+    if (total > m->cap_layers) {
+        int cap = m->cap_layers ? m->cap_layers : 16;
+        while (cap < total) cap *= 2;
+        Layer *nl = (Layer*)arena_grow(&d->ctx.arena, m->layers, (size_t)m->cap_layers * sizeof(Layer), (size_t)cap * sizeof(Layer));
+        if (!nl) return 1;
+        m->layers = nl;
+        m->cap_layers = cap;
+    }
+    if (net_reserve(rn, total)) return 1;
+    ModelCost gone;
+    memset(&gone, 0, sizeof(gone));
+    for (int i = first; i < lb; i++) {
+        cost_accumulate(&gone, &m->layers[i], &rn->cost.layers[i]);
+        rn->n_errors -= rn->errors[i];
+    }
+    memmove(m->layers + first + fresh, m->layers + lb, (size_t)tail * sizeof(Layer));
+    if (fresh) memcpy(m->layers + first, slice.layers, (size_t)fresh * sizeof(Layer));
+    memmove(rn->kw + first + fresh, rn->kw + lb, (size_t)tail * sizeof(int));
+    memmove(rn->errors + first + fresh, rn->errors + lb, (size_t)tail);
+    memset(rn->errors + first, 0, (size_t)fresh);
+    memmove(rn->cost.layers + first + fresh, rn->cost.layers + lb, (size_t)tail * sizeof(LayerCost));
+    for (int i = s, j = first; i < end; i++)
+        if (is_layer_token(d->toks[i].type)) rn->kw[j++] = i;
+    m->n_layers = total;
+    st->layers_analyzed = analyze_from(d, rn, m, first, fresh, &gone);
+    return 0;
+}
+
+int reparse_edit(ReparseDoc *d, const TextEdit *e, ReparseStats *st) {
+    ReparseStats local;
+    if (!st) st = &local;
+    memset(st, 0, sizeof(*st));
+    double t0 = stats_now();
+    if (e->offset > d->len || e->removed > d->len - e->offset) {
+        fprintf(d->ctx.diag, "Error: edit at %zu+%zu is outside the %zu byte text\n", e->offset, e->removed, d->len);
+        return 1;
+    }
+    int dl = count_lines(e->text, e->inserted) - count_lines(d->src + e->offset, e->removed);
+    if (apply_text(d, e) != 0) {
+        d->ok = 0;
+        nets_free(d);
+    } else {
+        int ta, tb, k = -1;
+        int small = d->ok && d->ctx.arena.bytes <= REPARSE_COMPACT * d->arena_full + REPARSE_COMPACT_MIN;
+        if (small && relex(d, e, &ta, &tb) == 0) {
+            st->tokens = d->n_fresh + 1;
+            k = body_of(d, ta, tb);
+        }
+        if (k < 0 || edit_body(d, e, k, ta, tb, dl, st) != 0) parse_full(d, st);
+    }
+    st->seconds = stats_now() - t0;
+    return doc_status(d);
+}
+
+void reparse_free(ReparseDoc *d) {
+    nets_free(d);
+    compile_ctx_free(&d->ctx);
+    free(d->src);
+    free(d->toks);
+    free(d->fresh);
+    memset(d, 0, sizeof(*d));
+}
@@ -0,0 +1,566 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/server.h"
+
+#ifdef _WIN32
+
+int serve(const char *sock_path, int workers, unsigned long long cache_bytes) {
+    (void)sock_path; (void)workers; (void)cache_bytes;
+    fprintf(stderr, "Error: --serve needs Unix domain sockets\n");
+    return 1;
+}
+
+int client_compile(const char *sock_path, const char *in_path, const CodegenOptions *opts) {
+    (void)sock_path; (void)in_path; (void)opts;
+    fprintf(stderr, "Error: --connect needs Unix domain sockets\n");
+    return 1;
+}
+
+#else
+
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include "../include/codegen.h"
+#include "../include/threadpool.h"
+
+#define LRU_BUCKETS 4096
+#define SERVER_IO_TIMEOUT 30        // seconds a client may stall mid-request before its worker gives up
+
+// a finished compile: code followed by diagnostics in one block
+typedef struct LruEntry {
+    uint64_t key;
+    char *data;
+    size_t out_len, diag_len;
+    int ok;
+    struct LruEntry *hnext;         // bucket chain
+    struct LruEntry *prev, *next;   // recency list, head is the newest
+} LruEntry;
+
+typedef struct Worker Worker;
+typedef struct Conn Conn;
+
+typedef struct {
+    int fd;
+    const char *path;
+    ThreadPool *tp;
+    Worker *workers;                // one per pool thread, by tp_worker_id()
+    int wake[2];                    // pipe: a connection came back, or stop
+    pthread_mutex_t mu;             // guards everything below
+    int stop;
+    Conn *returned;                 // served connections for the poller to watch again
+    LruEntry *buckets[LRU_BUCKETS];
+    LruEntry *head, *tail;
+    unsigned long long bytes, max_bytes;
+    unsigned long requests, hits, errors;
+} Server;
+
+struct Conn {
+    int fd;
+    char buf[4096];
+    size_t start, end;
+    Server *server;
+    Conn *next;                     // in Server.returned
+};
+
+// ---- result cache ----
+
+static void lru_unlink(Server *s, LruEntry *e) {
+    if (e->prev) e->prev->next = e->next; else s->head = e->next;
+    if (e->next) e->next->prev = e->prev; else s->tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+static void lru_push(Server *s, LruEntry *e) {
+    e->next = s->head;
+    if (s->head) s->head->prev = e;
+    s->head = e;
+    if (!s->tail) s->tail = e;
+}
+
+static void lru_drop_tail(Server *s) {
+    LruEntry *e = s->tail;
+    lru_unlink(s, e);
+    LruEntry **p = &s->buckets[e->key % LRU_BUCKETS];
+    while (*p != e) p = &(*p)->hnext;
+    *p = e->hnext;
+    s->bytes -= e->out_len + e->diag_len;
+    free(e->data);
+    free(e);
+}
+
+// copies a hit into *data (realloc'd); caller holds no lock
+static int lru_get(Server *s, uint64_t key, char **data, size_t *cap, size_t *out_len, size_t *diag_len, int *ok) {
+    int hit = 0;
+    pthread_mutex_lock(&s->mu);
+    LruEntry *e = s->buckets[key % LRU_BUCKETS];
+    while (e && e->key != key) e = e->hnext;
+    if (e) {
+        size_t n = e->out_len + e->diag_len;
+        if (n > *cap) { *data = (char*)realloc(*data, n); *cap = n; }
+        memcpy(*data, e->data, n);
+        *out_len = e->out_len;
+        *diag_len = e->diag_len;
+        *ok = e->ok;
+        lru_unlink(s, e);
+        lru_push(s, e);
+        s->hits++;
+        hit = 1;
+    }
+    pthread_mutex_unlock(&s->mu);
+    return hit;
+}
+
+static void lru_put(Server *s, uint64_t key, const char *out, size_t out_len, const char *diag, size_t diag_len, int ok) {
+    size_t n = out_len + diag_len;
+    if (s->max_bytes == 0 || n > s->max_bytes / 4) return;
+    LruEntry *e = (LruEntry*)calloc(1, sizeof(LruEntry));
+    e->data = (char*)malloc(n ? n : 1);
+    memcpy(e->data, out, out_len);
+    memcpy(e->data + out_len, diag, diag_len);
+    e->key = key;
+    e->out_len = out_len;
+    e->diag_len = diag_len;
+    e->ok = ok;
+    pthread_mutex_lock(&s->mu);
+    LruEntry *old = s->buckets[key % LRU_BUCKETS];
+    while (old && old->key != key) old = old->hnext;
+    if (old) {
+        // another worker finished the same source first
+        pthread_mutex_unlock(&s->mu);
+        free(e->data);
+        free(e);
+        return;
+    }
+    e->hnext = s->buckets[key % LRU_BUCKETS];
+    s->buckets[key % LRU_BUCKETS] = e;
+    lru_push(s, e);
+    s->bytes += n;
+    while (s->bytes > s->max_bytes) lru_drop_tail(s);
+    pthread_mutex_unlock(&s->mu);
+}
+
+// ---- connection I/O ----
+
+static int write_full(int fd, const char *p, size_t n) {
+    while (n > 0) {
+        ssize_t w = write(fd, p, n);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return -1;
+        p += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+static int conn_fill(Conn *c) {
+    if (c->start == c->end) c->start = c->end = 0;
+    ssize_t r;
+    do r = read(c->fd, c->buf + c->end, sizeof(c->buf) - c->end); while (r < 0 && errno == EINTR);
+    if (r <= 0) return -1;
+    c->end += (size_t)r;
+    return 0;
+}
+
+// one '\n'-terminated line without the newline; -1 on EOF or overlong line
+static int conn_line(Conn *c, char *line, size_t n) {
+    while (1) {
+        char *nl = (char*)memchr(c->buf + c->start, '\n', c->end - c->start);
+        if (nl) {
+            size_t len = (size_t)(nl - (c->buf + c->start));
+            if (len >= n) return -1;
+            memcpy(line, c->buf + c->start, len);
+            line[len] = '\0';
+            c->start += len + 1;
+            return 0;
+        }
+        if (c->end - c->start >= n) return -1;
+        if (c->start > 0) {
+            memmove(c->buf, c->buf + c->start, c->end - c->start);
+            c->end -= c->start;
+            c->start = 0;
+        }
+        if (conn_fill(c) != 0) return -1;
+    }
+}
+
+static int conn_read(Conn *c, char *dst, size_t n) {
+    size_t have = c->end - c->start;
+    if (have > n) have = n;
+    memcpy(dst, c->buf + c->start, have);
+    c->start += have;
+    dst += have;
+    n -= have;
+    while (n > 0) {
+        ssize_t r = read(c->fd, dst, n);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return -1;
+        dst += r;
+        n -= (size_t)r;
+    }
+    return 0;
+}
+
+static int respond(int fd, int ok, const char *out, size_t out_len, const char *diag, size_t diag_len) {
+    char head[64];
+    int n = snprintf(head, sizeof(head), "%s %zu %zu\n", ok ? "OK" : "ERR", out_len, diag_len);
+    return write_full(fd, head, (size_t)n) || write_full(fd, out, out_len) || write_full(fd, diag, diag_len);
+}
+
+// ---- workers ----
+
+struct Worker {
+    CompileContext ctx;     // warm: arena and interner survive between requests
+    char *src;
+    size_t src_cap;
+    char *hit;
+    size_t hit_cap;
+};
+
+// the <options> field: "-" or a comma-separated list of no-fuse, int8 and
+// profile=FIRST:LAST, the codegen switches of the same names
+static void options_encode(const CodegenOptions *o, char *buf, size_t n) {
+    char profile[40] = "", all[64];
+    if (o->profile) snprintf(profile, sizeof(profile), ",profile=%d:%d", o->profile_first, o->profile_last);
+    snprintf(all, sizeof(all), "%s%s%s", o->no_fuse ? ",no-fuse" : "", o->quantize == QUANT_INT8 ? ",int8" : "", profile);
+    snprintf(buf, n, "%s", all[0] ? all + 1 : "-");
+}
+
+// fills opts from the field; the first option it does not know goes to bad
+static int options_decode(const char *field, CodegenOptions *opts, char *bad, size_t bad_n) {
+    if (strcmp(field, "-") == 0) return 0;
+    for (const char *p = field; *p; ) {
+        size_t len = strcspn(p, ",");
+        int first, last, used = 0;
+        if (len == 7 && memcmp(p, "no-fuse", 7) == 0) opts->no_fuse = 1;
+        else if (len == 4 && memcmp(p, "int8", 4) == 0) opts->quantize = QUANT_INT8;
+        else if (sscanf(p, "profile=%d:%d%n", &first, &last, &used) == 2 && (size_t)used == len && first >= 0 && last >= first) {
+            opts->profile = 1;
+            opts->profile_first = first;
+            opts->profile_last = last;
+        }
+        else { snprintf(bad, bad_n, "%.*s", (int)len, p); return -1; }
+        p += len;
+        if (*p == ',') p++;
+    }
+    return 0;
+}
+
+// -1 when the line is not a request; *bad is set when it is one with options this server does not know
+static int parse_request(const char *line, CodegenOptions *opts, size_t *len, char *name, size_t name_n, char *bad, size_t bad_n) {
+    char target[16], options[128];
+    unsigned long long n;
+    int used = 0;
+    if (sscanf(line, "COMPILE %15s %llu %127s %n", target, &n, options, &used) < 3 || used == 0) return -1;
+    if (strcmp(target, "python") == 0) opts->target = TARGET_PYTHON;
+    else if (strcmp(target, "c") == 0) opts->target = TARGET_C;
+    else if (strcmp(target, "ast-bin") == 0) opts->target = TARGET_AST_BIN;
+    else return -1;
+    if (n > SERVER_MAX_SOURCE) return -1;
+    *len = (size_t)n;
+    snprintf(name, name_n, "%s", line[used] ? line + used : "<request>");
+    *bad = '\0';
+    options_decode(options, opts, bad, bad_n);
+    return 0;
+}
+
+// one request; -1 closes the connection
+static int handle_request(Server *s, Worker *w, Conn *c) {
+    char line[1200], name[1024];
+    if (conn_line(c, line, sizeof(line)) != 0) return -1;
+    CodegenOptions opts = { TARGET_PYTHON };
+    size_t len;
+    char bad[128];
+    if (parse_request(line, &opts, &len, name, sizeof(name), bad, sizeof(bad)) != 0) {
+        static const char msg[] = "Error: bad request, expected COMPILE <python|c|ast-bin> <bytes> <options> <name>\n";
+        respond(c->fd, 0, "", 0, msg, sizeof(msg) - 1);
+        return -1;
+    }
+    if (len > w->src_cap) { w->src = (char*)realloc(w->src, len); w->src_cap = len; }
+    if (conn_read(c, w->src, len) != 0) return -1;
+    if (*bad) {
+        // compiling without it would answer a different question
+        char msg[256];
+        int n = snprintf(msg, sizeof(msg), "Error: %s: the server does not support option '%s'\n", name, bad);
+        pthread_mutex_lock(&s->mu);
+        s->requests++;
+        s->errors++;
+        pthread_mutex_unlock(&s->mu);
+        return respond(c->fd, 0, "", 0, msg, (size_t)n < sizeof(msg) ? (size_t)n : sizeof(msg) - 1);
+    }
+
+    char okey[256];
+    codegen_options_key(&opts, okey, sizeof(okey));
+    uint64_t key = cache_key(w->src, len, okey);
+    size_t out_len, diag_len;
+    int ok, rc;
+    if (lru_get(s, key, &w->hit, &w->hit_cap, &out_len, &diag_len, &ok)) {
+        rc = respond(c->fd, ok, w->hit, out_len, w->hit + out_len, diag_len);
+    } else {
+        char *out = NULL, *diag = NULL;
+        size_t on = 0, dn = 0;
+        CompileContext *ctx = &w->ctx;
+        ctx->in_path = name;
+        ctx->opts = opts;
+        ctx->out = open_memstream(&out, &on);
+        ctx->diag = open_memstream(&diag, &dn);
+        if (!ctx->out || !ctx->diag) return -1;
+        ok = compile_source(ctx, w->src, len) == 0;
+        fclose(ctx->out);
+        fclose(ctx->diag);
+        ctx->out = NULL;
+        ctx->diag = stderr;
+        lru_put(s, key, out, on, diag, dn, ok);
+        rc = respond(c->fd, ok, out, on, diag, dn);
+        free(out);
+        free(diag);
+    }
+    pthread_mutex_lock(&s->mu);
+    s->requests++;
+    if (!ok) s->errors++;
+    pthread_mutex_unlock(&s->mu);
+    return rc;
+}
+
+// one request on a ready connection, then the connection goes back to the
+// poller and this pool thread to the next ready connection
+static void serve_one(void *arg) {
+    Conn *c = (Conn*)arg;
+    Server *s = c->server;
+    if (handle_request(s, &s->workers[tp_worker_id()], c) != 0) {
+        close(c->fd);
+        free(c);
+        return;
+    }
+    pthread_mutex_lock(&s->mu);
+    c->next = s->returned;
+    s->returned = c;
+    pthread_mutex_unlock(&s->mu);
+    char b = 0;
+    while (write(s->wake[1], &b, 1) < 0 && errno == EINTR) {}
+}
+
+// connections waiting for their next request, and the poll set to watch them
+typedef struct {
+    Conn **conns;
+    struct pollfd *pfd;     // two more than conns
+    size_t n, cap;
+} IdleSet;
+
+static void idle_add(IdleSet *q, Conn *c) {
+    if (q->n + 2 >= q->cap) {
+        q->cap = q->cap ? q->cap * 2 : 64;
+        q->conns = (Conn**)realloc(q->conns, q->cap * sizeof(Conn*));
+        q->pfd = (struct pollfd*)realloc(q->pfd, q->cap * sizeof(struct pollfd));
+    }
+    q->conns[q->n++] = c;
+}
+
+// accepts connections and polls the idle ones; a connection with a request
+// waiting (or already buffered) is queued on the pool as one serve_one task
+static void *poller_main(void *arg) {
+    Server *s = (Server*)arg;
+    IdleSet q = { NULL, NULL, 0, 64 };
+    q.conns = (Conn**)malloc(q.cap * sizeof(Conn*));
+    q.pfd = (struct pollfd*)malloc(q.cap * sizeof(struct pollfd));
+    while (1) {
+        struct pollfd *pfd = q.pfd;
+        Conn **idle = q.conns;
+        size_t n_idle = q.n;
+        pfd[0].fd = s->wake[0];
+        pfd[1].fd = s->fd;
+        for (size_t i = 0; i < n_idle; i++) pfd[i + 2].fd = idle[i]->fd;
+        for (size_t i = 0; i < n_idle + 2; i++) { pfd[i].events = POLLIN; pfd[i].revents = 0; }
+        if (poll(pfd, (nfds_t)(n_idle + 2), -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            break;
+        }
+        // pfd[0] is the wake pipe, pfd[1] the listener; idle_add below may move pfd
+        int woken = pfd[0].revents != 0, pending = pfd[1].revents != 0;
+        size_t kept = 0;
+        for (size_t i = 0; i < n_idle; i++) {
+            if (pfd[i + 2].revents) tp_submit(s->tp, serve_one, idle[i]);
+            else idle[kept++] = idle[i];
+        }
+        q.n = kept;
+        if (woken) {
+            char drain[64];
+            while (read(s->wake[0], drain, sizeof(drain)) > 0) {}
+            pthread_mutex_lock(&s->mu);
+            Conn *c = s->returned;
+            s->returned = NULL;
+            int stop = s->stop;
+            pthread_mutex_unlock(&s->mu);
+            if (stop) {
+                // serve() closes what is still being served
+                while (c) { Conn *next = c->next; close(c->fd); free(c); c = next; }
+                break;
+            }
+            while (c) {
+                Conn *next = c->next;
+                // a pipelined request is already in the buffer, where poll cannot see it
+                if (c->start < c->end) tp_submit(s->tp, serve_one, c);
+                else idle_add(&q, c);
+                c = next;
+            }
+        }
+        if (pending) {
+            int fd;
+            while ((fd = accept(s->fd, NULL, NULL)) >= 0) {
+                // BSDs hand out the listener's O_NONBLOCK; workers read blocking, with a timeout
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+                struct timeval tv = { SERVER_IO_TIMEOUT, 0 };
+                setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+                setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+                Conn *c = (Conn*)malloc(sizeof(Conn));
+                c->fd = fd;
+                c->start = c->end = 0;
+                c->server = s;
+                c->next = NULL;
+                idle_add(&q, c);
+            }
+        }
+    }
+    for (size_t i = 0; i < q.n; i++) { close(q.conns[i]->fd); free(q.conns[i]); }
+    free(q.conns);
+    free(q.pfd);
+    return NULL;
+}
+
+static int socket_addr(const char *path, struct sockaddr_un *a) {
+    memset(a, 0, sizeof(*a));
+    a->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(a->sun_path)) { fprintf(stderr, "Error: socket path too long: %s\n", path); return -1; }
+    strcpy(a->sun_path, path);
+    return 0;
+}
+
+static int connect_to(const char *path) {
+    struct sockaddr_un a;
+    if (socket_addr(path, &a) != 0) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr*)&a, sizeof(a)) != 0) { close(fd); return -1; }
+    return fd;
+}
+
+int serve(const char *sock_path, int workers, unsigned long long cache_bytes) {
+    struct sockaddr_un a;
+    if (socket_addr(sock_path, &a) != 0) return 1;
+    // refuse to take over a live server; clear a stale socket file
+    int probe = connect_to(sock_path);
+    if (probe >= 0) { close(probe); fprintf(stderr, "Error: a server is already listening on %s\n", sock_path); return 1; }
+    struct stat st;
+    if (stat(sock_path, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(sock_path);
+
+    Server *s = (Server*)calloc(1, sizeof(Server));
+    s->path = sock_path;
+    s->max_bytes = cache_bytes;
+    pthread_mutex_init(&s->mu, NULL);
+    s->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s->fd < 0 || bind(s->fd, (struct sockaddr*)&a, sizeof(a)) != 0 || listen(s->fd, 128) != 0 || pipe(s->wake) != 0) {
+        perror(sock_path);
+        if (s->fd >= 0) close(s->fd);
+        free(s);
+        return 1;
+    }
+    // the poller accepts until EAGAIN and drains the wake pipe the same way
+    fcntl(s->fd, F_SETFL, fcntl(s->fd, F_GETFL) | O_NONBLOCK);
+    fcntl(s->wake[0], F_SETFL, fcntl(s->wake[0], F_GETFL) | O_NONBLOCK);
+
+    // workers inherit the blocked set; only this thread takes the signals
+    sigset_t sigs;
+    sigemptyset(&sigs);
+    sigaddset(&sigs, SIGINT);
+    sigaddset(&sigs, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &sigs, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (workers < 1) workers = tp_default_threads();
+    s->workers = (Worker*)calloc((size_t)workers, sizeof(Worker));
+    for (int i = 0; i < workers; i++) {
+        compile_ctx_init(&s->workers[i].ctx, "<request>", "<memory>");
+        s->workers[i].ctx.quiet = 1;
+    }
+    s->tp = tp_create(workers);
+    pthread_t poller;
+    pthread_create(&poller, NULL, poller_main, s);
+    fprintf(stderr, "Serving on %s with %d workers (Ctrl-C to stop)\n", sock_path, workers);
+
+    int sig;
+    sigwait(&sigs, &sig);
+    pthread_mutex_lock(&s->mu);
+    s->stop = 1;
+    pthread_mutex_unlock(&s->mu);
+    char b = 0;
+    while (write(s->wake[1], &b, 1) < 0 && errno == EINTR) {}
+    pthread_join(poller, NULL);
+    // requests already handed out finish; their connections end up on returned
+    tp_destroy(s->tp);
+    while (s->returned) {
+        Conn *c = s->returned;
+        s->returned = c->next;
+        close(c->fd);
+        free(c);
+    }
+    for (int i = 0; i < workers; i++) {
+        free(s->workers[i].src);
+        free(s->workers[i].hit);
+        compile_ctx_free(&s->workers[i].ctx);
+    }
+    free(s->workers);
+    close(s->wake[0]);
+    close(s->wake[1]);
+    close(s->fd);
+    unlink(sock_path);
+    fprintf(stderr, "Served %lu requests (%lu from the result cache, %lu failed)\n", s->requests, s->hits, s->errors);
+    while (s->tail) lru_drop_tail(s);
+    pthread_mutex_destroy(&s->mu);
+    free(s);
+    return 0;
+}
+
+int client_compile(const char *sock_path, const char *in_path, const CodegenOptions *opts) {
+    LexerState src;     // only used to load the file
+    if (lexer_init_file(&src, in_path) != 0) return 1;
+    int fd = connect_to(sock_path);
+    if (fd < 0) { perror(sock_path); lexer_free(&src); return 1; }
+    signal(SIGPIPE, SIG_IGN);
+    char head[1200], options[128];
+    static const char *targets[] = { "python", "c", "ast-bin" };
+    options_encode(opts, options, sizeof(options));
+    int n = snprintf(head, sizeof(head), "COMPILE %s %zu %s %s\n", targets[opts->target], src.len, options, in_path);
+    int rc = 1;
+    Conn *c = (Conn*)malloc(sizeof(Conn));
+    c->fd = fd;
+    c->start = c->end = 0;
+    size_t out_len, diag_len;
+    char status[8];
+    if (write_full(fd, head, (size_t)n) == 0 && write_full(fd, src.src, src.len) == 0 &&
+        conn_line(c, head, sizeof(head)) == 0 && sscanf(head, "%7s %zu %zu", status, &out_len, &diag_len) == 3) {
+        char *body = (char*)malloc(out_len + diag_len + 1);
+        if (conn_read(c, body, out_len + diag_len) == 0) {
+            fwrite(body, 1, out_len, stdout);
+            fwrite(body + out_len, 1, diag_len, stderr);
+            rc = strcmp(status, "OK") == 0 ? 0 : 1;
+        }
+        free(body);
+    } else {
+        fprintf(stderr, "Error: no response from %s\n", sock_path);
+    }
+    free(c);
+    close(fd);
+    lexer_free(&src);
+    return rc;
+}
+
+#endif
@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <time.h>
+#include "../include/stats.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+static const char *const phase_names[PHASE_COUNT] = {
+    "read", "lex", "parse", "ast", "analyze", "memplan", "codegen"
+};
+
+double stats_now(void) {
+#ifdef _WIN32
+    LARGE_INTEGER f, c;
+    QueryPerformanceFrequency(&f);
+    QueryPerformanceCounter(&c);
+    return (double)c.QuadPart / (double)f.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+void stats_add(CompileStats *dst, const CompileStats *src) {
+    for (int i = 0; i < PHASE_COUNT; i++) dst->t[i] += src->t[i];
+    dst->files += src->files;
+    dst->in_bytes += src->in_bytes;
+    dst->tokens += src->tokens;
+    dst->layers += src->layers;
+    dst->arena_allocs += src->arena_allocs;
+    dst->arena_bytes += src->arena_bytes;
+    dst->arena_chunks += src->arena_chunks;
+    dst->out_bytes += src->out_bytes;
+}
+
+static double rate(double n, double secs) { return secs > 0 ? n / secs : 0.0; }
+
+void stats_print(FILE *f, const CompileStats *s, int mode) {
+    double total = 0;
+    for (int i = 0; i < PHASE_COUNT; i++) total += s->t[i];
+    if (mode & STATS_JSON) {
+        fprintf(f, "{\"files\": %lld, \"phases_ms\": {", s->files);
+        for (int i = 0; i < PHASE_COUNT; i++) fprintf(f, "%s\"%s\": %.3f", i ? ", " : "", phase_names[i], s->t[i] * 1e3);
+        fprintf(f, "}, \"total_ms\": %.3f", total * 1e3);
+        if (mode & STATS_COUNTERS)
+            fprintf(f, ", \"input_bytes\": %lld, \"tokens\": %lld, \"layers\": %lld, \"arena_allocs\": %lld, "
+                       "\"arena_bytes\": %lld, \"arena_chunks\": %lld, \"output_bytes\": %lld",
+                    s->in_bytes, s->tokens, s->layers, s->arena_allocs, s->arena_bytes, s->arena_chunks, s->out_bytes);
+        fprintf(f, "}\n");
+        return;
+    }
+    fprintf(f, "Compile time by phase (%lld file%s, summed over threads)\n", s->files, s->files == 1 ? "" : "s");
+    fprintf(f, "  %-10s %12s %7s\n", "phase", "ms", "%");
+    for (int i = 0; i < PHASE_COUNT; i++)
+        fprintf(f, "  %-10s %12.3f %6.1f%%\n", phase_names[i], s->t[i] * 1e3, total > 0 ? 100.0 * s->t[i] / total : 0.0);
+    fprintf(f, "  %-10s %12.3f\n", "total", total * 1e3);
+    if (!(mode & STATS_COUNTERS)) return;
+    fprintf(f, "Counters\n");
+    fprintf(f, "  %-16s %14lld  %8.1f MB/s lexed\n", "input bytes", s->in_bytes, rate(s->in_bytes / 1048576.0, s->t[PHASE_LEX]));
+    fprintf(f, "  %-16s %14lld  %8.2f Mtokens/s\n", "tokens", s->tokens, rate(s->tokens / 1e6, s->t[PHASE_LEX]));
+    fprintf(f, "  %-16s %14lld\n", "layers", s->layers);
+    fprintf(f, "  %-16s %14lld\n", "arena allocs", s->arena_allocs);
+    fprintf(f, "  %-16s %14lld\n", "arena bytes", s->arena_bytes);
+    fprintf(f, "  %-16s %14lld\n", "arena chunks", s->arena_chunks);
+    fprintf(f, "  %-16s %14lld  %8.1f MB/s generated\n", "output bytes", s->out_bytes, rate(s->out_bytes / 1048576.0, s->t[PHASE_CODEGEN]));
+}
@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "../include/sweep.h"
+#include "../include/grammar.h"
+#include "../include/cache.h"
+
+long long sweep_count(const NetworkAST *n) {
+    long long c = 1;
+    for (int i = 0; i < n->n_axes; i++) c *= n->axes[i].n;
+    return c;
+}
+
+void sweep_name(const NetworkAST *n, long long v, char *buf, size_t len) {
+    int width = 1;
+    for (long long c = sweep_count(n) - 1; c >= 10; c /= 10) width++;
+    snprintf(buf, len, "%s_%0*lld", n->model->name, width, v);
+}
+
+int sweep_variant(const NetworkAST *n, long long v, Arena *a, ModelAST *m, TrainAST *t) {
+    const ModelAST *base = n->model;
+    char name[512];
+    sweep_name(n, v, name, sizeof(name));
+    memset(m, 0, sizeof(*m));
+    *t = n->train;
+    m->name = arena_strndup(a, name, strlen(name));
+    if (!m->name) return 1;
+    if (base->n_layers) {
+        m->layers = (Layer*)arena_alloc(a, (size_t)base->n_layers * sizeof(Layer));
+        if (!m->layers) return 1;
+        memcpy(m->layers, base->layers, (size_t)base->n_layers * sizeof(Layer));
+    }
+    m->n_layers = m->cap_layers = base->n_layers;
+    // mixed radix, last axis fastest
+    for (int j = n->n_axes - 1; j >= 0; j--) {
+        const SweepAxis *ax = &n->axes[j];
+        const ParamValue *pv = &ax->values[v % ax->n];
+        v /= ax->n;
+        if (ax->layer >= 0) layer_set_param(&m->layers[ax->layer], ax->param, pv);
+        else train_set_param(t, ax->param, pv);
+    }
+    return 0;
+}
+
+void sweep_write_manifest(FILE *f, const NetworkAST *n, const char *prefix, const char *suffix) {
+    fprintf(f, "variant\tfile");
+    for (int j = 0; j < n->n_axes; j++) {
+        const SweepAxis *ax = &n->axes[j];
+        if (ax->layer >= 0) fprintf(f, "\t%s[%d].%s", layer_type_name(n->model->layers[ax->layer].type), ax->layer, param_name[ax->param]);
+        else fprintf(f, "\ttrain.%s", param_name[ax->param]);
+    }
+    fprintf(f, "\n");
+    long long count = sweep_count(n);
+    int *digit = (int*)calloc((size_t)n->n_axes + 1, sizeof(int));
+    char name[512];
+    for (long long v = 0; v < count; v++) {
+        sweep_name(n, v, name, sizeof(name));
+        fprintf(f, "%lld\t%s%s%s", v, prefix, name, suffix);
+        long long r = v;
+        for (int j = n->n_axes - 1; j >= 0; j--) {
+            digit[j] = (int)(r % n->axes[j].n);
+            r /= n->axes[j].n;
+        }
+        for (int j = 0; j < n->n_axes; j++) {
+            const ParamValue *pv = &n->axes[j].values[digit[j]];
+            if (pv->str) fprintf(f, "\t%s", pv->str);
+            else fprintf(f, "\t%d", pv->num);
+        }
+        fprintf(f, "\n");
+    }
+    free(digit);
+}
+
+// ---- prefix trie ----
+
+typedef struct TrieNode {
+    const struct TrieNode *parent;  // NULL for the first layer
+    Layer layer;
+    LayerCost cost;
+    ModelCost totals;               // through this layer (layers unused)
+    TensorShape shape;              // running shape after it
+    int errors;                     // shape errors through this layer
+    uint64_t hash;
+} TrieNode;
+
+struct SweepTrie {
+    pthread_mutex_t mu;
+    Arena arena;            // the nodes
+    TrieNode **slots;       // open addressing on (parent, layer)
+    size_t cap, count;
+    long long walked;
+};
+
+SweepTrie *sweep_trie_new(void) {
+    SweepTrie *t = (SweepTrie*)calloc(1, sizeof(SweepTrie));
+    if (!t) return NULL;
+    t->cap = 1024;
+    t->slots = (TrieNode**)calloc(t->cap, sizeof(TrieNode*));
+    if (!t->slots) { free(t); return NULL; }
+    arena_init(&t->arena);
+    pthread_mutex_init(&t->mu, NULL);
+    return t;
+}
+
+void sweep_trie_free(SweepTrie *t) {
+    if (!t) return;
+    pthread_mutex_destroy(&t->mu);
+    arena_release(&t->arena);
+    free(t->slots);
+    free(t);
+}
+
+void sweep_trie_counts(SweepTrie *t, long long *nodes, long long *layers) {
+    pthread_mutex_lock(&t->mu);
+    *nodes = (long long)t->count;
+    *layers = t->walked;
+    pthread_mutex_unlock(&t->mu);
+}
+
+static int layer_eq(const Layer *a, const Layer *b) {
+    return a->type == b->type && a->activation == b->activation && memcmp(&a->p, &b->p, sizeof(a->p)) == 0;
+}
+
+static uint64_t node_hash(const TrieNode *parent, const Layer *L) {
+    struct { const void *parent, *act; int type; int p[3]; } k;
+    memset(&k, 0, sizeof(k));
+    k.parent = parent;
+    k.act = L->activation;
+    k.type = (int)L->type;
+    memcpy(k.p, &L->p, sizeof(L->p));
+    return hash64(&k, sizeof(k), 0);
+}
+
+static void trie_grow(SweepTrie *t) {
+    size_t cap = t->cap * 2;
+    TrieNode **slots = (TrieNode**)calloc(cap, sizeof(TrieNode*));
+    if (!slots) return;
+    for (size_t i = 0; i < t->cap; i++) {
+        TrieNode *n = t->slots[i];
+        if (!n) continue;
+        size_t j = (size_t)n->hash & (cap - 1);
+        while (slots[j]) j = (j + 1) & (cap - 1);
+        slots[j] = n;
+    }
+    free(t->slots);
+    t->slots = slots;
+    t->cap = cap;
+}
+
+// the node for layer L (index i) after parent, analysed on first use
+static const TrieNode *trie_step(SweepTrie *t, FILE *diag, const TrieNode *parent, const Layer *L, int i) {
+    uint64_t h = node_hash(parent, L);
+    pthread_mutex_lock(&t->mu);
+    t->walked++;
+    size_t j = (size_t)h & (t->cap - 1);
+    for (TrieNode *n; (n = t->slots[j]) != NULL; j = (j + 1) & (t->cap - 1)) {
+        if (n->hash == h && n->parent == parent && layer_eq(&n->layer, L)) {
+            pthread_mutex_unlock(&t->mu);
+            return n;
+        }
+    }
+    TrieNode *n = (TrieNode*)arena_alloc(&t->arena, sizeof(TrieNode));
+    if (n) {
+        TensorShape start = ANALYSIS_DEFAULT_INPUT;
+        n->parent = parent;
+        n->layer = *L;
+        n->hash = h;
+        n->shape = parent ? parent->shape : start;
+        n->errors = analyze_layer(diag, L, i, &n->shape, &n->cost) + (parent ? parent->errors : 0);
+        if (parent) n->totals = parent->totals;
+        cost_accumulate(&n->totals, L, &n->cost);
+        t->slots[j] = n;
+        if (++t->count * 2 > t->cap) trie_grow(t);
+    }
+    pthread_mutex_unlock(&t->mu);
+    return n;
+}
+
+int sweep_analyze(SweepTrie *t, FILE *diag, Arena *a, const ModelAST *m, ModelCost *out) {
+    memset(out, 0, sizeof(*out));
+    out->n = m->n_layers;
+    out->layers = (LayerCost*)arena_alloc(a, sizeof(LayerCost) * (size_t)(m->n_layers ? m->n_layers : 1));
+    if (!out->layers) return 1;
+    const TrieNode *node = NULL;
+    for (int i = 0; i < m->n_layers; i++) {
+        node = trie_step(t, diag, node, &m->layers[i], i);
+        if (!node) return 1;
+        out->layers[i] = node->cost;
+    }
+    if (node) {
+        out->input = node->totals.input;
+        out->params = node->totals.params;
+        out->macs = node->totals.macs;
+        out->flops = node->totals.flops;
+        out->act_bytes = node->totals.act_bytes;
+        out->peak_act_bytes = node->totals.peak_act_bytes;
+    }
+    if (m->n_layers == 0 || m->layers[0].type != LAYER_INPUT) {
+        TensorShape d = ANALYSIS_DEFAULT_INPUT;
+        out->input = d;
+    }
+    return node ? node->errors : 0;
+}
@@ -0,0 +1,209 @@
+#ifdef __linux__
+#define _GNU_SOURCE     // pthread_setaffinity_np
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../include/threadpool.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+typedef struct {
+    tp_fn fn;
+    void *arg;
+} Task;
+
+// ring buffer: head is the oldest task (stolen by others), tail-1 the newest (popped by the owner)
+typedef struct {
+    pthread_mutex_t mu;
+    Task *buf;
+    size_t cap, head, tail;
+} Deque;
+
+struct ThreadPool {
+    int n;
+    pthread_t *threads;
+    Deque *q;
+    pthread_mutex_t mu;
+    pthread_cond_t work_cv;     // signalled when a task is queued or on stop
+    pthread_cond_t done_cv;     // signalled when pending drops to zero
+    long queued;                // tasks sitting in deques
+    long pending;               // tasks submitted and not yet finished
+    unsigned next;              // round-robin cursor for external submits
+    int stop;
+};
+
+typedef struct {
+    ThreadPool *tp;
+    int id;
+} WorkerArg;
+
+static _Thread_local int tls_worker = -1;
+static _Thread_local ThreadPool *tls_pool = NULL;
+
+static void deque_push(Deque *d, Task t) {
+    pthread_mutex_lock(&d->mu);
+    if (d->tail - d->head == d->cap) {
+        size_t ncap = d->cap ? d->cap * 2 : 64;
+        Task *nb = (Task*)malloc(ncap * sizeof(Task));
+        for (size_t i = d->head; i < d->tail; i++) nb[i - d->head] = d->buf[i & (d->cap - 1)];
+        free(d->buf);
+        d->tail -= d->head; d->head = 0;
+        d->buf = nb; d->cap = ncap;
+    }
+    d->buf[d->tail++ & (d->cap - 1)] = t;
+    pthread_mutex_unlock(&d->mu);
+}
+
+static int deque_pop(Deque *d, Task *out) {
+    int ok = 0;
+    pthread_mutex_lock(&d->mu);
+    if (d->tail != d->head) { *out = d->buf[--d->tail & (d->cap - 1)]; ok = 1; }
+    pthread_mutex_unlock(&d->mu);
+    return ok;
+}
+
+static int deque_steal(Deque *d, Task *out) {
+    int ok = 0;
+    pthread_mutex_lock(&d->mu);
+    if (d->tail != d->head) { *out = d->buf[d->head++ & (d->cap - 1)]; ok = 1; }
+    pthread_mutex_unlock(&d->mu);
+    return ok;
+}
+
+static int take(ThreadPool *tp, int id, Task *out) {
+    int ok = deque_pop(&tp->q[id], out);
+    for (int k = 1; !ok && k < tp->n; k++) ok = deque_steal(&tp->q[(id + k) % tp->n], out);
+    if (ok) {
+        pthread_mutex_lock(&tp->mu);
+        tp->queued--;
+        pthread_mutex_unlock(&tp->mu);
+    }
+    return ok;
+}
+
+static void *worker_main(void *p) {
+    WorkerArg *wa = (WorkerArg*)p;
+    ThreadPool *tp = wa->tp;
+    int id = wa->id;
+    free(wa);
+    tls_worker = id;
+    tls_pool = tp;
+    while (1) {
+        Task t;
+        if (take(tp, id, &t)) {
+            t.fn(t.arg);
+            pthread_mutex_lock(&tp->mu);
+            if (--tp->pending == 0) pthread_cond_broadcast(&tp->done_cv);
+            pthread_mutex_unlock(&tp->mu);
+            continue;
+        }
+        pthread_mutex_lock(&tp->mu);
+        while (tp->queued <= 0 && !tp->stop) pthread_cond_wait(&tp->work_cv, &tp->mu);
+        int done = tp->stop && tp->queued <= 0;
+        pthread_mutex_unlock(&tp->mu);
+        if (done) break;
+    }
+    return NULL;
+}
+
+int tp_default_threads(void) {
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return (int)si.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+int tp_pin_workers(ThreadPool *tp) {
+#ifdef __linux__
+    // the allowed set, not 0..n-1: under taskset or a container cpuset they differ
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0) return -1;
+    int ncpu = CPU_COUNT(&allowed), rc = 0;
+    for (int i = 0; i < tp->n; i++) {
+        int want = i % ncpu, cpu = -1;
+        for (int c = 0; c < CPU_SETSIZE && want >= 0; c++) if (CPU_ISSET(c, &allowed) && want-- == 0) cpu = c;
+        cpu_set_t one;
+        CPU_ZERO(&one);
+        CPU_SET(cpu, &one);
+        if (pthread_setaffinity_np(tp->threads[i], sizeof(one), &one) != 0) rc = -1;
+    }
+    return rc;
+#else
+    (void)tp;
+    return -1;
+#endif
+}
+
+ThreadPool *tp_create(int nthreads) {
+    if (nthreads < 1) nthreads = tp_default_threads();
+    ThreadPool *tp = (ThreadPool*)calloc(1, sizeof(ThreadPool));
+    tp->n = nthreads;
+    tp->threads = (pthread_t*)calloc((size_t)nthreads, sizeof(pthread_t));
+    tp->q = (Deque*)calloc((size_t)nthreads, sizeof(Deque));
+    pthread_mutex_init(&tp->mu, NULL);
+    pthread_cond_init(&tp->work_cv, NULL);
+    pthread_cond_init(&tp->done_cv, NULL);
+    for (int i = 0; i < nthreads; i++) pthread_mutex_init(&tp->q[i].mu, NULL);
+    for (int i = 0; i < nthreads; i++) {
+        WorkerArg *wa = (WorkerArg*)malloc(sizeof(WorkerArg));
+        wa->tp = tp; wa->id = i;
+        pthread_create(&tp->threads[i], NULL, worker_main, wa);
+    }
+    return tp;
+}
+
+void tp_submit(ThreadPool *tp, tp_fn fn, void *arg) {
+    Task t = { fn, arg };
+    int id;
+    pthread_mutex_lock(&tp->mu);
+    tp->pending++;
+    id = (tls_pool == tp) ? tls_worker : (int)(tp->next++ % (unsigned)tp->n);
+    pthread_mutex_unlock(&tp->mu);
+    deque_push(&tp->q[id], t);
+    pthread_mutex_lock(&tp->mu);
+    tp->queued++;
+    pthread_cond_signal(&tp->work_cv);
+    pthread_mutex_unlock(&tp->mu);
+}
+
+void tp_wait(ThreadPool *tp) {
+    pthread_mutex_lock(&tp->mu);
+    while (tp->pending > 0) pthread_cond_wait(&tp->done_cv, &tp->mu);
+    pthread_mutex_unlock(&tp->mu);
+}
+
+void tp_destroy(ThreadPool *tp) {
+    if (!tp) return;
+    tp_wait(tp);
+    pthread_mutex_lock(&tp->mu);
+    tp->stop = 1;
+    pthread_cond_broadcast(&tp->work_cv);
+    pthread_mutex_unlock(&tp->mu);
+    for (int i = 0; i < tp->n; i++) pthread_join(tp->threads[i], NULL);
+    for (int i = 0; i < tp->n; i++) {
+        pthread_mutex_destroy(&tp->q[i].mu);
+        free(tp->q[i].buf);
+    }
+    pthread_mutex_destroy(&tp->mu);
+    pthread_cond_destroy(&tp->work_cv);
+    pthread_cond_destroy(&tp->done_cv);
+    free(tp->q);
+    free(tp->threads);
+    free(tp);
+}
+
+int tp_worker_id(void) {
+    return tls_worker;
+}
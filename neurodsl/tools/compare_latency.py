@@ -0,0 +1,53 @@
+"""Compare single-image inference latency of the Keras model and the native C model.
+
+Usage (from the neurodsl directory):
+    ./neurodsl examples/example.nn                 # generated/model.py
+    ./neurodsl --target=c examples/example.nn      # generated/model.c
+    python tools/compare_latency.py [iterations]
+
+Both models get the same MNIST-shaped random input. Weights are random in
+both cases; only latency is compared, not outputs.
+"""
+import os
+import subprocess
+import sys
+import time
+
+ITERS = int(sys.argv[1]) if len(sys.argv) > 1 else 1000
+HERE = os.path.dirname(os.path.abspath(__file__))
+GEN = os.path.join(HERE, '..', 'generated')
+
+
+def bench_c():
+    exe = os.path.join(GEN, 'model_bench')
+    src = os.path.join(GEN, 'model.c')
+    subprocess.check_call(['cc', '-O3', '-march=native', '-DNN_BENCH', src, '-o', exe, '-lm'])
+    out = subprocess.check_output([exe, str(ITERS)]).decode()
+    return float(out.split(':')[1].split('us')[0])
+
+
+def bench_keras():
+    os.environ['TF_CPP_MIN_LOG_LEVEL'] = '2'
+    import numpy as np
+    sys.path.insert(0, GEN)
+    import model as generated
+    m = generated.build_model()
+    x = np.random.rand(1, *m.input_shape[1:]).astype('float32')
+    for _ in range(10):
+        m(x, training=False)
+    t0 = time.perf_counter()
+    for _ in range(ITERS):
+        m(x, training=False)
+    return (time.perf_counter() - t0) / ITERS * 1e6
+
+
+if __name__ == '__main__':
+    c_us = bench_c()
+    print('native C : %10.2f us/inference' % c_us)
+    try:
+        k_us = bench_keras()
+    except ImportError as e:
+        print('keras    : skipped (%s)' % e)
+        sys.exit(0)
+    print('keras    : %10.2f us/inference' % k_us)
+    print('speedup  : %10.1fx' % (k_us / c_us))
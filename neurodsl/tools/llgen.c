@@ -0,0 +1,475 @@
+// llgen: LL(1) parse table generator for the NeuroDSL grammar.
+//
+//   gcc tools/llgen.c -o llgen
+//   ./llgen grammar/neurodsl.g include/grammar.h src/grammar.c
+//
+// Reads the grammar, computes nullable/FIRST/FOLLOW, fills the predictive
+// parse table and fails on any LL(1) conflict. The generated files are
+// committed, so building the compiler does not need this tool.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define MAX_SYMS 256
+#define MAX_PRODS 250
+#define MAX_RHS 32
+#define MAX_WORDS 128
+#define NAME_LEN 48
+
+enum { SYM_T, SYM_NT, SYM_ACT };
+
+typedef struct {
+    char name[NAME_LEN];
+    int kind;
+    int index;          // position among symbols of the same kind
+    int defined;        // nonterminal has a rule
+    int nullable;
+} Sym;
+
+typedef struct {
+    int lhs;
+    int rhs[MAX_RHS];
+    int n;
+} Prod;
+
+static Sym syms[MAX_SYMS];
+static int n_syms, n_kind[3];
+static Prod prods[MAX_PRODS];
+static int n_prods;
+static unsigned char first[MAX_SYMS][MAX_SYMS], follow[MAX_SYMS][MAX_SYMS];   // [nonterminal][terminal]
+static int table[MAX_SYMS][MAX_SYMS];
+
+static struct { char word[NAME_LEN]; char tok[NAME_LEN]; } keywords[MAX_WORDS];
+static int n_keywords;
+static char params[MAX_WORDS][NAME_LEN];
+static int n_params;
+static int recover[MAX_SYMS];
+static char start_name[NAME_LEN];
+static const char *grammar_path;
+static int line = 1;
+
+static void die(const char *fmt, const char *arg) {
+    fprintf(stderr, "%s:%d: ", grammar_path, line);
+    fprintf(stderr, fmt, arg);
+    fputc('\n', stderr);
+    exit(1);
+}
+
+static int sym_find(const char *name) {
+    for (int i = 0; i < n_syms; i++) if (strcmp(syms[i].name, name) == 0) return i;
+    return -1;
+}
+
+// @name is an action, UPPER is a terminal, anything else a nonterminal
+static int sym_get(const char *word) {
+    int kind = word[0] == '@' ? SYM_ACT : isupper((unsigned char)word[0]) ? SYM_T : SYM_NT;
+    const char *name = kind == SYM_ACT ? word + 1 : word;
+    int i = sym_find(name);
+    if (i >= 0) {
+        if (syms[i].kind != kind) die("symbol '%s' used with two kinds", name);
+        return i;
+    }
+    if (n_syms == MAX_SYMS) die("too many symbols at '%s'", name);
+    Sym *s = &syms[n_syms];
+    snprintf(s->name, NAME_LEN, "%s", name);
+    s->kind = kind;
+    s->index = n_kind[kind]++;
+    return n_syms++;
+}
+
+// ---- reading the grammar ----
+
+static char *src;
+static size_t pos, len;
+
+static void skip_space(void) {
+    while (pos < len) {
+        if (src[pos] == '\n') { line++; pos++; }
+        else if (isspace((unsigned char)src[pos])) pos++;
+        else if (src[pos] == '#') { while (pos < len && src[pos] != '\n') pos++; }
+        else break;
+    }
+}
+
+// next word on the current line, for directives; returns 0 at line end
+static int line_word(char *out) {
+    while (pos < len && src[pos] != '\n' && isspace((unsigned char)src[pos])) pos++;
+    if (pos >= len || src[pos] == '\n' || src[pos] == '#') return 0;
+    size_t n = 0;
+    while (pos < len && !isspace((unsigned char)src[pos]) && src[pos] != '#') {
+        if (n + 1 < NAME_LEN) out[n++] = src[pos];
+        pos++;
+    }
+    out[n] = '\0';
+    return 1;
+}
+
+// a name, or one of the punctuators : | ; as a one-char string
+static int next_word(char *out) {
+    skip_space();
+    if (pos >= len) return 0;
+    char c = src[pos];
+    if (c == ':' || c == '|' || c == ';' || c == '%') { out[0] = c; out[1] = '\0'; pos++; return 1; }
+    size_t n = 0;
+    if (c == '@') out[n++] = src[pos++];
+    while (pos < len && (isalnum((unsigned char)src[pos]) || src[pos] == '_')) {
+        if (n + 1 < NAME_LEN) out[n++] = src[pos];
+        pos++;
+    }
+    out[n] = '\0';
+    if (n == 0 || (n == 1 && c == '@')) {
+        char bad[2] = { c, 0 };
+        die("unexpected character '%s'", bad);
+    }
+    return 1;
+}
+
+static void directive(void) {
+    char d[NAME_LEN], w[NAME_LEN];
+    if (!line_word(d)) die("empty directive%s", "");
+    if (strcmp(d, "start") == 0) {
+        if (!line_word(start_name)) die("%%start needs a nonterminal%s", "");
+    } else if (strcmp(d, "keyword") == 0) {
+        if (n_keywords == MAX_WORDS) die("too many keywords%s", "");
+        if (!line_word(keywords[n_keywords].word) || !line_word(keywords[n_keywords].tok))
+            die("%%keyword needs a word and a terminal%s", "");
+        sym_get(keywords[n_keywords].tok);
+        n_keywords++;
+    } else if (strcmp(d, "param") == 0) {
+        while (line_word(w)) {
+            if (n_params == MAX_WORDS) die("too many params%s", "");
+            snprintf(params[n_params++], NAME_LEN, "%s", w);
+        }
+    } else if (strcmp(d, "recover") == 0) {
+        while (line_word(w)) recover[sym_get(w)] = 1;
+    } else {
+        die("unknown directive %%%s", d);
+    }
+}
+
+static void read_grammar(void) {
+    char w[NAME_LEN];
+    while (next_word(w)) {
+        if (w[0] == '%') { directive(); continue; }
+        int lhs = sym_get(w);
+        if (syms[lhs].kind != SYM_NT) die("rule for non-nonterminal '%s'", w);
+        if (syms[lhs].defined) die("two rules for '%s'; use | for alternatives", w);
+        syms[lhs].defined = 1;
+        if (!next_word(w) || strcmp(w, ":") != 0) die("expected ':' after %s", syms[lhs].name);
+        Prod *p = &prods[n_prods++];
+        p->lhs = lhs;
+        while (1) {
+            if (!next_word(w)) die("missing ';' after rule %s", syms[lhs].name);
+            if (strcmp(w, ";") == 0) break;
+            if (strcmp(w, "|") == 0) {
+                if (n_prods == MAX_PRODS) die("too many productions%s", "");
+                p = &prods[n_prods++];
+                p->lhs = lhs;
+                continue;
+            }
+            if (p->n == MAX_RHS) die("production too long in %s", syms[lhs].name);
+            p->rhs[p->n++] = sym_get(w);
+        }
+    }
+}
+
+// ---- analysis ----
+
+// FIRST of rhs[from..]; returns 1 if that suffix is nullable
+static int first_of(const Prod *p, int from, unsigned char *out) {
+    for (int i = from; i < p->n; i++) {
+        const Sym *s = &syms[p->rhs[i]];
+        if (s->kind == SYM_ACT) continue;
+        if (s->kind == SYM_T) { out[p->rhs[i]] = 1; return 0; }
+        for (int t = 0; t < n_syms; t++) if (first[p->rhs[i]][t]) out[t] = 1;
+        if (!s->nullable) return 0;
+    }
+    return 1;
+}
+
+static void compute_sets(int start) {
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int k = 0; k < n_prods; k++) {
+            Prod *p = &prods[k];
+            unsigned char f[MAX_SYMS] = {0};
+            int nul = first_of(p, 0, f);
+            if (nul && !syms[p->lhs].nullable) { syms[p->lhs].nullable = 1; changed = 1; }
+            for (int t = 0; t < n_syms; t++)
+                if (f[t] && !first[p->lhs][t]) { first[p->lhs][t] = 1; changed = 1; }
+        }
+    }
+    int eof = sym_find("EOF");
+    if (eof >= 0) follow[start][eof] = 1;
+    changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int k = 0; k < n_prods; k++) {
+            Prod *p = &prods[k];
+            for (int i = 0; i < p->n; i++) {
+                int b = p->rhs[i];
+                if (syms[b].kind != SYM_NT) continue;
+                unsigned char f[MAX_SYMS] = {0};
+                int nul = first_of(p, i + 1, f);
+                if (nul) for (int t = 0; t < n_syms; t++) if (follow[p->lhs][t]) f[t] = 1;
+                for (int t = 0; t < n_syms; t++)
+                    if (f[t] && !follow[b][t]) { follow[b][t] = 1; changed = 1; }
+            }
+        }
+    }
+}
+
+static void fill_table(void) {
+    int conflicts = 0;
+    for (int k = 0; k < n_prods; k++) {
+        Prod *p = &prods[k];
+        unsigned char f[MAX_SYMS] = {0};
+        if (first_of(p, 0, f))
+            for (int t = 0; t < n_syms; t++) if (follow[p->lhs][t]) f[t] = 1;
+        for (int t = 0; t < n_syms; t++) {
+            if (!f[t]) continue;
+            if (table[p->lhs][t] && table[p->lhs][t] != k + 1) {
+                fprintf(stderr, "%s: LL(1) conflict in %s on %s: productions %d and %d\n",
+                        grammar_path, syms[p->lhs].name, syms[t].name, table[p->lhs][t] - 1, k);
+                conflicts++;
+            }
+            table[p->lhs][t] = k + 1;
+        }
+    }
+    if (conflicts) exit(1);
+}
+
+// ---- output ----
+
+static void upper(char *dst, const char *s) {
+    while (*s) *dst++ = (char)toupper((unsigned char)*s++);
+    *dst = '\0';
+}
+
+static void sym_ref(FILE *f, int s) {
+    char u[NAME_LEN];
+    upper(u, syms[s].name);
+    if (syms[s].kind == SYM_T) fprintf(f, "TOK_%s", u);
+    else if (syms[s].kind == SYM_NT) fprintf(f, "LL_NT(NT_%s)", u);
+    else fprintf(f, "LL_ACT(ACT_%s)", u);
+}
+
+static void print_prod(FILE *f, const Prod *p) {
+    fprintf(f, "%s ->", syms[p->lhs].name);
+    for (int i = 0; i < p->n; i++) fprintf(f, " %s%s", syms[p->rhs[i]].kind == SYM_ACT ? "@" : "", syms[p->rhs[i]].name);
+    if (p->n == 0) fprintf(f, " (empty)");
+}
+
+static void print_set(FILE *f, const unsigned char *set) {
+    for (int t = 0; t < n_syms; t++) if (set[t]) fprintf(f, " %s", syms[t].name);
+}
+
+static void write_header(FILE *f) {
+    char u[NAME_LEN];
+    fprintf(f, "// Generated by tools/llgen.c from %s. Do not edit.\n", grammar_path);
+    fprintf(f, "#ifndef GRAMMAR_H\n#define GRAMMAR_H\n\n#include <stddef.h>\n#include \"lexer.h\"\n\n");
+    fprintf(f, "typedef enum {\n");
+    for (int i = 0; i < n_syms; i++)
+        if (syms[i].kind == SYM_NT) { upper(u, syms[i].name); fprintf(f, "    NT_%s,\n", u); }
+    fprintf(f, "    NT_COUNT\n} Nonterminal;\n\n");
+    fprintf(f, "typedef enum {\n");
+    for (int i = 0; i < n_syms; i++)
+        if (syms[i].kind == SYM_ACT) { upper(u, syms[i].name); fprintf(f, "    ACT_%s,\n", u); }
+    fprintf(f, "    ACT_COUNT\n} Action;\n\n");
+    fprintf(f, "// identifiers the lexer recognises as parameter names (Token.param)\n");
+    fprintf(f, "typedef enum {\n    PARAM_NONE,\n");
+    for (int i = 0; i < n_params; i++) { upper(u, params[i]); fprintf(f, "    PARAM_%s,\n", u); }
+    fprintf(f, "    PARAM_COUNT\n} ParamId;\n\n");
+    upper(u, start_name);
+    fprintf(f,
+        "// parse stack symbols: TokenType values, then nonterminals, then actions\n"
+        "#define LL_NT(x) (TOK_COUNT + (x))\n"
+        "#define LL_ACT(x) (TOK_COUNT + NT_COUNT + (x))\n"
+        "#define LL_START LL_NT(NT_%s)\n\n", u);
+    fprintf(f,
+        "extern const unsigned char ll_table[NT_COUNT][TOK_COUNT];  // production + 1, 0 = no entry\n"
+        "extern const unsigned char ll_default[NT_COUNT];           // epsilon production + 1 of nullable nonterminals\n"
+        "extern const unsigned char ll_recover[NT_COUNT];           // skip unexpected tokens here\n"
+        "extern const unsigned short ll_rhs_start[];                // production p is ll_rhs[ll_rhs_start[p] .. ll_rhs_start[p + 1])\n"
+        "extern const unsigned short ll_rhs[];                      // right-hand sides, reversed for pushing\n"
+        "extern const char *const ll_nt_name[NT_COUNT];\n"
+        "extern const char *const param_name[PARAM_COUNT];\n\n"
+        "// keyword and parameter name lookup for an identifier span; sets *param\n"
+        "TokenType lookup_word(const char *s, size_t n, unsigned int *param);\n\n"
+        "#endif\n");
+}
+
+// Smallest power-of-two table, then smallest multipliers, for which
+// (s[0] * a + s[n - 1] * b + n * c) & (size - 1) puts every word in its own slot.
+static int find_word_hash(const char **w, int n, unsigned *size, unsigned *a, unsigned *b, unsigned *c, int *slot) {
+    for (*size = 16; *size <= 1024; *size *= 2) {
+        if ((unsigned)n > *size) continue;
+        for (*a = 1; *a < 64; (*a)++)
+            for (*b = 1; *b < 64; (*b)++)
+                for (*c = 0; *c < 16; (*c)++) {
+                    unsigned char used[1024] = {0};
+                    int i;
+                    for (i = 0; i < n; i++) {
+                        size_t len = strlen(w[i]);
+                        unsigned h = ((unsigned char)w[i][0] * *a + (unsigned char)w[i][len - 1] * *b + (unsigned)len * *c) & (*size - 1);
+                        if (used[h]) break;
+                        used[h] = 1;
+                        slot[i] = (int)h;
+                    }
+                    if (i == n) return 1;
+                }
+    }
+    return 0;
+}
+
+static void write_source(FILE *f) {
+    char u[NAME_LEN];
+    fprintf(f, "// Generated by tools/llgen.c from %s. Do not edit.\n", grammar_path);
+    fprintf(f, "#include <string.h>\n#include \"../include/grammar.h\"\n\n");
+
+    fprintf(f, "/*\n");
+    for (int i = 0; i < n_syms; i++) {
+        if (syms[i].kind != SYM_NT) continue;
+        fprintf(f, " * %-12s FIRST  {", syms[i].name);
+        print_set(f, first[i]);
+        fprintf(f, " }%s\n * %-12s FOLLOW {", syms[i].nullable ? " nullable" : "", "");
+        print_set(f, follow[i]);
+        fprintf(f, " }\n");
+    }
+    fprintf(f, " */\n\n");
+
+    fprintf(f, "const unsigned char ll_table[NT_COUNT][TOK_COUNT] = {\n");
+    for (int i = 0; i < n_syms; i++) {
+        if (syms[i].kind != SYM_NT) continue;
+        upper(u, syms[i].name);
+        fprintf(f, "    [NT_%s] = {", u);
+        int any = 0;
+        for (int t = 0; t < n_syms; t++) {
+            if (!table[i][t]) continue;
+            fprintf(f, "%s[", any++ ? ", " : " ");
+            sym_ref(f, t);
+            fprintf(f, "] = %d", table[i][t]);
+        }
+        fprintf(f, "%s},\n", any ? " " : "");
+    }
+    fprintf(f, "};\n\n");
+
+    fprintf(f, "const unsigned char ll_default[NT_COUNT] = {\n");
+    for (int k = 0; k < n_prods; k++) {
+        unsigned char dummy[MAX_SYMS] = {0};
+        if (!first_of(&prods[k], 0, dummy)) continue;
+        upper(u, syms[prods[k].lhs].name);
+        fprintf(f, "    [NT_%s] = %d,\n", u, k + 1);
+    }
+    fprintf(f, "};\n\n");
+
+    fprintf(f, "const unsigned char ll_recover[NT_COUNT] = {\n");
+    for (int i = 0; i < n_syms; i++)
+        if (recover[i]) { upper(u, syms[i].name); fprintf(f, "    [NT_%s] = 1,\n", u); }
+    fprintf(f, "};\n\n");
+
+    fprintf(f, "const unsigned short ll_rhs_start[] = {");
+    int at = 0;
+    for (int k = 0; k <= n_prods; k++) {
+        fprintf(f, "%s%d", k ? ", " : " ", at);
+        if (k < n_prods) at += prods[k].n;
+    }
+    fprintf(f, " };\n\n");
+
+    fprintf(f, "const unsigned short ll_rhs[] = {\n");
+    for (int k = 0; k < n_prods; k++) {
+        fprintf(f, "    // %d: ", k);
+        print_prod(f, &prods[k]);
+        fprintf(f, "\n");
+        if (prods[k].n == 0) continue;
+        fprintf(f, "   ");
+        for (int i = prods[k].n - 1; i >= 0; i--) { fprintf(f, " "); sym_ref(f, prods[k].rhs[i]); fprintf(f, ","); }
+        fprintf(f, "\n");
+    }
+    fprintf(f, "    0\n};\n\n");
+
+    fprintf(f, "const char *const ll_nt_name[NT_COUNT] = {");
+    for (int i = 0, k = 0; i < n_syms; i++)
+        if (syms[i].kind == SYM_NT) fprintf(f, "%s\"%s\"", k++ ? ", " : " ", syms[i].name);
+    fprintf(f, " };\n\n");
+
+    fprintf(f, "const char *const param_name[PARAM_COUNT] = { \"\"");
+    for (int i = 0; i < n_params; i++) fprintf(f, ", \"%s\"", params[i]);
+    fprintf(f, " };\n\n");
+
+    // keywords and parameter names in a perfect hash table: one hash, one
+    // length check and one memcmp per identifier
+    const char *words[2 * MAX_WORDS];
+    int nw = 0;
+    size_t maxlen = 0;
+    for (int i = 0; i < n_keywords; i++) words[nw++] = keywords[i].word;
+    for (int i = 0; i < n_params; i++) words[nw++] = params[i];
+    for (int i = 0; i < nw; i++) if (strlen(words[i]) > maxlen) maxlen = strlen(words[i]);
+    unsigned size, a, b, c;
+    int slot[2 * MAX_WORDS];
+    if (!find_word_hash(words, nw, &size, &a, &b, &c, slot)) die("no perfect hash for the keywords%s", "");
+    fprintf(f, "// perfect hash of the %d keywords and parameter names, found by llgen\n", nw);
+    fprintf(f, "#define WORD_HASH(s, n) (((unsigned char)(s)[0] * %uu + (unsigned char)(s)[(n) - 1] * %uu + (unsigned)(n) * %uu) & %uu)\n\n", a, b, c, size - 1);
+    fprintf(f, "static const struct { unsigned char len, tok, param; char text[%zu]; } word_table[%u] = {\n", maxlen + 1, size);
+    for (int i = 0; i < nw; i++) {
+        fprintf(f, "    [%d] = { %zu, ", slot[i], strlen(words[i]));
+        if (i < n_keywords) fprintf(f, "TOK_%s, PARAM_NONE", keywords[i].tok);
+        else { upper(u, words[i]); fprintf(f, "TOK_IDENTIFIER, PARAM_%s", u); }
+        fprintf(f, ", \"%s\" },\n", words[i]);
+    }
+    fprintf(f, "};\n\n");
+    fprintf(f, "TokenType lookup_word(const char *s, size_t n, unsigned int *param) {\n");
+    fprintf(f, "    *param = PARAM_NONE;\n");
+    fprintf(f, "    if (n == 0 || n > %zu) return TOK_IDENTIFIER;\n", maxlen);
+    fprintf(f, "    unsigned h = WORD_HASH(s, n);\n");
+    fprintf(f, "    if (word_table[h].len != n || memcmp(word_table[h].text, s, n) != 0) return TOK_IDENTIFIER;\n");
+    fprintf(f, "    *param = word_table[h].param;\n");
+    fprintf(f, "    return (TokenType)word_table[h].tok;\n");
+    fprintf(f, "}\n");
+}
+
+static FILE *open_out(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) { perror(path); exit(1); }
+    return f;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 4) {
+        fprintf(stderr, "usage: %s grammar.g out.h out.c\n", argv[0]);
+        return 2;
+    }
+    grammar_path = argv[1];
+    FILE *in = fopen(grammar_path, "rb");
+    if (!in) { perror(grammar_path); return 1; }
+    fseek(in, 0, SEEK_END);
+    len = (size_t)ftell(in);
+    rewind(in);
+    src = (char*)malloc(len + 1);
+    if (!src || fread(src, 1, len, in) != len) { perror(grammar_path); return 1; }
+    fclose(in);
+
+    read_grammar();
+    if (!start_name[0]) die("missing %%start%s", "");
+    int start = sym_find(start_name);
+    if (start < 0 || syms[start].kind != SYM_NT) die("start symbol '%s' has no rule", start_name);
+    for (int i = 0; i < n_syms; i++) {
+        if (syms[i].kind == SYM_NT && !syms[i].defined) die("nonterminal '%s' has no rule", syms[i].name);
+        if (recover[i] && syms[i].kind != SYM_NT) die("%%recover on non-nonterminal '%s'", syms[i].name);
+    }
+    compute_sets(start);
+    fill_table();
+
+    FILE *h = open_out(argv[2]);
+    write_header(h);
+    fclose(h);
+    FILE *c = open_out(argv[3]);
+    write_source(c);
+    fclose(c);
+    printf("%s: %d terminals, %d nonterminals, %d actions, %d productions\n",
+           grammar_path, n_kind[SYM_T], n_kind[SYM_NT], n_kind[SYM_ACT], n_prods);
+    return 0;
+}
@@ -0,0 +1,89 @@
+"""Load test for the compile server (neurodsl --serve).
+
+Usage (from the neurodsl directory):
+    ./neurodsl --serve /tmp/neurodsl.sock --jobs 8 &
+    python tools/loadtest.py /tmp/neurodsl.sock [--clients 16] [--requests 200]
+                             [--file examples/example.nn] [--target python|c] [--same-source]
+
+Every client keeps one connection open and sends its requests back to back.
+By default each request gets a unique trailing comment, so nothing is
+served from the server's result cache; --same-source measures cache hits.
+Prints p50/p90/p99/max latency and requests/s.
+"""
+import argparse
+import socket
+import threading
+import time
+
+
+def recv_response(f):
+    head = f.readline().split()
+    if len(head) != 3:
+        raise RuntimeError('bad response header %r' % head)
+    status, out_len, diag_len = head[0], int(head[1]), int(head[2])
+    body = f.read(out_len + diag_len)
+    if len(body) != out_len + diag_len:
+        raise RuntimeError('short response')
+    return status == b'OK'
+
+
+def client(path, src, args, cid, lat, errors):
+    s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    s.connect(path)
+    f = s.makefile('rb')
+    for i in range(args.requests):
+        body = src if args.same_source else src + b'# client %d request %d\n' % (cid, i)
+        head = b'COMPILE %s %d %s loadtest-%d.nn\n' % (args.target.encode(), len(body), args.options.encode(), cid)
+        t0 = time.perf_counter()
+        s.sendall(head + body)
+        ok = recv_response(f)
+        lat.append(time.perf_counter() - t0)
+        if not ok:
+            errors.append(i)
+    s.close()
+
+
+def pct(sorted_lat, p):
+    return sorted_lat[min(len(sorted_lat) - 1, int(len(sorted_lat) * p / 100.0))]
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument('socket')
+    ap.add_argument('--clients', type=int, default=16)
+    ap.add_argument('--requests', type=int, default=200, help='per client')
+    ap.add_argument('--file', default='examples/example.nn')
+    ap.add_argument('--target', default='python', choices=['python', 'c'])
+    ap.add_argument('--options', default='-', help='e.g. no-fuse,int8 (- for none)')
+    ap.add_argument('--same-source', action='store_true')
+    args = ap.parse_args()
+    with open(args.file, 'rb') as f:
+        src = f.read()
+    if not src.endswith(b'\n'):
+        src += b'\n'
+
+    lats = [[] for _ in range(args.clients)]
+    errors = []
+    threads = [threading.Thread(target=client, args=(args.socket, src, args, i, lats[i], errors))
+               for i in range(args.clients)]
+    t0 = time.perf_counter()
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    wall = time.perf_counter() - t0
+
+    lat = sorted(x for l in lats for x in l)
+    n = len(lat)
+    if n == 0:
+        print('no requests completed')
+        return 1
+    print('%d requests from %d clients in %.2fs: %.0f requests/s, %d failed'
+          % (n, args.clients, wall, n / wall, len(errors)))
+    print('latency ms: p50 %.3f  p90 %.3f  p99 %.3f  max %.3f'
+          % (pct(lat, 50) * 1e3, pct(lat, 90) * 1e3, pct(lat, 99) * 1e3, lat[-1] * 1e3))
+    return 0
+
+
+if __name__ == '__main__':
+    raise SystemExit(main())